@@ -19,19 +19,84 @@ CONFIG-=app_bundle
 # Auto include all .cpp files in the project src directory (can specifiy individually if required)
 SOURCES+= $$PWD/src/NGLScene.cpp \
 					$$PWD/src/main.cpp \
-          $$PWD/src/MeshWithAABB.cpp
+          $$PWD/src/MeshWithAABB.cpp \
+          $$PWD/src/SceneGraph.cpp \
+          $$PWD/src/IndexedMesh.cpp \
+          $$PWD/src/MeshLOD.cpp \
+          $$PWD/src/OcclusionCuller.cpp \
+          $$PWD/src/SoftwareOcclusion.cpp \
+          $$PWD/src/GeometryCache.cpp \
+          $$PWD/src/SceneFile.cpp \
+          $$PWD/src/AsyncLoader.cpp \
+          $$PWD/src/CompressedTexture.cpp \
+          $$PWD/src/FrameArena.cpp \
+          $$PWD/src/AllocationCounter.cpp \
+          $$PWD/src/Profiler.cpp \
+          $$PWD/src/Stats.cpp \
+          $$PWD/src/EventRecording.cpp \
+          $$PWD/src/ComputeBounds.cpp \
+          $$PWD/src/ConvexHull.cpp \
+          $$PWD/src/Benchmark.cpp \
+          $$PWD/src/WorkerPool.cpp \
+          $$PWD/src/SpatialHashGrid.cpp \
+          $$PWD/src/LinearBVH.cpp \
+          $$PWD/src/DeformingBVH.cpp \
+          $$PWD/src/MappedBVH.cpp \
+          $$PWD/src/AtomicWrite.cpp \
+          $$PWD/src/QuantizedVertex.cpp \
+          $$PWD/src/CompressedBVH.cpp \
+          $$PWD/src/Meshlets.cpp \
+          $$PWD/src/IndirectRenderer.cpp \
+          $$PWD/src/IndexOptimizer.cpp \
+          $$PWD/src/FrustumSet.cpp \
+          $$PWD/src/ViewportLayout.cpp
 # same for the .h files
 HEADERS+= $$PWD/include/NGLScene.h \
-					$$PWD/include/MeshWithAABB.h
+					$$PWD/include/MeshWithAABB.h \
+					$$PWD/include/AABB.h \
+					$$PWD/include/SceneGraph.h \
+					$$PWD/include/IndexedMesh.h \
+					$$PWD/include/MeshLOD.h \
+					$$PWD/include/OcclusionCuller.h \
+					$$PWD/include/SoftwareOcclusion.h \
+					$$PWD/include/GeometryCache.h \
+					$$PWD/include/SceneFile.h \
+					$$PWD/include/AsyncLoader.h \
+					$$PWD/include/CompressedTexture.h \
+					$$PWD/include/FrameArena.h \
+					$$PWD/include/AllocationCounter.h \
+					$$PWD/include/Profiler.h \
+					$$PWD/include/Stats.h \
+					$$PWD/include/EventRecording.h \
+					$$PWD/include/ComputeBounds.h \
+					$$PWD/include/ConvexHull.h \
+					$$PWD/include/Benchmark.h \
+					$$PWD/include/WorkerPool.h \
+					$$PWD/include/SpatialHashGrid.h \
+					$$PWD/include/LinearBVH.h \
+					$$PWD/include/DeformingBVH.h \
+					$$PWD/include/MappedBVH.h \
+					$$PWD/include/AtomicWrite.h \
+					$$PWD/include/QuantizedVertex.h \
+					$$PWD/include/CompressedBVH.h \
+					$$PWD/include/Meshlets.h \
+					$$PWD/include/IndirectRenderer.h \
+					$$PWD/include/IndexOptimizer.h \
+					$$PWD/include/FrustumSet.h \
+					$$PWD/include/ViewportLayout.h
 # and add the include dir into the search path for Qt and make
 INCLUDEPATH +=./include
 # where our exe is going to live (root of project)
 DESTDIR=./
 # add the glsl shader files
 OTHER_FILES+= shaders/*.glsl \
+							scenes/*.scene \
+							layouts/*.layout \
 							README.md
 # were are going to default to a console app
 CONFIG += console
+# the asset loader uses std::thread
+CONFIG += thread
 # note each command you add needs a ; as it will be run as a single line
 # first check if we are shadow building or not easiest way is to check out against current
 !equals(PWD, $${OUT_PWD}){
@@ -40,11 +105,15 @@ CONFIG += console
 	copydata.commands += mkdir -p $$OUT_PWD/shaders ;
 	copydata.commands += mkdir -p $$OUT_PWD/textures ;
 	copydata.commands += mkdir -p $$OUT_PWD/models ;
+	copydata.commands += mkdir -p $$OUT_PWD/scenes ;
+	copydata.commands += mkdir -p $$OUT_PWD/layouts ;
 	copydata.commands += echo "copying files" ;
 	# then copy the files
 	copydata.commands += $(COPY_DIR) $$PWD/shaders/* $$OUT_PWD/shaders/ ;
 	copydata.commands += $(COPY_DIR) $$PWD/textures/* $$OUT_PWD/textures/ ;
 	copydata.commands += $(COPY_DIR) $$PWD/models/* $$OUT_PWD/models/ ;
+	copydata.commands += $(COPY_DIR) $$PWD/scenes/* $$OUT_PWD/scenes/ ;
+	copydata.commands += $(COPY_DIR) $$PWD/layouts/* $$OUT_PWD/layouts/ ;
 	# now make sure the first target is built before copy
 	first.depends = $(first) copydata
 	export(first.depends)
@@ -0,0 +1,30 @@
+# the C interface to the bounding volume code (include/BoundsAPI.h) as a shared library
+TEMPLATE=lib
+TARGET=SimpleAABBBounds
+# where to put the .o files, apart from the app's as they are built with other flags
+OBJECTS_DIR=obj/bounds
+# plain C++, no Qt needed
+QT-=gui core
+CONFIG+=shared thread
+CONFIG-=qt
+# only the saabb_ functions are exported
+QMAKE_CXXFLAGS+=-fvisibility=hidden -fvisibility-inlines-hidden
+DEFINES+=SAABB_BUILD
+SOURCES+= $$PWD/src/BoundsAPI.cpp \
+          $$PWD/src/LinearBVH.cpp \
+          $$PWD/src/WorkerPool.cpp
+HEADERS+= $$PWD/include/BoundsAPI.h \
+					$$PWD/include/LinearBVH.h \
+					$$PWD/include/WorkerPool.h \
+					$$PWD/include/AABB.h
+INCLUDEPATH +=./include
+DESTDIR=./
+NGLPATH=$$(NGLDIR)
+isEmpty(NGLPATH){ # note brace must be here
+	message("including $HOME/NGL")
+	include($(HOME)/NGL/UseNGL.pri)
+}
+else{ # note brace must be here
+	message("Using custom NGL location")
+	include($(NGLDIR)/UseNGL.pri)
+}
@@ -0,0 +1,90 @@
+#ifndef AABB_H_
+#define AABB_H_
+#include <ngl/Vec3.h>
+#include <ngl/Mat4.h>
+#include <algorithm>
+#include <limits>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file AABB.h
+/// @brief a light weight min / max axis aligned box, unlike ngl::BBox this holds no GL
+/// resources so it is cheap to copy, store in flat arrays and update every frame
+//----------------------------------------------------------------------------------------------------------------------
+struct AABB
+{
+  ngl::Vec3 m_min;
+  ngl::Vec3 m_max;
+  // default box is empty (inverted) so the first extend sets it
+  AABB() { reset(); }
+  AABB(const ngl::Vec3 &_min, const ngl::Vec3 &_max) : m_min(_min), m_max(_max) {}
+
+  void reset()
+  {
+    const ngl::Real big=std::numeric_limits<ngl::Real>::max();
+    m_min.set(big,big,big);
+    m_max.set(-big,-big,-big);
+  }
+  bool isEmpty() const { return m_min.m_x>m_max.m_x; }
+
+  void extend(const ngl::Vec3 &_p)
+  {
+    m_min.m_x=std::min(m_min.m_x,_p.m_x); m_max.m_x=std::max(m_max.m_x,_p.m_x);
+    m_min.m_y=std::min(m_min.m_y,_p.m_y); m_max.m_y=std::max(m_max.m_y,_p.m_y);
+    m_min.m_z=std::min(m_min.m_z,_p.m_z); m_max.m_z=std::max(m_max.m_z,_p.m_z);
+  }
+  void extend(const AABB &_b)
+  {
+    m_min.m_x=std::min(m_min.m_x,_b.m_min.m_x); m_max.m_x=std::max(m_max.m_x,_b.m_max.m_x);
+    m_min.m_y=std::min(m_min.m_y,_b.m_min.m_y); m_max.m_y=std::max(m_max.m_y,_b.m_max.m_y);
+    m_min.m_z=std::min(m_min.m_z,_b.m_min.m_z); m_max.m_z=std::max(m_max.m_z,_b.m_max.m_z);
+  }
+
+  // shrink to the overlap with _b, empty if they do not overlap
+  void intersect(const AABB &_b)
+  {
+    m_min.m_x=std::max(m_min.m_x,_b.m_min.m_x); m_max.m_x=std::min(m_max.m_x,_b.m_max.m_x);
+    m_min.m_y=std::max(m_min.m_y,_b.m_min.m_y); m_max.m_y=std::min(m_max.m_y,_b.m_max.m_y);
+    m_min.m_z=std::max(m_min.m_z,_b.m_min.m_z); m_max.m_z=std::min(m_max.m_z,_b.m_max.m_z);
+  }
+
+  ngl::Vec3 center() const { return (m_min+m_max)*0.5f; }
+  ngl::Vec3 size() const { return m_max-m_min; }
+
+  bool overlaps(const AABB &_b) const
+  {
+    return m_min.m_x<=_b.m_max.m_x && m_max.m_x>=_b.m_min.m_x &&
+           m_min.m_y<=_b.m_max.m_y && m_max.m_y>=_b.m_min.m_y &&
+           m_min.m_z<=_b.m_max.m_z && m_max.m_z>=_b.m_min.m_z;
+  }
+
+  ngl::Real surfaceArea() const
+  {
+    ngl::Vec3 d=size();
+    return 2.0f*(d.m_x*d.m_y+d.m_y*d.m_z+d.m_z*d.m_x);
+  }
+
+  // transform the box by _tx (ngl row vector convention v*tx) and return the box of the result.
+  // This is Arvo's method, it gives the same answer as transforming all 8 corners but only
+  // needs 9 multiply / min / max steps
+  AABB transformed(const ngl::Mat4 &_tx) const
+  {
+    AABB r;
+    for(int j=0; j<3; ++j)
+    {
+      ngl::Real lo=_tx.m_m[3][j];
+      ngl::Real hi=lo;
+      for(int i=0; i<3; ++i)
+      {
+        ngl::Real a=_tx.m_m[i][j]*m_min[i];
+        ngl::Real b=_tx.m_m[i][j]*m_max[i];
+        lo+=std::min(a,b);
+        hi+=std::max(a,b);
+      }
+      r.m_min[j]=lo;
+      r.m_max[j]=hi;
+    }
+    return r;
+  }
+};
+
+#endif
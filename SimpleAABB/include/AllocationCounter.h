@@ -0,0 +1,22 @@
+#ifndef ALLOCATIONCOUNTER_H_
+#define ALLOCATIONCOUNTER_H_
+#include <cstddef>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file AllocationCounter.h
+/// @brief counts every call to the global operator new (AllocationCounter.cpp replaces it for
+/// the whole program, nothrow and, where the compiler has them, sized and aligned forms
+/// included). Take the count before and after a block of code to see how many heap
+/// allocations it made.
+/// @class AllocationCounter
+//----------------------------------------------------------------------------------------------------------------------
+class AllocationCounter
+{
+  public :
+    // operator new calls since the program started
+    static size_t allocations();
+    // bytes requested by those calls
+    static size_t bytes();
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef ASYNCLOADER_H_
+#define ASYNCLOADER_H_
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file AsyncLoader.h
+/// @brief a small pool of worker threads for loading work that must not block the GL thread.
+/// Jobs run in submission order (several at once) and must not make GL calls, anything GL
+/// related is handed back to the GL thread by the job itself.
+/// @class AsyncLoader
+//----------------------------------------------------------------------------------------------------------------------
+class AsyncLoader
+{
+  public :
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief start the workers
+    /// @param[in] _numThreads 0 means one less than the number of cores (and at least one)
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit AsyncLoader(size_t _numThreads=0);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief jobs that have not started are dropped, running ones are waited for
+    //----------------------------------------------------------------------------------------------------------------------
+    ~AsyncLoader();
+    AsyncLoader(const AsyncLoader &)=delete;
+    AsyncLoader &operator=(const AsyncLoader &)=delete;
+
+    void submit(std::function<void()> _job);
+    // jobs queued or running
+    size_t pending() const {return m_pending.load();}
+
+  private :
+    void worker();
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_quit=false;
+    std::atomic<size_t> m_pending;
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef ATOMICWRITE_H_
+#define ATOMICWRITE_H_
+#include <functional>
+#include <ostream>
+#include <string>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file AtomicWrite.h
+/// @brief writing the on disk caches so that nothing ever reads (or maps) half of one
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief write _file with _write into a temporary name unique to this process and call, then
+/// rename it over _file. Processes or loader threads writing the same cache never write into
+/// each other's temporary, and an interrupted write leaves the old file (or none) behind.
+/// @param[in] _write fills the binary stream, false to give up
+/// @returns false if the file could not be written, the temporary is removed
+//----------------------------------------------------------------------------------------------------------------------
+bool writeAtomically(const std::string &_file, const std::function<bool(std::ostream &_out)> &_write);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+#include <ostream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Benchmark.h
+/// @brief command line benchmarks, these make no GL calls and print their results to stdout
+//----------------------------------------------------------------------------------------------------------------------
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief run the benchmark for a --bench-* command line option, arguments starting with a
+/// digit are counts and the rest obj files, with no arguments at all it uses models/Helix.obj
+/// and the benchmark's usual counts
+/// @param[out] _exitCode the benchmark's process exit code
+/// @returns false if _option is not a benchmark
+//----------------------------------------------------------------------------------------------------------------------
+bool runBenchmark(const std::string &_option, const std::vector<std::string> &_args, int &_exitCode);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief list the --bench-* options, their arguments and what they measure
+//----------------------------------------------------------------------------------------------------------------------
+void printBenchmarks(std::ostream &_out);
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief cost and tightness of the world AABB of each mesh under random rotation, scale and
+/// translation, from the 8 local box corners and from the convex hull, compared with the
+/// exact box of every vertex
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkBounds(const std::vector<std::string> &_objFiles);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief build, box, sphere and pair query times of the SpatialHashGrid and the LinearBVH
+/// against brute force for _counts similar sized boxes at a constant density, checking the
+/// results agree
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkGrid(const std::vector<size_t> &_counts);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief refitting against rebuilding the triangle BVH of each mesh while it is twisted and
+/// bent, with the SAH cost of each and how often DeformingBVH rebuilt in the background
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkRefit(const std::vector<std::string> &_objFiles);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief startup cost of each mesh's triangle BVH, built from the triangles against mapped
+/// from the .bvh cache, checking queries on the mapped tree match the built one
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkBVHCache(const std::vector<std::string> &_objFiles);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief vertex buffer size of each mesh as floats and as QuantizedVertex, with the worst
+/// position, uv and normal error of the quantized copy
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkQuantize(const std::vector<std::string> &_objFiles);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief memory and box query time of the CompressedBVH against the LinearBVH it was built
+/// from, over each mesh's triangles and over synthetic height fields of the given triangle
+/// counts, checking no exact hit is lost
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkCompressed(const std::vector<std::string> &_objFiles, const std::vector<size_t> &_syntheticTriangles);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief triangles each of the four panel cameras would submit with meshlet culling for
+/// randomly placed copies of each mesh, and the time to cull, checking no front facing
+/// triangle with a corner on screen is dropped
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkMeshlets(const std::vector<std::string> &_objFiles);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief vertex cache miss rates (ACMR / ATVR) and overdraw of every level in the obj's
+/// order, as built without IndexOptimizer and as built with it, plus the time of each pass
+/// @returns a process exit code
+//----------------------------------------------------------------------------------------------------------------------
+int benchmarkIndexOrder(const std::vector<std::string> &_objFiles);
+
+#endif
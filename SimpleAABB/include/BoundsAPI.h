@@ -0,0 +1,107 @@
+#ifndef BOUNDSAPI_H_
+#define BOUNDSAPI_H_
+#include <stddef.h>
+#include <stdint.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file BoundsAPI.h
+/// @brief a plain C interface to the bounding volume code, built as the SimpleAABBBounds shared
+/// library so other tools and pipelines can run batch queries without linking C++ or copying
+/// their data into our types. Everything works on arrays the caller owns, read and written in
+/// place with a byte stride between elements so they can sit inside the caller's own structs
+/// (a stride of 0 means tightly packed).
+///
+///   box     6 floats, min x y z then max x y z
+///   matrix  16 floats as ngl::Mat4 and glUniformMatrix4fv without transpose take them,
+///           translation in elements 12 13 14, points are transformed as row vectors p*M
+///   vector  3 floats x y z
+///
+/// Nothing here allocates once a context's scratch has grown to the size of the scene, and no
+/// C++ exception gets out, failures come back as an saabb_status. Calls on one context must not
+/// overlap, separate contexts are independent.
+//----------------------------------------------------------------------------------------------------------------------
+#if defined(_WIN32)
+  #if defined(SAABB_BUILD)
+    #define SAABB_API __declspec(dllexport)
+  #else
+    #define SAABB_API __declspec(dllimport)
+  #endif
+#else
+  #define SAABB_API __attribute__((visibility("default")))
+#endif
+
+#define SAABB_API_VERSION 1
+/// object id of a ray that hit nothing
+#define SAABB_NO_HIT 0xffffffffu
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef enum saabb_status
+{
+  SAABB_OK=0,
+  SAABB_INVALID_ARGUMENT,
+  // the scene has changed size since saabb_build, or was never built
+  SAABB_NOT_BUILT,
+  SAABB_OUT_OF_MEMORY,
+  // more results than the caller's buffer holds, the count says how many there are
+  SAABB_BUFFER_TOO_SMALL
+} saabb_status;
+
+typedef struct saabb_context saabb_context;
+
+typedef struct saabb_ray_hit
+{
+  uint32_t object;
+  float t;
+} saabb_ray_hit;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief SAABB_API_VERSION of the library, check it against the header's before other calls
+//----------------------------------------------------------------------------------------------------------------------
+SAABB_API uint32_t saabb_version(void);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief world space box of each of _count local boxes under its matrix, written to
+/// _worldBoxes. Needs no context and may be called from any thread. Empty boxes stay empty.
+//----------------------------------------------------------------------------------------------------------------------
+SAABB_API saabb_status saabb_transform_boxes(const float *_matrices, size_t _matrixStride,
+                                             const float *_localBoxes, size_t _localStride,
+                                             size_t _count, float *_worldBoxes, size_t _worldStride);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief make a context for the hierarchy queries
+/// @param[in] _numThreads threads including the caller to build and query with, 0 shares one
+/// thread per core with everything else in the process
+//----------------------------------------------------------------------------------------------------------------------
+SAABB_API saabb_status saabb_create(size_t _numThreads, saabb_context **_context);
+SAABB_API void saabb_destroy(saabb_context *_context);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief build the hierarchy over _count boxes, object i is box i. The boxes are not kept, the
+/// caller may reuse them straight away.
+//----------------------------------------------------------------------------------------------------------------------
+SAABB_API saabb_status saabb_build(saabb_context *_context, const float *_boxes, size_t _stride, size_t _count);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief new boxes for the objects of the last build, keeping its hierarchy. Cheaper than a
+/// build but the queries slow down as the objects move away from where they were built.
+//----------------------------------------------------------------------------------------------------------------------
+SAABB_API saabb_status saabb_refit(saabb_context *_context, const float *_boxes, size_t _stride, size_t _count);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief every pair of overlapping boxes once as two object ids, lowest first, into _pairs
+/// which holds _maxPairs of them. _numPairs is set to the number of pairs there are, if that
+/// is more than _maxPairs the first _maxPairs are written and SAABB_BUFFER_TOO_SMALL returned.
+//----------------------------------------------------------------------------------------------------------------------
+SAABB_API saabb_status saabb_overlap_pairs(saabb_context *_context, uint32_t *_pairs, size_t _maxPairs, size_t *_numPairs);
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief the nearest box along each of _count rays origin+t*direction for 0<=t<=_maxT, the
+/// directions need not be unit length. A ray that hits nothing gets object SAABB_NO_HIT.
+//----------------------------------------------------------------------------------------------------------------------
+SAABB_API saabb_status saabb_raycast(saabb_context *_context, const float *_origins, size_t _originStride,
+                                     const float *_directions, size_t _directionStride, size_t _count,
+                                     float _maxT, saabb_ray_hit *_hits, size_t _hitStride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
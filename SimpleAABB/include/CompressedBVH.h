@@ -0,0 +1,72 @@
+#ifndef COMPRESSEDBVH_H_
+#define COMPRESSEDBVH_H_
+#include <cstdint>
+#include <vector>
+#include "AABB.h"
+#include "LinearBVH.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file CompressedBVH.h
+/// @brief a 4 wide copy of a LinearBVH with every node in one 64 byte cache line, for trees
+/// too big to stay in cache. A node keeps its own box as an origin and a power of two step per
+/// axis, and each child box as 8 bit steps from the origin rounded outwards, so the children
+/// always contain what the full precision boxes did (Ylitie et al, "Efficient Incoherent Ray
+/// Traversal on GPUs Through Compressed Wide BVHs", HPG 2017). The four child boxes of a node
+/// are decoded and tested together with SSE.
+///
+/// Leaves are the object ids themselves, no leaf boxes are kept, so queries return every
+/// object whose rounded box overlaps. That is all of the exact hits plus a few near misses,
+/// which the narrow phase has to reject anyway.
+/// @class CompressedBVH
+//----------------------------------------------------------------------------------------------------------------------
+class CompressedBVH
+{
+  public :
+    static constexpr uint32_t c_leaf=LinearBVH::c_leaf;
+    static constexpr int c_width=4;
+    struct Node
+    {
+      // child boxes are m_origin + q * 2^m_exponent on each axis, q from 0 to 255
+      float m_origin[3];
+      int8_t m_exponent[3];
+      uint8_t m_count;
+      // [axis][child] so one 32 bit load gives an axis of all four children
+      uint8_t m_min[3][c_width];
+      uint8_t m_max[3][c_width];
+      // a node index, or c_leaf | object id
+      uint32_t m_child[c_width];
+      uint32_t m_pad[2];
+    };
+    CompressedBVH()=default;
+    CompressedBVH(const CompressedBVH &)=delete;
+    CompressedBVH &operator=(const CompressedBVH &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief replace the tree with a compressed copy of _tree, object ids are as given to
+    /// _tree's build and must be below c_leaf
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const LinearBVH &_tree);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every object whose rounded box overlaps _box, a superset of the objects
+    /// the LinearBVH would return
+    //----------------------------------------------------------------------------------------------------------------------
+    void queryBox(const AABB &_box, std::vector<uint32_t> &_out) const;
+
+    size_t numNodes() const {return m_numNodes;}
+    // the root is node 0
+    const Node &node(size_t _index) const {return m_nodes[_index];}
+    // decoded box of child _child of _node
+    static AABB childBox(const Node &_node, int _child);
+    size_t memoryBytes() const {return m_numNodes*sizeof(Node);}
+
+  private :
+    // every level has at most three siblings waiting on the stack
+    static constexpr size_t c_stackSize=400;
+    // set the origin, steps and child boxes of _node from the exact boxes
+    static void quantize(Node &_node, const AABB *_boxes, int _count);
+    // the nodes start on a cache line boundary inside m_storage
+    std::vector<char> m_storage;
+    Node *m_nodes=nullptr;
+    size_t m_numNodes=0;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef COMPRESSEDTEXTURE_H_
+#define COMPRESSEDTEXTURE_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <ngl/Types.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file CompressedTexture.h
+/// @brief a block compressed texture with its full mip chain. The first time an image is used
+/// it is decoded, box filtered down to 1x1 and every level is compressed on the CPU, opaque
+/// images to BC1 (4 bits per pixel) and images with alpha to BC7 (8 bits per pixel, mode 6
+/// only). The result is written next to the image as image.mips in the same layout it has in
+/// memory, so later runs load it with a single read and no decode.
+/// @class CompressedTexture
+//----------------------------------------------------------------------------------------------------------------------
+class CompressedTexture
+{
+  public :
+    enum class Format : uint32_t {BC1,BC7};
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief load _file.mips if it is up to date with _file else build and save it. No GL
+    /// calls are made so this can run on a loader thread.
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit CompressedTexture(const std::string &_file);
+    // false if the image could not be loaded
+    bool isValid() const {return !m_data.empty();}
+    Format format() const;
+    int width() const;
+    int height() const;
+    size_t numLevels() const;
+    // size of all the compressed levels
+    size_t gpuBytes() const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief make the GL texture with every mip level, needs a current GL context. If the
+    /// driver does not support the format the blocks are decoded and uploaded as RGBA8.
+    //----------------------------------------------------------------------------------------------------------------------
+    GLuint createTexture() const;
+    // check the GL compressed format list, needs a current GL context
+    static bool isFormatSupported(Format _format);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief block encoders / decoders, _rgba is a 4x4 tile of RGBA8 pixels in row order.
+    /// BC1 blocks are 8 bytes, BC7 blocks are 16 and the decoder only handles mode 6 which
+    /// is all the encoder writes.
+    //----------------------------------------------------------------------------------------------------------------------
+    static void encodeBC1(const uint8_t *_rgba, uint8_t *_block);
+    static void decodeBC1(const uint8_t *_block, uint8_t *_rgba);
+    static void encodeBC7(const uint8_t *_rgba, uint8_t *_block);
+    static void decodeBC7(const uint8_t *_block, uint8_t *_rgba);
+
+  private :
+    struct Header
+    {
+      char m_magic[4];
+      uint32_t m_version;
+      // size and modification time of the source image
+      uint64_t m_sourceKey;
+      uint32_t m_format;
+      uint32_t m_width;
+      uint32_t m_height;
+      uint32_t m_numLevels;
+    };
+    struct Level
+    {
+      uint32_t m_width;
+      uint32_t m_height;
+      // offset of the blocks from the start of m_data and their size in bytes
+      uint32_t m_offset;
+      uint32_t m_size;
+    };
+    bool load(const std::string &_fname, uint64_t _sourceKey);
+    bool build(const std::string &_file, uint64_t _sourceKey);
+    // checks a loaded file's format and level table against the layout build writes
+    bool checkLevels() const;
+    const Header &header() const {return *reinterpret_cast<const Header *>(&m_data[0]);}
+    const Level &level(size_t _i) const {return reinterpret_cast<const Level *>(&m_data[sizeof(Header)])[_i];}
+    // header, level table then the blocks of every level, exactly as stored in the file
+    std::vector<char> m_data;
+};
+
+#endif
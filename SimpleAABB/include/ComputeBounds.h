@@ -0,0 +1,93 @@
+#ifndef COMPUTEBOUNDS_H_
+#define COMPUTEBOUNDS_H_
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include "AABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ComputeBounds.h
+/// @brief exact world space AABBs of transformed meshes from a GL 4.3 compute shader
+/// (shaders/AABBCompute.glsl). Every instance added in a frame is transformed vertex by vertex
+/// straight from the mesh VBO and reduced to a min / max on the GPU, one dispatch per distinct
+/// VBO. The results are read back once their fence has signalled, normally a frame or two
+/// later, so the CPU never waits. GL thread only.
+/// @class ComputeBounds
+//----------------------------------------------------------------------------------------------------------------------
+class ComputeBounds
+{
+  public :
+    struct Result
+    {
+      // the id given to add()
+      size_t m_id;
+      // the transform the box was computed with
+      ngl::Mat4 m_world;
+      AABB m_box;
+    };
+    ComputeBounds()=default;
+    ~ComputeBounds();
+    ComputeBounds(const ComputeBounds &)=delete;
+    ComputeBounds &operator=(const ComputeBounds &)=delete;
+    // true if the current context is GL 4.3 or later
+    static bool isSupported();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the compute program, false if it does not compile
+    //----------------------------------------------------------------------------------------------------------------------
+    bool init();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief false while every result buffer is still waiting on the GPU, nothing should be
+    /// added until a later collect() frees one
+    //----------------------------------------------------------------------------------------------------------------------
+    bool canDispatch() const {return m_frames[m_current].m_fence==nullptr;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief queue the bounds of _numVerts vertices of _vbo (positions first, _stride 32 bit
+    /// words apart) transformed by _world. Given _dequantize the positions are QuantizedVertex
+    /// 16 bit unorms which it maps to object space, otherwise they are floats.
+    //----------------------------------------------------------------------------------------------------------------------
+    void add(size_t _id, GLuint _vbo, size_t _numVerts, size_t _stride, const ngl::Mat4 &_world, const ngl::Mat4 *_dequantize=nullptr);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief issue everything added since the last dispatch
+    //----------------------------------------------------------------------------------------------------------------------
+    void dispatch();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append the results of every finished dispatch to _results, never waits
+    //----------------------------------------------------------------------------------------------------------------------
+    void collect(std::vector<Result> &_results);
+
+  private :
+    struct Job
+    {
+      size_t m_id;
+      GLuint m_vbo;
+      size_t m_numVerts;
+      size_t m_stride;
+      ngl::Mat4 m_world;
+      // what the shader transforms by, m_world with the dequantize matrix folded in
+      ngl::Mat4 m_shaderMatrix;
+      bool m_quantized;
+    };
+    struct Frame
+    {
+      GLuint m_matrices=0;
+      GLuint m_bounds=0;
+      // instances the buffers can hold
+      size_t m_capacity=0;
+      GLsync m_fence=nullptr;
+      std::vector<Job> m_jobs;
+    };
+    static constexpr size_t c_framesInFlight=3;
+    static constexpr GLuint c_groupSize=256;
+    // work groups per instance, each walks the vertices with this stride
+    static constexpr GLuint c_maxGroups=32;
+    std::array<Frame,c_framesInFlight> m_frames;
+    size_t m_current=0;
+    std::vector<Job> m_pending;
+    // staging for the matrix upload, the bounds reset and the readback
+    std::vector<ngl::Real> m_matrixData;
+    std::vector<uint32_t> m_boundsData;
+};
+
+#endif
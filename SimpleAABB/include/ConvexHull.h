@@ -0,0 +1,77 @@
+#ifndef CONVEXHULL_H_
+#define CONVEXHULL_H_
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include "AABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ConvexHull.h
+/// @brief the vertices of the convex hull of a point set, built once per mesh with quickhull.
+/// The extreme point of a mesh in any direction is always a hull vertex, so the box of the
+/// transformed hull is the exact world AABB of the whole mesh under any affine transform
+/// while only touching a small fraction of its vertices.
+/// @class ConvexHull
+//----------------------------------------------------------------------------------------------------------------------
+class ConvexHull
+{
+  public :
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief quickhull of _count points, positions are the first three floats of each point
+    /// and _stride floats apart. Points within c_relativeTolerance of the hull are dropped.
+    /// Flat or degenerate input (no tetrahedron can be made) keeps every distinct point.
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const ngl::Real *_points, size_t _stride, size_t _count);
+    bool isEmpty() const {return m_numPoints==0;}
+    size_t numPoints() const {return m_numPoints;}
+    ngl::Vec3 point(size_t _i) const {return ngl::Vec3(m_coords[_i],m_coords[m_padded+_i],m_coords[2*m_padded+_i]);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief box of the hull transformed by _tx (ngl row vector convention), grown by the
+    /// build tolerance so it still contains every point that was dropped
+    //----------------------------------------------------------------------------------------------------------------------
+    AABB bounds(const ngl::Mat4 &_tx) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the same box from six support() queries, one per face of the box.
+    /// @param[in,out] _extremes the hull points that were furthest along -x -y -z +x +y +z last
+    /// time, used as the starting points and updated. A small change in _tx then usually
+    /// needs only a step or two of the walk per axis.
+    //----------------------------------------------------------------------------------------------------------------------
+    AABB bounds(const ngl::Mat4 &_tx, uint32_t *_extremes) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief index of the hull point furthest along _dir. Walks the hull edges uphill from
+    /// _start, which on a convex hull can only stop at the furthest point, so the cost depends
+    /// on how far the answer is from _start rather than on the size of the hull.
+    //----------------------------------------------------------------------------------------------------------------------
+    uint32_t support(const ngl::Vec3 &_dir, uint32_t _start=0) const;
+    // binary form used by the MeshLOD cache, read fails (leaving the hull as it was) on a short
+    // file or neighbour lists that do not index the points
+    bool read(std::istream &_in);
+    bool write(std::ostream &_out) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief how far outside the hull a point can be, relative to the size of the point set
+    //----------------------------------------------------------------------------------------------------------------------
+    static constexpr double c_relativeTolerance=1e-6;
+
+  private :
+    // fill m_coords from the hull points
+    void setPoints(const std::vector<ngl::Vec3> &_points);
+    // fill the neighbour lists from the hull faces (hull point indices, three per face)
+    void setAdjacency(const std::vector<uint32_t> &_triangles);
+    // move a linear only box by the translation and grow it by the tolerance
+    void pad(const ngl::Mat4 &_tx, AABB &_box) const;
+    // all the x then all the y then all the z, each run padded to a multiple of 8 by
+    // repeating the last point so bounds() never needs a remainder loop
+    std::vector<ngl::Real> m_coords;
+    size_t m_numPoints=0;
+    size_t m_padded=0;
+    // the hull points joined to point i by an edge are m_adjacency[m_adjacencyStart[i]] up to
+    // m_adjacency[m_adjacencyStart[i+1]], empty if the input was flat
+    std::vector<uint32_t> m_adjacencyStart;
+    std::vector<uint32_t> m_adjacency;
+    // absolute tolerance the hull was built with
+    ngl::Real m_tolerance=0.0f;
+};
+
+#endif
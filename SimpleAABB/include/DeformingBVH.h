@@ -0,0 +1,78 @@
+#ifndef DEFORMINGBVH_H_
+#define DEFORMINGBVH_H_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <ngl/Types.h>
+#include "AABB.h"
+#include "AsyncLoader.h"
+#include "LinearBVH.h"
+#include "WorkerPool.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file DeformingBVH.h
+/// @brief a triangle hierarchy for a mesh whose vertices move (skinning, morphs) rather than
+/// the whole mesh being transformed. Each update refits the existing tree to the new triangle
+/// boxes, which keeps the topology and is far cheaper than a rebuild. As the mesh moves away
+/// from its shape at build time the refitted boxes overlap more, so the SAH cost is checked
+/// after every refit. Once it is c_rebuildRatio times the cost just after the last build a
+/// new tree is built on a background thread from a snapshot of the boxes. The next update
+/// after it finishes swaps it in, refitting it to the latest vertices first.
+/// @class DeformingBVH
+//----------------------------------------------------------------------------------------------------------------------
+class DeformingBVH
+{
+  public :
+    static constexpr double c_rebuildRatio=1.25;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief refits run on _pool (null for the shared pool), background builds on one thread
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit DeformingBVH(WorkerPool *_pool=nullptr);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief waits for a background build that is still running
+    //----------------------------------------------------------------------------------------------------------------------
+    ~DeformingBVH();
+    DeformingBVH(const DeformingBVH &)=delete;
+    DeformingBVH &operator=(const DeformingBVH &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the tree from scratch over the triangles, positions are the first three
+    /// floats of each vertex, _stride floats apart. The indices are kept for update().
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const ngl::Real *_positions, size_t _stride, const uint32_t *_indices, size_t _numTriangles);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the vertices have moved (same layout as build), refit and rebuild if needed
+    //----------------------------------------------------------------------------------------------------------------------
+    void update(const ngl::Real *_positions);
+
+    const LinearBVH &tree() const {return *m_tree;}
+    // triangle t of the tree's leaves is triangle t of the mesh
+    const std::vector<AABB> &triangleBoxes() const {return m_boxes;}
+    // SAH cost of the current tree over its cost when it was built
+    double costRatio() const {return m_cost/m_builtCost;}
+    // trees swapped in from the background so far
+    size_t rebuilds() const {return m_rebuilds;}
+    bool rebuilding() const {return m_rebuilding;}
+
+  private :
+    void computeBoxes(const ngl::Real *_positions);
+    void startRebuild();
+    WorkerPool *m_pool;
+    size_t m_stride=0;
+    std::vector<uint32_t> m_indices;
+    std::vector<AABB> m_boxes;
+    std::unique_ptr<LinearBVH> m_tree;
+    double m_cost=1.0;
+    double m_builtCost=1.0;
+    size_t m_rebuilds=0;
+    bool m_rebuilding=false;
+    // only touched by the background build while m_rebuilding
+    std::vector<AABB> m_snapshot;
+    WorkerPool m_backgroundPool;
+    // the finished background tree, handed over with an atomic exchange
+    std::atomic<LinearBVH *> m_ready;
+    // one thread, reset first in the destructor so a running build finishes before the rest goes
+    std::unique_ptr<AsyncLoader> m_rebuilder;
+};
+
+#endif
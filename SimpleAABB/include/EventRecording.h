@@ -0,0 +1,86 @@
+#ifndef EVENTRECORDING_H_
+#define EVENTRECORDING_H_
+#include <QObject>
+#include <QSurfaceFormat>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+class QWindow;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file EventRecording.h
+/// @brief capture of the input a window receives and offscreen replay of it at fixed simulated
+/// time, so two builds can be timed on exactly the same workload. A recording is a text file,
+/// # starts a comment, the first number of each event is the timer tick it arrived after and
+/// the second the wall clock ms since recording started (kept for reference, replay ignores it).
+///
+///   size    width height
+///   key     tick ms key modifiers
+///   press   tick ms x y button buttons modifiers       (also release and move)
+///   wheel   tick ms x y delta buttons modifiers
+///   resize  tick ms width height
+///   end     ticks
+//----------------------------------------------------------------------------------------------------------------------
+struct RecordedEvent
+{
+  enum class Type {KEY,PRESS,RELEASE,MOVE,WHEEL,RESIZE};
+  Type m_type;
+  size_t m_tick;
+  double m_ms;
+  // key code or mouse button, wheel delta
+  int m_code=0;
+  int m_x=0;
+  int m_y=0;
+  int m_buttons=0;
+  int m_modifiers=0;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief event filter that writes everything that drives the scene (keys, mouse, wheel, resize
+/// and timer ticks) to a recording while the window runs normally
+/// @class EventRecorder
+//----------------------------------------------------------------------------------------------------------------------
+class EventRecorder : public QObject
+{
+  public :
+    EventRecorder(const std::string &_file, QWindow *_window);
+    // writes the end line with the tick count
+    ~EventRecorder();
+    bool isOpen() const {return m_out.is_open();}
+    bool eventFilter(QObject *_object, QEvent *_event) override;
+
+  private :
+    void write(const char *_type, const std::vector<int> &_values);
+    std::ofstream m_out;
+    size_t m_tick=0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief plays a recording back into an NGLScene that is never shown. Everything draws into an
+/// FBO on an offscreen surface, the first tick only starts once every asset has loaded and each
+/// recorded tick is followed by exactly one frame, so the work done per frame depends only on
+/// the recording. Frame times (paintGL through glFinish) and the Stats counters are written per
+/// frame as CSV and summarised on stdout.
+/// @class EventPlayer
+//----------------------------------------------------------------------------------------------------------------------
+class EventPlayer
+{
+  public :
+    bool load(const std::string &_file);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the scene offscreen and replay into it
+    /// @returns a process exit code
+    //----------------------------------------------------------------------------------------------------------------------
+    int run(const std::string &_sceneFile, const std::string &_statsSocket, QSurfaceFormat _format, const std::string &_csvFile) const;
+
+  private :
+    std::vector<RecordedEvent> m_events;
+    int m_width=1024;
+    int m_height=720;
+    size_t m_ticks=0;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef FRAMEARENA_H_
+#define FRAMEARENA_H_
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrameArena.h
+/// @brief bump allocator for data that only lives for a frame. There are two buffers and
+/// nextFrame() flips between them, resetting the new one in O(1), so anything allocated
+/// since the previous flip stays valid until the one after (eg timerEvent results read in the
+/// following paintGL). Nothing is freed individually. If a frame needs more than the buffer
+/// holds the extra comes from the heap and the buffer is grown on its next reset so the
+/// steady state makes no heap allocations.
+/// @class FrameArena
+//----------------------------------------------------------------------------------------------------------------------
+class FrameArena
+{
+  public :
+    explicit FrameArena(size_t _capacity=64*1024);
+    FrameArena(const FrameArena &)=delete;
+    FrameArena &operator=(const FrameArena &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief switch buffers and reset the one switched to, everything allocated from it
+    /// two flips ago is gone
+    //----------------------------------------------------------------------------------------------------------------------
+    void nextFrame();
+    void *allocate(size_t _bytes, size_t _align=alignof(std::max_align_t));
+    template<typename T>
+    T *allocate(size_t _count) {return static_cast<T *>(allocate(sizeof(T)*_count,alignof(T)));}
+
+    // bytes handed out from the current buffer since it was reset
+    size_t used() const {return m_buffers[m_current].m_used;}
+    size_t capacity() const {return m_buffers[m_current].m_capacity;}
+    // most either buffer has ever needed in one frame
+    size_t highWater() const {return m_highWater;}
+    // allocations that did not fit and went to the heap
+    size_t overflows() const {return m_overflows;}
+
+  private :
+    struct Buffer
+    {
+      std::unique_ptr<char[]> m_memory;
+      size_t m_capacity=0;
+      size_t m_used=0;
+      // anything that did not fit, freed on reset
+      std::vector<std::unique_ptr<char[]>> m_overflow;
+      size_t m_overflowBytes=0;
+    };
+    Buffer m_buffers[2];
+    size_t m_current=0;
+    size_t m_highWater=0;
+    size_t m_overflows=0;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief std allocator drawing from a FrameArena, deallocate does nothing
+//----------------------------------------------------------------------------------------------------------------------
+template<typename T>
+class ArenaAllocator
+{
+  public :
+    typedef T value_type;
+    ArenaAllocator(FrameArena &_arena) : m_arena(&_arena) {}
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &_other) : m_arena(_other.arena()) {}
+    T *allocate(size_t _n) {return m_arena->allocate<T>(_n);}
+    void deallocate(T *, size_t) {}
+    FrameArena *arena() const {return m_arena;}
+  private :
+    FrameArena *m_arena;
+};
+
+template<typename T, typename U>
+bool operator==(const ArenaAllocator<T> &_a, const ArenaAllocator<U> &_b) {return _a.arena()==_b.arena();}
+template<typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &_a, const ArenaAllocator<U> &_b) {return _a.arena()!=_b.arena();}
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief a vector for per frame lists, construct it with the arena: FrameVector<int> v(arena);
+//----------------------------------------------------------------------------------------------------------------------
+template<typename T>
+using FrameVector=std::vector<T,ArenaAllocator<T>>;
+
+#endif
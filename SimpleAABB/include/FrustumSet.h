@@ -0,0 +1,46 @@
+#ifndef FRUSTUMSET_H_
+#define FRUSTUMSET_H_
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include "AABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file FrustumSet.h
+/// @brief the frustums of up to c_maxViews views tested together, so one walk over the scene
+/// gives every object a bit per view it can be seen in. The six planes of four views at a
+/// time are stored side by side and a box is tested against all four with SSE (a plain loop
+/// without it). The test is the usual conservative one, a box is only dropped when it is wholly
+/// outside one of the planes.
+/// @class FrustumSet
+//----------------------------------------------------------------------------------------------------------------------
+class FrustumSet
+{
+  public :
+    static constexpr size_t c_maxViews=64;
+    typedef uint64_t Mask;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief take the planes from _numViews view projection matrices, bit v of a mask is _VPs[v]
+    //----------------------------------------------------------------------------------------------------------------------
+    void set(const ngl::Mat4 *_VPs, size_t _numViews);
+    size_t size() const {return m_numViews;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief a bit for each view _box is at least partly inside, empty boxes are in none
+    //----------------------------------------------------------------------------------------------------------------------
+    Mask visibleMask(const AABB &_box) const;
+
+  private :
+    // m_planes[plane][component][view] for four views, a point is inside when
+    // n.p+d>=0 for every plane. Unused views have zero planes and are masked off.
+    struct Group
+    {
+      ngl::Real m_planes[6][4][4];
+    };
+    std::vector<Group> m_groups;
+    size_t m_numViews=0;
+    Mask m_all=0;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef GEOMETRYCACHE_H_
+#define GEOMETRYCACHE_H_
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AABB.h"
+#include "AsyncLoader.h"
+#include "CompressedTexture.h"
+#include "MeshLOD.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file GeometryCache.h
+/// @brief reference counted store of the meshes and textures used by a scene. Each file is
+/// loaded once however many objects use it, objects just hold the small ids handed out here.
+/// An asset is freed when the last reference to it is released.
+///
+/// Loading is asynchronous, acquire returns straight away and the file is parsed / decoded
+/// on the loader threads. update() is then called once a frame on the GL thread to move
+/// finished assets onto the GPU a chunk at a time within a time budget. Until a mesh is
+/// ready isReady() is false and bounds() returns a placeholder box.
+/// @class GeometryCache
+//----------------------------------------------------------------------------------------------------------------------
+class GeometryCache
+{
+  public :
+    typedef uint32_t MeshID;
+    typedef uint32_t TextureID;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief everything loaded for one mesh file
+    //----------------------------------------------------------------------------------------------------------------------
+    struct Mesh
+    {
+      std::string m_file;
+      // null until the loader thread is done with it
+      std::unique_ptr<MeshLOD> m_lod;
+      size_t m_refCount=0;
+      // uploaded and drawable
+      bool m_ready=false;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief bounds used for meshes that have not loaded yet
+    //----------------------------------------------------------------------------------------------------------------------
+    static const AABB c_placeholderBounds;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief largest single buffer copy made by update()
+    //----------------------------------------------------------------------------------------------------------------------
+    static constexpr size_t c_uploadChunk=256*1024;
+
+    GeometryCache()=default;
+    ~GeometryCache();
+    GeometryCache(const GeometryCache &)=delete;
+    GeometryCache &operator=(const GeometryCache &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief get a mesh and add a reference to it, a new file is queued for loading
+    //----------------------------------------------------------------------------------------------------------------------
+    MeshID acquireMesh(const std::string &_file);
+    void releaseMesh(MeshID _id);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief get a texture and add a reference to it, a new file is queued for loading
+    //----------------------------------------------------------------------------------------------------------------------
+    TextureID acquireTexture(const std::string &_file);
+    void releaseTexture(TextureID _id);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief upload finished loads to the GPU, needs a current GL context
+    /// @param[in] _budget stop starting new copies once this much time has been spent, at
+    /// least one copy is always made so loading can not stall
+    /// @param[out] _readyMeshes meshes that became drawable in this call are appended
+    //----------------------------------------------------------------------------------------------------------------------
+    void update(std::chrono::steady_clock::duration _budget, std::vector<MeshID> &_readyMeshes);
+    // something is still being loaded or uploaded
+    bool isLoading() const {return m_inFlight!=0;}
+
+    const Mesh &mesh(MeshID _id) const {return *m_meshes[_id];}
+    bool isReady(MeshID _id) const {return m_meshes[_id]->m_ready;}
+    const AABB &bounds(MeshID _id) const;
+    // null until the mesh is ready
+    const ConvexHull *hull(MeshID _id) const;
+    // 0 until the texture has been uploaded
+    GLuint texture(TextureID _id) const {return m_textures[_id].m_glID;}
+    size_t numMeshes() const {return m_meshLookup.size();}
+    size_t numTextures() const {return m_textureLookup.size();}
+
+  private :
+    struct Texture
+    {
+      std::string m_file;
+      GLuint m_glID=0;
+      size_t m_refCount=0;
+      bool m_ready=false;
+    };
+    // what a loader thread hands back, exactly one of the pointers is set
+    struct Loaded
+    {
+      uint32_t m_id;
+      std::unique_ptr<MeshLOD> m_lod;
+      std::unique_ptr<CompressedTexture> m_texture;
+    };
+    void freeMesh(MeshID _id);
+    void freeTexture(TextureID _id);
+    // slots are reused once freed so ids stay small. A slot whose load is still in flight
+    // is only freed when the load comes back so the result can not land in a reused slot
+    std::vector<std::unique_ptr<Mesh>> m_meshes;
+    std::vector<MeshID> m_freeMeshes;
+    std::unordered_map<std::string,MeshID> m_meshLookup;
+    std::vector<Texture> m_textures;
+    std::vector<TextureID> m_freeTextures;
+    std::unordered_map<std::string,TextureID> m_textureLookup;
+    // filled by the loader threads, drained by update()
+    std::mutex m_doneMutex;
+    std::vector<Loaded> m_done;
+    // GL thread only, loaded assets waiting for (or part way through) their upload
+    std::deque<MeshID> m_meshUploads;
+    std::deque<Loaded> m_textureUploads;
+    // loads that have been queued but are not yet ready
+    size_t m_inFlight=0;
+    // declared last so the threads are joined before anything they write to is destroyed
+    AsyncLoader m_loader;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef INDEXOPTIMIZER_H_
+#define INDEXOPTIMIZER_H_
+#include <cstddef>
+#include <vector>
+#include <ngl/Types.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file IndexOptimizer.h
+/// @brief load time reordering of triangle lists for the GPU. optimizeVertexCache is Tipsify
+/// (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+/// Overdraw"), fanning around the most recently used vertex that will still be in a FIFO cache
+/// of c_cacheSize entries. optimizeOverdraw then cuts that order into clusters where the
+/// cache restarts or the cluster's own miss rate is good enough, and sorts the clusters so
+/// those facing out from the mesh centre are drawn first and hide the rest. Finally
+/// optimizeVertexFetch renumbers the vertices in the order they are first used.
+/// @class IndexOptimizer
+//----------------------------------------------------------------------------------------------------------------------
+class IndexOptimizer
+{
+  public :
+    // roughly the post transform cache of current hardware
+    static constexpr size_t c_cacheSize=16;
+    struct CacheStats
+    {
+      // vertices transformed per triangle, 0.5 is the best a big regular mesh can do and 3 the worst
+      ngl::Real m_acmr=0.0f;
+      // vertices transformed per vertex used, 1 is ideal
+      ngl::Real m_atvr=0.0f;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief simulate a FIFO cache of _cacheSize over the triangle list
+    //----------------------------------------------------------------------------------------------------------------------
+    static CacheStats analyzeCache(const GLuint *_indices, size_t _numIndices, size_t _numVertices, size_t _cacheSize=c_cacheSize);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief reorder the triangles of _indices in place for a FIFO cache of _cacheSize
+    //----------------------------------------------------------------------------------------------------------------------
+    static void optimizeVertexCache(GLuint *_indices, size_t _numIndices, size_t _numVertices, size_t _cacheSize=c_cacheSize);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief reorder clusters of an optimizeVertexCache order in place, a cluster is only split
+    /// where its miss rate is at most _threshold times that of the cache restart it is in
+    /// @param[in] _positions first three floats of each vertex, _stride floats apart
+    //----------------------------------------------------------------------------------------------------------------------
+    static void optimizeOverdraw(const ngl::Real *_positions, size_t _stride, GLuint *_indices, size_t _numIndices,
+                                 size_t _numVertices, ngl::Real _threshold=1.05f, size_t _cacheSize=c_cacheSize);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief sort given clusters of _indices outward facing first, moving their triangles
+    /// @param[in] _clusterStarts first index of each cluster in order, the last runs to _numIndices
+    /// @param[out] _order old cluster number at each new position
+    //----------------------------------------------------------------------------------------------------------------------
+    static void sortClusters(const ngl::Real *_positions, size_t _stride, GLuint *_indices, size_t _numIndices,
+                             const std::vector<size_t> &_clusterStarts, std::vector<size_t> &_order);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief renumber the vertices in the order _indices first uses them, unused ones last
+    /// @param[out] _remap new number of each old vertex, apply it to the vertex data
+    //----------------------------------------------------------------------------------------------------------------------
+    static void optimizeVertexFetch(GLuint *_indices, size_t _numIndices, size_t _numVertices, std::vector<GLuint> &_remap);
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef INDEXEDMESH_H_
+#define INDEXEDMESH_H_
+#include <string>
+#include <vector>
+#include <ngl/Types.h>
+#include <ngl/Obj.h>
+#include "AABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file IndexedMesh.h
+/// @brief ngl::Obj keeps separate position / uv / normal indices per face and builds an
+/// un-indexed VAO. This is the welded, triangulated, indexed version of the same data that
+/// the mesh processing passes (LOD etc) work on.
+//----------------------------------------------------------------------------------------------------------------------
+struct IndexedMesh
+{
+  // same attribute layout as the ngl::Obj VAO, position at 0, uv at 1, normal at 2
+  struct Vertex
+  {
+    ngl::Real m_x,m_y,m_z;
+    ngl::Real m_u,m_v;
+    ngl::Real m_nx,m_ny,m_nz;
+  };
+  std::vector<Vertex> m_verts;
+  // triangle list, 3 per face
+  std::vector<GLuint> m_indices;
+  // the obj position index each vertex came from, several vertices share a position
+  // where uv or normal seams split them
+  std::vector<GLuint> m_posIndex;
+  // number of unique positions (max m_posIndex + 1)
+  size_t m_numPositions=0;
+
+  size_t numTriangles() const {return m_indices.size()/3;}
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief weld the (position,uv,normal) triplets of _mesh into unique vertices, polygons
+  /// are split into triangle fans
+  //----------------------------------------------------------------------------------------------------------------------
+  static IndexedMesh fromObj(ngl::Obj &_mesh);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the same as fromObj but reading the file directly. ngl::Obj builds GL objects when
+  /// it loads so this is the version that is safe to call from a worker thread.
+  /// @returns false if the file can not be read or has out of range indices
+  //----------------------------------------------------------------------------------------------------------------------
+  static bool loadObj(const std::string &_fname, IndexedMesh &_out);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief object space bounds of the vertices
+  //----------------------------------------------------------------------------------------------------------------------
+  AABB bounds() const;
+};
+
+#endif
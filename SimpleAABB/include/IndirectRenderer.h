@@ -0,0 +1,199 @@
+#ifndef INDIRECTRENDERER_H_
+#define INDIRECTRENDERER_H_
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include "GeometryCache.h"
+#include "MeshLOD.h"
+#include "SceneGraph.h"
+#include "Stats.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file IndirectRenderer.h
+/// @brief GPU driven drawing of a whole scene graph, one glMultiDrawElementsIndirect per
+/// texture for each view (so one per panel for the shipped scenes, which share a texture).
+/// Every mesh's vertices and LOD index ranges are appended to one vertex and one index buffer
+/// as the mesh arrives, a chunk at a time within the frame's upload budget, and each frame the
+/// nodes' world matrices and world boxes go into a shader storage buffer.
+/// For each view a compute shader (shaders/IndirectCull.glsl) tests every box against the
+/// frustum, picks the level as MeshLOD::selectLevel does and appends a draw command for each
+/// node in sight, packed per texture by an atomic counter. The command's base instance is
+/// the node, which the vertex shader (shaders/IndirectVertex.glsl) uses to fetch the world
+/// matrix. Culling::CPU makes the same commands on the CPU and uploads them instead, for
+/// comparison. Needs GL 4.3, GL thread only.
+/// @class IndirectRenderer
+//----------------------------------------------------------------------------------------------------------------------
+class IndirectRenderer
+{
+  public :
+    enum class Culling : char {GPU,CPU};
+    struct Counts
+    {
+      size_t m_nodes=0;
+      // triangles drawn and what the same nodes would have been at full detail
+      size_t m_triangles=0;
+      size_t m_fullTriangles=0;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief _numViews views, each gets its own command and counter region so the GPU
+    /// memory and the readback grow with the layout rather than the most it could have
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit IndirectRenderer(size_t _numViews) : m_numViews(_numViews) {}
+    ~IndirectRenderer();
+    IndirectRenderer(const IndirectRenderer &)=delete;
+    IndirectRenderer &operator=(const IndirectRenderer &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the cull and draw programs, false if they do not compile. The draw
+    /// program shares the TextureFragment shader so that has to be loaded first.
+    //----------------------------------------------------------------------------------------------------------------------
+    bool init();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief take this frame's drawable nodes from _scene. A mesh that has become ready is
+    /// given space at the end of the shared buffers and its data copied in over the next frames,
+    /// for up to _budget each frame (always at least one chunk). Its nodes are drawn once all of
+    /// it is there.
+    //----------------------------------------------------------------------------------------------------------------------
+    void beginFrame(const SceneGraph &_scene, const GeometryCache &_geometry, std::chrono::steady_clock::duration _budget);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief cull and draw the frame's nodes for one view, the caller sets the viewport
+    /// @param[in] _view the layout viewport, below the _numViews the renderer was made for
+    /// @param[in] _useLOD false draws every node at full detail
+    /// @returns what was drawn for Culling::CPU, the GPU counts come back later from collect()
+    //----------------------------------------------------------------------------------------------------------------------
+    Counts draw(size_t _view, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight, bool _useLOD, Culling _culling);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief call after the frame's last draw so its GPU counts can be read back
+    //----------------------------------------------------------------------------------------------------------------------
+    void endFrame();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the GPU culled counts of the newest frame the GPU has finished, never waits
+    /// @returns false if no frame has finished since the last call, only the first _numViews
+    /// entries are written
+    //----------------------------------------------------------------------------------------------------------------------
+    bool collect(std::array<Counts,Stats::c_maxViews> &_counts);
+    size_t numNodes() const {return m_objects.size();}
+
+  private :
+    static constexpr size_t c_maxLevels=8;
+    static constexpr size_t c_framesInFlight=3;
+    static constexpr GLuint c_groupSize=64;
+    // counters for each view, the Counts then the commands written for each texture
+    static constexpr size_t c_numTotals=3;
+    // the layouts below match the structs in the shaders (std430)
+    struct Object
+    {
+      ngl::Real m_world[16];
+      ngl::Real m_boxMin[4];
+      ngl::Real m_boxMax[4];
+      uint32_t m_mesh;
+      uint32_t m_batch;
+      // first command slot of the batch
+      uint32_t m_batchStart;
+      uint32_t m_pad;
+    };
+    struct MeshRanges
+    {
+      uint32_t m_first[c_maxLevels];
+      uint32_t m_count[c_maxLevels];
+      int32_t m_baseVertex;
+      uint32_t m_numLevels;
+      uint32_t m_pad[2];
+    };
+    // DrawElementsIndirectCommand
+    struct Command
+    {
+      uint32_t m_count;
+      uint32_t m_instanceCount;
+      uint32_t m_firstIndex;
+      int32_t m_baseVertex;
+      uint32_t m_baseInstance;
+    };
+    static_assert(sizeof(Object)==112 && sizeof(MeshRanges)==80 && sizeof(Command)==20,"the shaders expect these layouts");
+    // the nodes sharing a texture, their commands are m_size slots from m_start
+    struct Batch
+    {
+      GLuint m_texture;
+      uint32_t m_start;
+      uint32_t m_size;
+    };
+    struct Frame
+    {
+      GLuint m_counters=0;
+      GLsync m_fence=nullptr;
+    };
+    // a mesh's place in the shared buffers, its m_ranges entry is only filled in once all of
+    // it has been copied
+    struct Slot
+    {
+      const MeshLOD *m_lod=nullptr;
+      MeshRanges m_ranges=MeshRanges();
+      size_t m_numVertices=0;
+      size_t m_numIndices=0;
+    };
+    // a mesh still being copied, part 0 is the vertices and part l+1 level l's indices
+    struct Pending
+    {
+      GeometryCache::MeshID m_mesh;
+      size_t m_part;
+      size_t m_copied;
+    };
+    // give _lod the space after everything else and queue its copy
+    void place(GeometryCache::MeshID _mesh, const MeshLOD *_lod);
+    // forget _mesh, its space is only reused once every mesh has gone
+    void release(GeometryCache::MeshID _mesh);
+    // copy queued meshes in chunks until _budget has gone
+    void copyPending(std::chrono::steady_clock::duration _budget);
+    // grow the shared buffers to hold _vertices and _indices, keeping what is in them
+    void reserveGeometry(size_t _vertices, size_t _indices);
+    // point the VAO at the current vertex and index buffers
+    void bindGeometry();
+    // grow the per node buffers to hold _count nodes and _batches textures
+    void reserve(size_t _count, size_t _batches);
+    // the same test and level choice as the cull shader
+    bool cullObject(const Object &_object, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight, bool _useLOD,
+                    Command &_command) const;
+
+    GLuint m_vao=0;
+    GLuint m_vbo=0;
+    GLuint m_ibo=0;
+    // object index per instance, so a command's base instance picks its node
+    GLuint m_objectIds=0;
+    GLuint m_objectBuffer=0;
+    GLuint m_meshBuffer=0;
+    // m_numViews regions of m_capacity commands
+    GLuint m_commands=0;
+    size_t m_numViews;
+    std::array<Frame,c_framesInFlight> m_frames;
+    size_t m_current=0;
+    size_t m_capacity=0;
+    size_t m_batchCapacity=0;
+    // the meshes in the shared buffers by GeometryCache::MeshID, m_ranges mirrors m_meshBuffer
+    // and has no levels for a mesh that is not all there yet
+    std::vector<Slot> m_slots;
+    std::vector<MeshRanges> m_ranges;
+    bool m_rangesChanged=false;
+    std::deque<Pending> m_pending;
+    // which meshes this frame's scene uses
+    std::vector<char> m_used;
+    // elements given out and allocated in m_vbo and m_ibo, and given out to meshes since released
+    size_t m_numVertices=0;
+    size_t m_vertexCapacity=0;
+    size_t m_numIndices=0;
+    size_t m_indexCapacity=0;
+    size_t m_deadVertices=0;
+    size_t m_deadIndices=0;
+    // this frame's nodes sorted by texture, with their scene index
+    std::vector<std::pair<GLuint,size_t>> m_order;
+    std::vector<Object> m_objects;
+    std::vector<Batch> m_batches;
+    // staging for the CPU culled commands and the counter reset / readback
+    std::vector<Command> m_cpuCommands;
+    std::vector<uint32_t> m_counterData;
+};
+
+#endif
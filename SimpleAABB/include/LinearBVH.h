@@ -0,0 +1,126 @@
+#ifndef LINEARBVH_H_
+#define LINEARBVH_H_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "AABB.h"
+
+class WorkerPool;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file LinearBVH.h
+/// @brief a bounding volume hierarchy rebuilt from scratch every frame, for scenes where most
+/// objects move and refitting a tree lets it decay. The box centres are given Morton codes and
+/// radix sorted, the hierarchy comes straight from the sorted codes (Karras, "Maximizing
+/// Parallelism in the Construction of BVHs, Octrees, and k-d Trees", HPG 2012) with every
+/// internal node built independently, then the node boxes are fitted bottom up. Every stage
+/// runs on all threads of a WorkerPool.
+///
+/// With n objects there are n-1 internal nodes and the root is node 0. A child index with
+/// c_leaf set is a leaf, the rest of it is a position in the sorted order, objectAt() maps
+/// that back to the id passed to build().
+/// @class LinearBVH
+//----------------------------------------------------------------------------------------------------------------------
+class LinearBVH
+{
+  public :
+    typedef std::pair<uint32_t,uint32_t> Pair;
+    static constexpr uint32_t c_leaf=0x80000000u;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief Morton code length. 30 bits (10 per axis) sort in half the passes, 63 bits (21 per
+    /// axis) still separate objects in very large or very dense scenes
+    //----------------------------------------------------------------------------------------------------------------------
+    enum class CodeBits {BITS30,BITS63};
+    struct Node
+    {
+      AABB m_box;
+      uint32_t m_left;
+      uint32_t m_right;
+    };
+    explicit LinearBVH(WorkerPool *_pool=nullptr);
+    ~LinearBVH();
+    LinearBVH(const LinearBVH &)=delete;
+    LinearBVH &operator=(const LinearBVH &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief replace the tree with one over _count boxes, object i is _boxes[i]
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const AABB *_boxes, size_t _count, CodeBits _bits=CodeBits::BITS30);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief keep the hierarchy but take new boxes for the same objects (as many as were built)
+    /// and refit every node bottom up. Much cheaper than build() but the tree gets worse as the
+    /// objects move away from where it was built, sahCost() says how much.
+    //----------------------------------------------------------------------------------------------------------------------
+    void refit(const AABB *_boxes);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief surface area heuristic cost of the tree, the expected number of node and leaf box
+    /// tests for a random ray, only meaningful compared with another cost for the same objects
+    //----------------------------------------------------------------------------------------------------------------------
+    double sahCost() const;
+    // the pool later builds and refits run on
+    void setPool(WorkerPool *_pool);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every object whose box overlaps _box
+    //----------------------------------------------------------------------------------------------------------------------
+    void queryBox(const AABB &_box, std::vector<uint32_t> &_out) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every object whose box is within _radius of _centre
+    //----------------------------------------------------------------------------------------------------------------------
+    void querySphere(const ngl::Vec3 &_centre, ngl::Real _radius, std::vector<uint32_t> &_out) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every pair of overlapping boxes once, lowest id first. The leaves are
+    /// shared out over the pool so this uses scratch space in the tree and is not thread safe.
+    //----------------------------------------------------------------------------------------------------------------------
+    void queryPairs(std::vector<Pair> &_out);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the nearest box hit by the ray _origin+t*_direction with 0<=t<=_maxT, the box is
+    /// hit where the ray enters it or at t=0 when the origin is inside
+    /// @returns false if no box is hit, otherwise _object and _t are set
+    //----------------------------------------------------------------------------------------------------------------------
+    bool raycast(const ngl::Vec3 &_origin, const ngl::Vec3 &_direction, ngl::Real _maxT, uint32_t &_object, ngl::Real &_t) const;
+
+    size_t size() const {return m_order.size();}
+    const Node &node(uint32_t _index) const {return m_nodes[_index];}
+    // box and object id of the leaf at sorted position _index
+    const AABB &leafBox(uint32_t _index) const {return m_leafBoxes[_index];}
+    uint32_t objectAt(uint32_t _index) const {return m_order[_index];}
+    // box of everything, empty for an empty tree
+    AABB bounds() const;
+
+  private :
+    static constexpr size_t c_grain=4096;
+    static constexpr int c_radixBits=8;
+    // each level down has a longer common prefix, which is at most 64 code and 64 index bits
+    static constexpr size_t c_stackSize=130;
+    static constexpr size_t c_buckets=size_t(1)<<c_radixBits;
+    // parallel LSD radix sort of m_codes carrying m_order along, only the low _bits
+    void sortCodes(int _bits);
+    // length of the common prefix of the codes at sorted positions _i and _j, ties broken on
+    // the positions so every code is unique. -1 when _j is out of range.
+    int delta(int64_t _i, int64_t _j) const;
+    void buildNode(uint32_t _index);
+    // the node boxes from the leaf boxes
+    void fitNodes();
+    template<typename Inside> void query(const Inside &_inside, std::vector<uint32_t> &_out) const;
+    WorkerPool *m_pool;
+    std::vector<Node> m_nodes;
+    // parent of each internal node then of each leaf, the root's entry is unused
+    std::vector<uint32_t> m_parents;
+    std::vector<AABB> m_leafBoxes;
+    std::vector<uint32_t> m_order;
+    std::vector<uint64_t> m_codes;
+    // build scratch
+    std::vector<uint32_t> m_orderScratch;
+    std::vector<uint64_t> m_codesScratch;
+    std::vector<AABB> m_chunkBounds;
+    // per chunk digit counts, then where each chunk writes each digit
+    std::vector<size_t> m_histograms;
+    // children of each internal node that have finished fitting
+    std::unique_ptr<std::atomic<uint32_t>[]> m_visits;
+    size_t m_visitCapacity=0;
+    std::vector<std::vector<Pair>> m_chunkPairs;
+};
+
+#endif
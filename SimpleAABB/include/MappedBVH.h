@@ -0,0 +1,82 @@
+#ifndef MAPPEDBVH_H_
+#define MAPPEDBVH_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AABB.h"
+#include "LinearBVH.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MappedBVH.h
+/// @brief a LinearBVH and the mesh bounds saved next to the mesh and mapped read only at load,
+/// so startup does no building, parsing or pointer fixing. The file is a header followed by
+/// the node, leaf box and object id arrays exactly as they sit in memory, found by offsets from
+/// the start of the file so it works wherever it is mapped. Every process using the same file
+/// shares one copy through the page cache.
+///
+/// The header holds a version and the source key of the mesh (as for the .lod cache) so a
+/// stale or foreign file is rebuilt. Files are written in native byte order.
+/// @class MappedBVH
+//----------------------------------------------------------------------------------------------------------------------
+class MappedBVH
+{
+  public :
+    MappedBVH()=default;
+    ~MappedBVH();
+    MappedBVH(const MappedBVH &)=delete;
+    MappedBVH &operator=(const MappedBVH &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief map _file, false if it is missing, does not match _sourceKey or its header is
+    /// malformed. Only the header and the array ranges are checked, so opening touches one page
+    /// however big the tree. queryBox checks each index as it walks, so a corrupt tree can give
+    /// wrong answers but never reads outside the file.
+    //----------------------------------------------------------------------------------------------------------------------
+    bool open(const std::string &_file, uint64_t _sourceKey);
+    void close();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief save _tree and the mesh bounds. The file is written under a temporary name and
+    /// renamed over _file so processes that have the old one mapped keep reading valid pages.
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool write(const std::string &_file, uint64_t _sourceKey, const LinearBVH &_tree, const AABB &_bounds);
+
+    bool isOpen() const {return m_data!=nullptr;}
+    const AABB &bounds() const {return m_header->m_bounds;}
+    uint64_t sourceKey() const {return m_header->m_sourceKey;}
+    size_t numLeaves() const {return m_header->m_numLeaves;}
+    // numLeaves()-1 of them, the root is node 0 (see LinearBVH). The arrays are inside the file
+    // but their indices are unchecked, walk them as queryBox does.
+    const LinearBVH::Node *nodes() const {return m_nodes;}
+    const AABB *leafBoxes() const {return m_leafBoxes;}
+    const uint32_t *order() const {return m_order;}
+    size_t fileBytes() const {return m_size;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every leaf (triangle) whose box overlaps _box
+    //----------------------------------------------------------------------------------------------------------------------
+    void queryBox(const AABB &_box, std::vector<uint32_t> &_out) const;
+
+  private :
+    struct Header
+    {
+      char m_magic[4];
+      uint32_t m_version;
+      uint64_t m_sourceKey;
+      // catches a file from a build with a different Node layout
+      uint32_t m_nodeBytes;
+      uint32_t m_numLeaves;
+      uint64_t m_nodesOffset;
+      uint64_t m_leafBoxesOffset;
+      uint64_t m_orderOffset;
+      uint64_t m_fileBytes;
+      AABB m_bounds;
+    };
+    const char *m_data=nullptr;
+    size_t m_size=0;
+    // set when the file had to be read rather than mapped
+    std::vector<char> m_copy;
+    const Header *m_header=nullptr;
+    const LinearBVH::Node *m_nodes=nullptr;
+    const AABB *m_leafBoxes=nullptr;
+    const uint32_t *m_order=nullptr;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef MESHLOD_H_
+#define MESHLOD_H_
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <ngl/Mat4.h>
+#include "AABB.h"
+#include "ConvexHull.h"
+#include "IndexedMesh.h"
+#include "MappedBVH.h"
+#include "Meshlets.h"
+#include "QuantizedVertex.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file MeshLOD.h
+/// @brief a chain of simplified versions of an obj mesh. Level 0 is the full mesh, each
+/// following level has roughly half the triangles of the one before. The levels are built
+/// with quadric error half edge collapses so they all share the original vertex buffer and
+/// only differ in their index ranges. The result is cached next to the obj so the
+/// simplification only runs once per asset. The full mesh's triangles are put in meshlet
+/// order so its meshlets can be drawn as index ranges. A hierarchy over them is cached the
+/// same way in a file that is mapped rather than read (see MappedBVH). Every level is then
+/// reordered for the post transform cache and overdraw (see IndexOptimizer).
+/// @class MeshLOD
+//----------------------------------------------------------------------------------------------------------------------
+class MeshLOD
+{
+  public :
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief load the chain from _objFile.lod if it is up to date, else parse the obj then
+    /// build and save it. No GL calls are made so this can run on a loader thread, the GPU
+    /// copy is made afterwards with upload().
+    /// @param[in] _objFile the full resolution mesh
+    /// @param[in] _numLevels max number of levels including the full mesh
+    //----------------------------------------------------------------------------------------------------------------------
+    MeshLOD(const std::string &_objFile, size_t _numLevels=5);
+    ~MeshLOD();
+    MeshLOD(const MeshLOD &)=delete;
+    MeshLOD &operator=(const MeshLOD &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief FLOAT uploads IndexedMesh::Vertex as it is, QUANTIZED uploads the half size
+    /// QuantizedVertex (draw with the QuantizedTextureShader and dequantizeMatrix()). Applies to
+    /// meshes constructed after it is set, so set it before any loads start.
+    //----------------------------------------------------------------------------------------------------------------------
+    enum class VertexFormat : char {FLOAT,QUANTIZED};
+    static void setVertexFormat(VertexFormat _format) {s_vertexFormat=_format;}
+    static VertexFormat vertexFormat() {return s_vertexFormat;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief true (the default) reorders the indices of every level for the vertex cache and
+    /// overdraw and the vertices for fetch locality when the chain is built. False keeps the
+    /// file's order, cached separately so the two can be compared. Set before any loads start.
+    //----------------------------------------------------------------------------------------------------------------------
+    static void setOptimizeIndices(bool _optimize) {s_optimizeIndices=_optimize;}
+    // the cache file for _objFile with _extension (".lod" or ".bvh") for the current order
+    static std::string cacheFile(const std::string &_objFile, const std::string &_extension);
+
+    // false if the obj could not be loaded
+    bool isValid() const {return !m_levels.empty();}
+    // object space bounds of the full mesh
+    const AABB &bounds() const {return m_bounds;}
+    // convex hull of the vertices, built with the levels and kept in the same cache
+    const ConvexHull &hull() const {return m_hull;}
+    // triangle hierarchy of level 0, leaf ids are triangle numbers. Mapped from the .bvh cache
+    // (built and written first if that is missing or stale) on the first call, from any thread.
+    // Not open if it could not be built or mapped.
+    const MappedBVH &bvh() const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief copy up to _maxBytes more of the vertex / index data to the GPU, the first call
+    /// creates the VAO. Needs a current GL context.
+    /// @returns true once everything has been uploaded and the mesh can be drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    bool upload(size_t _maxBytes);
+    bool isUploaded() const;
+    // total size of the GPU buffers
+    size_t gpuBytes() const;
+    size_t numLevels() const {return m_levels.size();}
+    size_t numTriangles(size_t _level) const {return m_levels[_level].m_count/3;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw one level, the caller binds the texture (use with the TextureShader)
+    //----------------------------------------------------------------------------------------------------------------------
+    void draw(size_t _level) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw index ranges of the full mesh in one call, eg the meshlets that survive
+    /// Meshlets::cull
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawRanges(const GLsizei *_counts, const void *const *_offsets, size_t _numRanges) const;
+    // clusters of the full mesh's triangles, built with the levels and kept in the same cache
+    const Meshlets &meshlets() const {return m_meshlets;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief CPU side access to a level for software rasterization, positions are the first
+    /// three floats of each vertex, c_positionStride floats apart
+    //----------------------------------------------------------------------------------------------------------------------
+    const ngl::Real *positions() const {return &m_geometry.m_verts[0].m_x;}
+    static constexpr size_t c_positionStride=sizeof(IndexedMesh::Vertex)/sizeof(ngl::Real);
+    const GLuint *indices(size_t _level) const {return &m_allIndices[m_levels[_level].m_first];}
+    // the float vertices, numVertices() of them, whatever format was uploaded
+    const IndexedMesh::Vertex *vertices() const {return m_geometry.m_verts.data();}
+    // the GPU vertex buffer once uploaded, for compute passes. The position comes first in each
+    // vertex, vertexStride() 32 bit words apart, as floats or (isQuantized()) 16 bit unorms.
+    GLuint vertexBuffer() const {return m_vbo;}
+    size_t vertexStride() const {return isQuantized() ? sizeof(QuantizedVertex)/4 : c_positionStride;}
+    bool isQuantized() const {return !m_quantized.empty();}
+    // premultiply the model matrix with this to draw, identity unless isQuantized()
+    ngl::Mat4 dequantizeMatrix() const;
+    size_t numVertices() const {return m_geometry.m_verts.size();}
+    size_t numIndices(size_t _level) const {return m_levels[_level].m_count;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief pick a level from the on screen size of a world space box
+    /// @param[in] _box world space bounds of the object
+    /// @param[in] _VP the view projection (ortho or perspective) the box is drawn with
+    /// @param[in] _viewportWidth _viewportHeight size of the viewport in pixels
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t selectLevel(const AABB &_box, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief projected size in pixels of the larger screen axis of _box, each axis scaled by
+    /// its own viewport dimension so wide or tall panels are measured right. A box crossing the
+    /// near plane is reported as covering the whole viewport.
+    //----------------------------------------------------------------------------------------------------------------------
+    static ngl::Real projectedSize(const AABB &_box, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief on screen size at which the full mesh is used, each halving drops a level
+    //----------------------------------------------------------------------------------------------------------------------
+    static constexpr ngl::Real c_fullDetailPixels=512.0f;
+
+  private :
+    struct Level
+    {
+      // offset and count in m_allIndices
+      GLuint m_first;
+      GLuint m_count;
+    };
+    // build the levels from m_geometry (which must already hold the full mesh)
+    void build(size_t _numLevels);
+    // IndexOptimizer passes over the built levels, level 0 through its meshlets
+    void optimizeIndices();
+    // _sourceKey identifies the obj the cache was built from (file size and time)
+    bool load(const std::string &_fname, uint64_t _sourceKey);
+    bool save(const std::string &_fname, uint64_t _sourceKey) const;
+    // build the level 0 triangle hierarchy and write it to _fname
+    bool saveBVH(const std::string &_fname, uint64_t _sourceKey) const;
+    IndexedMesh m_geometry;
+    AABB m_bounds;
+    ConvexHull m_hull;
+    Meshlets m_meshlets;
+    // where bvh() finds the cache and the key it must match
+    std::string m_bvhFile;
+    uint64_t m_sourceKey=0;
+    mutable std::once_flag m_bvhOnce;
+    mutable MappedBVH m_bvh;
+    // the vertices in the GPU format when quantizing, kept until the mesh is destroyed so an
+    // upload can be resumed
+    std::vector<QuantizedVertex> m_quantized;
+    static VertexFormat s_vertexFormat;
+    static bool s_optimizeIndices;
+    // every level's indices one after the other
+    std::vector<GLuint> m_allIndices;
+    std::vector<Level> m_levels;
+    GLuint m_vao=0;
+    GLuint m_vbo=0;
+    GLuint m_ibo=0;
+    // bytes copied so far, vertices first then indices
+    size_t m_uploaded=0;
+};
+
+#endif
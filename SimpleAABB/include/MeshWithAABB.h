@@ -5,29 +5,54 @@
 #include <ngl/BBox.h>
 #include <ngl/Transformation.h>
 #include <ngl/Vec3.h>
-#include <ngl/Obj.h>
-#include <ngl/AbstractVAO.h>
+#include "AABB.h"
+
+class ConvexHull;
 
 class MeshWithAABB
 {
   public :
-    MeshWithAABB( ngl::Obj *_mesh);
+    // just the bounds, the mesh itself is drawn through the GeometryCache
+    MeshWithAABB(const AABB &_localBounds);
+    // replace the object space box, the world box is reset until the next setTransform.
+    // _hull (owned by the mesh, may be null) gives exact world boxes in BoundsMode::HULL
+    void setLocalBounds(const AABB &_box, const ConvexHull *_hull=nullptr);
     void setTransform( ngl::Transformation &_t);
-    void draw() const;
-    void drawAABB() const;
-    enum class Extents : char {LEFT,RIGHT,TOP,BOTTOM,BACK,FRONT};
+    // set from a full world matrix (used by the SceneGraph)
+    void setTransform( const ngl::Mat4 &_tx);
+    // draw the box as lines, this sets MVP on the current shader from _VP
+    void drawAABB(const ngl::Mat4 &_VP) const;
+    // draw the box with filled faces, used for occlusion queries
+    void drawAABBSolid(const ngl::Mat4 &_VP) const;
+    // the matrix that maps the unit box (-0.5 to 0.5) onto the world AABB
+    ngl::Mat4 boxMatrix() const;
+    // release the shared unit box, call before the GL context goes away
+    static void releaseUnitBox();
+    // the world space box from the last setTransform
+    const AABB &getAABB() const {return m_aabb;}
+    // narrow the world box with a tighter one that also bounds the mesh (kept until the next
+    // setTransform)
+    void tighten(const AABB &_box);
+    // CORNERS transforms the 8 corners of the local box (fast, loose under rotation), HULL
+    // transforms the convex hull vertices (exact, cost grows with the hull size), SUPPORT
+    // gives the same exact box by walking the hull from last update's extreme points (cost
+    // grows with how far the node turned)
+    enum class BoundsMode : char {CORNERS,HULL,SUPPORT};
+    // applies from the next setTransform on, shared by every instance
+    static void setBoundsMode(BoundsMode _mode) {s_boundsMode=_mode;}
+    static BoundsMode boundsMode() {return s_boundsMode;}
   private :
     // this is the untransformed extents of the mesh (initial BBox)
     std::array<ngl::Vec4,8> m_defaultExtents;
-    // the actual mesh used for drawing etc
-    ngl::Obj *m_mesh;
-    // bounding box the size of the AABB
-    std::shared_ptr<ngl::BBox> m_bbox;
-    // calculate the extents of the tx and create bbox;
-    void getExtents();
-    void setBBox();
- //   ngl::AbstractVAO *m_vao=nullptr;
-
+    // one unit box VAO shared by every instance, scaled onto the AABB when drawn
+    static std::unique_ptr<ngl::BBox> s_unitBox;
+    static ngl::BBox &unitBox();
+    // world space min / max of the transformed extents
+    AABB m_aabb;
+    const ConvexHull *m_hull=nullptr;
+    // hull points furthest along -x -y -z +x +y +z at the last SUPPORT update
+    std::array<uint32_t,6> m_extremes;
+    static BoundsMode s_boundsMode;
 };
 
 
@@ -0,0 +1,81 @@
+#ifndef MESHLETS_H_
+#define MESHLETS_H_
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include <ngl/Vec4.h>
+#include "AABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Meshlets.h
+/// @brief a triangle list split into small clusters (up to c_maxVertices vertices and
+/// c_maxTriangles triangles) that can be culled on their own, so a big mesh that is mostly off
+/// screen or facing away is not submitted whole. Each meshlet keeps its object space box and a
+/// cone holding all of its triangle normals. A meshlet is dropped when its box is outside the
+/// frustum or when the eye is behind every one of its triangles (the cone test from
+/// meshoptimizer, made conservative for the bounding sphere). Meshlets are culled four at a
+/// time with SSE and the survivors come out as index ranges for one glMultiDrawElements, with
+/// neighbouring survivors merged.
+/// @class Meshlets
+//----------------------------------------------------------------------------------------------------------------------
+class Meshlets
+{
+  public :
+    static constexpr size_t c_maxVertices=64;
+    static constexpr size_t c_maxTriangles=124;
+    struct Meshlet
+    {
+      // range of the index buffer
+      GLuint m_first;
+      GLuint m_count;
+      AABB m_box;
+      ngl::Vec3 m_coneAxis;
+      // sine of the cone's half angle, above 1 when the normals are too spread to ever cull
+      ngl::Real m_coneCutoff;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief group the triangles of _indices, reordering them in place so each meshlet is a
+    /// contiguous run. Triangles are added to a meshlet by how few new vertices they bring.
+    /// Positions are the first three floats of each vertex, _stride floats apart.
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const ngl::Real *_positions, size_t _stride, GLuint *_indices, size_t _numTriangles);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief after build(), reorder each meshlet's triangles for the vertex cache and then the
+    /// meshlets themselves as overdraw clusters (see IndexOptimizer), keeping each contiguous
+    //----------------------------------------------------------------------------------------------------------------------
+    void optimize(const ngl::Real *_positions, size_t _stride, GLuint *_indices);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief find the meshlets that can be seen
+    /// @param[in] _MVP object to clip space
+    /// @param[in] _eye object space eye, w 1 for a perspective view. An orthographic view has
+    /// its eye at infinity, w 0 and xyz pointing back towards the viewer.
+    /// @param[in] _cullBackFaces false to skip the cone test, eg when the model matrix mirrors
+    /// @param[out] _counts,_offsets index counts and byte offsets for glMultiDrawElements,
+    /// room for size() of each
+    /// @param[out] _numRanges ranges written
+    /// @returns triangles in the ranges
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t cull(const ngl::Mat4 &_MVP, const ngl::Vec4 &_eye, bool _cullBackFaces,
+                GLsizei *_counts, const void **_offsets, size_t &_numRanges) const;
+
+    size_t size() const {return m_meshlets.size();}
+    const Meshlet &meshlet(size_t _index) const {return m_meshlets[_index];}
+    // binary form used by the MeshLOD cache, read fails (leaving the meshlets as they were)
+    // unless the ranges are whole triangles covering the _numIndices of level 0 in order
+    bool read(std::istream &_in, size_t _numIndices);
+    bool write(std::ostream &_out) const;
+
+  private :
+    // fill m_streams from m_meshlets
+    void setStreams();
+    std::vector<Meshlet> m_meshlets;
+    // the culling data as c_numStreams arrays of m_padded floats so four meshlets load at once
+    enum Stream {CENTRE_X,CENTRE_Y,CENTRE_Z,EXTENT_X,EXTENT_Y,EXTENT_Z,AXIS_X,AXIS_Y,AXIS_Z,CUTOFF,RADIUS,c_numStreams};
+    std::vector<ngl::Real> m_streams;
+    size_t m_padded=0;
+};
+
+#endif
@@ -7,8 +7,24 @@
 #include <ngl/Transformation.h>
 #include <QOpenGLWindow>
 #include <memory>
+#include <string>
 #include <array>
+#include <chrono>
+#include <vector>
 #include "MeshWithAABB.h"
+#include "SceneGraph.h"
+#include "GeometryCache.h"
+#include "OcclusionCuller.h"
+#include "SoftwareOcclusion.h"
+#include "FrameArena.h"
+#include "Profiler.h"
+#include "Stats.h"
+#include "ComputeBounds.h"
+#include "SpatialHashGrid.h"
+#include "LinearBVH.h"
+#include "IndirectRenderer.h"
+#include "FrustumSet.h"
+#include "ViewportLayout.h"
 //----------------------------------------------------------------------------------------------------------------------
 /// @file NGLScene.h
 /// @brief this class inherits from the Qt OpenGLWindow and allows us to use NGL to draw OpenGL
@@ -27,9 +43,10 @@ class NGLScene : public QOpenGLWindow
   public:
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief ctor for our NGL drawing class
-    /// @param [in] parent the parent window to the class
+    /// @param [in] _sceneFile the scene description to load in initializeGL
+    /// @param [in] _statsSocket if not empty the frame counters are served as JSON on this UNIX socket
     //----------------------------------------------------------------------------------------------------------------------
-    NGLScene();
+    NGLScene(const std::string &_sceneFile="scenes/default.scene", const std::string &_statsSocket="");
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief dtor must close down ngl and release OpenGL resources
     //----------------------------------------------------------------------------------------------------------------------
@@ -49,25 +66,43 @@ class NGLScene : public QOpenGLWindow
     void resizeGL(int _w, int _h) override;
 
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief toggle full / panel screen
+    /// @brief toggle the viewport under the mouse filling the window and the full layout
     //----------------------------------------------------------------------------------------------------------------------
     void toggleWindow();
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief frame in the active window
+    /// @brief put the active viewport's camera back where the layout started it
     //----------------------------------------------------------------------------------------------------------------------
     void frameActive();
-private :
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief enums for the current window
+    /// @brief false if initializeGL could not load the layout or scene file, nothing is drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    bool isSceneLoaded() const {return m_sceneLoaded;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief true until every mesh and texture the scene uses is on the GPU
+    //----------------------------------------------------------------------------------------------------------------------
+    bool isLoading() const {return m_geometry.isLoading();}
     //----------------------------------------------------------------------------------------------------------------------
-    enum class Window{TOP,FRONT,SIDE,PERSP,ALL};
+    /// @brief how the meshes are drawn, a draw per node or one multi draw indirect per panel
+    /// with the commands made by a compute shader cull or on the CPU. Set before the window is
+    /// created to pick the starting path, I cycles them.
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief enum to indicate if we are in full screen or panel mode for drawing
+    enum class DrawPath : char {DIRECT,GPU,CPU};
+    static void setDrawPath(DrawPath _path) {s_drawPath=_path;}
     //----------------------------------------------------------------------------------------------------------------------
-    enum class Mode{FULLSCREEN,PANEL};
+    /// @brief the viewport layout file initializeGL loads (see ViewportLayout.h), set before
+    /// the window is created
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief this structure is used to store mouse info for each windwo
-    /// there will be one each plus a fullscreen one
+    static void setLayoutFile(const std::string &_file) {s_layoutFile=_file;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief print the frame's triangle, culling, heap allocation and broad phase figures to
+    /// the console when they change. Off by default as the render loop should not be writing
+    /// to the console, the same figures are in the Stats counters (J and --stats).
+    //----------------------------------------------------------------------------------------------------------------------
+    static void setVerbose(bool _verbose) {s_verbose=_verbose;}
+private :
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief this structure is used to store mouse info for each viewport, a viewport keeps
+    /// its own when it fills the window
     //----------------------------------------------------------------------------------------------------------------------
 
     typedef struct MouseInfo
@@ -83,37 +118,49 @@ private :
       bool m_translate; /// @brief flag to indicate if trans is active
     }m;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief array of mouse info
+    /// @brief the viewports and their mouse info, in layout order
     //----------------------------------------------------------------------------------------------------------------------
-    std::array<MouseInfo,5> m_panelMouseInfo;
+    static std::string s_layoutFile;
+    ViewportLayout m_layout;
+    std::vector<MouseInfo> m_panelMouseInfo;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief which is the current active window
+    /// @brief the viewport filling the window or ViewportLayout::c_noViewport for the layout
     //----------------------------------------------------------------------------------------------------------------------
-    Window m_activeWindow=Window::ALL;
+    size_t m_fullscreen=ViewportLayout::c_noViewport;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief draw the top
-    /// @param[in] _m the mode to draw the window
+    /// @brief the viewport the mouse acts on, the full window one or the one under the mouse
     //----------------------------------------------------------------------------------------------------------------------
-    void top(Mode _m=Mode::PANEL);
+    size_t activeViewport() const;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief draw the front
-    /// @param[in] _m the mode to draw the window
+    /// @brief where the mouse starts viewport _v's scene, ortho views keep their zoom in z
     //----------------------------------------------------------------------------------------------------------------------
-    void front(Mode _m=Mode::PANEL);
+    ngl::Vec3 startModelPos(size_t _v) const;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief draw the side
-    /// @param[in] _m the mode to draw the window
+    /// @brief the matrices of each viewport drawn this frame, bit k of a FrustumSet mask is
+    /// m_drawnViews[k]
     //----------------------------------------------------------------------------------------------------------------------
-    void side(Mode _m=Mode::PANEL);
+    struct ViewState
+    {
+      size_t m_viewport;
+      // the mouse transform of the scene, then the camera
+      ngl::Mat4 m_model;
+      ngl::Mat4 m_view;
+      ngl::Mat4 m_projection;
+      ngl::Mat4 m_VP;
+      std::array<int,4> m_rect;
+    };
+    std::vector<ViewState> m_drawnViews;
+    std::vector<ngl::Mat4> m_drawnVPs;
+    FrustumSet m_frustums;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief draw the perspective
-    /// @param[in] _m the mode to draw the window
+    /// @brief fill m_drawnViews with the viewports to draw this frame
     //----------------------------------------------------------------------------------------------------------------------
-    void persp(Mode _m=Mode::PANEL);
+    void setupViews();
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief get the quadrant the window is in
+    /// @brief the mouse transform of viewport _v for the scene or for its grid. Ortho views pan
+    /// along the camera axes and zoom with a scale, persp views spin and move the scene.
     //----------------------------------------------------------------------------------------------------------------------
-    Window getActiveQuadrant()const;
+    ngl::Mat4 modelMatrix(size_t _v, bool _grid) const;
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief current mouse x position
     //----------------------------------------------------------------------------------------------------------------------
@@ -131,31 +178,187 @@ private :
     //----------------------------------------------------------------------------------------------------------------------
     int m_height=720;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief our view matrix
+    /// @brief the scene description file and the shared meshes / textures it uses, each
+    /// mesh carries its LOD chain, the level is picked per viewport from the projected AABB
+    //----------------------------------------------------------------------------------------------------------------------
+    std::string m_sceneFile;
+    bool m_sceneLoaded=false;
+    GeometryCache m_geometry;
+    bool m_useLOD=true;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the transform hierarchy of meshes and the root node spun by the timer
+    //----------------------------------------------------------------------------------------------------------------------
+    SceneGraph m_scene;
+    SceneGraph::NodeID m_root=0;
+    ngl::Mat4 m_rootLocal;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief triangles the frame would draw at full detail and what was actually submitted
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t m_trianglesFull=0;
+    size_t m_trianglesSubmitted=0;
+    size_t m_lastTrianglesSubmitted=0;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief occlusion queries per viewport, meshes whose box was hidden last time are skipped
+    //----------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<OcclusionCuller> m_occlusion;
+    bool m_useOcclusion=true;
+    std::array<size_t,Stats::c_maxViews> m_occludedMeshes;
+    std::array<size_t,Stats::c_maxViews> m_lastOccludedMeshes;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief frustum culling of every drawn viewport in one walk over the scene, each node
+    /// gets a bit per viewport and the nodes of each viewport are gathered into one frame
+    /// arena list, _starts[k] to _starts[k+1] for m_drawnViews[k]
+    //----------------------------------------------------------------------------------------------------------------------
+    void cullViews(FrameVector<uint32_t> &_nodes, FrameVector<size_t> &_starts);
+    std::array<size_t,Stats::c_maxViews> m_frustumCulled;
+    std::array<size_t,Stats::c_maxViews> m_lastFrustumCulled;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief print _label and the count of each viewport in the layout
+    //----------------------------------------------------------------------------------------------------------------------
+    void printPerView(const char *_label, const std::array<size_t,Stats::c_maxViews> &_counts) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the console figures at the end of paintGL, only when verbose
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool s_verbose;
+    void reportFrame();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief CPU depth buffer culling, run per viewport over the nodes in its frustum (C toggles).
+    /// Off by default, it rasterizes full detail occluders for every viewport every frame and
+    /// only pays when they hide more draws than that costs (--verbose prints both)
+    //----------------------------------------------------------------------------------------------------------------------
+    SoftwareOcclusion m_softwareOcclusion;
+    bool m_useSoftwareOcclusion=false;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief meshlet frustum and back face culling of full detail meshes (M toggles), with
+    /// the triangles it saved per viewport
     //----------------------------------------------------------------------------------------------------------------------
-    ngl::Mat4 m_view;
+    bool m_useMeshlets=false;
+    std::array<size_t,Stats::c_maxViews> m_meshletCulled;
+    std::array<size_t,Stats::c_maxViews> m_lastMeshletCulled;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief our projection matrix
+    /// @brief the multi draw indirect renderer (needs GL 4.3) and the nodes it drew per viewport.
+    /// The software and query occlusion culling are skipped on those paths. GPU culled counts
+    /// come back a couple of frames late and stand in for the frame's counts when they do.
     //----------------------------------------------------------------------------------------------------------------------
-    ngl::Mat4 m_projection;
+    static DrawPath s_drawPath;
+    DrawPath m_drawPath;
+    std::unique_ptr<IndirectRenderer> m_indirect;
+    std::array<IndirectRenderer::Counts,Stats::c_maxViews> m_indirectCounts;
+    std::array<size_t,Stats::c_maxViews> m_indirectNodes;
+    std::array<size_t,Stats::c_maxViews> m_lastIndirectNodes;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief the model position for mouse movement
+    /// @brief draw the frame's nodes for drawn view _view through m_indirect
     //----------------------------------------------------------------------------------------------------------------------
-    ngl::Vec3 m_modelPos;
+    void drawIndirect(const ViewState &_view);
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief our model
+    /// @brief per frame cost of the software cull against the cost of the mesh draws
     //----------------------------------------------------------------------------------------------------------------------
-    std::shared_ptr<ngl::Obj> m_mesh;
-    std::unique_ptr<MeshWithAABB> m_meshAABB;
+    size_t m_softwareCulled=0;
+    size_t m_meshesDrawn=0;
+    std::chrono::steady_clock::duration m_softwareCullTime;
+    std::chrono::steady_clock::duration m_meshDrawTime;
+    std::chrono::steady_clock::time_point m_lastCullReport;
     //----------------------------------------------------------------------------------------------------------------------
-    /// @brief the mouse transformations
+    /// @brief rasterize the largest of the _numNodes nodes into m_softwareOcclusion and fill
+    /// _visible with a flag for each of them
     //----------------------------------------------------------------------------------------------------------------------
-    ngl::Transformation m_globalTransform;
+    void softwareCull(const ViewState &_view, const uint32_t *_nodes, size_t _numNodes, FrameVector<unsigned char> &_visible);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the meshlets of the full detail mesh that survive culling
+    /// @param[in] _view the global transform times the viewport's view
+    /// @returns triangles drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t drawMeshlets(const MeshLOD &_lod, const ngl::Mat4 &_world, const ngl::Mat4 &_view, const ngl::Mat4 &_VP, bool _orthographic);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief exact world boxes from every transformed vertex, computed on the GPU (E toggles,
+    /// needs GL 4.3). Results arrive a frame or more late so each keeps the transform it was
+    /// computed with and is carried over to the node's current transform before use.
+    //----------------------------------------------------------------------------------------------------------------------
+    struct ExactBounds
+    {
+      AABB m_box;
+      ngl::Mat4 m_world;
+      ngl::Mat4 m_inverseWorld;
+      // transform of the last request so an unmoved node is not sent again
+      ngl::Mat4 m_sentWorld;
+      bool m_valid=false;
+      bool m_sent=false;
+    };
+    std::unique_ptr<ComputeBounds> m_computeBounds;
+    bool m_exactBounds=false;
+    std::vector<ExactBounds> m_exact;
+    std::vector<ComputeBounds::Result> m_exactResults;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief apply the exact boxes that have come back and send the nodes that have moved
+    //----------------------------------------------------------------------------------------------------------------------
+    void updateExactBounds();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief rebuild every world box from the local bounds (or hull) after a bounds mode change
+    //----------------------------------------------------------------------------------------------------------------------
+    void resetBounds();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief overlapping pairs of world boxes found by a spatial hash grid or an LBVH rebuilt
+    /// after every scene update (G cycles off, grid, LBVH), with --verbose the pair count is
+    /// printed when it changes
+    //----------------------------------------------------------------------------------------------------------------------
+    enum class BroadPhase {OFF,GRID,LBVH};
+    BroadPhase m_broadPhase=BroadPhase::OFF;
+    SpatialHashGrid m_grid;
+    LinearBVH m_lbvh;
+    std::vector<AABB> m_gridBoxes;
+    std::vector<SpatialHashGrid::Pair> m_pairs;
+    size_t m_lastPairs=static_cast<size_t>(-1);
+    void updateBroadPhase();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief startup timing printed with --verbose, assets load in the background so the first
+    /// frame comes well before everything is on the GPU
+    //----------------------------------------------------------------------------------------------------------------------
+    std::chrono::steady_clock::time_point m_startTime;
+    bool m_firstFrameReported=false;
+    bool m_loadReported=false;
+    std::vector<GeometryCache::MeshID> m_readyMeshes;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief scratch memory for lists that only live for a frame, flipped only at the start of
+    /// paintGL so what timerEvent allocates lasts into the following paint. m_frameAllocations
+    /// counts heap allocations made by the frame code (timer plus paint) which should settle to
+    /// zero once everything has loaded.
+    //----------------------------------------------------------------------------------------------------------------------
+    FrameArena m_frameArena;
+    size_t m_frameAllocations=0;
+    size_t m_lastFrameAllocations=static_cast<size_t>(-1);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief GPU timing for the viewport draws and the on screen profile overlay (P toggles
+    /// profiling and the overlay, T writes a Chrome trace)
+    //----------------------------------------------------------------------------------------------------------------------
+    GpuProfiler m_gpuProfiler;
+    std::unique_ptr<ngl::Text> m_text;
+    bool m_showProfile=false;
+    std::vector<std::pair<const char *,double>> m_cpuZones;
+    std::vector<std::pair<const char *,double>> m_gpuZones;
+    std::vector<std::pair<const char *,double>> m_lastGpuZones;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief serves the Stats counters to monitoring, J also writes them to SimpleAABB.stats.json
+    //----------------------------------------------------------------------------------------------------------------------
+    std::unique_ptr<StatsServer> m_statsServer;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw the last frame's zone times and counters over the whole window
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawProfileOverlay();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief give the geometry cache this frame's upload budget and swap the real bounds in
+    /// for the placeholders of any mesh that became ready
+    //----------------------------------------------------------------------------------------------------------------------
+    void uploadAssets();
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief method to load transform matrices to the shader
     //----------------------------------------------------------------------------------------------------------------------
-    void loadMatricesToShader();
-    void loadMatricesToTextureShader();
+    void loadMatricesToShader(const ngl::Mat4 &_model, const ViewState &_view);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief draw one viewport, its nodes and their AABBs then the grid
+    /// @param[in] _view the drawn view
+    /// @param[in] _nodes the nodes in its frustum from cullViews, empty on the indirect paths
+    //----------------------------------------------------------------------------------------------------------------------
+    void drawViewport(const ViewState &_view, const uint32_t *_nodes, size_t _numNodes);
     //----------------------------------------------------------------------------------------------------------------------
     /// @brief Qt Event called when a key is pressed
     /// @param [in] _event the Qt event to query for size etc
@@ -192,6 +395,8 @@ private :
     //----------------------------------------------------------------------------------------------------------------------
     ngl::Transformation m_transform;
     bool m_active=false;
+    // degrees the root has spun, one per timer tick so a replay reproduces it exactly
+    float m_rotation=0.0f;
     enum class RotMode : char {XROT,YROT,ZROT,ALL};
     RotMode m_rotMode=RotMode::XROT;
 
@@ -0,0 +1,70 @@
+#ifndef OCCLUSIONCULLER_H_
+#define OCCLUSIONCULLER_H_
+#include <vector>
+#include <ngl/Types.h>
+#include <ngl/Mat4.h>
+#include "AABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file OcclusionCuller.h
+/// @brief hardware occlusion queries, one per object per view. The box of each object is
+/// drawn depth only inside a GL_ANY_SAMPLES_PASSED query after the visible meshes, the result
+/// is picked up on a later frame once GL reports it available so we never stall waiting
+/// for the GPU. Objects keep their last known state until a new result arrives.
+/// @class OcclusionCuller
+//----------------------------------------------------------------------------------------------------------------------
+class OcclusionCuller
+{
+  public :
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief ctor
+    /// @param[in] _numViews number of independent views (each has its own depth buffer contents)
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit OcclusionCuller(size_t _numViews);
+    ~OcclusionCuller();
+    OcclusionCuller(const OcclusionCuller &)=delete;
+    OcclusionCuller &operator=(const OcclusionCuller &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief make sure there are _numObjects queries for _view and collect any finished results,
+    /// call once per view per frame before isVisible
+    //----------------------------------------------------------------------------------------------------------------------
+    void beginView(size_t _view, size_t _numObjects);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the last known result, objects with no result yet are visible
+    //----------------------------------------------------------------------------------------------------------------------
+    bool isVisible(size_t _view, size_t _object) const {return m_views[_view][_object].m_visible;}
+    // true once a query for the object has been read back, its result is then a real one
+    bool hasResult(size_t _view, size_t _object) const {return m_views[_view][_object].m_answered;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief true if a new query can be issued (the previous one has been read back)
+    //----------------------------------------------------------------------------------------------------------------------
+    bool canQuery(size_t _view, size_t _object) const {return !m_views[_view][_object].m_pending;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief start / end the query for an object, draw its box in between. The depth and
+    /// colour writes should be disabled by the caller for the whole box pass.
+    //----------------------------------------------------------------------------------------------------------------------
+    void beginQuery(size_t _view, size_t _object);
+    void endQuery(size_t _view, size_t _object);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief mark an object visible without a query, used when the box can't be trusted
+    /// (e.g. it crosses the near plane so some of its faces would be clipped away)
+    //----------------------------------------------------------------------------------------------------------------------
+    void forceVisible(size_t _view, size_t _object);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief true if any corner of _box is behind the near plane of _VP (clip z < -w), so
+    /// part of the box would be clipped away
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool crossesNearPlane(const AABB &_box, const ngl::Mat4 &_VP);
+
+  private :
+    struct Query
+    {
+      GLuint m_id=0;
+      bool m_pending=false;
+      bool m_visible=true;
+      bool m_answered=false;
+    };
+    std::vector<std::vector<Query>> m_views;
+};
+
+#endif
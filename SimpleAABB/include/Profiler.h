@@ -0,0 +1,167 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <ngl/Types.h>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Profiler.h
+/// @brief scoped CPU timing zones, GL timestamp zones and Chrome trace export.
+///
+/// PROFILE_ZONE("name") times the enclosing scope. Every thread writes its zones to its own
+/// fixed size ring buffer so recording takes no locks, a lock is only taken the first time a
+/// thread records and when the buffers are read for export. When profiling is disabled a zone
+/// costs one relaxed atomic load. Names must be string literals (or otherwise live for the
+/// whole run) as only the pointer is stored.
+///
+/// writeChromeTrace() writes everything still in the buffers in the trace event format that
+/// chrome://tracing and Perfetto load.
+/// @class Profiler
+//----------------------------------------------------------------------------------------------------------------------
+class Profiler
+{
+  public :
+    struct Event
+    {
+      const char *m_name;
+      // nanoseconds since the profiler started
+      uint64_t m_start;
+      uint64_t m_end;
+    };
+    // events kept per thread, older ones are overwritten
+    static constexpr size_t c_eventsPerThread=1<<16;
+
+    static bool enabled() {return s_enabled.load(std::memory_order_relaxed);}
+    static void setEnabled(bool _on) {s_enabled.store(_on,std::memory_order_relaxed);}
+    static uint64_t now();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a finished zone to the calling thread's buffer
+    //----------------------------------------------------------------------------------------------------------------------
+    static void record(const char *_name, uint64_t _start, uint64_t _end);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a GPU zone already converted to the CPU clock, GL thread only
+    //----------------------------------------------------------------------------------------------------------------------
+    static void recordGPU(const char *_name, uint64_t _start, uint64_t _end);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief write every buffered CPU and GPU zone as Chrome trace event JSON
+    //----------------------------------------------------------------------------------------------------------------------
+    static bool writeChromeTrace(const std::string &_file);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief total time per zone name recorded by the calling thread since the last call,
+    /// used for the on screen overlay. _gpu gives the GPU zones instead.
+    //----------------------------------------------------------------------------------------------------------------------
+    static void collectFrame(std::vector<std::pair<const char *,double>> &_msPerZone, bool _gpu=false);
+
+  private :
+    struct ThreadBuffer;
+    static ThreadBuffer &threadBuffer();
+    static ThreadBuffer &gpuBuffer();
+    // every buffer ever created, they are never freed so a thread exiting is harmless
+    static std::mutex &registryMutex();
+    static std::vector<std::unique_ptr<ThreadBuffer>> &registry();
+    static std::atomic<bool> s_enabled;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief times its own lifetime, use through PROFILE_ZONE
+//----------------------------------------------------------------------------------------------------------------------
+class ProfileZone
+{
+  public :
+    explicit ProfileZone(const char *_name) : m_name(_name), m_active(Profiler::enabled())
+    {
+      if(m_active)
+      {
+        m_start=Profiler::now();
+      }
+    }
+    ~ProfileZone()
+    {
+      if(m_active)
+      {
+        Profiler::record(m_name,m_start,Profiler::now());
+      }
+    }
+    ProfileZone(const ProfileZone &)=delete;
+    ProfileZone &operator=(const ProfileZone &)=delete;
+  private :
+    const char *m_name;
+    uint64_t m_start=0;
+    bool m_active;
+};
+
+#define PROFILE_ZONE_JOIN2(_a,_b) _a##_b
+#define PROFILE_ZONE_JOIN(_a,_b) PROFILE_ZONE_JOIN2(_a,_b)
+#define PROFILE_ZONE(_name) ProfileZone PROFILE_ZONE_JOIN(profileZone,__LINE__)(_name)
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief GL_TIMESTAMP query pairs around GPU work. Results are read a few frames later when
+/// they are available so the CPU never waits on the GPU, then handed to Profiler::recordGPU.
+/// GL thread only and needs a current context for everything but construction.
+/// @class GpuProfiler
+//----------------------------------------------------------------------------------------------------------------------
+class GpuProfiler
+{
+  public :
+    GpuProfiler()=default;
+    ~GpuProfiler();
+    GpuProfiler(const GpuProfiler &)=delete;
+    GpuProfiler &operator=(const GpuProfiler &)=delete;
+    // zones do not nest, each begin must be followed by its end
+    void begin(const char *_name);
+    void end();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief call once per frame after the last zone, collects the oldest frame's results
+    //----------------------------------------------------------------------------------------------------------------------
+    void endFrame();
+
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief RAII begin / end that does nothing while the Profiler is disabled
+    //----------------------------------------------------------------------------------------------------------------------
+    class Zone
+    {
+      public :
+        Zone(GpuProfiler &_profiler, const char *_name) : m_profiler(Profiler::enabled() ? &_profiler : nullptr)
+        {
+          if(m_profiler)
+          {
+            m_profiler->begin(_name);
+          }
+        }
+        ~Zone()
+        {
+          if(m_profiler)
+          {
+            m_profiler->end();
+          }
+        }
+        Zone(const Zone &)=delete;
+        Zone &operator=(const Zone &)=delete;
+      private :
+        GpuProfiler *m_profiler;
+    };
+
+  private :
+    struct Query
+    {
+      const char *m_name;
+      GLuint m_begin;
+      GLuint m_end;
+    };
+    struct Frame
+    {
+      std::vector<Query> m_queries;
+      size_t m_used=0;
+    };
+    // results are read when a frame slot comes round again
+    static constexpr size_t c_framesInFlight=4;
+    std::array<Frame,c_framesInFlight> m_frames;
+    size_t m_current=0;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef QUANTIZEDVERTEX_H_
+#define QUANTIZEDVERTEX_H_
+#include <cstdint>
+#include <ngl/Mat4.h>
+#include "AABB.h"
+#include "IndexedMesh.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file QuantizedVertex.h
+/// @brief a 16 byte GPU vertex, half the size of IndexedMesh::Vertex. The position is 16 bit
+/// unorm inside the mesh's AABB, the uv is half float and the normal is octahedral encoded
+/// (Cigolle et al, "A Survey of Efficient Representations for Independent Unit Vectors",
+/// JCGT 2014) as two 16 bit snorms. The GPU reads the position as 0-1 within the box and
+/// dequantizeMatrix() folded into the model matrix maps it back to object space, so
+/// shaders/QuantizedTextureVertex.glsl only adds the normal decode.
+//----------------------------------------------------------------------------------------------------------------------
+struct QuantizedVertex
+{
+  // x y z then padding so the uv starts 4 byte aligned
+  uint16_t m_position[4];
+  uint16_t m_uv[2];
+  int16_t m_normal[2];
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief pack _v, whose position must lie inside _range
+  //----------------------------------------------------------------------------------------------------------------------
+  static QuantizedVertex encode(const IndexedMesh::Vertex &_v, const AABB &_range);
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the matrix taking 0-1 positions onto _range, premultiply the model matrix with it
+  //----------------------------------------------------------------------------------------------------------------------
+  static ngl::Mat4 dequantizeMatrix(const AABB &_range);
+  // IEEE half with round to nearest, out of range values become infinity
+  static uint16_t toHalf(float _f);
+  static float fromHalf(uint16_t _h);
+  // unit vector to the two octahedral coordinates in -1 to 1 and back
+  static void octEncode(const ngl::Vec3 &_n, ngl::Real &_x, ngl::Real &_y);
+  static ngl::Vec3 octDecode(ngl::Real _x, ngl::Real _y);
+};
+
+#endif
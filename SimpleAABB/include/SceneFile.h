@@ -0,0 +1,36 @@
+#ifndef SCENEFILE_H_
+#define SCENEFILE_H_
+#include <string>
+#include <vector>
+#include "GeometryCache.h"
+#include "SceneGraph.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SceneFile.h
+/// @brief loads a text scene description into a SceneGraph. One entry per line, # starts a
+/// comment, a parent must be declared before its children and - means no parent.
+///
+///   object name parent mesh texture  tx ty tz  rx ry rz  sx sy sz
+///   grid   name parent mesh texture  nx ny nz  spacing scale
+///
+/// grid makes nx*ny*nz copies on a regular lattice centred on the parent (named name_0,
+/// name_1 ...) and is mainly there to build large test scenes.
+//----------------------------------------------------------------------------------------------------------------------
+struct SceneFile
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief the nodes that were created for each named object, in file order
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<std::pair<std::string,SceneGraph::NodeID>> m_nodes;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief local transform each node was given in the file
+  //----------------------------------------------------------------------------------------------------------------------
+  std::vector<ngl::Mat4> m_locals;
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief parse _file adding everything to _scene, meshes and textures come from _cache
+  /// @returns false if the file could not be opened, bad lines are reported and skipped
+  //----------------------------------------------------------------------------------------------------------------------
+  bool load(const std::string &_file, SceneGraph &_scene, GeometryCache &_cache);
+};
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef SCENEGRAPH_H_
+#define SCENEGRAPH_H_
+#include <vector>
+#include <cstdint>
+#include <ngl/Mat4.h>
+#include "AABB.h"
+#include "MeshWithAABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SceneGraph.h
+/// @brief a transform hierarchy kept as flat arrays in depth first order, the nodes' matrices
+/// and subtree boxes, with each node's MeshWithAABB world box and Asset in parallel arrays. A
+/// parent always comes before its children and a whole subtree is a contiguous range
+/// [i, i+subtreeSize). World matrices and boxes are only recomputed for dirty subtrees
+/// in update(), walking the array front to back for transforms and back to front to refit
+/// the subtree bounds.
+/// @class SceneGraph
+//----------------------------------------------------------------------------------------------------------------------
+class SceneGraph
+{
+  public :
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief handle used to refer to a node, this stays valid when other nodes are inserted
+    //----------------------------------------------------------------------------------------------------------------------
+    typedef size_t NodeID;
+    static constexpr NodeID c_noParent=static_cast<NodeID>(-1);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the shared assets a node draws with (ids from the GeometryCache), Asset() is 0,0
+    //----------------------------------------------------------------------------------------------------------------------
+    struct Asset
+    {
+      uint32_t m_mesh;
+      uint32_t m_texture;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief add a node, it is placed at the end of _parent's subtree
+    /// @param[in] _localBounds object space bounds of what is drawn at this node
+    /// @param[in] _local the transform relative to the parent
+    /// @param[in] _parent the parent node or c_noParent for a new root
+    /// @param[in] _asset which cached mesh / texture to draw the node with
+    //----------------------------------------------------------------------------------------------------------------------
+    NodeID addNode(const AABB &_localBounds, const ngl::Mat4 &_local, NodeID _parent=c_noParent, Asset _asset=Asset());
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief set the local transform and mark the node (and so its subtree) dirty
+    //----------------------------------------------------------------------------------------------------------------------
+    void setLocalTransform(NodeID _id, const ngl::Mat4 &_local);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief change the object space bounds of the node at _index (eg once its mesh has loaded)
+    /// and optionally the hull used for exact world boxes
+    //----------------------------------------------------------------------------------------------------------------------
+    void setLocalBounds(size_t _index, const AABB &_localBounds, const ConvexHull *_hull=nullptr);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief narrow the world box of the mesh at _index with a tighter box that still bounds
+    /// it, this lasts until the node next moves. Subtree bounds are left as they are, they
+    /// still contain the tighter box.
+    //----------------------------------------------------------------------------------------------------------------------
+    void tightenBounds(size_t _index, const AABB &_box) {m_meshes[_index].tighten(_box);}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief recompute world matrices and boxes for all dirty subtrees
+    /// @returns the number of nodes whose world transform was updated
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t update();
+
+    size_t size() const {return m_nodes.size();}
+    // the following access nodes by their position in the depth first array, this is
+    // what should be used for drawing / culling loops
+    const ngl::Mat4 &worldMatrix(size_t _index) const {return m_nodes[_index].m_world;}
+    const AABB &subtreeBounds(size_t _index) const {return m_nodes[_index].m_bounds;}
+    const MeshWithAABB &mesh(size_t _index) const {return m_meshes[_index];}
+    const Asset &asset(size_t _index) const {return m_assets[_index];}
+    size_t subtreeSize(size_t _index) const {return m_nodes[_index].m_subtreeSize;}
+    size_t indexOf(NodeID _id) const {return m_index[_id];}
+
+  private :
+    struct Node
+    {
+      ngl::Mat4 m_local;
+      ngl::Mat4 m_world;
+      // world box of this node's mesh and all of its descendants
+      AABB m_bounds;
+      // position of the parent in m_nodes or c_noParent
+      size_t m_parent;
+      // number of nodes in this subtree including this one
+      size_t m_subtreeSize;
+      NodeID m_id;
+      // local transform has changed since the last update
+      bool m_localDirty;
+      // this node or something below it needs updating
+      bool m_subtreeDirty;
+      // world matrix was recomputed in the current update pass
+      bool m_moved;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief flag _index and all of its ancestors as having a dirty subtree
+    //----------------------------------------------------------------------------------------------------------------------
+    void markDirty(size_t _index);
+    // hot node data in depth first order
+    std::vector<Node> m_nodes;
+    // the per node mesh state, parallel to m_nodes
+    std::vector<MeshWithAABB> m_meshes;
+    std::vector<Asset> m_assets;
+    // NodeID -> position in m_nodes
+    std::vector<size_t> m_index;
+    // nodes visited in the current update, used for the bottom up refit
+    std::vector<size_t> m_refit;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef SOFTWAREOCCLUSION_H_
+#define SOFTWAREOCCLUSION_H_
+#include <vector>
+#include <ngl/Types.h>
+#include <ngl/Mat4.h>
+#include "AABB.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SoftwareOcclusion.h
+/// @brief a small CPU depth buffer for occlusion culling with no GPU involvement. A few big
+/// occluder meshes are rasterized (depth only, 4 pixels at a time with SSE when available)
+/// into a low resolution buffer, a per tile max depth is built on top and then boxes are
+/// tested against it, tile first and only dropping to pixels where the tile can't decide.
+/// Depth is NDC z mapped to [0,1] with 1 the far plane.
+/// @class SoftwareOcclusion
+//----------------------------------------------------------------------------------------------------------------------
+class SoftwareOcclusion
+{
+  public :
+    static constexpr int c_width=256;
+    static constexpr int c_height=128;
+    static constexpr int c_tileSize=8;
+    static constexpr int c_tilesX=c_width/c_tileSize;
+    static constexpr int c_tilesY=c_height/c_tileSize;
+
+    SoftwareOcclusion();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief clear to the far plane and set the view projection used to test boxes
+    //----------------------------------------------------------------------------------------------------------------------
+    void begin(const ngl::Mat4 &_VP);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief rasterize an indexed triangle list into the depth buffer
+    /// @param[in] _positions first position, x y z consecutive
+    /// @param[in] _stride floats between one position and the next
+    /// @param[in] _indices triangle list indices
+    /// @param[in] _numIndices number of indices (3 per triangle)
+    /// @param[in] _MVP object to clip space, ngl row vector convention
+    //----------------------------------------------------------------------------------------------------------------------
+    void rasterize(const ngl::Real *_positions, size_t _stride, const GLuint *_indices, size_t _numIndices, const ngl::Mat4 &_MVP);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief build the per tile max depth, call after the occluders are drawn
+    //----------------------------------------------------------------------------------------------------------------------
+    void end();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief is any part of the world space _box in front of the occluders, boxes crossing the
+    /// near plane are always visible and boxes entirely off screen are not
+    //----------------------------------------------------------------------------------------------------------------------
+    bool isVisible(const AABB &_box) const;
+
+  private :
+    void rasterizeTriangle(const ngl::Real *_v0, const ngl::Real *_v1, const ngl::Real *_v2);
+    // c_width x c_height depths row by row
+    std::vector<float> m_depth;
+    // max (farthest) depth of each tile
+    std::vector<float> m_tileMax;
+    ngl::Mat4 m_VP;
+};
+
+#endif
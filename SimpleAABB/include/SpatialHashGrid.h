@@ -0,0 +1,124 @@
+#ifndef SPATIALHASHGRID_H_
+#define SPATIALHASHGRID_H_
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <ngl/Vec3.h>
+#include "AABB.h"
+
+class WorkerPool;
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file SpatialHashGrid.h
+/// @brief broad phase for many objects of about the same size, where a tree is more than is
+/// needed. Space is cut into cubic cells and each object goes in every cell its box touches.
+/// Only occupied cells are stored, in an open addressed (linear probing) table keyed on the
+/// cell coordinates. Each slot holds a range of one flat array of object ids, so a query reads
+/// the ids of a cell from contiguous memory.
+///
+/// The grid is rebuilt from scratch rather than updated, on all cores of a WorkerPool: the
+/// cells are claimed with compare and swap and counted, then prefix summed and filled. The
+/// order of ids inside a cell can change from build to build, results are the same set.
+///
+/// An object touching more than c_maxCellsPerObject cells is kept on a separate list that
+/// every query checks, so one huge box can not blow up the table. Results never repeat: an
+/// object (or pair) is only reported from the first cell, in each axis, that both sides share.
+/// @class SpatialHashGrid
+//----------------------------------------------------------------------------------------------------------------------
+class SpatialHashGrid
+{
+  public :
+    typedef std::pair<uint32_t,uint32_t> Pair;
+    static constexpr size_t c_maxCellsPerObject=64;
+    explicit SpatialHashGrid(WorkerPool *_pool=nullptr);
+    ~SpatialHashGrid();
+    SpatialHashGrid(const SpatialHashGrid &)=delete;
+    SpatialHashGrid &operator=(const SpatialHashGrid &)=delete;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief replace the contents with _count boxes, object i is _boxes[i]
+    /// @param[in] _cellSize edge length of a cell, 0 picks twice the mean of the largest extent
+    /// of each box so a typical object touches 2 to 4 cells
+    //----------------------------------------------------------------------------------------------------------------------
+    void build(const AABB *_boxes, size_t _count, ngl::Real _cellSize=0.0f);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every object whose box overlaps _box
+    //----------------------------------------------------------------------------------------------------------------------
+    void queryBox(const AABB &_box, std::vector<uint32_t> &_out) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every object whose box is within _radius of _centre
+    //----------------------------------------------------------------------------------------------------------------------
+    void querySphere(const ngl::Vec3 &_centre, ngl::Real _radius, std::vector<uint32_t> &_out) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief append every pair of overlapping boxes once, lowest id first. The cells are
+    /// shared out over the pool so this uses scratch space in the grid and is not thread safe.
+    //----------------------------------------------------------------------------------------------------------------------
+    void queryPairs(std::vector<Pair> &_out);
+
+    size_t size() const {return m_boxes.size();}
+    ngl::Real cellSize() const {return m_cellSize;}
+    // cells with at least one object in them
+    size_t numCells() const {return m_numCells;}
+    // objects too big for the cells
+    size_t numOversized() const {return m_oversized.size();}
+
+  private :
+    struct CellRange
+    {
+      int32_t m_min[3];
+      int32_t m_max[3];
+    };
+    struct Slot
+    {
+      // packed cell coordinates, c_emptyKey when unused
+      std::atomic<uint64_t> m_key;
+      // objects in the cell
+      std::atomic<uint32_t> m_count;
+      // first of them in m_ids
+      uint32_t m_start;
+    };
+    static constexpr uint64_t c_emptyKey=~uint64_t(0);
+    static constexpr size_t c_grain=4096;
+    CellRange cellRange(const AABB &_box) const;
+    static uint64_t cellKey(int32_t _x, int32_t _y, int32_t _z);
+    size_t hashSlot(uint64_t _key) const;
+    // one per object per cell it is in, in object order
+    struct Entry
+    {
+      uint32_t m_slot;
+      // where the object goes among the cell's ids
+      uint32_t m_rank;
+    };
+    // index of the slot for _key, claiming an empty one if it is not there yet
+    uint32_t claim(uint64_t _key);
+    // the slot for _key or null
+    const Slot *find(uint64_t _key) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief call _fn(ids,count,x,y,z) for every occupied cell in _range, walking the table
+    /// instead of the range when the range has more cells than are occupied
+    //----------------------------------------------------------------------------------------------------------------------
+    template<typename F> void forEachCell(const CellRange &_range, const F &_fn) const;
+    WorkerPool *m_pool;
+    ngl::Real m_cellSize=1.0f;
+    ngl::Real m_inverseCellSize=1.0f;
+    // copies of the boxes and the cells they touch, by object id
+    std::vector<AABB> m_boxes;
+    std::vector<CellRange> m_ranges;
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_capacity=0;
+    size_t m_numCells=0;
+    // every cell's object ids back to back
+    std::vector<uint32_t> m_ids;
+    std::vector<uint32_t> m_oversized;
+    std::vector<Entry> m_entries;
+    // build scratch, one entry per chunk of c_grain objects or slots
+    std::vector<double> m_chunkExtent;
+    std::vector<AABB> m_chunkBounds;
+    std::vector<size_t> m_chunkEntries;
+    std::vector<size_t> m_chunkOversized;
+    std::vector<size_t> m_chunkSlots;
+    std::vector<std::vector<Pair>> m_chunkPairs;
+};
+
+#endif
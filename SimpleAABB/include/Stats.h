@@ -0,0 +1,106 @@
+#ifndef STATS_H_
+#define STATS_H_
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file Stats.h
+/// @brief per frame counters (draw calls, program switches, triangles, AABB updates, culled
+/// boxes per view, heap allocations and GL bytes uploaded). Every counter is a relaxed atomic
+/// so any thread can add to it without a lock. endFrame() moves the running counts into the
+/// last frame values and the totals, readers see those and never the half built current frame.
+/// The last frame values are copied one counter at a time so a reader racing endFrame() can
+/// mix two neighbouring frames. The views are named by the viewport layout, only the named
+/// ones are written to the JSON.
+/// @class Stats
+//----------------------------------------------------------------------------------------------------------------------
+class Stats
+{
+  public :
+    enum class Counter : size_t {DRAW_CALLS,PROGRAM_SWITCHES,TRIANGLES,AABBS_UPDATED,GL_BYTES_UPLOADED,HEAP_ALLOCATIONS,SOFTWARE_OCCLUSION_MISSES,COUNT};
+    static constexpr size_t c_numCounters=static_cast<size_t>(Counter::COUNT);
+    // the most viewports a layout can have, in layout order
+    static constexpr size_t c_maxViews=64;
+    // longest view name kept, including the terminator
+    static constexpr size_t c_maxViewName=32;
+    // big enough for every counter and c_maxViews named views
+    static constexpr size_t c_maxJSON=8192;
+
+    static void add(Counter _counter, uint64_t _n=1)
+    {
+      s_current[static_cast<size_t>(_counter)].fetch_add(_n,std::memory_order_relaxed);
+    }
+    static void addCulled(size_t _view, uint64_t _n=1)
+    {
+      s_current[c_numCounters+_view].fetch_add(_n,std::memory_order_relaxed);
+    }
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief publish the counts added since the last call as the last frame, called once per
+    /// frame by the thread that owns the frame
+    //----------------------------------------------------------------------------------------------------------------------
+    static void endFrame();
+    static uint64_t lastFrame(Counter _counter);
+    static uint64_t total(Counter _counter);
+    static uint64_t lastFrameCulled(size_t _view);
+    static uint64_t totalCulled(size_t _view);
+    static uint64_t frames() {return s_frames.load(std::memory_order_relaxed);}
+    static const char *name(Counter _counter);
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief name the views culled counts are reported for, longer names are cut short and
+    /// views past c_maxViews dropped
+    //----------------------------------------------------------------------------------------------------------------------
+    static void setViewNames(const std::vector<std::string> &_names);
+    // views named by setViewNames, the ones with culled counts
+    static size_t numViews();
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief format the last frame and the totals as JSON into _buffer, no heap allocation so
+    /// it is safe to call while allocations are being counted. Returns the length written or 0
+    /// if _buffer is too small.
+    //----------------------------------------------------------------------------------------------------------------------
+    static size_t toJSON(char *_buffer, size_t _size);
+    static bool writeJSON(const std::string &_file);
+
+  private :
+    // the culled counts per view follow the plain counters
+    typedef std::array<std::atomic<uint64_t>,c_numCounters+c_maxViews> Values;
+    static Values s_current;
+    static Values s_lastFrame;
+    static Values s_total;
+    static std::atomic<uint64_t> s_frames;
+    // fixed storage so toJSON can read the names without allocating, the mutex keeps it from
+    // seeing half a rename
+    static std::array<std::array<char,c_maxViewName>,c_maxViews> s_viewNames;
+    static size_t s_numViewNames;
+    static std::mutex s_viewNamesMutex;
+};
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief serves Stats::toJSON on a UNIX domain socket so monitoring can scrape a running
+/// instance, every connection is sent one JSON document and closed. The listener runs on its
+/// own thread and only reads the counters. Not available on Windows.
+/// @class StatsServer
+//----------------------------------------------------------------------------------------------------------------------
+class StatsServer
+{
+  public :
+    // any existing file at _path is replaced
+    explicit StatsServer(const std::string &_path);
+    ~StatsServer();
+    StatsServer(const StatsServer &)=delete;
+    StatsServer &operator=(const StatsServer &)=delete;
+    bool isListening() const {return m_socket>=0;}
+
+  private :
+    void run();
+    std::string m_path;
+    int m_socket=-1;
+    std::atomic<bool> m_running;
+    std::thread m_thread;
+};
+
+#endif
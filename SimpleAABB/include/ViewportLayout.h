@@ -0,0 +1,81 @@
+#ifndef VIEWPORTLAYOUT_H_
+#define VIEWPORTLAYOUT_H_
+#include <array>
+#include <string>
+#include <vector>
+#include <ngl/Mat4.h>
+#include <ngl/Types.h>
+#include <ngl/Vec3.h>
+#include "FrustumSet.h"
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file ViewportLayout.h
+/// @brief the views NGLScene draws, read from a text layout file. One viewport per line, #
+/// starts a comment.
+///
+///   ortho name  x y w h  ex ey ez  tx ty tz  ux uy uz  size near far  grx gry grz  gox goy goz
+///   persp name  x y w h  ex ey ez  tx ty tz  ux uy uz  fov  near far  grx gry grz  gox goy goz
+///
+/// x y w h place the viewport as fractions of the window from its bottom left corner. The
+/// camera looks from the eye e at the target t with up u. An ortho view shows size either
+/// side of the centre, the mouse pans it across the view plane and the wheel zooms. A persp
+/// view has a vertical field of view of fov degrees and the window's aspect, the mouse orbits
+/// and moves the scene in it. The grid is drawn rotated by gr degrees and moved by go. There
+/// can be up to c_maxViewports viewports.
+/// @class ViewportLayout
+//----------------------------------------------------------------------------------------------------------------------
+class ViewportLayout
+{
+  public :
+    static constexpr size_t c_maxViewports=FrustumSet::c_maxViews;
+    static constexpr size_t c_noViewport=static_cast<size_t>(-1);
+    struct Viewport
+    {
+      std::string m_name;
+      bool m_perspective=false;
+      ngl::Real m_x=0.0f;
+      ngl::Real m_y=0.0f;
+      ngl::Real m_width=1.0f;
+      ngl::Real m_height=1.0f;
+      ngl::Vec3 m_eye;
+      ngl::Vec3 m_target;
+      ngl::Vec3 m_up;
+      // half height of an ortho view or the field of view of a persp one
+      ngl::Real m_size=5.0f;
+      ngl::Real m_near=0.1f;
+      ngl::Real m_far=100.0f;
+      ngl::Vec3 m_gridRotation;
+      ngl::Vec3 m_gridOffset;
+      // camera axes in world space, an ortho view pans along them
+      ngl::Vec3 m_right;
+      ngl::Vec3 m_cameraUp;
+      ngl::Mat4 m_view;
+    };
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief replace the viewports with those in _file
+    /// @returns false if the file could not be opened or has no viewports, bad lines are
+    /// reported and skipped
+    //----------------------------------------------------------------------------------------------------------------------
+    bool load(const std::string &_file);
+    size_t size() const {return m_viewports.size();}
+    const Viewport &viewport(size_t _index) const {return m_viewports[_index];}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the viewport under window position _x,_y (origin top left as Qt gives it) of a
+    /// _width by _height window, or c_noViewport
+    //----------------------------------------------------------------------------------------------------------------------
+    size_t viewportAt(int _x, int _y, int _width, int _height) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief x, y, width and height for glViewport in a _width by _height pixel window,
+    /// neighbouring viewports share an edge with no gap
+    //----------------------------------------------------------------------------------------------------------------------
+    std::array<int,4> pixelRect(size_t _index, int _width, int _height) const;
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief the projection for a viewport _aspect times as wide as it is high
+    //----------------------------------------------------------------------------------------------------------------------
+    ngl::Mat4 projection(size_t _index, ngl::Real _aspect) const;
+
+  private :
+    std::vector<Viewport> m_viewports;
+};
+
+#endif
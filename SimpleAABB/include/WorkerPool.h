@@ -0,0 +1,72 @@
+#ifndef WORKERPOOL_H_
+#define WORKERPOOL_H_
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------------------------
+/// @file WorkerPool.h
+/// @brief fork / join data parallel loops for per frame work. Unlike the AsyncLoader this is
+/// for short jobs the caller waits on, the calling thread takes chunks too and parallelFor only
+/// returns once every chunk is done. Nothing is allocated per call.
+/// @class WorkerPool
+//----------------------------------------------------------------------------------------------------------------------
+class WorkerPool
+{
+  public :
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief start the workers
+    /// @param[in] _numThreads total threads including the caller, 0 means one per core
+    //----------------------------------------------------------------------------------------------------------------------
+    explicit WorkerPool(size_t _numThreads=0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool &)=delete;
+    WorkerPool &operator=(const WorkerPool &)=delete;
+    // threads working on a loop, including the caller
+    size_t numThreads() const {return m_threads.size()+1;}
+    //----------------------------------------------------------------------------------------------------------------------
+    /// @brief call _fn(begin,end) for [0,_count) in chunks of _grain and wait for all of them.
+    /// Chunk k always covers [k*_grain,(k+1)*_grain) so per chunk results can be indexed by
+    /// begin/_grain. One loop runs at a time, a second caller waits for the first, and a call
+    /// made from inside one of this pool's chunks runs its own chunks on the calling thread.
+    /// If a chunk throws no further chunks are started, and once the running ones are done the
+    /// first exception is rethrown to the caller.
+    //----------------------------------------------------------------------------------------------------------------------
+    template<typename F> void parallelFor(size_t _count, size_t _grain, const F &_fn)
+    {
+      run(_count,_grain,[](const void *_context, size_t _begin, size_t _end){(*static_cast<const F *>(_context))(_begin,_end);},&_fn);
+    }
+    // a pool shared by everything in the process, started on first use
+    static WorkerPool &shared();
+
+  private :
+    typedef void (*Task)(const void *, size_t, size_t);
+    void run(size_t _count, size_t _grain, Task _task, const void *_context);
+    void worker();
+    // take chunks of the current loop until there are none left or one throws
+    void work();
+    std::vector<std::thread> m_threads;
+    // held for the whole of a loop
+    std::mutex m_runMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    bool m_quit=false;
+    // bumped for each loop so the workers can tell a new one from a spurious wake up
+    uint64_t m_generation=0;
+    // workers that have not finished the current loop
+    size_t m_busy=0;
+    Task m_task=nullptr;
+    const void *m_context=nullptr;
+    size_t m_count=0;
+    size_t m_grain=1;
+    std::atomic<size_t> m_next;
+    // the first exception thrown by a chunk of the current loop
+    std::exception_ptr m_error;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#version 430 core
+
+// exact world space bounds of one mesh under many transforms. Work groups along x walk the
+// vertices, y picks the instance. Each group reduces in shared memory then one invocation
+// merges the group's box into the instance's slot with atomics.
+layout(local_size_x=256) in;
+
+/// @brief the mesh VBO, interleaved vertices vertexStride words apart with the position first
+layout(std430,binding=0) readonly buffer Vertices { float verts[]; };
+/// @brief the same VBO for quantized meshes, x y in the first word and z in the low half of the
+/// second as 16 bit unorms (QuantizedVertex)
+layout(std430,binding=0) readonly buffer PackedVertices { uint packedVerts[]; };
+/// @brief the world matrix of each instance
+layout(std430,binding=1) readonly buffer Matrices { mat4 worlds[]; };
+/// @brief min xyz then max xyz per instance as order preserving uints
+layout(std430,binding=2) buffer Bounds { uint bounds[]; };
+
+uniform int numVerts;
+uniform int vertexStride;
+uniform int firstInstance;
+// non zero when the vertices are packed, the matrices then include the dequantize scale / offset
+uniform int quantized;
+
+shared vec3 groupMin[256];
+shared vec3 groupMax[256];
+
+// flip the bits so unsigned integer order matches float order
+uint orderedBits(float _f)
+{
+  uint u=floatBitsToUint(_f);
+  return (u & 0x80000000u)!=0u ? ~u : u | 0x80000000u;
+}
+
+void main()
+{
+  uint instance=uint(firstInstance)+gl_WorkGroupID.y;
+  mat4 world=worlds[instance];
+  vec3 lo=vec3(3.402823e38);
+  vec3 hi=vec3(-3.402823e38);
+  uint step=gl_NumWorkGroups.x*gl_WorkGroupSize.x;
+  for(uint v=gl_GlobalInvocationID.x; v<uint(numVerts); v+=step)
+  {
+    uint base=v*uint(vertexStride);
+    vec3 local;
+    if(quantized!=0)
+    {
+      uint xy=packedVerts[base];
+      uint z=packedVerts[base+1u];
+      local=vec3(float(xy & 0xffffu),float(xy>>16),float(z & 0xffffu))/65535.0;
+    }
+    else
+    {
+      local=vec3(verts[base],verts[base+1u],verts[base+2u]);
+    }
+    vec3 p=(world*vec4(local,1.0)).xyz;
+    lo=min(lo,p);
+    hi=max(hi,p);
+  }
+  uint i=gl_LocalInvocationIndex;
+  groupMin[i]=lo;
+  groupMax[i]=hi;
+  memoryBarrierShared();
+  barrier();
+  for(uint s=gl_WorkGroupSize.x/2u; s>0u; s>>=1u)
+  {
+    if(i<s)
+    {
+      groupMin[i]=min(groupMin[i],groupMin[i+s]);
+      groupMax[i]=max(groupMax[i],groupMax[i+s]);
+    }
+    memoryBarrierShared();
+    barrier();
+  }
+  // groups past the end of a small mesh saw no vertices
+  if(i==0u && groupMin[0].x<=groupMax[0].x)
+  {
+    uint slot=instance*6u;
+    atomicMin(bounds[slot],orderedBits(groupMin[0].x));
+    atomicMin(bounds[slot+1u],orderedBits(groupMin[0].y));
+    atomicMin(bounds[slot+2u],orderedBits(groupMin[0].z));
+    atomicMax(bounds[slot+3u],orderedBits(groupMax[0].x));
+    atomicMax(bounds[slot+4u],orderedBits(groupMax[0].y));
+    atomicMax(bounds[slot+5u],orderedBits(groupMax[0].z));
+  }
+}
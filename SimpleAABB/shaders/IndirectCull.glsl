@@ -0,0 +1,125 @@
+#version 430 core
+
+// frustum culls every node of the scene for one view and writes an indirect draw command for
+// each one in sight. One invocation per node, the commands of the nodes sharing a texture are
+// packed from the start of their batch by an atomic counter.
+layout(local_size_x=64) in;
+
+struct Object
+{
+  mat4 world;
+  vec4 boxMin;
+  vec4 boxMax;
+  uint mesh;
+  uint batch;
+  uint batchStart;
+  uint pad;
+};
+struct Mesh
+{
+  uint first[8];
+  uint count[8];
+  int baseVertex;
+  uint numLevels;
+  uint pad0;
+  uint pad1;
+};
+// DrawElementsIndirectCommand
+struct Command
+{
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+/// @brief the frame's nodes with their world space boxes
+layout(std430,binding=0) readonly buffer Objects { Object objects[]; };
+/// @brief the index range of each level of each mesh in the shared buffers
+layout(std430,binding=1) readonly buffer Meshes { Mesh meshes[]; };
+/// @brief the commands of every view, zeroed before the dispatch so unused slots draw nothing
+layout(std430,binding=2) writeonly buffer Commands { Command commands[]; };
+/// @brief per view the nodes, triangles and full detail triangles drawn, then the commands
+/// written for each batch
+layout(std430,binding=3) buffer Counters { uint counters[]; };
+
+uniform mat4 VP;
+uniform int numObjects;
+uniform int viewportWidth;
+uniform int viewportHeight;
+uniform int useLOD;
+uniform float fullDetailPixels;
+// where this view's commands and counters start
+uniform int commandBase;
+uniform int counterBase;
+
+const uint c_numTotals=3u;
+
+// as MeshLOD::projectedSize, a box crossing the eye plane covers the viewport
+float projectedSize(vec3 _min, vec3 _max)
+{
+  vec2 lo=vec2(3.402823e38);
+  vec2 hi=vec2(-3.402823e38);
+  for(int i=0; i<8; ++i)
+  {
+    vec3 corner=vec3((i&1)!=0 ? _max.x : _min.x,(i&2)!=0 ? _max.y : _min.y,(i&4)!=0 ? _max.z : _min.z);
+    vec4 clip=VP*vec4(corner,1.0);
+    if(clip.w<=0.0001)
+    {
+      return float(max(viewportWidth,viewportHeight));
+    }
+    lo=min(lo,clip.xy/clip.w);
+    hi=max(hi,clip.xy/clip.w);
+  }
+  vec2 size=(hi-lo)*0.5*vec2(viewportWidth,viewportHeight);
+  return max(size.x,size.y);
+}
+
+void main()
+{
+  uint i=gl_GlobalInvocationID.x;
+  if(i>=uint(numObjects))
+  {
+    return;
+  }
+  vec3 boxMin=objects[i].boxMin.xyz;
+  vec3 boxMax=objects[i].boxMax.xyz;
+  vec3 centre=(boxMin+boxMax)*0.5;
+  vec3 extent=(boxMax-boxMin)*0.5;
+  // the clip space planes are w plus or minus each row of VP, out when wholly behind one
+  vec4 w=vec4(VP[0][3],VP[1][3],VP[2][3],VP[3][3]);
+  for(int axis=0; axis<3; ++axis)
+  {
+    vec4 row=vec4(VP[0][axis],VP[1][axis],VP[2][axis],VP[3][axis]);
+    for(int side=-1; side<=1; side+=2)
+    {
+      vec4 plane=w+float(side)*row;
+      if(dot(plane.xyz,centre)+dot(abs(plane.xyz),extent)+plane.w<0.0)
+      {
+        return;
+      }
+    }
+  }
+  uint mesh=objects[i].mesh;
+  uint numLevels=meshes[mesh].numLevels;
+  uint level=0u;
+  if(useLOD!=0)
+  {
+    float pixels=projectedSize(boxMin,boxMax);
+    if(pixels<=0.0)
+    {
+      level=numLevels-1u;
+    }
+    else if(pixels<fullDetailPixels)
+    {
+      level=min(uint(log2(fullDetailPixels/pixels)),numLevels-1u);
+    }
+  }
+  uint count=meshes[mesh].count[level];
+  uint slot=atomicAdd(counters[uint(counterBase)+c_numTotals+objects[i].batch],1u);
+  commands[uint(commandBase)+objects[i].batchStart+slot]=Command(count,1u,meshes[mesh].first[level],meshes[mesh].baseVertex,i);
+  atomicAdd(counters[uint(counterBase)],1u);
+  atomicAdd(counters[uint(counterBase)+1u],count/3u);
+  atomicAdd(counters[uint(counterBase)+2u],meshes[mesh].count[0]/3u);
+}
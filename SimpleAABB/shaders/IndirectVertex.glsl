@@ -0,0 +1,34 @@
+#version 430 core
+
+// TextureVertex for the IndirectRenderer, each node's world matrix is fetched with the
+// instance attribute, which the draw command's base instance sets to the node index
+
+/// @brief view projection of the panel
+uniform mat4 VP;
+// first attribute the vertex values from our VAO
+layout (location=0)in vec3 inVert;
+// second attribute the UV values from our VAO
+layout (location=1)in vec2 inUV;
+// the node this instance draws
+layout (location=3)in uint inObject;
+
+struct Object
+{
+  mat4 world;
+  vec4 boxMin;
+  vec4 boxMax;
+  uint mesh;
+  uint batch;
+  uint batchStart;
+  uint pad;
+};
+layout(std430,binding=0) readonly buffer Objects { Object objects[]; };
+
+// we use this to pass the UV values to the frag shader
+out vec2 vertUV;
+
+void main()
+{
+  gl_Position=VP*objects[inObject].world*vec4(inVert,1.0);
+  vertUV=inUV;
+}
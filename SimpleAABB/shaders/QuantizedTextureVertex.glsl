@@ -0,0 +1,33 @@
+#version 330 core
+
+/// @brief MVP passed from app, the mesh's dequantize matrix times its model view projection
+uniform mat4 MVP;
+// first attribute 16 bit unorm positions, 0-1 across the mesh bounds
+layout (location=0)in vec3 inVert;
+// second attribute the half float UV values from our VAO
+layout (location=1)in vec2 inUV;
+// third attribute the octahedral encoded normal as two snorms
+layout (location=2)in vec2 inNormal;
+// we use this to pass the UV values to the frag shader
+out vec2 vertUV;
+// object space normal for shaders that light the mesh
+out vec3 vertNormal;
+
+vec3 octDecode(vec2 _e)
+{
+  vec3 n=vec3(_e,1.0-abs(_e.x)-abs(_e.y));
+  // unfold the lower half of the octahedron
+  float t=max(-n.z,0.0);
+  n.x+= n.x>=0.0 ? -t : t;
+  n.y+= n.y>=0.0 ? -t : t;
+  return normalize(n);
+}
+
+void main()
+{
+// the dequantize scale / offset is already folded into MVP
+gl_Position = MVP*vec4(inVert, 1.0);
+// pass the UV values to the frag shader
+vertUV=inUV.st;
+vertNormal=octDecode(inNormal);
+}
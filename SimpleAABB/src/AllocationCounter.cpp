@@ -0,0 +1,192 @@
+#include "AllocationCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+  // relaxed is enough, these are only ever read as totals
+  std::atomic<size_t> s_allocations(0);
+  std::atomic<size_t> s_bytes(0);
+
+  void count(size_t _size)
+  {
+    s_allocations.fetch_add(1,std::memory_order_relaxed);
+    s_bytes.fetch_add(_size,std::memory_order_relaxed);
+  }
+
+  void *counted(size_t _size)
+  {
+    count(_size);
+    if(void *p=std::malloc(_size ? _size : 1))
+    {
+      return p;
+    }
+    throw std::bad_alloc();
+  }
+
+#if defined(__cpp_aligned_new)
+  // for types aligned beyond max_align_t, which the library would otherwise allocate uncounted
+  void *countedAligned(size_t _size, std::align_val_t _align)
+  {
+    count(_size);
+    size_t align=std::max(static_cast<size_t>(_align),sizeof(void *));
+    void *p=nullptr;
+#ifdef _WIN32
+    p=_aligned_malloc(_size ? _size : 1,align);
+#else
+    if(posix_memalign(&p,align,_size ? _size : 1)!=0)
+    {
+      p=nullptr;
+    }
+#endif
+    if(p)
+    {
+      return p;
+    }
+    throw std::bad_alloc();
+  }
+
+  void freeAligned(void *_p)
+  {
+#ifdef _WIN32
+    _aligned_free(_p);
+#else
+    std::free(_p);
+#endif
+  }
+#endif
+}
+
+size_t AllocationCounter::allocations()
+{
+  return s_allocations.load(std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::bytes()
+{
+  return s_bytes.load(std::memory_order_relaxed);
+}
+
+// every replaceable form is defined here rather than trusting the library's defaults to forward
+// to the plain ones (older libstdc++ nothrow new calls malloc itself). The sized and aligned
+// forms only exist from C++14 (with -fsized-deallocation) and C++17, so they follow the
+// compiler's feature macros.
+void *operator new(size_t _size)
+{
+  return counted(_size);
+}
+
+void *operator new[](size_t _size)
+{
+  return counted(_size);
+}
+
+void *operator new(size_t _size, const std::nothrow_t &) noexcept
+{
+  try
+  {
+    return counted(_size);
+  }
+  catch(const std::bad_alloc &)
+  {
+    return nullptr;
+  }
+}
+
+void *operator new[](size_t _size, const std::nothrow_t &) noexcept
+{
+  return operator new(_size,std::nothrow);
+}
+
+void operator delete(void *_p) noexcept
+{
+  std::free(_p);
+}
+
+void operator delete[](void *_p) noexcept
+{
+  std::free(_p);
+}
+
+void operator delete(void *_p, const std::nothrow_t &) noexcept
+{
+  std::free(_p);
+}
+
+void operator delete[](void *_p, const std::nothrow_t &) noexcept
+{
+  std::free(_p);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *_p, size_t) noexcept
+{
+  std::free(_p);
+}
+
+void operator delete[](void *_p, size_t) noexcept
+{
+  std::free(_p);
+}
+#endif
+
+#if defined(__cpp_aligned_new)
+void *operator new(size_t _size, std::align_val_t _align)
+{
+  return countedAligned(_size,_align);
+}
+
+void *operator new[](size_t _size, std::align_val_t _align)
+{
+  return countedAligned(_size,_align);
+}
+
+void *operator new(size_t _size, std::align_val_t _align, const std::nothrow_t &) noexcept
+{
+  try
+  {
+    return countedAligned(_size,_align);
+  }
+  catch(const std::bad_alloc &)
+  {
+    return nullptr;
+  }
+}
+
+void *operator new[](size_t _size, std::align_val_t _align, const std::nothrow_t &) noexcept
+{
+  return operator new(_size,_align,std::nothrow);
+}
+
+void operator delete(void *_p, std::align_val_t) noexcept
+{
+  freeAligned(_p);
+}
+
+void operator delete[](void *_p, std::align_val_t) noexcept
+{
+  freeAligned(_p);
+}
+
+void operator delete(void *_p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+  freeAligned(_p);
+}
+
+void operator delete[](void *_p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+  freeAligned(_p);
+}
+
+void operator delete(void *_p, size_t, std::align_val_t) noexcept
+{
+  freeAligned(_p);
+}
+
+void operator delete[](void *_p, size_t, std::align_val_t) noexcept
+{
+  freeAligned(_p);
+}
+#endif
@@ -0,0 +1,60 @@
+#include "AsyncLoader.h"
+#include <algorithm>
+
+AsyncLoader::AsyncLoader(size_t _numThreads) : m_pending(0)
+{
+  if(_numThreads==0)
+  {
+    // leave a core for the GL thread, hardware_concurrency may report 0
+    unsigned int cores=std::thread::hardware_concurrency();
+    _numThreads=std::max(1u,cores>1 ? cores-1 : 1u);
+  }
+  for(size_t i=0; i<_numThreads; ++i)
+  {
+    m_threads.push_back(std::thread(&AsyncLoader::worker,this));
+  }
+}
+
+AsyncLoader::~AsyncLoader()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit=true;
+    m_jobs.clear();
+  }
+  m_wake.notify_all();
+  for(auto &t : m_threads)
+  {
+    t.join();
+  }
+}
+
+void AsyncLoader::submit(std::function<void()> _job)
+{
+  ++m_pending;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(_job));
+  }
+  m_wake.notify_one();
+}
+
+void AsyncLoader::worker()
+{
+  for(;;)
+  {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock,[this](){return m_quit || !m_jobs.empty();});
+      if(m_quit)
+      {
+        return;
+      }
+      job=std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    job();
+    --m_pending;
+  }
+}
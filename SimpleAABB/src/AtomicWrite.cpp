@@ -0,0 +1,52 @@
+#include "AtomicWrite.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#ifndef _WIN32
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+namespace
+{
+  std::string temporaryName(const std::string &_file)
+  {
+    static std::atomic<unsigned> s_count(0);
+#ifdef _WIN32
+    long pid=_getpid();
+#else
+    long pid=getpid();
+#endif
+    return _file+".tmp."+std::to_string(pid)+"."+std::to_string(s_count++);
+  }
+}
+
+bool writeAtomically(const std::string &_file, const std::function<bool(std::ostream &_out)> &_write)
+{
+  std::string temporary=temporaryName(_file);
+  {
+    std::ofstream out(temporary,std::ios::binary | std::ios::trunc);
+    if(!out.is_open())
+    {
+      return false;
+    }
+    bool written=_write(out);
+    out.close();
+    if(!written || !out)
+    {
+      std::remove(temporary.c_str());
+      return false;
+    }
+  }
+#ifdef _WIN32
+  // rename will not replace an existing file here
+  std::remove(_file.c_str());
+#endif
+  if(std::rename(temporary.c_str(),_file.c_str())!=0)
+  {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,1079 @@
+#include "Benchmark.h"
+#include "CompressedBVH.h"
+#include "ConvexHull.h"
+#include "DeformingBVH.h"
+#include "IndexOptimizer.h"
+#include "IndexedMesh.h"
+#include "MeshLOD.h"
+#include "MeshWithAABB.h"
+#include "LinearBVH.h"
+#include "MappedBVH.h"
+#include "QuantizedVertex.h"
+#include "SpatialHashGrid.h"
+#include "WorkerPool.h"
+#include <ngl/Util.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+
+namespace
+{
+  typedef std::chrono::duration<double,std::nano> ns;
+
+  // what every per mesh benchmark shares: load each file in turn and run _run on it, failing
+  // if a mesh will not load or _run returns false, but still going on to the next file
+  template <typename Run>
+  int forEachMesh(const std::vector<std::string> &_objFiles, Run _run)
+  {
+    int result=EXIT_SUCCESS;
+    for(const auto &file : _objFiles)
+    {
+      MeshLOD mesh(file);
+      if(!mesh.isValid() || !_run(file,mesh))
+      {
+        result=EXIT_FAILURE;
+      }
+    }
+    return result;
+  }
+
+  // as forEachMesh for the benchmarks that want the obj as it was loaded, before any LOD build
+  template <typename Run>
+  int forEachObj(const std::vector<std::string> &_objFiles, Run _run)
+  {
+    int result=EXIT_SUCCESS;
+    for(const auto &file : _objFiles)
+    {
+      IndexedMesh mesh;
+      if(!IndexedMesh::loadObj(file,mesh))
+      {
+        std::cerr<<"unable to load mesh "<<file<<"\n";
+        result=EXIT_FAILURE;
+      }
+      else if(!_run(file,mesh))
+      {
+        result=EXIT_FAILURE;
+      }
+    }
+    return result;
+  }
+
+  // scale by _s, rotate by the unit quaternion (_w,_x,_y,_z) then move by _t
+  ngl::Mat4 makeTransform(ngl::Real _w, ngl::Real _x, ngl::Real _y, ngl::Real _z, const ngl::Vec3 &_s, const ngl::Vec3 &_t)
+  {
+    ngl::Real r[3][3]={{1-2*(_y*_y+_z*_z),2*(_x*_y+_w*_z),2*(_x*_z-_w*_y)},
+                       {2*(_x*_y-_w*_z),1-2*(_x*_x+_z*_z),2*(_y*_z+_w*_x)},
+                       {2*(_x*_z+_w*_y),2*(_y*_z-_w*_x),1-2*(_x*_x+_y*_y)}};
+    ngl::Mat4 m;
+    m.identity();
+    // rows are the transformed axes
+    for(int i=0; i<3; ++i)
+    {
+      for(int j=0; j<3; ++j)
+      {
+        m.m_m[i][j]=_s[i]*r[i][j];
+      }
+      m.m_m[3][i]=_t[i];
+    }
+    return m;
+  }
+
+  // unrelated transforms one after the other, random rotation (uniform quaternion), non
+  // uniform scale and translation
+  std::vector<ngl::Mat4> randomTransforms(size_t _count)
+  {
+    std::mt19937 rng(1234);
+    std::normal_distribution<ngl::Real> normal;
+    std::uniform_real_distribution<ngl::Real> scale(0.25f,4.0f);
+    std::vector<ngl::Mat4> result(_count);
+    for(auto &m : result)
+    {
+      ngl::Real w=normal(rng), x=normal(rng), y=normal(rng), z=normal(rng);
+      ngl::Real len=std::sqrt(w*w+x*x+y*y+z*z);
+      ngl::Vec3 s(scale(rng),scale(rng),scale(rng));
+      ngl::Vec3 t(normal(rng)*10.0f,normal(rng)*10.0f,normal(rng)*10.0f);
+      m=makeTransform(w/len,x/len,y/len,z/len,s,t);
+    }
+    return result;
+  }
+
+  // an object spinning a degree a frame about a tilted axis, like the animated scene nodes
+  std::vector<ngl::Mat4> animatedTransforms(size_t _count)
+  {
+    ngl::Vec3 axis(0.3f,1.0f,0.2f);
+    axis.normalize();
+    std::vector<ngl::Mat4> result(_count);
+    for(size_t f=0; f<_count; ++f)
+    {
+      // half the angle, a degree is 0.01745 radians
+      ngl::Real half=0.5f*static_cast<ngl::Real>(f)*0.0174533f;
+      ngl::Real s=std::sin(half);
+      result[f]=makeTransform(std::cos(half),axis.m_x*s,axis.m_y*s,axis.m_z*s,ngl::Vec3(1.0f,2.0f,0.5f),ngl::Vec3(0.0f,0.0f,0.0f));
+    }
+    return result;
+  }
+
+  // mean ns per setTransform over _transforms, _sum is there so the work can not be dropped
+  double timeUpdates(MeshWithAABB &_node, const std::vector<ngl::Mat4> &_transforms, size_t _passes, ngl::Real &_sum)
+  {
+    auto start=std::chrono::steady_clock::now();
+    for(size_t pass=0; pass<_passes; ++pass)
+    {
+      for(const auto &tx : _transforms)
+      {
+        _node.setTransform(tx);
+        _sum+=_node.getAABB().m_max.m_x;
+      }
+    }
+    return std::chrono::duration_cast<ns>(std::chrono::steady_clock::now()-start).count()/(_transforms.size()*_passes);
+  }
+
+  ngl::Real volume(const AABB &_box)
+  {
+    ngl::Vec3 d=_box.size();
+    return d.m_x*d.m_y*d.m_z;
+  }
+
+  // the box of every transformed vertex, the reference both modes are measured against
+  AABB allVertices(const MeshLOD &_mesh, const ngl::Mat4 &_tx)
+  {
+    AABB box;
+    const ngl::Real *p=_mesh.positions();
+    for(size_t i=0; i<_mesh.numVertices(); ++i, p+=MeshLOD::c_positionStride)
+    {
+      ngl::Vec3 v;
+      for(int j=0; j<3; ++j)
+      {
+        v[j]=p[0]*_tx.m_m[0][j]+p[1]*_tx.m_m[1][j]+p[2]*_tx.m_m[2][j]+_tx.m_m[3][j];
+      }
+      box.extend(v);
+    }
+    return box;
+  }
+}
+
+int benchmarkBounds(const std::vector<std::string> &_objFiles)
+{
+  // the timed loops run over every transform this many times, the tightness is measured on
+  // the first c_exactTransforms random ones as the all vertex reference is slow
+  constexpr size_t c_transforms=10000;
+  constexpr size_t c_passes=20;
+  constexpr size_t c_exactTransforms=1000;
+  std::vector<ngl::Mat4> transforms=randomTransforms(c_transforms);
+  std::vector<ngl::Mat4> animated=animatedTransforms(c_transforms);
+  static const char *modeNames[]={"corners","hull   ","support"};
+  MeshWithAABB::BoundsMode previous=MeshWithAABB::boundsMode();
+  int result=forEachMesh(_objFiles,[&](const std::string &_file, MeshLOD &_mesh)
+  {
+    bool ok=true;
+    auto start=std::chrono::steady_clock::now();
+    ConvexHull rebuilt;
+    rebuilt.build(_mesh.positions(),MeshLOD::c_positionStride,_mesh.numVertices());
+    double buildMs=std::chrono::duration_cast<ns>(std::chrono::steady_clock::now()-start).count()*1e-6;
+
+    std::vector<AABB> exact(c_exactTransforms);
+    start=std::chrono::steady_clock::now();
+    for(size_t t=0; t<c_exactTransforms; ++t)
+    {
+      exact[t]=allVertices(_mesh,transforms[t]);
+    }
+    double exactNs=std::chrono::duration_cast<ns>(std::chrono::steady_clock::now()-start).count()/c_exactTransforms;
+
+    std::cout<<_file<<": "<<_mesh.numVertices()<<" vertices, hull "<<_mesh.hull().numPoints()<<" points (built in "
+             <<buildMs<<" ms), every vertex "<<exactNs<<" ns per box\n";
+    MeshWithAABB node(_mesh.bounds());
+    node.setLocalBounds(_mesh.bounds(),&_mesh.hull());
+    for(auto mode : {MeshWithAABB::BoundsMode::CORNERS,MeshWithAABB::BoundsMode::HULL,MeshWithAABB::BoundsMode::SUPPORT})
+    {
+      MeshWithAABB::setBoundsMode(mode);
+      ngl::Real sum=0.0f;
+      double perBox=timeUpdates(node,transforms,c_passes,sum);
+      double perAnimatedBox=timeUpdates(node,animated,c_passes,sum);
+      // how much bigger than the exact box, and whether it ever failed to contain it
+      double meanExcess=0.0;
+      double maxExcess=0.0;
+      size_t missed=0;
+      for(size_t t=0; t<c_exactTransforms; ++t)
+      {
+        node.setTransform(transforms[t]);
+        const AABB &box=node.getAABB();
+        double excess=volume(box)/volume(exact[t])-1.0;
+        meanExcess+=excess;
+        maxExcess=std::max(maxExcess,excess);
+        AABB overlap=box;
+        overlap.intersect(exact[t]);
+        if(volume(overlap)<volume(exact[t])*0.999999f)
+        {
+          ++missed;
+        }
+      }
+      std::cout<<"  "<<modeNames[static_cast<int>(mode)]<<" "<<perBox<<" ns per random box, "<<perAnimatedBox<<" ns per animated box, volume over exact mean "
+               <<100.0*meanExcess/c_exactTransforms<<"% max "<<100.0*maxExcess<<"% (checksum "<<sum<<")\n";
+      if(missed)
+      {
+        std::cout<<"  "<<missed<<" boxes did not contain the whole mesh\n";
+        ok=false;
+      }
+    }
+    return ok;
+  });
+  MeshWithAABB::setBoundsMode(previous);
+  return result;
+}
+
+namespace
+{
+  // _count boxes of 0.5 to 1.5 units a side, spread so there is one per 8 cubic units
+  std::vector<AABB> randomBoxes(size_t _count, std::mt19937 &_rng)
+  {
+    ngl::Real side=std::cbrt(8.0f*_count);
+    std::uniform_real_distribution<ngl::Real> position(0.0f,side);
+    std::uniform_real_distribution<ngl::Real> extent(0.25f,0.75f);
+    std::vector<AABB> boxes(_count);
+    for(auto &b : boxes)
+    {
+      ngl::Vec3 c(position(_rng),position(_rng),position(_rng));
+      ngl::Vec3 h(extent(_rng),extent(_rng),extent(_rng));
+      b=AABB(c-h,c+h);
+    }
+    return boxes;
+  }
+
+  double elapsedNs(std::chrono::steady_clock::time_point _start)
+  {
+    return std::chrono::duration_cast<ns>(std::chrono::steady_clock::now()-_start).count();
+  }
+
+  // mean ms of _runs calls to _fn, after one untimed call that allocates
+  template<typename F> double meanMs(size_t _runs, const F &_fn)
+  {
+    _fn();
+    auto start=std::chrono::steady_clock::now();
+    for(size_t r=0; r<_runs; ++r)
+    {
+      _fn();
+    }
+    return elapsedNs(start)*1e-6/_runs;
+  }
+
+  // same ids in any order
+  bool sameSet(std::vector<uint32_t> &_a, std::vector<uint32_t> &_b)
+  {
+    std::sort(_a.begin(),_a.end());
+    std::sort(_b.begin(),_b.end());
+    return _a==_b;
+  }
+}
+
+int benchmarkGrid(const std::vector<size_t> &_counts)
+{
+  constexpr size_t c_builds=5;
+  constexpr size_t c_queries=1000;
+  // brute force pairs are timed on the first c_pairSample objects against all of them and
+  // scaled up, the full n squared loop would take minutes at a million
+  constexpr size_t c_pairSample=2000;
+  WorkerPool single(1);
+  WorkerPool &pool=WorkerPool::shared();
+  int result=EXIT_SUCCESS;
+  std::mt19937 rng(1234);
+  for(size_t count : _counts)
+  {
+    std::vector<AABB> boxes=randomBoxes(count,rng);
+    std::cout<<count<<" boxes, build on 1 / "<<pool.numThreads()<<" threads\n";
+
+    SpatialHashGrid serialGrid(&single);
+    SpatialHashGrid grid(&pool);
+    LinearBVH serialTree(&single);
+    LinearBVH tree(&pool);
+    double serialMs=meanMs(c_builds,[&](){serialGrid.build(boxes.data(),count);});
+    double parallelMs=meanMs(c_builds,[&](){grid.build(boxes.data(),count);});
+    std::cout<<"  grid build "<<serialMs<<" / "<<parallelMs<<" ms ("<<grid.numCells()<<" cells of "<<grid.cellSize()<<", "
+             <<grid.numOversized()<<" oversized)\n";
+    for(auto bits : {LinearBVH::CodeBits::BITS63,LinearBVH::CodeBits::BITS30})
+    {
+      serialMs=meanMs(c_builds,[&](){serialTree.build(boxes.data(),count,bits);});
+      parallelMs=meanMs(c_builds,[&](){tree.build(boxes.data(),count,bits);});
+      std::cout<<"  LBVH build "<<serialMs<<" / "<<parallelMs<<" ms ("<<(bits==LinearBVH::CodeBits::BITS30 ? 30 : 63)
+               <<" bit codes)\n";
+    }
+
+    // queries a few objects across, placed like the objects
+    std::vector<AABB> queries=randomBoxes(c_queries,rng);
+    ngl::Real scale=std::cbrt(static_cast<ngl::Real>(count)/c_queries);
+    for(auto &q : queries)
+    {
+      ngl::Vec3 c=q.center()*scale;
+      q=AABB(c-ngl::Vec3(2.0f,2.0f,2.0f),c+ngl::Vec3(2.0f,2.0f,2.0f));
+    }
+    std::vector<uint32_t> fromGrid;
+    std::vector<uint32_t> fromTree;
+    std::vector<uint32_t> expected;
+    size_t wrong=0;
+    size_t hits=0;
+    double gridBoxNs=0.0;
+    double treeBoxNs=0.0;
+    double bruteBoxNs=0.0;
+    double gridSphereNs=0.0;
+    double treeSphereNs=0.0;
+    double bruteSphereNs=0.0;
+    for(const auto &q : queries)
+    {
+      fromGrid.clear();
+      auto start=std::chrono::steady_clock::now();
+      grid.queryBox(q,fromGrid);
+      gridBoxNs+=elapsedNs(start);
+      fromTree.clear();
+      start=std::chrono::steady_clock::now();
+      tree.queryBox(q,fromTree);
+      treeBoxNs+=elapsedNs(start);
+      expected.clear();
+      start=std::chrono::steady_clock::now();
+      for(size_t i=0; i<count; ++i)
+      {
+        if(boxes[i].overlaps(q))
+        {
+          expected.push_back(static_cast<uint32_t>(i));
+        }
+      }
+      bruteBoxNs+=elapsedNs(start);
+      hits+=expected.size();
+      wrong+=sameSet(fromGrid,expected) && sameSet(fromTree,expected) ? 0 : 1;
+
+      ngl::Vec3 centre=q.center();
+      ngl::Real radius=2.0f;
+      fromGrid.clear();
+      start=std::chrono::steady_clock::now();
+      grid.querySphere(centre,radius,fromGrid);
+      gridSphereNs+=elapsedNs(start);
+      fromTree.clear();
+      start=std::chrono::steady_clock::now();
+      tree.querySphere(centre,radius,fromTree);
+      treeSphereNs+=elapsedNs(start);
+      expected.clear();
+      start=std::chrono::steady_clock::now();
+      for(size_t i=0; i<count; ++i)
+      {
+        ngl::Real d2=0.0f;
+        for(int a=0; a<3; ++a)
+        {
+          ngl::Real d=std::max(boxes[i].m_min[a]-centre[a],std::max(0.0f,centre[a]-boxes[i].m_max[a]));
+          d2+=d*d;
+        }
+        if(d2<=radius*radius)
+        {
+          expected.push_back(static_cast<uint32_t>(i));
+        }
+      }
+      bruteSphereNs+=elapsedNs(start);
+      wrong+=sameSet(fromGrid,expected) && sameSet(fromTree,expected) ? 0 : 1;
+    }
+    std::cout<<"  box query grid "<<gridBoxNs/c_queries<<" ns, LBVH "<<treeBoxNs/c_queries<<" ns, brute force "
+             <<bruteBoxNs/c_queries<<" ns ("<<static_cast<double>(hits)/c_queries<<" hits)\n";
+    std::cout<<"  sphere query grid "<<gridSphereNs/c_queries<<" ns, LBVH "<<treeSphereNs/c_queries<<" ns, brute force "
+             <<bruteSphereNs/c_queries<<" ns\n";
+
+    std::vector<SpatialHashGrid::Pair> gridPairs;
+    std::vector<LinearBVH::Pair> treePairs;
+    auto start=std::chrono::steady_clock::now();
+    grid.queryPairs(gridPairs);
+    double gridPairsMs=elapsedNs(start)*1e-6;
+    start=std::chrono::steady_clock::now();
+    tree.queryPairs(treePairs);
+    double treePairsMs=elapsedNs(start)*1e-6;
+    size_t sample=std::min(count,c_pairSample);
+    size_t bruteSamplePairs=0;
+    start=std::chrono::steady_clock::now();
+    for(size_t i=0; i<sample; ++i)
+    {
+      for(size_t j=i+1; j<count; ++j)
+      {
+        bruteSamplePairs+=boxes[i].overlaps(boxes[j]) ? 1 : 0;
+      }
+    }
+    double bruteNs=elapsedNs(start);
+    // the sampled rows are the longest ones of the triangle, scale by the number of tests
+    double tests=0.5*static_cast<double>(count)*(count-1);
+    double sampleTests=static_cast<double>(sample)*count-0.5*static_cast<double>(sample)*(sample+1);
+    double brutePairsMs=bruteNs*1e-6*tests/sampleTests;
+    size_t gridSamplePairs=0;
+    for(const auto &p : gridPairs)
+    {
+      gridSamplePairs+= p.first<sample ? 1 : 0;
+    }
+    std::sort(gridPairs.begin(),gridPairs.end());
+    std::sort(treePairs.begin(),treePairs.end());
+    bool repeated=std::adjacent_find(gridPairs.begin(),gridPairs.end())!=gridPairs.end();
+    std::cout<<"  pairs grid "<<gridPairsMs<<" ms, LBVH "<<treePairsMs<<" ms, brute force "<<brutePairsMs<<" ms"
+             <<(sample<count ? " (estimated)" : "")<<" ("<<gridPairs.size()<<" pairs)\n";
+    if(wrong || repeated || gridSamplePairs!=bruteSamplePairs || gridPairs!=treePairs)
+    {
+      std::cout<<"  grid, LBVH and brute force disagree: "<<wrong<<" queries, pairs "<<gridSamplePairs<<" against "
+               <<bruteSamplePairs<<", LBVH "<<treePairs.size()<<(repeated ? ", repeated pairs" : "")<<"\n";
+      result=EXIT_FAILURE;
+    }
+  }
+  return result;
+}
+
+namespace
+{
+  // twist the mesh about its vertical axis and bend it sideways, both swinging with _time
+  void deform(const MeshLOD &_mesh, const AABB &_bounds, ngl::Real _time, std::vector<ngl::Real> &_out)
+  {
+    ngl::Vec3 centre=_bounds.center();
+    ngl::Vec3 size=_bounds.size();
+    ngl::Real height=std::max(size.m_y,1e-6f);
+    ngl::Real twist=3.0f*std::sin(_time);
+    ngl::Real bend=0.5f*size.m_x*std::sin(0.7f*_time);
+    _out.resize(3*_mesh.numVertices());
+    const ngl::Real *p=_mesh.positions();
+    for(size_t i=0; i<_mesh.numVertices(); ++i, p+=MeshLOD::c_positionStride)
+    {
+      ngl::Real h=(p[1]-centre.m_y)/height;
+      ngl::Real angle=twist*h;
+      ngl::Real x=p[0]-centre.m_x;
+      ngl::Real z=p[2]-centre.m_z;
+      _out[3*i]=centre.m_x+x*std::cos(angle)-z*std::sin(angle)+bend*h*h;
+      _out[3*i+1]=p[1];
+      _out[3*i+2]=centre.m_z+x*std::sin(angle)+z*std::cos(angle);
+    }
+  }
+}
+
+int benchmarkRefit(const std::vector<std::string> &_objFiles)
+{
+  constexpr size_t c_frames=300;
+  return forEachMesh(_objFiles,[&](const std::string &_file, MeshLOD &_mesh)
+  {
+    size_t numTriangles=_mesh.numTriangles(0);
+    std::vector<ngl::Real> positions;
+    deform(_mesh,_mesh.bounds(),0.0f,positions);
+    // the same deformation three ways: refit and rebuild in the background when the SAH cost
+    // has grown, only ever refit, and rebuild from scratch every frame
+    DeformingBVH deforming;
+    deforming.build(positions.data(),3,_mesh.indices(0),numTriangles);
+    LinearBVH refitted;
+    refitted.build(deforming.triangleBoxes().data(),numTriangles);
+    double refitBuiltCost=refitted.sahCost();
+    LinearBVH rebuilt;
+    double updateMs=0.0;
+    double refitMs=0.0;
+    double rebuildMs=0.0;
+    double maxRatio=0.0;
+    double refitRatio=0.0;
+    double rebuiltCost=0.0;
+    for(size_t frame=1; frame<=c_frames; ++frame)
+    {
+      deform(_mesh,_mesh.bounds(),0.05f*frame,positions);
+      auto start=std::chrono::steady_clock::now();
+      deforming.update(positions.data());
+      updateMs+=elapsedNs(start)*1e-6;
+      maxRatio=std::max(maxRatio,deforming.costRatio());
+      const std::vector<AABB> &boxes=deforming.triangleBoxes();
+      start=std::chrono::steady_clock::now();
+      refitted.refit(boxes.data());
+      refitMs+=elapsedNs(start)*1e-6;
+      start=std::chrono::steady_clock::now();
+      rebuilt.build(boxes.data(),numTriangles);
+      rebuildMs+=elapsedNs(start)*1e-6;
+      refitRatio=std::max(refitRatio,refitted.sahCost()/refitBuiltCost);
+      rebuiltCost=rebuilt.sahCost();
+    }
+    std::cout<<_file<<": "<<numTriangles<<" triangles, "<<c_frames<<" deformed frames\n";
+    std::cout<<"  refit "<<refitMs/c_frames<<" ms, rebuild "<<rebuildMs/c_frames<<" ms per frame\n";
+    std::cout<<"  refit only: SAH cost up to "<<refitRatio<<"x its cost when built\n";
+    std::cout<<"  refit with background rebuilds: "<<updateMs/c_frames<<" ms per frame (triangle boxes, refit and SAH), "
+             <<deforming.rebuilds()<<" rebuilds, SAH cost up to "<<maxRatio<<"x, last frame "
+             <<deforming.tree().sahCost()/rebuiltCost<<"x a fresh build\n";
+    return true;
+  });
+}
+
+int benchmarkBVHCache(const std::vector<std::string> &_objFiles)
+{
+  constexpr size_t c_runs=20;
+  constexpr size_t c_queries=1000;
+  std::mt19937 rng(1234);
+  return forEachMesh(_objFiles,[&](const std::string &_file, MeshLOD &_mesh)
+  {
+    // bvh() writes the cache if it is missing or stale
+    if(!_mesh.bvh().isOpen())
+    {
+      return false;
+    }
+    size_t numTriangles=_mesh.numTriangles(0);
+    std::string bvhFile=MeshLOD::cacheFile(_file,".bvh");
+    uint64_t sourceKey=_mesh.bvh().sourceKey();
+
+    // what startup would cost without the cache, triangle boxes and a serial build as
+    // MeshLOD does on its loader thread
+    WorkerPool serial(1);
+    LinearBVH built(&serial);
+    std::vector<AABB> boxes(numTriangles);
+    auto start=std::chrono::steady_clock::now();
+    for(size_t run=0; run<c_runs; ++run)
+    {
+      const GLuint *tri=_mesh.indices(0);
+      for(size_t t=0; t<numTriangles; ++t, tri+=3)
+      {
+        AABB box;
+        for(int c=0; c<3; ++c)
+        {
+          const ngl::Real *v=_mesh.positions()+tri[c]*MeshLOD::c_positionStride;
+          box.extend(ngl::Vec3(v[0],v[1],v[2]));
+        }
+        boxes[t]=box;
+      }
+      built.build(boxes.data(),numTriangles);
+    }
+    double buildMs=elapsedNs(start)*1e-6/c_runs;
+
+    MappedBVH mapped;
+    start=std::chrono::steady_clock::now();
+    for(size_t run=0; run<c_runs; ++run)
+    {
+      mapped.open(bvhFile,sourceKey);
+    }
+    double mapMs=elapsedNs(start)*1e-6/c_runs;
+
+    // the first queries fault the pages in, unless another process already has
+    const AABB &bounds=mapped.bounds();
+    ngl::Vec3 size=bounds.m_max-bounds.m_min;
+    std::uniform_real_distribution<ngl::Real> unit(0.0f,1.0f);
+    std::vector<uint32_t> expected;
+    std::vector<uint32_t> found;
+    size_t mismatches=0;
+    double queryNs=0.0;
+    for(size_t q=0; q<c_queries; ++q)
+    {
+      ngl::Vec3 centre(bounds.m_min.m_x+unit(rng)*size.m_x,bounds.m_min.m_y+unit(rng)*size.m_y,bounds.m_min.m_z+unit(rng)*size.m_z);
+      ngl::Vec3 half=size*(0.05f*unit(rng));
+      AABB box(centre-half,centre+half);
+      expected.clear();
+      found.clear();
+      built.queryBox(box,expected);
+      start=std::chrono::steady_clock::now();
+      mapped.queryBox(box,found);
+      queryNs+=elapsedNs(start);
+      std::sort(expected.begin(),expected.end());
+      std::sort(found.begin(),found.end());
+      mismatches+=expected!=found;
+    }
+    std::cout<<_file<<": "<<numTriangles<<" triangles, "<<mapped.fileBytes()/1024<<" KB cache\n";
+    std::cout<<"  build "<<buildMs<<" ms, map "<<mapMs<<" ms, "<<queryNs/c_queries<<" ns per box query on the mapped tree\n";
+    if(mismatches)
+    {
+      std::cerr<<"  "<<mismatches<<" of "<<c_queries<<" queries differ from the built tree\n";
+      return false;
+    }
+    return true;
+  });
+}
+
+int benchmarkQuantize(const std::vector<std::string> &_objFiles)
+{
+  return forEachObj(_objFiles,[](const std::string &_file, const IndexedMesh &_mesh)
+  {
+    AABB bounds=_mesh.bounds();
+    ngl::Mat4 dequantize=QuantizedVertex::dequantizeMatrix(bounds);
+    ngl::Real positionError=0.0f;
+    ngl::Real uvError=0.0f;
+    ngl::Real normalError=0.0f;
+    for(const auto &v : _mesh.m_verts)
+    {
+      QuantizedVertex q=QuantizedVertex::encode(v,bounds);
+      // decode as the GPU does
+      ngl::Vec4 unit(q.m_position[0]/65535.0f,q.m_position[1]/65535.0f,q.m_position[2]/65535.0f,1.0f);
+      ngl::Vec4 p=unit*dequantize;
+      positionError=std::max({positionError,std::abs(p.m_x-v.m_x),std::abs(p.m_y-v.m_y),std::abs(p.m_z-v.m_z)});
+      uvError=std::max({uvError,std::abs(QuantizedVertex::fromHalf(q.m_uv[0])-v.m_u),std::abs(QuantizedVertex::fromHalf(q.m_uv[1])-v.m_v)});
+      ngl::Vec3 n(v.m_nx,v.m_ny,v.m_nz);
+      if(n.length()>0.0f)
+      {
+        n.normalize();
+        ngl::Vec3 decoded=QuantizedVertex::octDecode(std::max(-1.0f,q.m_normal[0]/32767.0f),std::max(-1.0f,q.m_normal[1]/32767.0f));
+        ngl::Real cosine=std::min(1.0f,std::max(-1.0f,n.dot(decoded)));
+        normalError=std::max(normalError,std::acos(cosine)*57.29578f);
+      }
+    }
+    size_t floatBytes=_mesh.m_verts.size()*sizeof(IndexedMesh::Vertex);
+    size_t packedBytes=_mesh.m_verts.size()*sizeof(QuantizedVertex);
+    ngl::Vec3 size=bounds.m_max-bounds.m_min;
+    std::cout<<_file<<": "<<_mesh.m_verts.size()<<" vertices, "<<floatBytes/1024<<" KB as floats, "<<packedBytes/1024<<" KB quantized\n";
+    std::cout<<"  max position error "<<positionError<<" ("<<100.0f*positionError/size.length()<<"% of the box diagonal), uv "
+             <<uvError<<", normal "<<normalError<<" degrees\n";
+    return true;
+  });
+}
+
+namespace
+{
+  // triangle boxes of a rolling height field with about _count triangles, two per grid square
+  std::vector<AABB> syntheticTriangles(size_t _count)
+  {
+    size_t side=std::max<size_t>(1,static_cast<size_t>(std::sqrt(0.5*static_cast<double>(_count))));
+    auto height=[](size_t _x, size_t _z)
+    {
+      return 4.0f*std::sin(0.05f*_x)*std::cos(0.07f*_z)+std::sin(0.31f*_x+0.17f*_z);
+    };
+    std::vector<AABB> boxes;
+    boxes.reserve(2*side*side);
+    for(size_t z=0; z<side; ++z)
+    {
+      for(size_t x=0; x<side; ++x)
+      {
+        ngl::Vec3 p00(x,height(x,z),z);
+        ngl::Vec3 p10(x+1,height(x+1,z),z);
+        ngl::Vec3 p01(x,height(x,z+1),z+1);
+        ngl::Vec3 p11(x+1,height(x+1,z+1),z+1);
+        AABB a;
+        a.extend(p00);
+        a.extend(p10);
+        a.extend(p11);
+        AABB b;
+        b.extend(p00);
+        b.extend(p11);
+        b.extend(p01);
+        boxes.push_back(a);
+        boxes.push_back(b);
+      }
+    }
+    return boxes;
+  }
+
+  bool compareCompressed(const std::string &_name, const std::vector<AABB> &_boxes)
+  {
+    constexpr size_t c_queries=100000;
+    LinearBVH tree;
+    tree.build(_boxes.data(),_boxes.size());
+    CompressedBVH compressed;
+    auto start=std::chrono::steady_clock::now();
+    compressed.build(tree);
+    double compressMs=elapsedNs(start)*1e-6;
+    // what a box query reads from each
+    size_t count=_boxes.size();
+    size_t treeBytes=(count-1)*sizeof(LinearBVH::Node)+count*(sizeof(AABB)+sizeof(uint32_t));
+    size_t compressedBytes=compressed.memoryBytes();
+
+    // a few triangles across, centred on random triangles so every query lands on the surface
+    ngl::Vec3 meanSize(0.0f,0.0f,0.0f);
+    for(const auto &b : _boxes)
+    {
+      meanSize+=b.m_max-b.m_min;
+    }
+    meanSize*=1.0f/static_cast<ngl::Real>(count);
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<size_t> pick(0,count-1);
+    std::vector<AABB> queries(c_queries);
+    for(auto &q : queries)
+    {
+      const AABB &b=_boxes[pick(rng)];
+      ngl::Vec3 centre=(b.m_min+b.m_max)*0.5f;
+      q=AABB(centre-meanSize*2.0f,centre+meanSize*2.0f);
+    }
+    std::vector<uint32_t> exact;
+    std::vector<uint32_t> candidates;
+    size_t exactHits=0;
+    start=std::chrono::steady_clock::now();
+    for(const auto &q : queries)
+    {
+      exact.clear();
+      tree.queryBox(q,exact);
+      exactHits+=exact.size();
+    }
+    double treeNs=elapsedNs(start)/c_queries;
+    size_t candidateHits=0;
+    start=std::chrono::steady_clock::now();
+    for(const auto &q : queries)
+    {
+      candidates.clear();
+      compressed.queryBox(q,candidates);
+      candidateHits+=candidates.size();
+    }
+    double compressedNs=elapsedNs(start)/c_queries;
+    // every exact hit has to be a candidate, checked on a sample outside the timing
+    size_t missed=0;
+    for(size_t i=0; i<c_queries; i+=97)
+    {
+      exact.clear();
+      candidates.clear();
+      tree.queryBox(queries[i],exact);
+      compressed.queryBox(queries[i],candidates);
+      std::sort(exact.begin(),exact.end());
+      std::sort(candidates.begin(),candidates.end());
+      missed+=!std::includes(candidates.begin(),candidates.end(),exact.begin(),exact.end());
+    }
+    std::cout<<_name<<": "<<count<<" triangles, "<<compressed.numNodes()<<" compressed nodes built in "<<compressMs<<" ms\n";
+    std::cout<<"  memory "<<treeBytes/1024<<" KB -> "<<compressedBytes/1024<<" KB ("
+             <<100.0*compressedBytes/treeBytes<<"%)\n";
+    std::cout<<"  box query "<<treeNs<<" ns -> "<<compressedNs<<" ns, "<<static_cast<double>(exactHits)/c_queries
+             <<" hits -> "<<static_cast<double>(candidateHits)/c_queries<<" candidates\n";
+    if(missed)
+    {
+      std::cerr<<"  "<<missed<<" sampled queries lost an exact hit\n";
+    }
+    return missed==0;
+  }
+}
+
+int benchmarkCompressed(const std::vector<std::string> &_objFiles, const std::vector<size_t> &_syntheticTriangles)
+{
+  int result=forEachMesh(_objFiles,[&](const std::string &_file, MeshLOD &_mesh)
+  {
+    std::vector<AABB> boxes(_mesh.numTriangles(0));
+    const GLuint *tri=_mesh.indices(0);
+    for(auto &box : boxes)
+    {
+      for(int c=0; c<3; ++c, ++tri)
+      {
+        const ngl::Real *v=_mesh.positions()+*tri*MeshLOD::c_positionStride;
+        box.extend(ngl::Vec3(v[0],v[1],v[2]));
+      }
+    }
+    return compareCompressed(_file,boxes);
+  });
+  for(size_t count : _syntheticTriangles)
+  {
+    std::vector<AABB> boxes=syntheticTriangles(count);
+    if(!compareCompressed("height field",boxes))
+    {
+      result=EXIT_FAILURE;
+    }
+  }
+  return result;
+}
+
+namespace
+{
+  struct PanelView
+  {
+    const char *m_name;
+    ngl::Mat4 m_view;
+    ngl::Mat4 m_projection;
+  };
+
+  // the four panel cameras NGLScene draws with, before any mouse rotation
+  std::vector<PanelView> panelViews()
+  {
+    ngl::Vec3 to(0,0,0);
+    std::vector<PanelView> views;
+    views.push_back({"top",ngl::lookAt(ngl::Vec3(0,5,0),to,ngl::Vec3(0,0,-1)),ngl::ortho(-5,5,-5,5,0.1f,500.0f)});
+    views.push_back({"front",ngl::lookAt(ngl::Vec3(0,0,5),to,ngl::Vec3(0,1,0)),ngl::ortho(-5,5,-5,5,0.01f,200.0f)});
+    views.push_back({"side",ngl::lookAt(ngl::Vec3(5,0,0),to,ngl::Vec3(0,1,0)),ngl::ortho(-5,5,-5,5,0.1f,100.0f)});
+    views.push_back({"persp",ngl::lookAt(ngl::Vec3(0,5,5),to,ngl::Vec3(0,1,0)),ngl::perspective(45.0f,1.0f,0.01f,100.0f)});
+    return views;
+  }
+
+  bool insideClip(const ngl::Vec4 &_p)
+  {
+    return std::abs(_p.m_x)<=_p.m_w && std::abs(_p.m_y)<=_p.m_w && std::abs(_p.m_z)<=_p.m_w;
+  }
+}
+
+int benchmarkMeshlets(const std::vector<std::string> &_objFiles)
+{
+  constexpr size_t c_placements=200;
+  std::vector<PanelView> views=panelViews();
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<ngl::Real> unit(-1.0f,1.0f);
+  std::normal_distribution<ngl::Real> gauss(0.0f,1.0f);
+  return forEachMesh(_objFiles,[&](const std::string &_file, MeshLOD &_mesh)
+  {
+    const Meshlets &meshlets=_mesh.meshlets();
+    if(meshlets.size()==0)
+    {
+      return false;
+    }
+    bool ok=true;
+    size_t numTriangles=_mesh.numTriangles(0);
+    const GLuint *indices=_mesh.indices(0);
+    // scaled to about a fifth of a panel and spread over the scene
+    ngl::Vec3 size=_mesh.bounds().m_max-_mesh.bounds().m_min;
+    ngl::Real scale=2.0f/std::max(size.m_x,std::max(size.m_y,size.m_z));
+    std::vector<GLsizei> counts(meshlets.size());
+    std::vector<const void *> offsets(meshlets.size());
+    std::vector<char> kept(numTriangles);
+    std::cout<<_file<<": "<<numTriangles<<" triangles in "<<meshlets.size()<<" meshlets\n";
+    for(const auto &panel : views)
+    {
+      ngl::Mat4 VP=panel.m_view*panel.m_projection;
+      bool orthographic=panel.m_projection.m_m[3][3]==1.0f;
+      size_t submitted=0;
+      size_t missed=0;
+      double cullNs=0.0;
+      for(size_t p=0; p<c_placements; ++p)
+      {
+        ngl::Real q[4]={gauss(rng),gauss(rng),gauss(rng),gauss(rng)};
+        ngl::Real len=std::sqrt(q[0]*q[0]+q[1]*q[1]+q[2]*q[2]+q[3]*q[3]);
+        ngl::Mat4 world=makeTransform(q[0]/len,q[1]/len,q[2]/len,q[3]/len,ngl::Vec3(scale,scale,scale),
+                                      ngl::Vec3(4.0f*unit(rng),4.0f*unit(rng),4.0f*unit(rng)));
+        // as NGLScene::drawMeshlets
+        ngl::Mat4 MV=world*panel.m_view;
+        ngl::Mat4 inverseMV=MV;
+        inverseMV=inverseMV.inverse();
+        ngl::Vec4 eye=(orthographic ? ngl::Vec4(0.0f,0.0f,1.0f,0.0f) : ngl::Vec4(0.0f,0.0f,0.0f,1.0f))*inverseMV;
+        ngl::Mat4 MVP=world*VP;
+        size_t numRanges=0;
+        auto start=std::chrono::steady_clock::now();
+        submitted+=meshlets.cull(MVP,eye,true,counts.data(),offsets.data(),numRanges);
+        cullNs+=elapsedNs(start);
+
+        // a front facing triangle with a corner on screen must have been kept
+        std::fill(kept.begin(),kept.end(),0);
+        for(size_t r=0; r<numRanges; ++r)
+        {
+          size_t first=reinterpret_cast<uintptr_t>(offsets[r])/sizeof(GLuint)/3;
+          std::fill(kept.begin()+first,kept.begin()+first+counts[r]/3,1);
+        }
+        for(size_t t=0; t<numTriangles; ++t)
+        {
+          if(kept[t])
+          {
+            continue;
+          }
+          ngl::Vec3 p[3];
+          bool onScreen=false;
+          for(int c=0; c<3; ++c)
+          {
+            const ngl::Real *v=_mesh.positions()+indices[3*t+c]*MeshLOD::c_positionStride;
+            p[c].set(v[0],v[1],v[2]);
+            onScreen|=insideClip(ngl::Vec4(v[0],v[1],v[2],1.0f)*MVP);
+          }
+          ngl::Vec3 normal=(p[1]-p[0]).cross(p[2]-p[0]);
+          ngl::Vec3 toEye(eye.m_x-p[0].m_x*eye.m_w,eye.m_y-p[0].m_y*eye.m_w,eye.m_z-p[0].m_z*eye.m_w);
+          missed+=onScreen && normal.dot(toEye)>0.0f;
+        }
+      }
+      std::cout<<"  "<<panel.m_name<<": "<<100.0*submitted/(numTriangles*c_placements)
+               <<"% of triangles submitted, culled in "<<cullNs*1e-3/c_placements<<" us\n";
+      if(missed)
+      {
+        std::cerr<<"  "<<missed<<" visible triangles were culled\n";
+        ok=false;
+      }
+    }
+    return ok;
+  });
+}
+
+namespace
+{
+  // pixels that pass the depth test per pixel covered, averaged over orthographic views from
+  // _numViews directions spread over the sphere and drawn in index order. Back faces are kept
+  // as the mesh shader does not cull them.
+  ngl::Real overdraw(const ngl::Real *_positions, size_t _stride, const GLuint *_indices, size_t _numIndices,
+                     size_t _numVertices, const AABB &_bounds, size_t _numViews=16)
+  {
+    constexpr int c_resolution=256;
+    ngl::Vec3 centre=(_bounds.m_min+_bounds.m_max)*0.5f;
+    ngl::Real radius=(_bounds.m_max-_bounds.m_min).length()*0.5f;
+    if(radius<=0.0f)
+    {
+      return 0.0f;
+    }
+    std::vector<ngl::Real> depth(c_resolution*c_resolution);
+    std::vector<ngl::Vec3> projected(_numVertices);
+    size_t shaded=0;
+    size_t covered=0;
+    for(size_t view=0; view<_numViews; ++view)
+    {
+      // Fibonacci sphere directions
+      ngl::Real z=1.0f-(2.0f*view+1.0f)/_numViews;
+      ngl::Real ring=std::sqrt(std::max(0.0f,1.0f-z*z));
+      ngl::Real angle=2.39996323f*view;
+      ngl::Vec3 forward(ring*std::cos(angle),ring*std::sin(angle),z);
+      ngl::Vec3 up= std::abs(forward.m_y)<0.9f ? ngl::Vec3(0.0f,1.0f,0.0f) : ngl::Vec3(1.0f,0.0f,0.0f);
+      ngl::Vec3 right=up.cross(forward);
+      right.normalize();
+      up=forward.cross(right);
+      ngl::Real toPixels=0.5f*c_resolution/radius;
+      for(size_t v=0; v<_numVertices; ++v)
+      {
+        const ngl::Real *p=_positions+v*_stride;
+        ngl::Vec3 d=ngl::Vec3(p[0],p[1],p[2])-centre;
+        projected[v].set(d.dot(right)*toPixels+0.5f*c_resolution,d.dot(up)*toPixels+0.5f*c_resolution,d.dot(forward));
+      }
+      std::fill(depth.begin(),depth.end(),std::numeric_limits<ngl::Real>::max());
+      for(size_t i=0; i+2<_numIndices; i+=3)
+      {
+        const ngl::Vec3 &a=projected[_indices[i]];
+        const ngl::Vec3 &b=projected[_indices[i+1]];
+        const ngl::Vec3 &c=projected[_indices[i+2]];
+        ngl::Real area=(b.m_x-a.m_x)*(c.m_y-a.m_y)-(b.m_y-a.m_y)*(c.m_x-a.m_x);
+        if(area==0.0f)
+        {
+          continue;
+        }
+        int x0=std::max(0,static_cast<int>(std::floor(std::min({a.m_x,b.m_x,c.m_x}))));
+        int x1=std::min(c_resolution-1,static_cast<int>(std::ceil(std::max({a.m_x,b.m_x,c.m_x}))));
+        int y0=std::max(0,static_cast<int>(std::floor(std::min({a.m_y,b.m_y,c.m_y}))));
+        int y1=std::min(c_resolution-1,static_cast<int>(std::ceil(std::max({a.m_y,b.m_y,c.m_y}))));
+        for(int y=y0; y<=y1; ++y)
+        {
+          for(int x=x0; x<=x1; ++x)
+          {
+            ngl::Real px=x+0.5f;
+            ngl::Real py=y+0.5f;
+            ngl::Real w0=((b.m_x-px)*(c.m_y-py)-(b.m_y-py)*(c.m_x-px))/area;
+            ngl::Real w1=((c.m_x-px)*(a.m_y-py)-(c.m_y-py)*(a.m_x-px))/area;
+            ngl::Real w2=1.0f-w0-w1;
+            if(w0<0.0f || w1<0.0f || w2<0.0f)
+            {
+              continue;
+            }
+            ngl::Real d=w0*a.m_z+w1*b.m_z+w2*c.m_z;
+            ngl::Real &stored=depth[y*c_resolution+x];
+            if(d<stored)
+            {
+              covered+=stored==std::numeric_limits<ngl::Real>::max();
+              stored=d;
+              ++shaded;
+            }
+          }
+        }
+      }
+    }
+    return covered ? static_cast<ngl::Real>(shaded)/static_cast<ngl::Real>(covered) : 0.0f;
+  }
+}
+
+int benchmarkIndexOrder(const std::vector<std::string> &_objFiles)
+{
+  return forEachObj(_objFiles,[](const std::string &_file, const IndexedMesh &_source)
+  {
+    // both orders come from (or go into) their own cache files
+    MeshLOD::setOptimizeIndices(false);
+    MeshLOD before(_file);
+    MeshLOD::setOptimizeIndices(true);
+    MeshLOD after(_file);
+    if(!before.isValid() || !after.isValid() || before.numLevels()!=after.numLevels())
+    {
+      return false;
+    }
+    std::cout<<_file<<": "<<_source.m_verts.size()<<" vertices, FIFO cache of "<<IndexOptimizer::c_cacheSize<<"\n";
+    auto report=[&](const char *_name, const ngl::Real *_positions, const GLuint *_indices, size_t _numIndices)
+    {
+      IndexOptimizer::CacheStats stats=IndexOptimizer::analyzeCache(_indices,_numIndices,_source.m_verts.size());
+      ngl::Real draw=overdraw(_positions,MeshLOD::c_positionStride,_indices,_numIndices,_source.m_verts.size(),_source.bounds());
+      std::cout<<"    "<<_name<<" ACMR "<<stats.m_acmr<<" ATVR "<<stats.m_atvr<<" overdraw "<<draw<<"\n";
+    };
+    std::cout<<"  level 0, "<<_source.numTriangles()<<" triangles\n";
+    report("obj order      ",&_source.m_verts[0].m_x,_source.m_indices.data(),_source.m_indices.size());
+    for(size_t l=0; l<after.numLevels(); ++l)
+    {
+      if(l>0)
+      {
+        std::cout<<"  level "<<l<<", "<<after.numTriangles(l)<<" triangles\n";
+      }
+      report(l==0 ? "meshlet order  " : "simplifier order",before.positions(),before.indices(l),before.numIndices(l));
+      report("optimized      ",after.positions(),after.indices(l),after.numIndices(l));
+    }
+    // what the passes cost when the cache has to be rebuilt
+    std::vector<GLuint> indices(_source.m_indices);
+    auto start=std::chrono::steady_clock::now();
+    IndexOptimizer::optimizeVertexCache(indices.data(),indices.size(),_source.m_verts.size());
+    auto cacheDone=std::chrono::steady_clock::now();
+    IndexOptimizer::optimizeOverdraw(&_source.m_verts[0].m_x,MeshLOD::c_positionStride,indices.data(),indices.size(),_source.m_verts.size());
+    auto overdrawDone=std::chrono::steady_clock::now();
+    std::vector<GLuint> remap;
+    IndexOptimizer::optimizeVertexFetch(indices.data(),indices.size(),_source.m_verts.size(),remap);
+    auto fetchDone=std::chrono::steady_clock::now();
+    typedef std::chrono::duration<double,std::milli> ms;
+    std::cout<<"  level 0 passes: vertex cache "<<std::chrono::duration_cast<ms>(cacheDone-start).count()
+             <<" ms, overdraw "<<std::chrono::duration_cast<ms>(overdrawDone-cacheDone).count()
+             <<" ms, vertex fetch "<<std::chrono::duration_cast<ms>(fetchDone-overdrawDone).count()<<" ms\n";
+    return true;
+  });
+}
+
+namespace
+{
+  typedef std::vector<std::string> Files;
+  typedef std::vector<size_t> Counts;
+
+  struct Command
+  {
+    const char *m_option;
+    const char *m_arguments;
+    const char *m_description;
+    // used when no arguments are given
+    bool m_defaultMesh;
+    size_t m_defaultCounts[3];
+    int (*m_run)(const Files &_objFiles, const Counts &_counts);
+  };
+
+  const Command c_commands[]=
+  {
+    {"--bench-bounds","[obj files]","corner, convex hull and hull support walk world boxes",true,{},
+     [](const Files &_f, const Counts &){return benchmarkBounds(_f);}},
+    {"--bench-grid","[counts]","spatial hash grid and LBVH against brute force",false,{10000,100000,1000000},
+     [](const Files &, const Counts &_c){return benchmarkGrid(_c);}},
+    {"--bench-refit","[obj files]","refitting against rebuilding a deforming mesh's triangle BVH",true,{},
+     [](const Files &_f, const Counts &){return benchmarkRefit(_f);}},
+    {"--bench-bvh-cache","[obj files]","building a mesh's triangle BVH against mapping its cache",true,{},
+     [](const Files &_f, const Counts &){return benchmarkBVHCache(_f);}},
+    {"--bench-quantize","[obj files]","size and error of the quantized vertex format",true,{},
+     [](const Files &_f, const Counts &){return benchmarkQuantize(_f);}},
+    {"--bench-compressed","[obj files] [triangle counts]","compressed wide BVH against the LBVH on meshes and height fields",true,{10000000},
+     [](const Files &_f, const Counts &_c){return benchmarkCompressed(_f,_c);}},
+    {"--bench-meshlets","[obj files]","triangles each panel submits with meshlet culling",true,{},
+     [](const Files &_f, const Counts &){return benchmarkMeshlets(_f);}},
+    {"--bench-index-order","[obj files]","vertex cache and overdraw of each LOD level with and without IndexOptimizer",true,{},
+     [](const Files &_f, const Counts &){return benchmarkIndexOrder(_f);}}
+  };
+}
+
+bool runBenchmark(const std::string &_option, const std::vector<std::string> &_args, int &_exitCode)
+{
+  for(const auto &command : c_commands)
+  {
+    if(_option!=command.m_option)
+    {
+      continue;
+    }
+    // anything starting with a digit is a count, the rest are obj files
+    Files objFiles;
+    Counts counts;
+    for(const auto &arg : _args)
+    {
+      if(!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0])))
+      {
+        counts.push_back(std::stoul(arg));
+      }
+      else
+      {
+        objFiles.push_back(arg);
+      }
+    }
+    if(_args.empty())
+    {
+      if(command.m_defaultMesh)
+      {
+        objFiles.push_back("models/Helix.obj");
+      }
+      for(size_t count : command.m_defaultCounts)
+      {
+        if(count)
+        {
+          counts.push_back(count);
+        }
+      }
+    }
+    _exitCode=command.m_run(objFiles,counts);
+    return true;
+  }
+  return false;
+}
+
+void printBenchmarks(std::ostream &_out)
+{
+  for(const auto &command : c_commands)
+  {
+    _out<<"  "<<command.m_option<<" "<<command.m_arguments<<"\n      "<<command.m_description<<"\n";
+  }
+}
@@ -0,0 +1,231 @@
+#include "BoundsAPI.h"
+#include "AABB.h"
+#include "LinearBVH.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include <ngl/Mat4.h>
+
+// the caller's floats are copied straight into our types
+static_assert(sizeof(ngl::Real)==sizeof(float),"the C interface needs single precision ngl");
+static_assert(sizeof(AABB)==6*sizeof(float),"AABB must be six packed floats");
+static_assert(sizeof(ngl::Mat4)==16*sizeof(float),"Mat4 must be sixteen packed floats");
+
+struct saabb_context
+{
+  explicit saabb_context(size_t _numThreads) :
+    m_ownPool(_numThreads ? new WorkerPool(_numThreads) : nullptr),
+    m_pool(_numThreads ? m_ownPool.get() : &WorkerPool::shared()),
+    m_bvh(m_pool)
+  {
+  }
+  std::unique_ptr<WorkerPool> m_ownPool;
+  WorkerPool *m_pool;
+  LinearBVH m_bvh;
+  bool m_built=false;
+  // strided boxes are gathered here, packed ones are used where they are
+  std::vector<AABB> m_boxes;
+  std::vector<LinearBVH::Pair> m_pairs;
+};
+
+namespace
+{
+  constexpr size_t c_rayGrain=1024;
+
+  // boxes the hierarchy can read, the caller's own when they are packed and aligned
+  const AABB *gatherBoxes(saabb_context &_context, const float *_boxes, size_t _stride, size_t _count)
+  {
+    if((_stride==0 || _stride==sizeof(AABB)) && reinterpret_cast<uintptr_t>(_boxes)%alignof(AABB)==0)
+    {
+      return reinterpret_cast<const AABB *>(_boxes);
+    }
+    _context.m_boxes.resize(_count);
+    const char *in=reinterpret_cast<const char *>(_boxes);
+    for(size_t i=0; i<_count; ++i)
+    {
+      std::memcpy(&_context.m_boxes[i],in+i*_stride,sizeof(AABB));
+    }
+    return _context.m_boxes.data();
+  }
+
+  ngl::Vec3 readVector(const float *_base, size_t _stride, size_t _index)
+  {
+    float v[3];
+    std::memcpy(v,reinterpret_cast<const char *>(_base)+_index*_stride,sizeof(v));
+    return ngl::Vec3(v[0],v[1],v[2]);
+  }
+}
+
+uint32_t saabb_version(void)
+{
+  return SAABB_API_VERSION;
+}
+
+saabb_status saabb_transform_boxes(const float *_matrices, size_t _matrixStride,
+                                   const float *_localBoxes, size_t _localStride,
+                                   size_t _count, float *_worldBoxes, size_t _worldStride)
+{
+  if(_count && (!_matrices || !_localBoxes || !_worldBoxes))
+  {
+    return SAABB_INVALID_ARGUMENT;
+  }
+  _matrixStride= _matrixStride ? _matrixStride : sizeof(ngl::Mat4);
+  _localStride= _localStride ? _localStride : sizeof(AABB);
+  _worldStride= _worldStride ? _worldStride : sizeof(AABB);
+  const char *matrices=reinterpret_cast<const char *>(_matrices);
+  const char *local=reinterpret_cast<const char *>(_localBoxes);
+  char *world=reinterpret_cast<char *>(_worldBoxes);
+  ngl::Mat4 tx;
+  AABB box;
+  for(size_t i=0; i<_count; ++i)
+  {
+    std::memcpy(&box,local+i*_localStride,sizeof(AABB));
+    if(!box.isEmpty())
+    {
+      std::memcpy(&tx.m_m[0][0],matrices+i*_matrixStride,sizeof(ngl::Mat4));
+      box=box.transformed(tx);
+    }
+    std::memcpy(world+i*_worldStride,&box,sizeof(AABB));
+  }
+  return SAABB_OK;
+}
+
+saabb_status saabb_create(size_t _numThreads, saabb_context **_context)
+{
+  if(!_context)
+  {
+    return SAABB_INVALID_ARGUMENT;
+  }
+  *_context=nullptr;
+  try
+  {
+    *_context=new saabb_context(_numThreads);
+  }
+  catch(const std::bad_alloc &)
+  {
+    return SAABB_OUT_OF_MEMORY;
+  }
+  catch(...)
+  {
+    // std::thread throws std::system_error when it can't start a worker
+    return SAABB_OUT_OF_MEMORY;
+  }
+  return SAABB_OK;
+}
+
+void saabb_destroy(saabb_context *_context)
+{
+  delete _context;
+}
+
+saabb_status saabb_build(saabb_context *_context, const float *_boxes, size_t _stride, size_t _count)
+{
+  if(!_context || (_count && !_boxes) || _count>=LinearBVH::c_leaf)
+  {
+    return SAABB_INVALID_ARGUMENT;
+  }
+  _stride= _stride ? _stride : sizeof(AABB);
+  _context->m_built=false;
+  try
+  {
+    _context->m_bvh.build(gatherBoxes(*_context,_boxes,_stride,_count),_count);
+  }
+  catch(const std::bad_alloc &)
+  {
+    return SAABB_OUT_OF_MEMORY;
+  }
+  _context->m_built=true;
+  return SAABB_OK;
+}
+
+saabb_status saabb_refit(saabb_context *_context, const float *_boxes, size_t _stride, size_t _count)
+{
+  if(!_context || (_count && !_boxes))
+  {
+    return SAABB_INVALID_ARGUMENT;
+  }
+  if(!_context->m_built || _count!=_context->m_bvh.size())
+  {
+    return SAABB_NOT_BUILT;
+  }
+  _stride= _stride ? _stride : sizeof(AABB);
+  try
+  {
+    _context->m_bvh.refit(gatherBoxes(*_context,_boxes,_stride,_count));
+  }
+  catch(const std::bad_alloc &)
+  {
+    _context->m_built=false;
+    return SAABB_OUT_OF_MEMORY;
+  }
+  return SAABB_OK;
+}
+
+saabb_status saabb_overlap_pairs(saabb_context *_context, uint32_t *_pairs, size_t _maxPairs, size_t *_numPairs)
+{
+  if(!_context || !_numPairs || (_maxPairs && !_pairs))
+  {
+    return SAABB_INVALID_ARGUMENT;
+  }
+  *_numPairs=0;
+  if(!_context->m_built)
+  {
+    return SAABB_NOT_BUILT;
+  }
+  std::vector<LinearBVH::Pair> &pairs=_context->m_pairs;
+  pairs.clear();
+  try
+  {
+    _context->m_bvh.queryPairs(pairs);
+  }
+  catch(const std::bad_alloc &)
+  {
+    return SAABB_OUT_OF_MEMORY;
+  }
+  *_numPairs=pairs.size();
+  size_t written=std::min(pairs.size(),_maxPairs);
+  for(size_t i=0; i<written; ++i)
+  {
+    _pairs[2*i]=pairs[i].first;
+    _pairs[2*i+1]=pairs[i].second;
+  }
+  return written==pairs.size() ? SAABB_OK : SAABB_BUFFER_TOO_SMALL;
+}
+
+saabb_status saabb_raycast(saabb_context *_context, const float *_origins, size_t _originStride,
+                           const float *_directions, size_t _directionStride, size_t _count,
+                           float _maxT, saabb_ray_hit *_hits, size_t _hitStride)
+{
+  if(!_context || (_count && (!_origins || !_directions || !_hits)) || !(_maxT>=0.0f))
+  {
+    return SAABB_INVALID_ARGUMENT;
+  }
+  if(!_context->m_built)
+  {
+    return SAABB_NOT_BUILT;
+  }
+  _originStride= _originStride ? _originStride : 3*sizeof(float);
+  _directionStride= _directionStride ? _directionStride : 3*sizeof(float);
+  _hitStride= _hitStride ? _hitStride : sizeof(saabb_ray_hit);
+  const LinearBVH &bvh=_context->m_bvh;
+  char *hits=reinterpret_cast<char *>(_hits);
+  // each ray is independent and the tree is only read so they share out over the pool
+  _context->m_pool->parallelFor(_count,c_rayGrain,[&](size_t _begin, size_t _end)
+  {
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      saabb_ray_hit hit={SAABB_NO_HIT,0.0f};
+      if(!bvh.raycast(readVector(_origins,_originStride,i),readVector(_directions,_directionStride,i),_maxT,hit.object,hit.t))
+      {
+        hit.object=SAABB_NO_HIT;
+        hit.t=0.0f;
+      }
+      std::memcpy(hits+i*_hitStride,&hit,sizeof(hit));
+    }
+  });
+  return SAABB_OK;
+}
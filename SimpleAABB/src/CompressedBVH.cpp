@@ -0,0 +1,264 @@
+#include "CompressedBVH.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COMPRESSEDBVH_SSE
+#endif
+
+constexpr uint32_t CompressedBVH::c_leaf;
+constexpr int CompressedBVH::c_width;
+constexpr size_t CompressedBVH::c_stackSize;
+
+static_assert(sizeof(CompressedBVH::Node)==64,"a compressed node should fill exactly one cache line");
+
+namespace
+{
+  constexpr size_t c_cacheLine=64;
+
+  // 2^_exponent built from the bits, exact for every exponent a node can hold
+  float stepSize(int _exponent)
+  {
+    uint32_t bits=static_cast<uint32_t>(_exponent+127)<<23;
+    float f;
+    std::memcpy(&f,&bits,sizeof(f));
+    return f;
+  }
+
+  // the same sum the traversal does, so the rounding checks see what queries will see
+  float decode(float _origin, float _step, int _q)
+  {
+    return _origin+static_cast<float>(_q)*_step;
+  }
+
+  ngl::Real surfaceArea(const AABB &_box)
+  {
+    ngl::Vec3 d=_box.m_max-_box.m_min;
+    return d.m_x*d.m_y+d.m_y*d.m_z+d.m_z*d.m_x;
+  }
+
+  // box of a LinearBVH child reference
+  const AABB &childBounds(const LinearBVH &_tree, uint32_t _ref)
+  {
+    return (_ref & LinearBVH::c_leaf) ? _tree.leafBox(_ref & ~LinearBVH::c_leaf) : _tree.node(_ref).m_box;
+  }
+}
+
+void CompressedBVH::quantize(Node &_node, const AABB *_boxes, int _count)
+{
+  AABB bounds;
+  for(int c=0; c<_count; ++c)
+  {
+    bounds.extend(_boxes[c]);
+  }
+  for(int a=0; a<3; ++a)
+  {
+    float origin=bounds.m_min[a];
+    float extent=bounds.m_max[a]-origin;
+    // the smallest power of two step that spans the node in 255 steps
+    int exponent=-126;
+    if(extent>0.0f)
+    {
+      std::frexp(extent/255.0f,&exponent);
+      exponent=std::max(exponent,-126);
+      while(exponent<127 && decode(origin,stepSize(exponent),255)<bounds.m_max[a])
+      {
+        ++exponent;
+      }
+    }
+    float step=stepSize(exponent);
+    _node.m_origin[a]=origin;
+    _node.m_exponent[a]=static_cast<int8_t>(exponent);
+    for(int c=0; c<c_width; ++c)
+    {
+      if(c>=_count)
+      {
+        _node.m_min[a][c]=0;
+        _node.m_max[a][c]=0;
+        continue;
+      }
+      // round outwards, then step further out if the float sums still fall inside the box
+      float lo=std::floor((_boxes[c].m_min[a]-origin)/step);
+      float hi=std::ceil((_boxes[c].m_max[a]-origin)/step);
+      int qMin=static_cast<int>(std::min(255.0f,std::max(0.0f,lo)));
+      int qMax=static_cast<int>(std::min(255.0f,std::max(0.0f,hi)));
+      while(qMin>0 && decode(origin,step,qMin)>_boxes[c].m_min[a])
+      {
+        --qMin;
+      }
+      while(qMax<255 && decode(origin,step,qMax)<_boxes[c].m_max[a])
+      {
+        ++qMax;
+      }
+      _node.m_min[a][c]=static_cast<uint8_t>(qMin);
+      _node.m_max[a][c]=static_cast<uint8_t>(qMax);
+    }
+  }
+  _node.m_count=static_cast<uint8_t>(_count);
+}
+
+AABB CompressedBVH::childBox(const Node &_node, int _child)
+{
+  AABB box;
+  for(int a=0; a<3; ++a)
+  {
+    float step=stepSize(_node.m_exponent[a]);
+    box.m_min[a]=decode(_node.m_origin[a],step,_node.m_min[a][_child]);
+    box.m_max[a]=decode(_node.m_origin[a],step,_node.m_max[a][_child]);
+  }
+  return box;
+}
+
+void CompressedBVH::build(const LinearBVH &_tree)
+{
+  std::vector<Node> nodes;
+  size_t count=_tree.size();
+  if(count==1)
+  {
+    nodes.resize(1);
+    AABB box=_tree.leafBox(0);
+    quantize(nodes[0],&box,1);
+    nodes[0].m_child[0]=c_leaf | _tree.objectAt(0);
+  }
+  else if(count>1)
+  {
+    // each binary node becomes a wide node whose children are found by opening the largest
+    // internal child until there are four
+    nodes.reserve(count/2);
+    nodes.resize(1);
+    std::vector<std::pair<uint32_t,uint32_t>> pending;
+    pending.push_back({0,0});
+    while(!pending.empty())
+    {
+      uint32_t binary=pending.back().first;
+      uint32_t wide=pending.back().second;
+      pending.pop_back();
+      uint32_t children[c_width]={_tree.node(binary).m_left,_tree.node(binary).m_right};
+      int numChildren=2;
+      while(numChildren<c_width)
+      {
+        int largest=-1;
+        ngl::Real largestArea=-1.0f;
+        for(int c=0; c<numChildren; ++c)
+        {
+          if(!(children[c] & LinearBVH::c_leaf))
+          {
+            ngl::Real area=surfaceArea(_tree.node(children[c]).m_box);
+            if(area>largestArea)
+            {
+              largest=c;
+              largestArea=area;
+            }
+          }
+        }
+        if(largest<0)
+        {
+          break;
+        }
+        const LinearBVH::Node &open=_tree.node(children[largest]);
+        children[largest]=open.m_left;
+        children[numChildren++]=open.m_right;
+      }
+      AABB boxes[c_width];
+      for(int c=0; c<numChildren; ++c)
+      {
+        boxes[c]=childBounds(_tree,children[c]);
+      }
+      Node node;
+      std::memset(&node,0,sizeof(Node));
+      quantize(node,boxes,numChildren);
+      for(int c=0; c<numChildren; ++c)
+      {
+        if(children[c] & LinearBVH::c_leaf)
+        {
+          node.m_child[c]=c_leaf | _tree.objectAt(children[c] & ~LinearBVH::c_leaf);
+        }
+        else
+        {
+          // siblings end up next to each other
+          node.m_child[c]=static_cast<uint32_t>(nodes.size());
+          pending.push_back({children[c],node.m_child[c]});
+          nodes.push_back(Node());
+        }
+      }
+      nodes[wide]=node;
+    }
+  }
+  m_numNodes=nodes.size();
+  m_storage.assign(m_numNodes*sizeof(Node)+c_cacheLine,0);
+  uintptr_t start=reinterpret_cast<uintptr_t>(m_storage.data());
+  m_nodes=reinterpret_cast<Node *>((start+c_cacheLine-1) & ~static_cast<uintptr_t>(c_cacheLine-1));
+  if(m_numNodes)
+  {
+    std::memcpy(m_nodes,nodes.data(),m_numNodes*sizeof(Node));
+  }
+}
+
+void CompressedBVH::queryBox(const AABB &_box, std::vector<uint32_t> &_out) const
+{
+  if(m_numNodes==0)
+  {
+    return;
+  }
+  uint32_t stack[c_stackSize];
+  size_t top=0;
+  stack[top++]=0;
+#if defined(COMPRESSEDBVH_SSE)
+  const __m128i zero=_mm_setzero_si128();
+  __m128 queryMin[3];
+  __m128 queryMax[3];
+  for(int a=0; a<3; ++a)
+  {
+    queryMin[a]=_mm_set1_ps(_box.m_min[a]);
+    queryMax[a]=_mm_set1_ps(_box.m_max[a]);
+  }
+#endif
+  while(top)
+  {
+    const Node &node=m_nodes[stack[--top]];
+    int hits=(1<<node.m_count)-1;
+#if defined(COMPRESSEDBVH_SSE)
+    __m128 overlap=_mm_castsi128_ps(_mm_set1_epi32(-1));
+    for(int a=0; a<3; ++a)
+    {
+      __m128 origin=_mm_set1_ps(node.m_origin[a]);
+      __m128 step=_mm_set1_ps(stepSize(node.m_exponent[a]));
+      int32_t packedMin;
+      int32_t packedMax;
+      std::memcpy(&packedMin,node.m_min[a],sizeof(int32_t));
+      std::memcpy(&packedMax,node.m_max[a],sizeof(int32_t));
+      // four bytes out to four ints then floats
+      __m128i qMin=_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedMin),zero),zero);
+      __m128i qMax=_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedMax),zero),zero);
+      __m128 lo=_mm_add_ps(origin,_mm_mul_ps(_mm_cvtepi32_ps(qMin),step));
+      __m128 hi=_mm_add_ps(origin,_mm_mul_ps(_mm_cvtepi32_ps(qMax),step));
+      overlap=_mm_and_ps(overlap,_mm_and_ps(_mm_cmple_ps(lo,queryMax[a]),_mm_cmpge_ps(hi,queryMin[a])));
+    }
+    hits&=_mm_movemask_ps(overlap);
+#else
+    for(int c=0; c<node.m_count; ++c)
+    {
+      if(!childBox(node,c).overlaps(_box))
+      {
+        hits&=~(1<<c);
+      }
+    }
+#endif
+    for(int c=0; c<c_width; ++c)
+    {
+      if(hits & (1<<c))
+      {
+        uint32_t child=node.m_child[c];
+        if(child & c_leaf)
+        {
+          _out.push_back(child & ~c_leaf);
+        }
+        else
+        {
+          stack[top++]=child;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,763 @@
+#include "CompressedTexture.h"
+#include "AtomicWrite.h"
+#include "Stats.h"
+#include <QImage>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sys/stat.h>
+
+// S3TC is not core GL but every desktop driver exposes it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+  #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+  #define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+namespace
+{
+  constexpr uint32_t c_mipVersion=1;
+  // BC7 4 bit index interpolation weights out of 64
+  constexpr int c_bc7Weights[16]={0,4,9,13,17,21,26,30,34,38,43,47,51,55,60,64};
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief mean and principal axis of the 16 block pixels using _channels floats, the axis is zero if all
+  /// the points are the same
+  //----------------------------------------------------------------------------------------------------------------------
+  void principalAxis(const float (*_p)[4], int _channels, float *_mean, float *_axis)
+  {
+    for(int c=0; c<_channels; ++c)
+    {
+      _mean[c]=0.0f;
+      for(int i=0; i<16; ++i)
+      {
+        _mean[c]+=_p[i][c];
+      }
+      _mean[c]/=16.0f;
+    }
+    float cov[4][4]={};
+    for(int i=0; i<16; ++i)
+    {
+      for(int a=0; a<_channels; ++a)
+      {
+        for(int b=0; b<_channels; ++b)
+        {
+          cov[a][b]+=(_p[i][a]-_mean[a])*(_p[i][b]-_mean[b]);
+        }
+      }
+    }
+    // power iteration, a handful of steps is plenty for a 4x4 block
+    float v[4]={1.0f,1.0f,1.0f,1.0f};
+    for(int iter=0; iter<8; ++iter)
+    {
+      float w[4]={};
+      for(int a=0; a<_channels; ++a)
+      {
+        for(int b=0; b<_channels; ++b)
+        {
+          w[a]+=cov[a][b]*v[b];
+        }
+      }
+      float len=0.0f;
+      for(int a=0; a<_channels; ++a)
+      {
+        len+=w[a]*w[a];
+      }
+      len=std::sqrt(len);
+      if(len<1e-6f)
+      {
+        std::fill(v,v+4,0.0f);
+        break;
+      }
+      for(int a=0; a<_channels; ++a)
+      {
+        v[a]=w[a]/len;
+      }
+    }
+    std::copy(v,v+_channels,_axis);
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief end points of the block along its principal axis
+  //----------------------------------------------------------------------------------------------------------------------
+  void axisEndpoints(const float (*_p)[4], int _channels, float *_e0, float *_e1)
+  {
+    float mean[4],axis[4];
+    principalAxis(_p,_channels,mean,axis);
+    float tMin=0.0f;
+    float tMax=0.0f;
+    for(int i=0; i<16; ++i)
+    {
+      float t=0.0f;
+      for(int c=0; c<_channels; ++c)
+      {
+        t+=(_p[i][c]-mean[c])*axis[c];
+      }
+      tMin=std::min(tMin,t);
+      tMax=std::max(tMax,t);
+    }
+    for(int c=0; c<_channels; ++c)
+    {
+      _e0[c]=mean[c]+axis[c]*tMin;
+      _e1[c]=mean[c]+axis[c]*tMax;
+    }
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief least squares end points given the weight _w[i] each pixel gives to _e0 (the rest
+  /// going to _e1), left alone if the system is degenerate
+  //----------------------------------------------------------------------------------------------------------------------
+  void fitEndpoints(const float (*_p)[4], int _channels, const float *_w, float *_e0, float *_e1)
+  {
+    float aa=0.0f, ab=0.0f, bb=0.0f;
+    float ap[4]={}, bp[4]={};
+    for(int i=0; i<16; ++i)
+    {
+      float a=_w[i];
+      float b=1.0f-a;
+      aa+=a*a; ab+=a*b; bb+=b*b;
+      for(int c=0; c<_channels; ++c)
+      {
+        ap[c]+=a*_p[i][c];
+        bp[c]+=b*_p[i][c];
+      }
+    }
+    float det=aa*bb-ab*ab;
+    if(std::fabs(det)<1e-6f)
+    {
+      return;
+    }
+    for(int c=0; c<_channels; ++c)
+    {
+      _e0[c]=std::min(255.0f,std::max(0.0f,(ap[c]*bb-bp[c]*ab)/det));
+      _e1[c]=std::min(255.0f,std::max(0.0f,(bp[c]*aa-ap[c]*ab)/det));
+    }
+  }
+
+  uint16_t pack565(const float *_c)
+  {
+    int r=static_cast<int>(std::lround(std::min(255.0f,std::max(0.0f,_c[0]))*31.0f/255.0f));
+    int g=static_cast<int>(std::lround(std::min(255.0f,std::max(0.0f,_c[1]))*63.0f/255.0f));
+    int b=static_cast<int>(std::lround(std::min(255.0f,std::max(0.0f,_c[2]))*31.0f/255.0f));
+    return static_cast<uint16_t>((r<<11) | (g<<5) | b);
+  }
+
+  void unpack565(uint16_t _c, int *_rgb)
+  {
+    int r=(_c>>11)&31;
+    int g=(_c>>5)&63;
+    int b=_c&31;
+    _rgb[0]=(r<<3) | (r>>2);
+    _rgb[1]=(g<<2) | (g>>4);
+    _rgb[2]=(b<<3) | (b>>2);
+  }
+
+  // the four colour BC1 palette (c0>c1), entries 2 and 3 are the 1/3 and 2/3 blends
+  void palette565(uint16_t _c0, uint16_t _c1, int (*_out)[3])
+  {
+    unpack565(_c0,_out[0]);
+    unpack565(_c1,_out[1]);
+    for(int c=0; c<3; ++c)
+    {
+      _out[2][c]=(2*_out[0][c]+_out[1][c])/3;
+      _out[3][c]=(_out[0][c]+2*_out[1][c])/3;
+    }
+  }
+
+  template<int N>
+  int closest(const float *_p, const int (*_palette)[N], int _size, int _channels, float &_error)
+  {
+    int best=0;
+    _error=std::numeric_limits<float>::max();
+    for(int i=0; i<_size; ++i)
+    {
+      float e=0.0f;
+      for(int c=0; c<_channels; ++c)
+      {
+        float d=_p[c]-_palette[i][c];
+        e+=d*d;
+      }
+      if(e<_error)
+      {
+        _error=e;
+        best=i;
+      }
+    }
+    return best;
+  }
+
+  // little endian bit packing used by BC7
+  struct BitWriter
+  {
+    uint8_t *m_out;
+    size_t m_pos=0;
+    void write(uint32_t _value, int _bits)
+    {
+      for(int i=0; i<_bits; ++i, ++m_pos)
+      {
+        if((_value>>i)&1)
+        {
+          m_out[m_pos>>3]|=static_cast<uint8_t>(1<<(m_pos&7));
+        }
+      }
+    }
+  };
+
+  struct BitReader
+  {
+    const uint8_t *m_in;
+    size_t m_pos=0;
+    uint32_t read(int _bits)
+    {
+      uint32_t v=0;
+      for(int i=0; i<_bits; ++i, ++m_pos)
+      {
+        v|=static_cast<uint32_t>((m_in[m_pos>>3]>>(m_pos&7))&1)<<i;
+      }
+      return v;
+    }
+  };
+
+  // the 4x4 tile at block (_bx,_by) with edge pixels repeated for sizes that are not a multiple of 4
+  void fetchBlock(const std::vector<uint8_t> &_image, int _w, int _h, int _bx, int _by, uint8_t *_rgba)
+  {
+    for(int y=0; y<4; ++y)
+    {
+      int sy=std::min(_by*4+y,_h-1);
+      for(int x=0; x<4; ++x)
+      {
+        int sx=std::min(_bx*4+x,_w-1);
+        std::memcpy(&_rgba[(y*4+x)*4],&_image[(static_cast<size_t>(sy)*_w+sx)*4],4);
+      }
+    }
+  }
+
+  // 2x2 box filter, odd edges reuse the last row / column
+  std::vector<uint8_t> downsample(const std::vector<uint8_t> &_image, int _w, int _h, int &_outW, int &_outH)
+  {
+    _outW=std::max(1,_w/2);
+    _outH=std::max(1,_h/2);
+    std::vector<uint8_t> out(static_cast<size_t>(_outW)*_outH*4);
+    for(int y=0; y<_outH; ++y)
+    {
+      int y0=std::min(y*2,_h-1);
+      int y1=std::min(y*2+1,_h-1);
+      for(int x=0; x<_outW; ++x)
+      {
+        int x0=std::min(x*2,_w-1);
+        int x1=std::min(x*2+1,_w-1);
+        for(int c=0; c<4; ++c)
+        {
+          int sum=_image[(static_cast<size_t>(y0)*_w+x0)*4+c]+_image[(static_cast<size_t>(y0)*_w+x1)*4+c]+
+                  _image[(static_cast<size_t>(y1)*_w+x0)*4+c]+_image[(static_cast<size_t>(y1)*_w+x1)*4+c];
+          out[(static_cast<size_t>(y)*_outW+x)*4+c]=static_cast<uint8_t>((sum+2)/4);
+        }
+      }
+    }
+    return out;
+  }
+}
+
+void CompressedTexture::encodeBC1(const uint8_t *_rgba, uint8_t *_block)
+{
+  float p[16][4];
+  for(int i=0; i<16; ++i)
+  {
+    for(int c=0; c<4; ++c)
+    {
+      p[i][c]=_rgba[i*4+c];
+    }
+  }
+  float e0[4],e1[4];
+  axisEndpoints(p,3,e1,e0);
+  // quantize, pick indices then refit the end points to those indices and go again
+  static const float weights[4]={1.0f,0.0f,2.0f/3.0f,1.0f/3.0f};
+  uint16_t c0=0,c1=0;
+  int indices[16];
+  for(int iter=0; iter<2; ++iter)
+  {
+    c0=pack565(e0);
+    c1=pack565(e1);
+    int palette[4][3];
+    palette565(c0,c1,palette);
+    float w[16];
+    for(int i=0; i<16; ++i)
+    {
+      float e;
+      indices[i]=closest(p[i],palette,4,3,e);
+      w[i]=weights[indices[i]];
+    }
+    fitEndpoints(p,3,w,e0,e1);
+  }
+  c0=pack565(e0);
+  c1=pack565(e1);
+  // four colour mode needs c0>c1, swapping the ends swaps index 0<->1 and 2<->3
+  if(c0<c1)
+  {
+    std::swap(c0,c1);
+  }
+  uint32_t bits=0;
+  if(c0!=c1)
+  {
+    int palette[4][3];
+    palette565(c0,c1,palette);
+    for(int i=0; i<16; ++i)
+    {
+      float e;
+      bits|=static_cast<uint32_t>(closest(p[i],palette,4,3,e))<<(i*2);
+    }
+  }
+  // equal ends would be three colour mode where index 3 is black, leave every index at 0
+  _block[0]=static_cast<uint8_t>(c0&0xff);
+  _block[1]=static_cast<uint8_t>(c0>>8);
+  _block[2]=static_cast<uint8_t>(c1&0xff);
+  _block[3]=static_cast<uint8_t>(c1>>8);
+  for(int i=0; i<4; ++i)
+  {
+    _block[4+i]=static_cast<uint8_t>(bits>>(i*8));
+  }
+}
+
+void CompressedTexture::decodeBC1(const uint8_t *_block, uint8_t *_rgba)
+{
+  uint16_t c0=static_cast<uint16_t>(_block[0] | (_block[1]<<8));
+  uint16_t c1=static_cast<uint16_t>(_block[2] | (_block[3]<<8));
+  int palette[4][4];
+  unpack565(c0,palette[0]);
+  unpack565(c1,palette[1]);
+  for(int c=0; c<3; ++c)
+  {
+    if(c0>c1)
+    {
+      palette[2][c]=(2*palette[0][c]+palette[1][c])/3;
+      palette[3][c]=(palette[0][c]+2*palette[1][c])/3;
+    }
+    else
+    {
+      palette[2][c]=(palette[0][c]+palette[1][c])/2;
+      palette[3][c]=0;
+    }
+  }
+  for(int i=0; i<4; ++i)
+  {
+    palette[i][3]= (c0<=c1 && i==3) ? 0 : 255;
+  }
+  uint32_t bits=_block[4] | (_block[5]<<8) | (_block[6]<<16) | (static_cast<uint32_t>(_block[7])<<24);
+  for(int i=0; i<16; ++i)
+  {
+    int index=(bits>>(i*2))&3;
+    for(int c=0; c<4; ++c)
+    {
+      _rgba[i*4+c]=static_cast<uint8_t>(palette[index][c]);
+    }
+  }
+}
+
+void CompressedTexture::encodeBC7(const uint8_t *_rgba, uint8_t *_block)
+{
+  // mode 6, one subset with RGBA 7 bit end points plus a p bit each and 4 bit indices
+  float p[16][4];
+  for(int i=0; i<16; ++i)
+  {
+    for(int c=0; c<4; ++c)
+    {
+      p[i][c]=_rgba[i*4+c];
+    }
+  }
+  float e0[4],e1[4];
+  axisEndpoints(p,4,e0,e1);
+  // one refit against the ideal indices of the unquantized end points
+  {
+    int palette[16][4];
+    for(int k=0; k<16; ++k)
+    {
+      for(int c=0; c<4; ++c)
+      {
+        palette[k][c]=static_cast<int>(((64-c_bc7Weights[k])*e0[c]+c_bc7Weights[k]*e1[c])/64.0f+0.5f);
+      }
+    }
+    float w[16];
+    for(int i=0; i<16; ++i)
+    {
+      float e;
+      w[i]=1.0f-c_bc7Weights[closest(p[i],palette,16,4,e)]/64.0f;
+    }
+    fitEndpoints(p,4,w,e0,e1);
+  }
+
+  // each end point shares one p bit across its channels, try all four combinations
+  int bestEnds[2][4]={};
+  int bestP[2]={0,0};
+  int bestIndices[16]={};
+  float bestError=std::numeric_limits<float>::max();
+  for(int pbits=0; pbits<4; ++pbits)
+  {
+    int pb[2]={pbits&1,pbits>>1};
+    int ends[2][4];
+    int expanded[2][4];
+    for(int c=0; c<4; ++c)
+    {
+      const float *src[2]={e0,e1};
+      for(int e=0; e<2; ++e)
+      {
+        ends[e][c]=std::min(127,std::max(0,static_cast<int>(std::lround((src[e][c]-pb[e])*0.5f))));
+        expanded[e][c]=(ends[e][c]<<1) | pb[e];
+      }
+    }
+    int palette[16][4];
+    for(int k=0; k<16; ++k)
+    {
+      for(int c=0; c<4; ++c)
+      {
+        palette[k][c]=((64-c_bc7Weights[k])*expanded[0][c]+c_bc7Weights[k]*expanded[1][c]+32)>>6;
+      }
+    }
+    int indices[16];
+    float error=0.0f;
+    for(int i=0; i<16; ++i)
+    {
+      float e;
+      indices[i]=closest(p[i],palette,16,4,e);
+      error+=e;
+    }
+    if(error<bestError)
+    {
+      bestError=error;
+      std::memcpy(bestEnds,ends,sizeof(ends));
+      std::memcpy(bestP,pb,sizeof(pb));
+      std::memcpy(bestIndices,indices,sizeof(indices));
+    }
+  }
+  // the first pixel's index is stored with an implied top bit of 0, flip the ends if needed
+  if(bestIndices[0]>=8)
+  {
+    for(int c=0; c<4; ++c)
+    {
+      std::swap(bestEnds[0][c],bestEnds[1][c]);
+    }
+    std::swap(bestP[0],bestP[1]);
+    for(int i=0; i<16; ++i)
+    {
+      bestIndices[i]=15-bestIndices[i];
+    }
+  }
+  std::memset(_block,0,16);
+  BitWriter out;
+  out.m_out=_block;
+  out.write(1<<6,7);
+  for(int c=0; c<4; ++c)
+  {
+    out.write(bestEnds[0][c],7);
+    out.write(bestEnds[1][c],7);
+  }
+  out.write(bestP[0],1);
+  out.write(bestP[1],1);
+  out.write(bestIndices[0],3);
+  for(int i=1; i<16; ++i)
+  {
+    out.write(bestIndices[i],4);
+  }
+}
+
+void CompressedTexture::decodeBC7(const uint8_t *_block, uint8_t *_rgba)
+{
+  BitReader in;
+  in.m_in=_block;
+  if(in.read(7)!=(1<<6))
+  {
+    // not something encodeBC7 wrote, show it as magenta rather than guess
+    for(int i=0; i<16; ++i)
+    {
+      _rgba[i*4]=255; _rgba[i*4+1]=0; _rgba[i*4+2]=255; _rgba[i*4+3]=255;
+    }
+    return;
+  }
+  int ends[2][4];
+  for(int c=0; c<4; ++c)
+  {
+    ends[0][c]=static_cast<int>(in.read(7));
+    ends[1][c]=static_cast<int>(in.read(7));
+  }
+  int p0=static_cast<int>(in.read(1));
+  int p1=static_cast<int>(in.read(1));
+  for(int c=0; c<4; ++c)
+  {
+    ends[0][c]=(ends[0][c]<<1) | p0;
+    ends[1][c]=(ends[1][c]<<1) | p1;
+  }
+  for(int i=0; i<16; ++i)
+  {
+    int w=c_bc7Weights[in.read(i==0 ? 3 : 4)];
+    for(int c=0; c<4; ++c)
+    {
+      _rgba[i*4+c]=static_cast<uint8_t>(((64-w)*ends[0][c]+w*ends[1][c]+32)>>6);
+    }
+  }
+}
+
+CompressedTexture::CompressedTexture(const std::string &_file)
+{
+  struct stat info;
+  if(stat(_file.c_str(),&info)!=0)
+  {
+    std::cerr<<"unable to find texture "<<_file<<"\n";
+    return;
+  }
+  uint64_t sourceKey=(static_cast<uint64_t>(info.st_mtime)<<32) ^ static_cast<uint64_t>(info.st_size);
+  std::string cacheFile=_file+".mips";
+  if(load(cacheFile,sourceKey))
+  {
+    return;
+  }
+  if(!build(_file,sourceKey))
+  {
+    return;
+  }
+  if(!writeAtomically(cacheFile,[this](std::ostream &_out)
+     {
+       return static_cast<bool>(_out.write(&m_data[0],static_cast<std::streamsize>(m_data.size())));
+     }))
+  {
+    std::cerr<<"unable to write texture cache "<<cacheFile<<"\n";
+  }
+}
+
+bool CompressedTexture::load(const std::string &_fname, uint64_t _sourceKey)
+{
+  std::ifstream in(_fname,std::ios::binary | std::ios::ate);
+  if(!in.is_open())
+  {
+    return false;
+  }
+  // the file is the in memory layout so one read is all it takes
+  std::streamsize size=in.tellg();
+  if(size<static_cast<std::streamsize>(sizeof(Header)))
+  {
+    return false;
+  }
+  m_data.resize(static_cast<size_t>(size));
+  in.seekg(0);
+  const Header &h=header();
+  if(!in.read(&m_data[0],size) || std::memcmp(h.m_magic,"AMIP",4)!=0 || h.m_version!=c_mipVersion ||
+     h.m_sourceKey!=_sourceKey || !checkLevels())
+  {
+    m_data.clear();
+    return false;
+  }
+  return true;
+}
+
+bool CompressedTexture::checkLevels() const
+{
+  const Header &h=header();
+  if((h.m_format!=static_cast<uint32_t>(Format::BC1) && h.m_format!=static_cast<uint32_t>(Format::BC7)) ||
+     h.m_width==0 || h.m_height==0 || h.m_numLevels==0 || h.m_numLevels>32 ||
+     m_data.size()<sizeof(Header)+h.m_numLevels*sizeof(Level))
+  {
+    return false;
+  }
+  uint64_t blockBytes= h.m_format==static_cast<uint32_t>(Format::BC1) ? 8 : 16;
+  // the levels follow the table back to back, each half the size of the one before down to 1x1
+  uint64_t offset=sizeof(Header)+h.m_numLevels*sizeof(Level);
+  for(uint32_t l=0; l<h.m_numLevels; ++l)
+  {
+    const Level &lev=level(l);
+    uint32_t w= l==0 ? h.m_width : std::max(1u,level(l-1).m_width/2);
+    uint32_t ht= l==0 ? h.m_height : std::max(1u,level(l-1).m_height/2);
+    uint64_t blocks=static_cast<uint64_t>((w+3)/4)*((ht+3)/4);
+    if(lev.m_width!=w || lev.m_height!=ht || lev.m_offset!=offset || lev.m_size!=blocks*blockBytes ||
+       offset+lev.m_size>m_data.size())
+    {
+      return false;
+    }
+    offset+=lev.m_size;
+  }
+  const Level &last=level(h.m_numLevels-1);
+  return offset==m_data.size() && last.m_width==1 && last.m_height==1;
+}
+
+bool CompressedTexture::build(const std::string &_file, uint64_t _sourceKey)
+{
+  QImage image(QString::fromStdString(_file));
+  if(image.isNull())
+  {
+    std::cerr<<"unable to load texture "<<_file<<"\n";
+    return false;
+  }
+  // GL wants the bottom row first
+  image=image.convertToFormat(QImage::Format_RGBA8888).mirrored(false,true);
+  int w=image.width();
+  int h=image.height();
+  std::vector<uint8_t> pixels(static_cast<size_t>(w)*h*4);
+  for(int y=0; y<h; ++y)
+  {
+    std::memcpy(&pixels[static_cast<size_t>(y)*w*4],image.constScanLine(y),static_cast<size_t>(w)*4);
+  }
+  Format format=image.hasAlphaChannel() ? Format::BC7 : Format::BC1;
+  size_t blockBytes= format==Format::BC1 ? 8 : 16;
+  void (*encode)(const uint8_t *,uint8_t *)= format==Format::BC1 ? encodeBC1 : encodeBC7;
+  void (*decode)(const uint8_t *,uint8_t *)= format==Format::BC1 ? decodeBC1 : decodeBC7;
+
+  uint32_t numLevels=1;
+  for(int s=std::max(w,h); s>1; s/=2)
+  {
+    ++numLevels;
+  }
+  // the sizes are known up front so the header and level table can be laid out first
+  std::vector<Level> levels(numLevels);
+  size_t offset=sizeof(Header)+numLevels*sizeof(Level);
+  for(uint32_t l=0; l<numLevels; ++l)
+  {
+    levels[l].m_width=static_cast<uint32_t>(std::max(1,w>>l));
+    levels[l].m_height=static_cast<uint32_t>(std::max(1,h>>l));
+    levels[l].m_offset=static_cast<uint32_t>(offset);
+    levels[l].m_size=static_cast<uint32_t>(((levels[l].m_width+3)/4)*((levels[l].m_height+3)/4)*blockBytes);
+    offset+=levels[l].m_size;
+  }
+  m_data.assign(offset,0);
+  Header &hdr=*reinterpret_cast<Header *>(&m_data[0]);
+  std::memcpy(hdr.m_magic,"AMIP",4);
+  hdr.m_version=c_mipVersion;
+  hdr.m_sourceKey=_sourceKey;
+  hdr.m_format=static_cast<uint32_t>(format);
+  hdr.m_width=static_cast<uint32_t>(w);
+  hdr.m_height=static_cast<uint32_t>(h);
+  hdr.m_numLevels=numLevels;
+  std::memcpy(&m_data[sizeof(Header)],&levels[0],numLevels*sizeof(Level));
+
+  double squaredError=0.0;
+  int lw=w;
+  int lh=h;
+  for(uint32_t l=0; l<numLevels; ++l)
+  {
+    if(l>0)
+    {
+      pixels=downsample(pixels,lw,lh,lw,lh);
+    }
+    uint8_t *block=reinterpret_cast<uint8_t *>(&m_data[levels[l].m_offset]);
+    int bw=(lw+3)/4;
+    int bh=(lh+3)/4;
+    for(int by=0; by<bh; ++by)
+    {
+      for(int bx=0; bx<bw; ++bx, block+=blockBytes)
+      {
+        uint8_t tile[64];
+        fetchBlock(pixels,lw,lh,bx,by,tile);
+        encode(tile,block);
+        if(l==0)
+        {
+          uint8_t check[64];
+          decode(block,check);
+          for(int i=0; i<64; ++i)
+          {
+            double d=static_cast<double>(tile[i])-check[i];
+            squaredError+=d*d;
+          }
+        }
+      }
+    }
+  }
+  size_t rawBytes=0;
+  for(const auto &l : levels)
+  {
+    rawBytes+=static_cast<size_t>(l.m_width)*l.m_height*4;
+  }
+  double rmse=std::sqrt(squaredError/(static_cast<double>((w+3)/4)*((h+3)/4)*64.0));
+  std::cout<<"compressed "<<_file<<" "<<w<<"x"<<h<<" "<<numLevels<<" levels to "
+           <<(format==Format::BC1 ? "BC1 " : "BC7 ")<<gpuBytes()/1024<<"KB (RGBA8 "<<rawBytes/1024
+           <<"KB) rmse "<<rmse<<"\n";
+  return true;
+}
+
+CompressedTexture::Format CompressedTexture::format() const
+{
+  return static_cast<Format>(header().m_format);
+}
+
+int CompressedTexture::width() const
+{
+  return static_cast<int>(header().m_width);
+}
+
+int CompressedTexture::height() const
+{
+  return static_cast<int>(header().m_height);
+}
+
+size_t CompressedTexture::numLevels() const
+{
+  return header().m_numLevels;
+}
+
+size_t CompressedTexture::gpuBytes() const
+{
+  return m_data.size()-sizeof(Header)-numLevels()*sizeof(Level);
+}
+
+bool CompressedTexture::isFormatSupported(Format _format)
+{
+  GLenum wanted= _format==Format::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+  GLint count=0;
+  glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS,&count);
+  std::vector<GLint> formats(static_cast<size_t>(std::max(count,1)));
+  glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS,&formats[0]);
+  return std::find(formats.begin(),formats.begin()+count,static_cast<GLint>(wanted))!=formats.begin()+count;
+}
+
+GLuint CompressedTexture::createTexture() const
+{
+  GLuint id;
+  glGenTextures(1,&id);
+  glBindTexture(GL_TEXTURE_2D,id);
+  size_t levels=numLevels();
+  bool compressed=isFormatSupported(format());
+  GLenum glFormat= format()==Format::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+  size_t blockBytes= format()==Format::BC1 ? 8 : 16;
+  void (*decode)(const uint8_t *,uint8_t *)= format()==Format::BC1 ? decodeBC1 : decodeBC7;
+  std::vector<uint8_t> pixels;
+  for(size_t l=0; l<levels; ++l)
+  {
+    const Level &lev=level(l);
+    const uint8_t *blocks=reinterpret_cast<const uint8_t *>(&m_data[lev.m_offset]);
+    GLsizei w=static_cast<GLsizei>(lev.m_width);
+    GLsizei h=static_cast<GLsizei>(lev.m_height);
+    if(compressed)
+    {
+      glCompressedTexImage2D(GL_TEXTURE_2D,static_cast<GLint>(l),glFormat,w,h,0,static_cast<GLsizei>(lev.m_size),blocks);
+      Stats::add(Stats::Counter::GL_BYTES_UPLOADED,lev.m_size);
+      continue;
+    }
+    // no driver support, expand the blocks back to RGBA8
+    pixels.resize(static_cast<size_t>(w)*h*4);
+    int bw=(w+3)/4;
+    int bh=(h+3)/4;
+    for(int by=0; by<bh; ++by)
+    {
+      for(int bx=0; bx<bw; ++bx, blocks+=blockBytes)
+      {
+        uint8_t tile[64];
+        decode(blocks,tile);
+        for(int y=0; y<4 && by*4+y<h; ++y)
+        {
+          for(int x=0; x<4 && bx*4+x<w; ++x)
+          {
+            std::memcpy(&pixels[(static_cast<size_t>(by*4+y)*w+bx*4+x)*4],&tile[(y*4+x)*4],4);
+          }
+        }
+      }
+    }
+    glTexImage2D(GL_TEXTURE_2D,static_cast<GLint>(l),GL_RGBA8,w,h,0,GL_RGBA,GL_UNSIGNED_BYTE,&pixels[0]);
+    Stats::add(Stats::Counter::GL_BYTES_UPLOADED,pixels.size());
+  }
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_BASE_LEVEL,0);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,static_cast<GLint>(levels-1));
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_REPEAT);
+  return id;
+}
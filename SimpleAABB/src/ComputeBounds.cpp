@@ -0,0 +1,195 @@
+#include "ComputeBounds.h"
+#include "Stats.h"
+#include <ngl/ShaderLib.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+constexpr size_t ComputeBounds::c_framesInFlight;
+constexpr GLuint ComputeBounds::c_groupSize;
+constexpr GLuint ComputeBounds::c_maxGroups;
+
+namespace
+{
+  const std::string c_program("AABBCompute");
+  // the min / max slots start at the far ends of the ordered range
+  const uint32_t c_resetBounds[6]={0xffffffffu,0xffffffffu,0xffffffffu,0u,0u,0u};
+  // GL_MAX_COMPUTE_WORK_GROUP_COUNT is at least this in every direction
+  constexpr size_t c_maxInstancesPerDispatch=65535;
+
+  // undo the shader's orderedBits
+  ngl::Real fromOrderedBits(uint32_t _u)
+  {
+    uint32_t bits= (_u & 0x80000000u) ? (_u & 0x7fffffffu) : ~_u;
+    ngl::Real f;
+    std::memcpy(&f,&bits,sizeof(f));
+    return f;
+  }
+}
+
+ComputeBounds::~ComputeBounds()
+{
+  for(auto &f : m_frames)
+  {
+    if(f.m_fence)
+    {
+      glDeleteSync(f.m_fence);
+    }
+    if(f.m_matrices)
+    {
+      glDeleteBuffers(1,&f.m_matrices);
+      glDeleteBuffers(1,&f.m_bounds);
+    }
+  }
+}
+
+bool ComputeBounds::isSupported()
+{
+#if defined(__APPLE__)
+  // capped at GL 4.1 so there are no compute shaders
+  return false;
+#else
+  GLint major=0;
+  GLint minor=0;
+  glGetIntegerv(GL_MAJOR_VERSION,&major);
+  glGetIntegerv(GL_MINOR_VERSION,&minor);
+  return major>4 || (major==4 && minor>=3);
+#endif
+}
+
+bool ComputeBounds::init()
+{
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  shader->createShaderProgram(c_program);
+  shader->attachShader("AABBComputeShader",ngl::ShaderType::COMPUTE);
+  shader->loadShaderSource("AABBComputeShader","shaders/AABBCompute.glsl");
+  shader->compileShader("AABBComputeShader");
+  shader->attachShaderToProgram(c_program,"AABBComputeShader");
+  shader->linkProgramObject(c_program);
+  GLint linked=GL_FALSE;
+  glGetProgramiv(shader->getProgramID(c_program),GL_LINK_STATUS,&linked);
+  if(linked!=GL_TRUE)
+  {
+    std::cerr<<"exact bounds compute shader did not build\n";
+    return false;
+  }
+  return true;
+}
+
+void ComputeBounds::add(size_t _id, GLuint _vbo, size_t _numVerts, size_t _stride, const ngl::Mat4 &_world, const ngl::Mat4 *_dequantize)
+{
+  m_pending.push_back({_id,_vbo,_numVerts,_stride,_world,_dequantize ? *_dequantize*_world : _world,_dequantize!=nullptr});
+}
+
+void ComputeBounds::dispatch()
+{
+#if !defined(__APPLE__)
+  Frame &frame=m_frames[m_current];
+  if(m_pending.empty() || frame.m_fence)
+  {
+    m_pending.clear();
+    return;
+  }
+  // instances of the same mesh go in one dispatch
+  std::stable_sort(m_pending.begin(),m_pending.end(),[](const Job &_a, const Job &_b){return _a.m_vbo<_b.m_vbo;});
+  size_t count=m_pending.size();
+  m_matrixData.resize(count*16);
+  m_boundsData.resize(count*6);
+  for(size_t i=0; i<count; ++i)
+  {
+    std::memcpy(&m_matrixData[i*16],&m_pending[i].m_shaderMatrix.m_m[0][0],16*sizeof(ngl::Real));
+    std::memcpy(&m_boundsData[i*6],c_resetBounds,sizeof(c_resetBounds));
+  }
+  if(frame.m_capacity<count)
+  {
+    if(!frame.m_matrices)
+    {
+      glGenBuffers(1,&frame.m_matrices);
+      glGenBuffers(1,&frame.m_bounds);
+    }
+    // grow by half again so a slowly growing scene does not reallocate every frame
+    frame.m_capacity=std::max(count,frame.m_capacity+frame.m_capacity/2);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,frame.m_matrices);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,frame.m_capacity*16*sizeof(ngl::Real),nullptr,GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,frame.m_bounds);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,frame.m_capacity*6*sizeof(uint32_t),nullptr,GL_STREAM_READ);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,frame.m_matrices);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER,0,count*16*sizeof(ngl::Real),&m_matrixData[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,frame.m_bounds);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER,0,count*6*sizeof(uint32_t),&m_boundsData[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,0);
+  Stats::add(Stats::Counter::GL_BYTES_UPLOADED,count*(16*sizeof(ngl::Real)+6*sizeof(uint32_t)));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,1,frame.m_matrices);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,2,frame.m_bounds);
+
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  shader->use(c_program);
+  for(size_t first=0; first<count; )
+  {
+    const Job &job=m_pending[first];
+    size_t end=first+1;
+    while(end<count && end-first<c_maxInstancesPerDispatch && m_pending[end].m_vbo==job.m_vbo)
+    {
+      ++end;
+    }
+    GLuint groups=std::min<GLuint>(c_maxGroups,static_cast<GLuint>((job.m_numVerts+c_groupSize-1)/c_groupSize));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,0,job.m_vbo);
+    shader->setUniform("numVerts",static_cast<int>(job.m_numVerts));
+    shader->setUniform("vertexStride",static_cast<int>(job.m_stride));
+    shader->setUniform("quantized",job.m_quantized ? 1 : 0);
+    shader->setUniform("firstInstance",static_cast<int>(first));
+    glDispatchCompute(std::max<GLuint>(groups,1),static_cast<GLuint>(end-first),1);
+    first=end;
+  }
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,0,0);
+  // the results are read with glGetBufferSubData once the fence says they are done
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  frame.m_fence=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+  frame.m_jobs.swap(m_pending);
+  m_pending.clear();
+  m_current=(m_current+1)%c_framesInFlight;
+#else
+  m_pending.clear();
+#endif
+}
+
+void ComputeBounds::collect(std::vector<Result> &_results)
+{
+#if !defined(__APPLE__)
+  // oldest first so a newer result for the same id comes later in _results
+  for(size_t n=0; n<c_framesInFlight; ++n)
+  {
+    Frame &frame=m_frames[(m_current+n)%c_framesInFlight];
+    if(!frame.m_fence)
+    {
+      continue;
+    }
+    GLenum status=glClientWaitSync(frame.m_fence,GL_SYNC_FLUSH_COMMANDS_BIT,0);
+    if(status!=GL_ALREADY_SIGNALED && status!=GL_CONDITION_SATISFIED)
+    {
+      // later frames can not have finished either
+      break;
+    }
+    glDeleteSync(frame.m_fence);
+    frame.m_fence=nullptr;
+    size_t count=frame.m_jobs.size();
+    m_boundsData.resize(count*6);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,frame.m_bounds);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER,0,count*6*sizeof(uint32_t),&m_boundsData[0]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,0);
+    for(size_t i=0; i<count; ++i)
+    {
+      const uint32_t *b=&m_boundsData[i*6];
+      AABB box(ngl::Vec3(fromOrderedBits(b[0]),fromOrderedBits(b[1]),fromOrderedBits(b[2])),
+               ngl::Vec3(fromOrderedBits(b[3]),fromOrderedBits(b[4]),fromOrderedBits(b[5])));
+      // a mesh with no vertices never leaves the reset values, which decode to NaN
+      if(box.m_min.m_x<=box.m_max.m_x)
+      {
+        _results.push_back({frame.m_jobs[i].m_id,frame.m_jobs[i].m_world,box});
+      }
+    }
+    frame.m_jobs.clear();
+  }
+#endif
+}
@@ -0,0 +1,627 @@
+#include "ConvexHull.h"
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <unordered_map>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CONVEXHULL_SSE
+#endif
+
+constexpr double ConvexHull::c_relativeTolerance;
+
+namespace
+{
+  // the hull is built in double so the orientation tests are exact enough for float input
+  struct Point
+  {
+    double m_x,m_y,m_z;
+  };
+  Point sub(const Point &_a, const Point &_b) {return {_a.m_x-_b.m_x,_a.m_y-_b.m_y,_a.m_z-_b.m_z};}
+  double dot(const Point &_a, const Point &_b) {return _a.m_x*_b.m_x+_a.m_y*_b.m_y+_a.m_z*_b.m_z;}
+  Point cross(const Point &_a, const Point &_b)
+  {
+    return {_a.m_y*_b.m_z-_a.m_z*_b.m_y,_a.m_z*_b.m_x-_a.m_x*_b.m_z,_a.m_x*_b.m_y-_a.m_y*_b.m_x};
+  }
+
+  struct Face
+  {
+    uint32_t m_v[3];
+    // unit outward normal and n.p of the plane
+    Point m_normal;
+    double m_offset;
+    // points above this face and no face made before it
+    std::vector<uint32_t> m_outside;
+    bool m_alive=true;
+    // last eye point that could see this face
+    uint32_t m_visibleFrom=0xffffffffu;
+    double distance(const Point &_p) const {return dot(m_normal,_p)-m_offset;}
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief incremental quickhull. Faces are oriented against a point inside the first
+  /// tetrahedron rather than by winding so a nearly flat face can not end up inside out.
+  //----------------------------------------------------------------------------------------------------------------------
+  class QuickHull
+  {
+    public :
+      QuickHull(const std::vector<Point> &_points, double _eps) : m_p(_points), m_eps(_eps) {}
+      // false if the points do not span a volume
+      bool build();
+      // indices of the points on the hull
+      std::vector<uint32_t> vertices() const;
+      // three point indices per hull face
+      std::vector<uint32_t> triangles() const;
+
+    private :
+      void addFace(uint32_t _a, uint32_t _b, uint32_t _c);
+      // give _point to the first of the faces from _first on it is outside of
+      void assign(uint32_t _point, size_t _first);
+      static uint64_t edgeKey(uint64_t _a, uint64_t _b) {return (_a<<32)|_b;}
+      const std::vector<Point> &m_p;
+      double m_eps;
+      Point m_inside;
+      std::vector<Face> m_faces;
+      // the live face on the left of each directed edge, the neighbour across a->b is the
+      // owner of b->a
+      std::unordered_map<uint64_t,uint32_t> m_edges;
+      // faces that may still have outside points
+      std::vector<uint32_t> m_pending;
+  };
+
+  void QuickHull::addFace(uint32_t _a, uint32_t _b, uint32_t _c)
+  {
+    Face f;
+    Point n=cross(sub(m_p[_b],m_p[_a]),sub(m_p[_c],m_p[_a]));
+    double len=std::sqrt(dot(n,n));
+    if(len>0.0)
+    {
+      n={n.m_x/len,n.m_y/len,n.m_z/len};
+    }
+    if(dot(n,sub(m_inside,m_p[_a]))>0.0)
+    {
+      std::swap(_b,_c);
+      n={-n.m_x,-n.m_y,-n.m_z};
+    }
+    f.m_v[0]=_a; f.m_v[1]=_b; f.m_v[2]=_c;
+    f.m_normal=n;
+    f.m_offset=dot(n,m_p[_a]);
+    for(int e=0; e<3; ++e)
+    {
+      m_edges[edgeKey(f.m_v[e],f.m_v[(e+1)%3])]=static_cast<uint32_t>(m_faces.size());
+    }
+    m_faces.push_back(std::move(f));
+  }
+
+  void QuickHull::assign(uint32_t _point, size_t _first)
+  {
+    for(size_t f=_first; f<m_faces.size(); ++f)
+    {
+      if(m_faces[f].distance(m_p[_point])>m_eps)
+      {
+        m_faces[f].m_outside.push_back(_point);
+        return;
+      }
+    }
+    // inside (or within eps of) every face, it can not be a hull vertex
+  }
+
+  bool QuickHull::build()
+  {
+    // the two furthest apart of the six axis extremes
+    uint32_t extreme[6]={0,0,0,0,0,0};
+    for(uint32_t i=1; i<m_p.size(); ++i)
+    {
+      const Point &p=m_p[i];
+      if(p.m_x<m_p[extreme[0]].m_x) extreme[0]=i;
+      if(p.m_x>m_p[extreme[1]].m_x) extreme[1]=i;
+      if(p.m_y<m_p[extreme[2]].m_y) extreme[2]=i;
+      if(p.m_y>m_p[extreme[3]].m_y) extreme[3]=i;
+      if(p.m_z<m_p[extreme[4]].m_z) extreme[4]=i;
+      if(p.m_z>m_p[extreme[5]].m_z) extreme[5]=i;
+    }
+    uint32_t v[4]={0,0,0,0};
+    double best=-1.0;
+    for(int a=0; a<6; ++a)
+    {
+      for(int b=a+1; b<6; ++b)
+      {
+        Point d=sub(m_p[extreme[a]],m_p[extreme[b]]);
+        if(dot(d,d)>best)
+        {
+          best=dot(d,d);
+          v[0]=extreme[a];
+          v[1]=extreme[b];
+        }
+      }
+    }
+    if(std::sqrt(best)<=m_eps)
+    {
+      return false;
+    }
+    // then the point furthest from that line and the point furthest from that plane
+    Point axis=sub(m_p[v[1]],m_p[v[0]]);
+    best=0.0;
+    for(uint32_t i=0; i<m_p.size(); ++i)
+    {
+      Point c=cross(axis,sub(m_p[i],m_p[v[0]]));
+      if(dot(c,c)>best)
+      {
+        best=dot(c,c);
+        v[2]=i;
+      }
+    }
+    if(std::sqrt(best/dot(axis,axis))<=m_eps)
+    {
+      return false;
+    }
+    Point normal=cross(axis,sub(m_p[v[2]],m_p[v[0]]));
+    double len=std::sqrt(dot(normal,normal));
+    best=0.0;
+    for(uint32_t i=0; i<m_p.size(); ++i)
+    {
+      double d=std::abs(dot(normal,sub(m_p[i],m_p[v[0]])))/len;
+      if(d>best)
+      {
+        best=d;
+        v[3]=i;
+      }
+    }
+    if(best<=m_eps)
+    {
+      return false;
+    }
+    m_inside={0.0,0.0,0.0};
+    for(uint32_t i : v)
+    {
+      m_inside={m_inside.m_x+0.25*m_p[i].m_x,m_inside.m_y+0.25*m_p[i].m_y,m_inside.m_z+0.25*m_p[i].m_z};
+    }
+    addFace(v[0],v[1],v[2]);
+    addFace(v[0],v[1],v[3]);
+    addFace(v[0],v[2],v[3]);
+    addFace(v[1],v[2],v[3]);
+    for(uint32_t i=0; i<m_p.size(); ++i)
+    {
+      if(i!=v[0] && i!=v[1] && i!=v[2] && i!=v[3])
+      {
+        assign(i,0);
+      }
+    }
+    m_pending={0,1,2,3};
+
+    std::vector<uint32_t> visible;
+    std::vector<uint64_t> horizon;
+    std::vector<uint32_t> orphans;
+    while(!m_pending.empty())
+    {
+      uint32_t current=m_pending.back();
+      if(!m_faces[current].m_alive || m_faces[current].m_outside.empty())
+      {
+        m_pending.pop_back();
+        continue;
+      }
+      // the furthest outside point of the face is certainly a hull vertex
+      const Face &face=m_faces[current];
+      uint32_t eye=face.m_outside[0];
+      double eyeDistance=face.distance(m_p[eye]);
+      for(uint32_t p : face.m_outside)
+      {
+        double d=face.distance(m_p[p]);
+        if(d>eyeDistance)
+        {
+          eye=p;
+          eyeDistance=d;
+        }
+      }
+      // flood out from the face to everything the eye can see, the edges from there to
+      // faces it can not see form the horizon loop which is joined up to the eye point
+      visible.assign(1,current);
+      m_faces[current].m_visibleFrom=eye;
+      horizon.clear();
+      for(size_t n=0; n<visible.size(); ++n)
+      {
+        const uint32_t *fv=m_faces[visible[n]].m_v;
+        for(int e=0; e<3; ++e)
+        {
+          auto across=m_edges.find(edgeKey(fv[(e+1)%3],fv[e]));
+          if(across==m_edges.end())
+          {
+            // only possible if rounding has broken the mesh, close the hole from the eye
+            horizon.push_back(edgeKey(fv[e],fv[(e+1)%3]));
+            continue;
+          }
+          Face &neighbour=m_faces[across->second];
+          if(neighbour.m_visibleFrom==eye)
+          {
+            continue;
+          }
+          if(neighbour.distance(m_p[eye])>0.0)
+          {
+            neighbour.m_visibleFrom=eye;
+            visible.push_back(across->second);
+          }
+          else
+          {
+            horizon.push_back(edgeKey(fv[e],fv[(e+1)%3]));
+          }
+        }
+      }
+      orphans.clear();
+      for(uint32_t f : visible)
+      {
+        Face &dead=m_faces[f];
+        for(int e=0; e<3; ++e)
+        {
+          auto edge=m_edges.find(edgeKey(dead.m_v[e],dead.m_v[(e+1)%3]));
+          if(edge!=m_edges.end() && edge->second==f)
+          {
+            m_edges.erase(edge);
+          }
+        }
+        dead.m_alive=false;
+        orphans.insert(orphans.end(),dead.m_outside.begin(),dead.m_outside.end());
+        std::vector<uint32_t>().swap(dead.m_outside);
+      }
+      size_t firstNew=m_faces.size();
+      for(uint64_t e : horizon)
+      {
+        addFace(static_cast<uint32_t>(e>>32),static_cast<uint32_t>(e&0xffffffffu),eye);
+      }
+      for(uint32_t p : orphans)
+      {
+        if(p!=eye)
+        {
+          assign(p,firstNew);
+        }
+      }
+      for(size_t f=firstNew; f<m_faces.size(); ++f)
+      {
+        if(!m_faces[f].m_outside.empty())
+        {
+          m_pending.push_back(static_cast<uint32_t>(f));
+        }
+      }
+    }
+    return true;
+  }
+
+  std::vector<uint32_t> QuickHull::vertices() const
+  {
+    std::vector<uint32_t> result;
+    for(const Face &f : m_faces)
+    {
+      if(f.m_alive)
+      {
+        result.insert(result.end(),f.m_v,f.m_v+3);
+      }
+    }
+    std::sort(result.begin(),result.end());
+    result.erase(std::unique(result.begin(),result.end()),result.end());
+    return result;
+  }
+
+  std::vector<uint32_t> QuickHull::triangles() const
+  {
+    std::vector<uint32_t> result;
+    for(const Face &f : m_faces)
+    {
+      if(f.m_alive)
+      {
+        result.insert(result.end(),f.m_v,f.m_v+3);
+      }
+    }
+    return result;
+  }
+
+  // bytes from the read position to the end of _in
+  size_t bytesLeft(std::istream &_in)
+  {
+    std::streampos here=_in.tellg();
+    _in.seekg(0,std::ios::end);
+    std::streampos end=_in.tellg();
+    _in.seekg(here);
+    return here<0 || end<here ? 0 : static_cast<size_t>(end-here);
+  }
+}
+
+void ConvexHull::build(const ngl::Real *_points, size_t _stride, size_t _count)
+{
+  // mesh vertices repeat positions along uv / normal seams, a hull with two copies of a
+  // point would have zero area faces so only the first copy is kept
+  std::vector<uint32_t> order(_count);
+  for(size_t i=0; i<_count; ++i)
+  {
+    order[i]=static_cast<uint32_t>(i);
+  }
+  auto position=[_points,_stride](uint32_t _i){return _points+_i*_stride;};
+  std::sort(order.begin(),order.end(),[&position](uint32_t _a, uint32_t _b)
+  {
+    return std::lexicographical_compare(position(_a),position(_a)+3,position(_b),position(_b)+3);
+  });
+  order.erase(std::unique(order.begin(),order.end(),[&position](uint32_t _a, uint32_t _b)
+  {
+    return std::equal(position(_a),position(_a)+3,position(_b));
+  }),order.end());
+  std::vector<Point> points(order.size());
+  double scale=0.0;
+  for(size_t i=0; i<order.size(); ++i)
+  {
+    const ngl::Real *p=position(order[i]);
+    points[i]={p[0],p[1],p[2]};
+    scale=std::max(scale,std::abs(points[i].m_x)+std::abs(points[i].m_y)+std::abs(points[i].m_z));
+  }
+  double eps=scale*c_relativeTolerance;
+  std::vector<ngl::Vec3> hull;
+  std::vector<uint32_t> triangles;
+  QuickHull quickHull(points,eps);
+  if(points.size()>=4 && quickHull.build())
+  {
+    std::vector<uint32_t> vertices=quickHull.vertices();
+    for(uint32_t i : vertices)
+    {
+      hull.emplace_back(points[i].m_x,points[i].m_y,points[i].m_z);
+    }
+    // renumber the faces to index the hull points
+    triangles=quickHull.triangles();
+    for(auto &v : triangles)
+    {
+      v=static_cast<uint32_t>(std::lower_bound(vertices.begin(),vertices.end(),v)-vertices.begin());
+    }
+    m_tolerance=static_cast<ngl::Real>(eps);
+  }
+  else
+  {
+    for(const auto &p : points)
+    {
+      hull.emplace_back(p.m_x,p.m_y,p.m_z);
+    }
+    m_tolerance=0.0f;
+  }
+  setPoints(hull);
+  setAdjacency(triangles);
+}
+
+void ConvexHull::setAdjacency(const std::vector<uint32_t> &_triangles)
+{
+  // both directions of every face edge, sorted by vertex then packed as one list per vertex
+  std::vector<uint64_t> edges;
+  edges.reserve(_triangles.size()*2);
+  for(size_t t=0; t<_triangles.size(); t+=3)
+  {
+    for(int e=0; e<3; ++e)
+    {
+      uint64_t a=_triangles[t+e];
+      uint64_t b=_triangles[t+(e+1)%3];
+      edges.push_back((a<<32)|b);
+      edges.push_back((b<<32)|a);
+    }
+  }
+  std::sort(edges.begin(),edges.end());
+  edges.erase(std::unique(edges.begin(),edges.end()),edges.end());
+  m_adjacency.resize(edges.size());
+  m_adjacencyStart.assign(_triangles.empty() ? 0 : m_numPoints+1,0);
+  for(size_t i=0; i<edges.size(); ++i)
+  {
+    m_adjacency[i]=static_cast<uint32_t>(edges[i]&0xffffffffu);
+    ++m_adjacencyStart[(edges[i]>>32)+1];
+  }
+  for(size_t v=1; v<m_adjacencyStart.size(); ++v)
+  {
+    m_adjacencyStart[v]+=m_adjacencyStart[v-1];
+  }
+}
+
+uint32_t ConvexHull::support(const ngl::Vec3 &_dir, uint32_t _start) const
+{
+  if(m_numPoints==0)
+  {
+    return 0;
+  }
+  const ngl::Real *xs=&m_coords[0];
+  const ngl::Real *ys=xs+m_padded;
+  const ngl::Real *zs=ys+m_padded;
+  auto extent=[&](uint32_t _v){return xs[_v]*_dir.m_x+ys[_v]*_dir.m_y+zs[_v]*_dir.m_z;};
+  uint32_t current= _start<m_numPoints ? _start : 0;
+  ngl::Real best=extent(current);
+  if(m_adjacencyStart.empty())
+  {
+    // no faces to walk (flat input) so look at everything
+    for(uint32_t v=0; v<m_numPoints; ++v)
+    {
+      ngl::Real e=extent(v);
+      if(e>best)
+      {
+        best=e;
+        current=v;
+      }
+    }
+    return current;
+  }
+  // a vertex of a convex polytope with no neighbour further along is the furthest of all
+  for(;;)
+  {
+    uint32_t next=current;
+    for(uint32_t k=m_adjacencyStart[current]; k<m_adjacencyStart[current+1]; ++k)
+    {
+      ngl::Real e=extent(m_adjacency[k]);
+      if(e>best)
+      {
+        best=e;
+        next=m_adjacency[k];
+      }
+    }
+    if(next==current)
+    {
+      return current;
+    }
+    current=next;
+  }
+}
+
+AABB ConvexHull::bounds(const ngl::Mat4 &_tx, uint32_t *_extremes) const
+{
+  AABB box;
+  if(m_numPoints==0)
+  {
+    return box;
+  }
+  for(int j=0; j<3; ++j)
+  {
+    // world axis j picks up column j of the matrix
+    ngl::Vec3 axis(_tx.m_m[0][j],_tx.m_m[1][j],_tx.m_m[2][j]);
+    _extremes[j]=support(-axis,_extremes[j]);
+    _extremes[j+3]=support(axis,_extremes[j+3]);
+    box.m_min[j]=point(_extremes[j]).dot(axis);
+    box.m_max[j]=point(_extremes[j+3]).dot(axis);
+  }
+  pad(_tx,box);
+  return box;
+}
+
+void ConvexHull::setPoints(const std::vector<ngl::Vec3> &_points)
+{
+  m_numPoints=_points.size();
+  m_padded=(m_numPoints+7)&~size_t(7);
+  m_coords.resize(m_padded*3);
+  for(size_t i=0; i<m_padded; ++i)
+  {
+    const ngl::Vec3 &p=_points[std::min(i,m_numPoints-1)];
+    m_coords[i]=p.m_x;
+    m_coords[m_padded+i]=p.m_y;
+    m_coords[2*m_padded+i]=p.m_z;
+  }
+}
+
+AABB ConvexHull::bounds(const ngl::Mat4 &_tx) const
+{
+  AABB box;
+  if(m_numPoints==0)
+  {
+    return box;
+  }
+  const ngl::Real *xs=&m_coords[0];
+  const ngl::Real *ys=xs+m_padded;
+  const ngl::Real *zs=ys+m_padded;
+  // only the linear part per point, the translation is added once at the end
+#if defined(CONVEXHULL_SSE)
+  // one pass per output axis keeps everything in registers, two sets of min / max so the
+  // loop is not held up waiting on the previous compare
+  for(int j=0; j<3; ++j)
+  {
+    __m128 mx=_mm_set1_ps(_tx.m_m[0][j]);
+    __m128 my=_mm_set1_ps(_tx.m_m[1][j]);
+    __m128 mz=_mm_set1_ps(_tx.m_m[2][j]);
+    __m128 lo0=_mm_set1_ps(std::numeric_limits<ngl::Real>::max());
+    __m128 hi0=_mm_set1_ps(-std::numeric_limits<ngl::Real>::max());
+    __m128 lo1=lo0;
+    __m128 hi1=hi0;
+    for(size_t i=0; i<m_padded; i+=8)
+    {
+      __m128 w0=_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs+i),mx),_mm_mul_ps(_mm_loadu_ps(ys+i),my)),_mm_mul_ps(_mm_loadu_ps(zs+i),mz));
+      __m128 w1=_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs+i+4),mx),_mm_mul_ps(_mm_loadu_ps(ys+i+4),my)),_mm_mul_ps(_mm_loadu_ps(zs+i+4),mz));
+      lo0=_mm_min_ps(lo0,w0);
+      hi0=_mm_max_ps(hi0,w0);
+      lo1=_mm_min_ps(lo1,w1);
+      hi1=_mm_max_ps(hi1,w1);
+    }
+    __m128 lo=_mm_min_ps(lo0,lo1);
+    __m128 hi=_mm_max_ps(hi0,hi1);
+    alignas(16) float l[4];
+    alignas(16) float h[4];
+    _mm_store_ps(l,lo);
+    _mm_store_ps(h,hi);
+    box.m_min[j]=std::min(std::min(l[0],l[1]),std::min(l[2],l[3]));
+    box.m_max[j]=std::max(std::max(h[0],h[1]),std::max(h[2],h[3]));
+  }
+#else
+  for(size_t i=0; i<m_numPoints; ++i)
+  {
+    for(int j=0; j<3; ++j)
+    {
+      ngl::Real w=xs[i]*_tx.m_m[0][j]+ys[i]*_tx.m_m[1][j]+zs[i]*_tx.m_m[2][j];
+      box.m_min[j]=std::min(box.m_min[j],w);
+      box.m_max[j]=std::max(box.m_max[j],w);
+    }
+  }
+#endif
+  pad(_tx,box);
+  return box;
+}
+
+void ConvexHull::pad(const ngl::Mat4 &_tx, AABB &_box) const
+{
+  for(int j=0; j<3; ++j)
+  {
+    // a dropped point is at most m_tolerance from the hull, which moves this far along j
+    ngl::Real pad=m_tolerance*(std::abs(_tx.m_m[0][j])+std::abs(_tx.m_m[1][j])+std::abs(_tx.m_m[2][j]));
+    _box.m_min[j]+=_tx.m_m[3][j]-pad;
+    _box.m_max[j]+=_tx.m_m[3][j]+pad;
+  }
+}
+
+bool ConvexHull::write(std::ostream &_out) const
+{
+  uint32_t count=static_cast<uint32_t>(m_numPoints);
+  _out.write(reinterpret_cast<const char *>(&count),sizeof(count));
+  _out.write(reinterpret_cast<const char *>(&m_tolerance),sizeof(m_tolerance));
+  for(size_t i=0; i<m_numPoints; ++i)
+  {
+    ngl::Vec3 p=point(i);
+    _out.write(reinterpret_cast<const char *>(&p.m_x),3*sizeof(ngl::Real));
+  }
+  uint32_t starts=static_cast<uint32_t>(m_adjacencyStart.size());
+  uint32_t links=static_cast<uint32_t>(m_adjacency.size());
+  _out.write(reinterpret_cast<const char *>(&starts),sizeof(starts));
+  _out.write(reinterpret_cast<const char *>(&links),sizeof(links));
+  _out.write(reinterpret_cast<const char *>(m_adjacencyStart.data()),starts*sizeof(uint32_t));
+  _out.write(reinterpret_cast<const char *>(m_adjacency.data()),links*sizeof(uint32_t));
+  return static_cast<bool>(_out);
+}
+
+bool ConvexHull::read(std::istream &_in)
+{
+  uint32_t count=0;
+  ngl::Real tolerance=0.0f;
+  _in.read(reinterpret_cast<char *>(&count),sizeof(count));
+  _in.read(reinterpret_cast<char *>(&tolerance),sizeof(tolerance));
+  if(!_in || count>bytesLeft(_in)/(3*sizeof(ngl::Real)))
+  {
+    return false;
+  }
+  std::vector<ngl::Vec3> points(count);
+  for(auto &p : points)
+  {
+    _in.read(reinterpret_cast<char *>(&p.m_x),3*sizeof(ngl::Real));
+  }
+  uint32_t starts=0;
+  uint32_t links=0;
+  _in.read(reinterpret_cast<char *>(&starts),sizeof(starts));
+  _in.read(reinterpret_cast<char *>(&links),sizeof(links));
+  if(!_in || (starts!=0 && starts!=count+1) || static_cast<uint64_t>(starts)+links>bytesLeft(_in)/sizeof(uint32_t))
+  {
+    return false;
+  }
+  std::vector<uint32_t> adjacencyStart(starts);
+  std::vector<uint32_t> adjacency(links);
+  _in.read(reinterpret_cast<char *>(adjacencyStart.data()),starts*sizeof(uint32_t));
+  _in.read(reinterpret_cast<char *>(adjacency.data()),links*sizeof(uint32_t));
+  if(!_in)
+  {
+    return false;
+  }
+  // support() walks these straight into the points, so every list has to lie inside the
+  // links and every neighbour has to be a point
+  if(starts && (adjacencyStart.front()!=0 || adjacencyStart.back()!=links ||
+                !std::is_sorted(adjacencyStart.begin(),adjacencyStart.end()) ||
+                std::any_of(adjacency.begin(),adjacency.end(),[count](uint32_t _n){return _n>=count;})))
+  {
+    return false;
+  }
+  m_tolerance=tolerance;
+  m_adjacencyStart.swap(adjacencyStart);
+  m_adjacency.swap(adjacency);
+  setPoints(points);
+  return true;
+}
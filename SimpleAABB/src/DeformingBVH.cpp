@@ -0,0 +1,92 @@
+#include "DeformingBVH.h"
+
+constexpr double DeformingBVH::c_rebuildRatio;
+
+namespace
+{
+  constexpr size_t c_grain=4096;
+}
+
+DeformingBVH::DeformingBVH(WorkerPool *_pool) :
+  m_pool(_pool ? _pool : &WorkerPool::shared()),
+  m_backgroundPool(1),
+  m_ready(nullptr)
+{
+  m_tree.reset(new LinearBVH(m_pool));
+  m_rebuilder.reset(new AsyncLoader(1));
+}
+
+DeformingBVH::~DeformingBVH()
+{
+  m_rebuilder.reset();
+  delete m_ready.load();
+}
+
+void DeformingBVH::computeBoxes(const ngl::Real *_positions)
+{
+  size_t numTriangles=m_indices.size()/3;
+  m_boxes.resize(numTriangles);
+  m_pool->parallelFor(numTriangles,c_grain,[this,_positions](size_t _begin, size_t _end)
+  {
+    for(size_t t=_begin; t<_end; ++t)
+    {
+      AABB box;
+      for(size_t k=0; k<3; ++k)
+      {
+        const ngl::Real *p=_positions+m_indices[3*t+k]*m_stride;
+        box.extend(ngl::Vec3(p[0],p[1],p[2]));
+      }
+      m_boxes[t]=box;
+    }
+  });
+}
+
+void DeformingBVH::build(const ngl::Real *_positions, size_t _stride, const uint32_t *_indices, size_t _numTriangles)
+{
+  // a build still running belongs to the old mesh
+  m_rebuilder.reset(new AsyncLoader(1));
+  delete m_ready.exchange(nullptr);
+  m_rebuilding=false;
+  m_stride=_stride;
+  m_indices.assign(_indices,_indices+3*_numTriangles);
+  computeBoxes(_positions);
+  m_tree->build(m_boxes.data(),m_boxes.size());
+  m_cost=m_tree->sahCost();
+  m_builtCost=m_cost;
+}
+
+void DeformingBVH::update(const ngl::Real *_positions)
+{
+  computeBoxes(_positions);
+  std::unique_ptr<LinearBVH> ready(m_ready.exchange(nullptr));
+  if(ready)
+  {
+    // built from boxes a few updates old, so refit before use like any other tree
+    ready->setPool(m_pool);
+    m_tree.swap(ready);
+    m_rebuilding=false;
+    ++m_rebuilds;
+    m_tree->refit(m_boxes.data());
+    m_cost=m_tree->sahCost();
+    m_builtCost=m_cost;
+    return;
+  }
+  m_tree->refit(m_boxes.data());
+  m_cost=m_tree->sahCost();
+  if(!m_rebuilding && m_cost>c_rebuildRatio*m_builtCost)
+  {
+    startRebuild();
+  }
+}
+
+void DeformingBVH::startRebuild()
+{
+  m_rebuilding=true;
+  m_snapshot=m_boxes;
+  m_rebuilder->submit([this]()
+  {
+    std::unique_ptr<LinearBVH> tree(new LinearBVH(&m_backgroundPool));
+    tree->build(m_snapshot.data(),m_snapshot.size());
+    m_ready.store(tree.release());
+  });
+}
@@ -0,0 +1,301 @@
+#include "EventRecording.h"
+#include "NGLScene.h"
+#include "Stats.h"
+#include <QCoreApplication>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QResizeEvent>
+#include <QWheelEvent>
+#include <QWindow>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+  const char *c_typeNames[]={"key","press","release","move","wheel","resize"};
+
+  // the render target in device pixels for a window of _width x _height
+  std::unique_ptr<QOpenGLFramebufferObject> makeTarget(int _width, int _height, qreal _ratio, const QSurfaceFormat &_format)
+  {
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::Depth);
+    format.setSamples(_format.samples());
+    return std::unique_ptr<QOpenGLFramebufferObject>(new QOpenGLFramebufferObject(static_cast<int>(_width*_ratio),
+                                                                                  static_cast<int>(_height*_ratio),format));
+  }
+}
+
+EventRecorder::EventRecorder(const std::string &_file, QWindow *_window) : m_out(_file)
+{
+  m_start=std::chrono::steady_clock::now();
+  if(!m_out.is_open())
+  {
+    std::cerr<<"unable to write recording "<<_file<<"\n";
+    return;
+  }
+  m_out<<"# SimpleAABB event recording\n";
+  m_out<<"size "<<_window->width()<<" "<<_window->height()<<"\n";
+  _window->installEventFilter(this);
+}
+
+EventRecorder::~EventRecorder()
+{
+  if(m_out.is_open())
+  {
+    m_out<<"end "<<m_tick<<"\n";
+  }
+}
+
+void EventRecorder::write(const char *_type, const std::vector<int> &_values)
+{
+  typedef std::chrono::duration<double,std::milli> ms;
+  m_out<<_type<<" "<<m_tick<<" "<<std::chrono::duration_cast<ms>(std::chrono::steady_clock::now()-m_start).count();
+  for(int v : _values)
+  {
+    m_out<<" "<<v;
+  }
+  m_out<<"\n";
+}
+
+bool EventRecorder::eventFilter(QObject *, QEvent *_event)
+{
+  if(!m_out.is_open())
+  {
+    return false;
+  }
+  switch(_event->type())
+  {
+    // the window only runs the one animation timer so every timer event is a tick
+    case QEvent::Timer : ++m_tick; break;
+    case QEvent::KeyPress :
+    {
+      QKeyEvent *e=static_cast<QKeyEvent *>(_event);
+      write("key",{e->key(),static_cast<int>(e->modifiers())});
+      break;
+    }
+    case QEvent::MouseButtonPress :
+    case QEvent::MouseButtonRelease :
+    case QEvent::MouseMove :
+    {
+      QMouseEvent *e=static_cast<QMouseEvent *>(_event);
+      const char *type= _event->type()==QEvent::MouseButtonPress ? "press" :
+                        _event->type()==QEvent::MouseButtonRelease ? "release" : "move";
+      write(type,{e->x(),e->y(),static_cast<int>(e->button()),static_cast<int>(e->buttons()),static_cast<int>(e->modifiers())});
+      break;
+    }
+    case QEvent::Wheel :
+    {
+      QWheelEvent *e=static_cast<QWheelEvent *>(_event);
+      write("wheel",{e->x(),e->y(),e->delta(),static_cast<int>(e->buttons()),static_cast<int>(e->modifiers())});
+      break;
+    }
+    case QEvent::Resize :
+    {
+      QResizeEvent *e=static_cast<QResizeEvent *>(_event);
+      write("resize",{e->size().width(),e->size().height()});
+      break;
+    }
+    default : break;
+  }
+  // only watching, the window still gets everything
+  return false;
+}
+
+bool EventPlayer::load(const std::string &_file)
+{
+  std::ifstream in(_file);
+  if(!in.is_open())
+  {
+    std::cerr<<"unable to open recording "<<_file<<"\n";
+    return false;
+  }
+  m_events.clear();
+  m_ticks=0;
+  std::string line;
+  size_t lineNumber=0;
+  while(std::getline(in,line))
+  {
+    ++lineNumber;
+    std::istringstream tokens(line);
+    std::string type;
+    if(!(tokens>>type) || type[0]=='#')
+    {
+      continue;
+    }
+    if(type=="size")
+    {
+      tokens>>m_width>>m_height;
+      continue;
+    }
+    if(type=="end")
+    {
+      tokens>>m_ticks;
+      continue;
+    }
+    auto name=std::find_if(std::begin(c_typeNames),std::end(c_typeNames),[&type](const char *_n){return type==_n;});
+    if(name==std::end(c_typeNames))
+    {
+      std::cerr<<_file<<":"<<lineNumber<<" unknown event "<<type<<"\n";
+      continue;
+    }
+    RecordedEvent e;
+    e.m_type=static_cast<RecordedEvent::Type>(name-std::begin(c_typeNames));
+    tokens>>e.m_tick>>e.m_ms;
+    switch(e.m_type)
+    {
+      case RecordedEvent::Type::KEY : tokens>>e.m_code>>e.m_modifiers; break;
+      case RecordedEvent::Type::WHEEL : tokens>>e.m_x>>e.m_y>>e.m_code>>e.m_buttons>>e.m_modifiers; break;
+      case RecordedEvent::Type::RESIZE : tokens>>e.m_x>>e.m_y; break;
+      default : tokens>>e.m_x>>e.m_y>>e.m_code>>e.m_buttons>>e.m_modifiers; break;
+    }
+    if(!tokens)
+    {
+      std::cerr<<_file<<":"<<lineNumber<<" bad "<<type<<" event\n";
+      continue;
+    }
+    m_events.push_back(e);
+  }
+  // a recording cut short (no end line) still plays up to its last event
+  if(!m_events.empty())
+  {
+    m_ticks=std::max(m_ticks,m_events.back().m_tick);
+  }
+  return true;
+}
+
+int EventPlayer::run(const std::string &_sceneFile, const std::string &_statsSocket, QSurfaceFormat _format, const std::string &_csvFile) const
+{
+  QOffscreenSurface surface;
+  surface.setFormat(_format);
+  surface.create();
+  QOpenGLContext context;
+  context.setFormat(_format);
+  if(!context.create() || !context.makeCurrent(&surface))
+  {
+    std::cerr<<"unable to create an offscreen GL context\n";
+    return EXIT_FAILURE;
+  }
+  std::ofstream csv(_csvFile);
+  if(!csv.is_open())
+  {
+    std::cerr<<"unable to write "<<_csvFile<<"\n";
+    return EXIT_FAILURE;
+  }
+  // the window is never shown, it is only used as something to send the events to
+  std::unique_ptr<NGLScene> scene(new NGLScene(_sceneFile,_statsSocket));
+  scene->resize(m_width,m_height);
+  qreal ratio=scene->devicePixelRatio();
+  std::unique_ptr<QOpenGLFramebufferObject> target=makeTarget(m_width,m_height,ratio,_format);
+  target->bind();
+  scene->initializeGL();
+  if(!scene->isSceneLoaded())
+  {
+    return EXIT_FAILURE;
+  }
+  scene->resizeGL(m_width,m_height);
+  // loading finishes at a different frame every run so get it out of the way first
+  while(scene->isLoading())
+  {
+    scene->paintGL();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  typedef std::chrono::duration<double,std::milli> ms;
+  csv<<"frame,tick,ms";
+  for(size_t c=0; c<Stats::c_numCounters; ++c)
+  {
+    csv<<","<<Stats::name(static_cast<Stats::Counter>(c));
+  }
+  csv<<",culled\n";
+  std::vector<double> frameTimes;
+  frameTimes.reserve(m_ticks+1);
+  size_t next=0;
+  for(size_t tick=0; tick<=m_ticks; ++tick)
+  {
+    for(; next<m_events.size() && m_events[next].m_tick==tick; ++next)
+    {
+      const RecordedEvent &e=m_events[next];
+      Qt::KeyboardModifiers modifiers=QFlag(e.m_modifiers);
+      Qt::MouseButtons buttons=QFlag(e.m_buttons);
+      switch(e.m_type)
+      {
+        case RecordedEvent::Type::KEY :
+        {
+          QKeyEvent key(QEvent::KeyPress,e.m_code,modifiers);
+          QCoreApplication::sendEvent(scene.get(),&key);
+          break;
+        }
+        case RecordedEvent::Type::PRESS :
+        case RecordedEvent::Type::RELEASE :
+        case RecordedEvent::Type::MOVE :
+        {
+          QEvent::Type type= e.m_type==RecordedEvent::Type::PRESS ? QEvent::MouseButtonPress :
+                             e.m_type==RecordedEvent::Type::RELEASE ? QEvent::MouseButtonRelease : QEvent::MouseMove;
+          QMouseEvent mouse(type,QPointF(e.m_x,e.m_y),static_cast<Qt::MouseButton>(e.m_code),buttons,modifiers);
+          QCoreApplication::sendEvent(scene.get(),&mouse);
+          break;
+        }
+        case RecordedEvent::Type::WHEEL :
+        {
+          QWheelEvent wheel(QPointF(e.m_x,e.m_y),e.m_code,buttons,modifiers);
+          QCoreApplication::sendEvent(scene.get(),&wheel);
+          break;
+        }
+        case RecordedEvent::Type::RESIZE :
+        {
+          scene->resize(e.m_x,e.m_y);
+          target=makeTarget(e.m_x,e.m_y,ratio,_format);
+          target->bind();
+          scene->resizeGL(e.m_x,e.m_y);
+          break;
+        }
+      }
+    }
+    if(tick<m_ticks)
+    {
+      QTimerEvent timer(0);
+      QCoreApplication::sendEvent(scene.get(),&timer);
+    }
+    // one frame per tick, timed until the GPU has finished with it
+    auto start=std::chrono::steady_clock::now();
+    scene->paintGL();
+    glFinish();
+    double frameTime=std::chrono::duration_cast<ms>(std::chrono::steady_clock::now()-start).count();
+    frameTimes.push_back(frameTime);
+    csv<<frameTimes.size()-1<<","<<tick<<","<<frameTime;
+    for(size_t c=0; c<Stats::c_numCounters; ++c)
+    {
+      csv<<","<<Stats::lastFrame(static_cast<Stats::Counter>(c));
+    }
+    uint64_t culled=0;
+    size_t numViews=Stats::numViews();
+    for(size_t v=0; v<numViews; ++v)
+    {
+      culled+=Stats::lastFrameCulled(v);
+    }
+    csv<<","<<culled<<"\n";
+  }
+  // GL objects in the scene go while the context is still current
+  scene.reset();
+  target.reset();
+
+  std::vector<double> sorted(frameTimes);
+  std::sort(sorted.begin(),sorted.end());
+  double sum=0.0;
+  for(double t : sorted)
+  {
+    sum+=t;
+  }
+  std::cout<<"replayed "<<m_events.size()<<" events over "<<sorted.size()<<" frames, frame ms mean "<<sum/sorted.size()
+           <<" median "<<sorted[sorted.size()/2]<<" p95 "<<sorted[std::min(sorted.size()-1,sorted.size()*95/100)]
+           <<" max "<<sorted.back()<<", per frame results in "<<_csvFile<<"\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+#include "FrameArena.h"
+#include <algorithm>
+
+FrameArena::FrameArena(size_t _capacity)
+{
+  for(auto &b : m_buffers)
+  {
+    b.m_memory.reset(new char[_capacity]);
+    b.m_capacity=_capacity;
+  }
+}
+
+void FrameArena::nextFrame()
+{
+  m_current^=1;
+  Buffer &b=m_buffers[m_current];
+  size_t needed=b.m_used+b.m_overflowBytes;
+  m_highWater=std::max(m_highWater,needed);
+  if(!b.m_overflow.empty())
+  {
+    // grow with some slack so a slowly growing scene does not overflow every frame
+    b.m_overflow.clear();
+    b.m_overflowBytes=0;
+    b.m_capacity=needed+needed/2;
+    b.m_memory.reset(new char[b.m_capacity]);
+  }
+  b.m_used=0;
+}
+
+void *FrameArena::allocate(size_t _bytes, size_t _align)
+{
+  Buffer &b=m_buffers[m_current];
+  uintptr_t base=reinterpret_cast<uintptr_t>(b.m_memory.get());
+  size_t offset=((base+b.m_used+_align-1) & ~(static_cast<uintptr_t>(_align)-1))-base;
+  if(offset+_bytes<=b.m_capacity)
+  {
+    b.m_used=offset+_bytes;
+    return b.m_memory.get()+offset;
+  }
+  // new[] of char is aligned for any fundamental type which covers everything we store
+  ++m_overflows;
+  b.m_overflowBytes+=_bytes;
+  b.m_overflow.push_back(std::unique_ptr<char[]>(new char[_bytes]));
+  return b.m_overflow.back().get();
+}
@@ -0,0 +1,91 @@
+#include "FrustumSet.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUMSET_SSE
+#endif
+
+constexpr size_t FrustumSet::c_maxViews;
+
+void FrustumSet::set(const ngl::Mat4 *_VPs, size_t _numViews)
+{
+  m_numViews=std::min(_numViews,c_maxViews);
+  m_all= m_numViews==c_maxViews ? ~Mask(0) : (Mask(1)<<m_numViews)-1;
+  m_groups.resize((m_numViews+3)/4);
+  std::memset(m_groups.data(),0,m_groups.size()*sizeof(Group));
+  for(size_t v=0; v<m_numViews; ++v)
+  {
+    Group &group=m_groups[v/4];
+    const ngl::Mat4 &VP=_VPs[v];
+    // with row vectors clip = p*VP so the planes come from the columns (w+x, w-x, w+y ...)
+    for(int p=0; p<6; ++p)
+    {
+      int axis=p/2;
+      ngl::Real sign= (p & 1) ? -1.0f : 1.0f;
+      for(int i=0; i<4; ++i)
+      {
+        group.m_planes[p][i][v%4]=VP.m_m[i][3]+sign*VP.m_m[i][axis];
+      }
+    }
+  }
+}
+
+FrustumSet::Mask FrustumSet::visibleMask(const AABB &_box) const
+{
+  if(_box.isEmpty())
+  {
+    return 0;
+  }
+  ngl::Vec3 c=_box.center();
+  ngl::Vec3 e=_box.size()*0.5f;
+  Mask mask=0;
+#if defined(FRUSTUMSET_SSE)
+  __m128 zero=_mm_setzero_ps();
+  __m128 absMask=_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 cx=_mm_set1_ps(c.m_x);
+  __m128 cy=_mm_set1_ps(c.m_y);
+  __m128 cz=_mm_set1_ps(c.m_z);
+  __m128 ex=_mm_set1_ps(e.m_x);
+  __m128 ey=_mm_set1_ps(e.m_y);
+  __m128 ez=_mm_set1_ps(e.m_z);
+  for(size_t g=0; g<m_groups.size(); ++g)
+  {
+    const ngl::Real (*planes)[4][4]=m_groups[g].m_planes;
+    __m128 visible=_mm_castsi128_ps(_mm_set1_epi32(-1));
+    for(int p=0; p<6; ++p)
+    {
+      __m128 nx=_mm_loadu_ps(planes[p][0]);
+      __m128 ny=_mm_loadu_ps(planes[p][1]);
+      __m128 nz=_mm_loadu_ps(planes[p][2]);
+      // signed distance of the centre plus the box's reach towards the plane
+      __m128 d=_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx,nx),_mm_mul_ps(cy,ny)),_mm_add_ps(_mm_mul_ps(cz,nz),_mm_loadu_ps(planes[p][3])));
+      __m128 r=_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex,_mm_and_ps(nx,absMask)),_mm_mul_ps(ey,_mm_and_ps(ny,absMask))),_mm_mul_ps(ez,_mm_and_ps(nz,absMask)));
+      visible=_mm_and_ps(visible,_mm_cmpge_ps(_mm_add_ps(d,r),zero));
+    }
+    mask|=static_cast<Mask>(_mm_movemask_ps(visible))<<(g*4);
+  }
+#else
+  for(size_t v=0; v<m_numViews; ++v)
+  {
+    const ngl::Real (*planes)[4][4]=m_groups[v/4].m_planes;
+    size_t lane=v%4;
+    bool visible=true;
+    for(int p=0; p<6 && visible; ++p)
+    {
+      ngl::Real nx=planes[p][0][lane];
+      ngl::Real ny=planes[p][1][lane];
+      ngl::Real nz=planes[p][2][lane];
+      ngl::Real d=c.m_x*nx+c.m_y*ny+c.m_z*nz+planes[p][3][lane];
+      ngl::Real r=e.m_x*std::abs(nx)+e.m_y*std::abs(ny)+e.m_z*std::abs(nz);
+      visible=d+r>=0.0f;
+    }
+    if(visible)
+    {
+      mask|=Mask(1)<<v;
+    }
+  }
+#endif
+  return mask & m_all;
+}
@@ -0,0 +1,226 @@
+#include "GeometryCache.h"
+
+const AABB GeometryCache::c_placeholderBounds(ngl::Vec3(-0.5f,-0.5f,-0.5f),ngl::Vec3(0.5f,0.5f,0.5f));
+constexpr size_t GeometryCache::c_uploadChunk;
+
+GeometryCache::~GeometryCache()
+{
+  for(auto &t : m_textures)
+  {
+    glDeleteTextures(1,&t.m_glID);
+  }
+}
+
+GeometryCache::MeshID GeometryCache::acquireMesh(const std::string &_file)
+{
+  auto found=m_meshLookup.find(_file);
+  if(found!=m_meshLookup.end())
+  {
+    ++m_meshes[found->second]->m_refCount;
+    return found->second;
+  }
+  std::unique_ptr<Mesh> mesh(new Mesh);
+  mesh->m_file=_file;
+  mesh->m_refCount=1;
+
+  MeshID id;
+  if(!m_freeMeshes.empty())
+  {
+    id=m_freeMeshes.back();
+    m_freeMeshes.pop_back();
+    m_meshes[id]=std::move(mesh);
+  }
+  else
+  {
+    id=static_cast<MeshID>(m_meshes.size());
+    m_meshes.push_back(std::move(mesh));
+  }
+  m_meshLookup[_file]=id;
+
+  // drawing goes through the LOD chain, it parses the obj (or reads its .lod cache) and
+  // works out the bounds without touching GL so the whole thing can run off thread
+  ++m_inFlight;
+  m_loader.submit([this,id,_file]()
+  {
+    Loaded done;
+    done.m_id=id;
+    done.m_lod.reset(new MeshLOD(_file));
+    std::lock_guard<std::mutex> lock(m_doneMutex);
+    m_done.push_back(std::move(done));
+  });
+  return id;
+}
+
+void GeometryCache::releaseMesh(MeshID _id)
+{
+  Mesh &mesh=*m_meshes[_id];
+  if(--mesh.m_refCount==0)
+  {
+    m_meshLookup.erase(mesh.m_file);
+    // still loading, update() frees it when the load comes back
+    if(mesh.m_ready || (mesh.m_lod && !mesh.m_lod->isValid()))
+    {
+      freeMesh(_id);
+    }
+  }
+}
+
+void GeometryCache::freeMesh(MeshID _id)
+{
+  m_meshes[_id].reset();
+  m_freeMeshes.push_back(_id);
+}
+
+GeometryCache::TextureID GeometryCache::acquireTexture(const std::string &_file)
+{
+  auto found=m_textureLookup.find(_file);
+  if(found!=m_textureLookup.end())
+  {
+    ++m_textures[found->second].m_refCount;
+    return found->second;
+  }
+  Texture tex;
+  tex.m_file=_file;
+  tex.m_refCount=1;
+
+  TextureID id;
+  if(!m_freeTextures.empty())
+  {
+    id=m_freeTextures.back();
+    m_freeTextures.pop_back();
+    m_textures[id]=tex;
+  }
+  else
+  {
+    id=static_cast<TextureID>(m_textures.size());
+    m_textures.push_back(tex);
+  }
+  m_textureLookup[_file]=id;
+
+  // the image is decoded and block compressed (or read back from its .mips cache) off
+  // thread, the GL texture is made in update()
+  ++m_inFlight;
+  m_loader.submit([this,id,_file]()
+  {
+    Loaded done;
+    done.m_id=id;
+    done.m_texture.reset(new CompressedTexture(_file));
+    std::lock_guard<std::mutex> lock(m_doneMutex);
+    m_done.push_back(std::move(done));
+  });
+  return id;
+}
+
+void GeometryCache::releaseTexture(TextureID _id)
+{
+  Texture &tex=m_textures[_id];
+  if(--tex.m_refCount==0)
+  {
+    m_textureLookup.erase(tex.m_file);
+    if(tex.m_ready)
+    {
+      freeTexture(_id);
+    }
+  }
+}
+
+void GeometryCache::freeTexture(TextureID _id)
+{
+  Texture &tex=m_textures[_id];
+  glDeleteTextures(1,&tex.m_glID);
+  tex.m_glID=0;
+  tex.m_ready=false;
+  m_freeTextures.push_back(_id);
+}
+
+const AABB &GeometryCache::bounds(MeshID _id) const
+{
+  const Mesh &mesh=*m_meshes[_id];
+  return mesh.m_ready ? mesh.m_lod->bounds() : c_placeholderBounds;
+}
+
+const ConvexHull *GeometryCache::hull(MeshID _id) const
+{
+  const Mesh &mesh=*m_meshes[_id];
+  return mesh.m_ready ? &mesh.m_lod->hull() : nullptr;
+}
+
+void GeometryCache::update(std::chrono::steady_clock::duration _budget, std::vector<MeshID> &_readyMeshes)
+{
+  auto start=std::chrono::steady_clock::now();
+  std::vector<Loaded> arrived;
+  {
+    std::lock_guard<std::mutex> lock(m_doneMutex);
+    arrived.swap(m_done);
+  }
+  for(auto &a : arrived)
+  {
+    if(a.m_lod)
+    {
+      Mesh &mesh=*m_meshes[a.m_id];
+      mesh.m_lod=std::move(a.m_lod);
+      if(!mesh.m_lod->isValid())
+      {
+        // stays a placeholder box, the MeshLOD has already said why
+        --m_inFlight;
+        if(mesh.m_refCount==0)
+        {
+          freeMesh(a.m_id);
+        }
+        continue;
+      }
+      m_meshUploads.push_back(a.m_id);
+    }
+    else
+    {
+      m_textureUploads.push_back(std::move(a));
+    }
+  }
+
+  // one chunk at a time until the budget is used up, geometry first as an untextured mesh
+  // says more than a texture on a placeholder box
+  bool first=true;
+  while(first || std::chrono::steady_clock::now()-start<_budget)
+  {
+    first=false;
+    if(!m_meshUploads.empty())
+    {
+      MeshID id=m_meshUploads.front();
+      Mesh &mesh=*m_meshes[id];
+      if(mesh.m_refCount==0)
+      {
+        // released while it was loading
+        m_meshUploads.pop_front();
+        --m_inFlight;
+        freeMesh(id);
+      }
+      else if(mesh.m_lod->upload(c_uploadChunk))
+      {
+        m_meshUploads.pop_front();
+        --m_inFlight;
+        mesh.m_ready=true;
+        _readyMeshes.push_back(id);
+      }
+    }
+    else if(!m_textureUploads.empty())
+    {
+      Loaded &load=m_textureUploads.front();
+      Texture &tex=m_textures[load.m_id];
+      tex.m_ready=true;
+      if(tex.m_refCount==0)
+      {
+        freeTexture(load.m_id);
+      }
+      else if(load.m_texture->isValid())
+      {
+        tex.m_glID=load.m_texture->createTexture();
+      }
+      m_textureUploads.pop_front();
+      --m_inFlight;
+    }
+    else
+    {
+      break;
+    }
+  }
+}
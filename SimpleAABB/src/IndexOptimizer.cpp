@@ -0,0 +1,322 @@
+#include "IndexOptimizer.h"
+#include <algorithm>
+#include <ngl/Vec3.h>
+
+constexpr size_t IndexOptimizer::c_cacheSize;
+
+namespace
+{
+  ngl::Vec3 position(const ngl::Real *_positions, size_t _stride, GLuint _v)
+  {
+    const ngl::Real *p=_positions+_v*_stride;
+    return ngl::Vec3(p[0],p[1],p[2]);
+  }
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief FIFO cache model, a vertex is in the cache while fewer than size() misses have
+  /// happened since it went in
+  //----------------------------------------------------------------------------------------------------------------------
+  class FifoCache
+  {
+    public :
+      FifoCache(size_t _numVertices, size_t _size) : m_size(_size), m_time(_numVertices,0) {}
+      // true on a miss
+      bool use(GLuint _v)
+      {
+        if(m_time[_v] && m_now-m_time[_v]<m_size)
+        {
+          return false;
+        }
+        m_time[_v]=++m_now;
+        return true;
+      }
+      size_t useTriangle(const GLuint *_tri)
+      {
+        return use(_tri[0])+use(_tri[1])+use(_tri[2]);
+      }
+      void clear()
+      {
+        // moving time on empties the cache without touching every vertex
+        m_now+=m_size;
+      }
+
+    private :
+      size_t m_size;
+      std::vector<size_t> m_time;
+      size_t m_now=0;
+  };
+}
+
+IndexOptimizer::CacheStats IndexOptimizer::analyzeCache(const GLuint *_indices, size_t _numIndices, size_t _numVertices, size_t _cacheSize)
+{
+  CacheStats stats;
+  if(_numIndices<3)
+  {
+    return stats;
+  }
+  FifoCache cache(_numVertices,_cacheSize);
+  std::vector<bool> used(_numVertices,false);
+  size_t misses=0;
+  size_t numUsed=0;
+  for(size_t i=0; i<_numIndices; ++i)
+  {
+    misses+=cache.use(_indices[i]);
+    if(!used[_indices[i]])
+    {
+      used[_indices[i]]=true;
+      ++numUsed;
+    }
+  }
+  stats.m_acmr=static_cast<ngl::Real>(misses)/static_cast<ngl::Real>(_numIndices/3);
+  stats.m_atvr=static_cast<ngl::Real>(misses)/static_cast<ngl::Real>(numUsed);
+  return stats;
+}
+
+void IndexOptimizer::optimizeVertexCache(GLuint *_indices, size_t _numIndices, size_t _numVertices, size_t _cacheSize)
+{
+  size_t numTriangles=_numIndices/3;
+  if(numTriangles==0)
+  {
+    return;
+  }
+  // triangles around each vertex and how many of them are still to be emitted
+  std::vector<GLuint> start(_numVertices+1,0);
+  for(size_t i=0; i<numTriangles*3; ++i)
+  {
+    ++start[_indices[i]+1];
+  }
+  for(size_t v=0; v<_numVertices; ++v)
+  {
+    start[v+1]+=start[v];
+  }
+  std::vector<GLuint> live(_numVertices);
+  for(size_t v=0; v<_numVertices; ++v)
+  {
+    live[v]=start[v+1]-start[v];
+  }
+  std::vector<GLuint> adjacency(start.back());
+  {
+    std::vector<GLuint> fill(start.begin(),start.end()-1);
+    for(size_t i=0; i<numTriangles*3; ++i)
+    {
+      adjacency[fill[_indices[i]]++]=static_cast<GLuint>(i/3);
+    }
+  }
+  std::vector<bool> emitted(numTriangles,false);
+  // time each vertex last went into the cache, starting past the cache size so nothing is in it
+  std::vector<size_t> cacheTime(_numVertices,0);
+  size_t now=_cacheSize+1;
+  std::vector<GLuint> deadEnds;
+  std::vector<GLuint> candidates;
+  std::vector<GLuint> ordered;
+  ordered.reserve(numTriangles*3);
+  size_t cursor=0;
+  long fan=0;
+  while(fan>=0)
+  {
+    candidates.clear();
+    for(GLuint k=start[fan]; k<start[fan+1]; ++k)
+    {
+      GLuint t=adjacency[k];
+      if(emitted[t])
+      {
+        continue;
+      }
+      emitted[t]=true;
+      for(int c=0; c<3; ++c)
+      {
+        GLuint v=_indices[t*3+c];
+        ordered.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if(now-cacheTime[v]>_cacheSize)
+        {
+          cacheTime[v]=now++;
+        }
+      }
+    }
+    // the candidate that will still be cached after its fan is emitted and went in longest
+    // ago, else any candidate with triangles left
+    fan=-1;
+    long best=-1;
+    for(GLuint v : candidates)
+    {
+      if(live[v]==0)
+      {
+        continue;
+      }
+      long priority=0;
+      if(now-cacheTime[v]+2*live[v]<=_cacheSize)
+      {
+        priority=static_cast<long>(now-cacheTime[v]);
+      }
+      if(priority>best)
+      {
+        best=priority;
+        fan=v;
+      }
+    }
+    if(fan<0)
+    {
+      // dead end, go back to a recent vertex with triangles left or on to the next one in order
+      while(!deadEnds.empty() && fan<0)
+      {
+        GLuint v=deadEnds.back();
+        deadEnds.pop_back();
+        if(live[v])
+        {
+          fan=v;
+        }
+      }
+      for(; fan<0 && cursor<_numVertices; ++cursor)
+      {
+        if(live[cursor])
+        {
+          fan=static_cast<long>(cursor);
+        }
+      }
+    }
+  }
+  std::copy(ordered.begin(),ordered.end(),_indices);
+}
+
+void IndexOptimizer::optimizeOverdraw(const ngl::Real *_positions, size_t _stride, GLuint *_indices, size_t _numIndices,
+                                      size_t _numVertices, ngl::Real _threshold, size_t _cacheSize)
+{
+  size_t numTriangles=_numIndices/3;
+  if(numTriangles==0)
+  {
+    return;
+  }
+  // hard boundaries where all three vertices miss, the order has moved to a new patch
+  std::vector<size_t> hard;
+  {
+    FifoCache cache(_numVertices,_cacheSize);
+    for(size_t t=0; t<numTriangles; ++t)
+    {
+      if(cache.useTriangle(_indices+t*3)==3 || t==0)
+      {
+        hard.push_back(t);
+      }
+    }
+  }
+  hard.push_back(numTriangles);
+  // soft boundaries inside each patch wherever the run so far is already as cache friendly
+  // as the whole patch, scaled by the threshold
+  std::vector<size_t> clusterStarts;
+  FifoCache cache(_numVertices,_cacheSize);
+  for(size_t h=0; h+1<hard.size(); ++h)
+  {
+    size_t begin=hard[h];
+    size_t end=hard[h+1];
+    cache.clear();
+    size_t patchMisses=0;
+    for(size_t t=begin; t<end; ++t)
+    {
+      patchMisses+=cache.useTriangle(_indices+t*3);
+    }
+    ngl::Real limit=_threshold*static_cast<ngl::Real>(patchMisses)/static_cast<ngl::Real>(end-begin);
+    cache.clear();
+    size_t clusterStart=begin;
+    size_t misses=0;
+    for(size_t t=begin; t<end; ++t)
+    {
+      misses+=cache.useTriangle(_indices+t*3);
+      if(static_cast<ngl::Real>(misses)<=limit*static_cast<ngl::Real>(t+1-clusterStart))
+      {
+        clusterStarts.push_back(clusterStart*3);
+        clusterStart=t+1;
+        misses=0;
+        cache.clear();
+      }
+    }
+    if(clusterStart<end)
+    {
+      clusterStarts.push_back(clusterStart*3);
+    }
+  }
+  std::vector<size_t> order;
+  sortClusters(_positions,_stride,_indices,_numIndices,clusterStarts,order);
+}
+
+void IndexOptimizer::sortClusters(const ngl::Real *_positions, size_t _stride, GLuint *_indices, size_t _numIndices,
+                                  const std::vector<size_t> &_clusterStarts, std::vector<size_t> &_order)
+{
+  size_t numClusters=_clusterStarts.size();
+  // area weighted centroid and normal of each cluster and of the whole mesh
+  std::vector<ngl::Vec3> centroids(numClusters,ngl::Vec3(0.0f,0.0f,0.0f));
+  std::vector<ngl::Vec3> normals(numClusters,ngl::Vec3(0.0f,0.0f,0.0f));
+  ngl::Vec3 meshCentroid(0.0f,0.0f,0.0f);
+  ngl::Real meshArea=0.0f;
+  for(size_t c=0; c<numClusters; ++c)
+  {
+    size_t end= c+1<numClusters ? _clusterStarts[c+1] : _numIndices;
+    ngl::Real area=0.0f;
+    for(size_t i=_clusterStarts[c]; i+3<=end; i+=3)
+    {
+      ngl::Vec3 p0=position(_positions,_stride,_indices[i]);
+      ngl::Vec3 p1=position(_positions,_stride,_indices[i+1]);
+      ngl::Vec3 p2=position(_positions,_stride,_indices[i+2]);
+      ngl::Vec3 n=(p1-p0).cross(p2-p0);
+      ngl::Real a=n.length();
+      centroids[c]+=(p0+p1+p2)*(a/3.0f);
+      normals[c]+=n;
+      area+=a;
+    }
+    meshCentroid+=centroids[c];
+    meshArea+=area;
+    if(area>0.0f)
+    {
+      centroids[c]*=1.0f/area;
+    }
+  }
+  if(meshArea>0.0f)
+  {
+    meshCentroid*=1.0f/meshArea;
+  }
+  std::vector<ngl::Real> key(numClusters);
+  for(size_t c=0; c<numClusters; ++c)
+  {
+    ngl::Real length=normals[c].length();
+    key[c]= length>0.0f ? (centroids[c]-meshCentroid).dot(normals[c])/length : 0.0f;
+  }
+  _order.resize(numClusters);
+  for(size_t c=0; c<numClusters; ++c)
+  {
+    _order[c]=c;
+  }
+  // stable so clusters facing the same way keep their cache friendly order
+  std::stable_sort(_order.begin(),_order.end(),[&](size_t _a, size_t _b){return key[_a]>key[_b];});
+  std::vector<GLuint> sorted;
+  sorted.reserve(_numIndices);
+  for(size_t c : _order)
+  {
+    size_t end= c+1<numClusters ? _clusterStarts[c+1] : _numIndices;
+    sorted.insert(sorted.end(),_indices+_clusterStarts[c],_indices+end);
+  }
+  std::copy(sorted.begin(),sorted.end(),_indices);
+}
+
+void IndexOptimizer::optimizeVertexFetch(GLuint *_indices, size_t _numIndices, size_t _numVertices, std::vector<GLuint> &_remap)
+{
+  const GLuint unused=static_cast<GLuint>(_numVertices);
+  _remap.assign(_numVertices,unused);
+  GLuint next=0;
+  for(size_t i=0; i<_numIndices; ++i)
+  {
+    GLuint &r=_remap[_indices[i]];
+    if(r==unused)
+    {
+      r=next++;
+    }
+    _indices[i]=r;
+  }
+  for(auto &r : _remap)
+  {
+    if(r==unused)
+    {
+      r=next++;
+    }
+  }
+}
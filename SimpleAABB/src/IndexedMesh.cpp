@@ -0,0 +1,238 @@
+#include "IndexedMesh.h"
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+  // one polygon corner, t and n are 1 based with 0 meaning not present
+  struct Corner
+  {
+    uint64_t m_v;
+    uint64_t m_t;
+    uint64_t m_n;
+    bool operator==(const Corner &_c) const {return m_v==_c.m_v && m_t==_c.m_t && m_n==_c.m_n;}
+  };
+
+  // the whole triplet is the key so any number of positions, uvs and normals welds correctly
+  struct CornerHash
+  {
+    size_t operator()(const Corner &_c) const
+    {
+      uint64_t h=_c.m_v*0x9e3779b97f4a7c15ull;
+      h=(h ^ (h>>29) ^ _c.m_t)*0xbf58476d1ce4e5b9ull;
+      h=(h ^ (h>>32) ^ _c.m_n)*0x94d049bb133111ebull;
+      return static_cast<size_t>(h ^ (h>>31));
+    }
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief weld the corners into unique vertices, _polySizes gives how many corners each
+  /// polygon uses and polygons are split into triangle fans
+  //----------------------------------------------------------------------------------------------------------------------
+  IndexedMesh weld(const std::vector<ngl::Vec3> &_verts, const std::vector<ngl::Vec3> &_uvs,
+                   const std::vector<ngl::Vec3> &_normals, const std::vector<Corner> &_corners,
+                   const std::vector<uint32_t> &_polySizes)
+  {
+    typedef IndexedMesh::Vertex Vertex;
+    IndexedMesh out;
+    out.m_numPositions=_verts.size();
+    std::unordered_map<Corner,GLuint,CornerHash> welded;
+    welded.reserve(_verts.size()*2);
+    out.m_indices.reserve(_polySizes.size()*3);
+
+    auto corner=[&](const Corner &_c) -> GLuint
+    {
+      auto found=welded.find(_c);
+      if(found!=welded.end())
+      {
+        return found->second;
+      }
+      Vertex vert;
+      const ngl::Vec3 &p=_verts[_c.m_v];
+      vert.m_x=p.m_x; vert.m_y=p.m_y; vert.m_z=p.m_z;
+      vert.m_u=vert.m_v=0.0f;
+      if(_c.m_t)
+      {
+        vert.m_u=_uvs[_c.m_t-1].m_x;
+        vert.m_v=_uvs[_c.m_t-1].m_y;
+      }
+      vert.m_nx=vert.m_nz=0.0f;
+      vert.m_ny=1.0f;
+      if(_c.m_n)
+      {
+        const ngl::Vec3 &nn=_normals[_c.m_n-1];
+        vert.m_nx=nn.m_x; vert.m_ny=nn.m_y; vert.m_nz=nn.m_z;
+      }
+      GLuint index=static_cast<GLuint>(out.m_verts.size());
+      out.m_verts.push_back(vert);
+      out.m_posIndex.push_back(static_cast<GLuint>(_c.m_v));
+      welded[_c]=index;
+      return index;
+    };
+
+    size_t base=0;
+    for(uint32_t size : _polySizes)
+    {
+      if(size>=3)
+      {
+        GLuint first=corner(_corners[base]);
+        GLuint prev=corner(_corners[base+1]);
+        for(size_t c=2; c<size; ++c)
+        {
+          GLuint cur=corner(_corners[base+c]);
+          out.m_indices.push_back(first);
+          out.m_indices.push_back(prev);
+          out.m_indices.push_back(cur);
+          prev=cur;
+        }
+      }
+      base+=size;
+    }
+    return out;
+  }
+
+  // obj indices are 1 based, negative counts back from the last element read so far
+  bool objIndex(long _i, size_t _count, uint64_t &_out)
+  {
+    long i= _i<0 ? static_cast<long>(_count)+_i : _i-1;
+    if(i<0 || i>=static_cast<long>(_count))
+    {
+      return false;
+    }
+    _out=static_cast<uint64_t>(i);
+    return true;
+  }
+}
+
+IndexedMesh IndexedMesh::fromObj(ngl::Obj &_mesh)
+{
+  std::vector<ngl::Face> faces=_mesh.getFaceList();
+  std::vector<Corner> corners;
+  std::vector<uint32_t> sizes;
+  corners.reserve(faces.size()*3);
+  sizes.reserve(faces.size());
+  for(const auto &f : faces)
+  {
+    for(size_t c=0; c<f.m_numVerts; ++c)
+    {
+      Corner corner;
+      corner.m_v=f.m_vert[c];
+      corner.m_t=f.m_textureCoord ? f.m_tex[c]+1 : 0;
+      corner.m_n=f.m_normals ? f.m_norm[c]+1 : 0;
+      corners.push_back(corner);
+    }
+    sizes.push_back(static_cast<uint32_t>(f.m_numVerts));
+  }
+  return weld(_mesh.getVertexList(),_mesh.getTextureCordList(),_mesh.getNormalList(),corners,sizes);
+}
+
+bool IndexedMesh::loadObj(const std::string &_fname, IndexedMesh &_out)
+{
+  std::ifstream in(_fname,std::ios::binary);
+  if(!in.is_open())
+  {
+    return false;
+  }
+  // one read then parse in place, this runs on the loader threads so avoid iostreams per token
+  std::string text((std::istreambuf_iterator<char>(in)),std::istreambuf_iterator<char>());
+  std::vector<ngl::Vec3> verts,uvs,normals;
+  std::vector<Corner> corners;
+  std::vector<uint32_t> sizes;
+
+  char *p=&text[0];
+  char *end;
+  while(*p)
+  {
+    const char *line=p;
+    // terminate the line so strtof / strtol can not run on into the next one
+    while(*p && *p!='\n')
+    {
+      ++p;
+    }
+    if(*p)
+    {
+      *p++='\0';
+    }
+    if(line[0]=='v' && (line[1]==' ' || line[1]=='t' || line[1]=='n'))
+    {
+      const char *s= line[1]==' ' ? line+1 : line+2;
+      ngl::Vec3 v(0.0f,0.0f,0.0f);
+      v.m_x=std::strtof(s,&end); s=end;
+      v.m_y=std::strtof(s,&end); s=end;
+      if(line[1]!='t')
+      {
+        v.m_z=std::strtof(s,&end);
+      }
+      auto &list= line[1]==' ' ? verts : line[1]=='t' ? uvs : normals;
+      list.push_back(v);
+    }
+    else if(line[0]=='f' && line[1]==' ')
+    {
+      const char *s=line+1;
+      uint32_t count=0;
+      for(;;)
+      {
+        long v=std::strtol(s,&end,10);
+        if(end==s)
+        {
+          break;
+        }
+        s=end;
+        Corner c;
+        c.m_t=c.m_n=0;
+        if(!objIndex(v,verts.size(),c.m_v))
+        {
+          return false;
+        }
+        // v, v/t, v//n or v/t/n
+        if(*s=='/')
+        {
+          ++s;
+          if(*s!='/')
+          {
+            long t=std::strtol(s,&end,10);
+            s=end;
+            if(!objIndex(t,uvs.size(),c.m_t))
+            {
+              return false;
+            }
+            ++c.m_t;
+          }
+          if(*s=='/')
+          {
+            ++s;
+            long n=std::strtol(s,&end,10);
+            s=end;
+            if(!objIndex(n,normals.size(),c.m_n))
+            {
+              return false;
+            }
+            ++c.m_n;
+          }
+        }
+        corners.push_back(c);
+        ++count;
+      }
+      sizes.push_back(count);
+    }
+  }
+  if(verts.empty())
+  {
+    return false;
+  }
+  _out=weld(verts,uvs,normals,corners,sizes);
+  return true;
+}
+
+AABB IndexedMesh::bounds() const
+{
+  AABB box;
+  for(const auto &v : m_verts)
+  {
+    box.extend(ngl::Vec3(v.m_x,v.m_y,v.m_z));
+  }
+  return box;
+}
@@ -0,0 +1,563 @@
+#include "IndirectRenderer.h"
+#include <ngl/ShaderLib.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+constexpr size_t IndirectRenderer::c_maxLevels;
+constexpr size_t IndirectRenderer::c_framesInFlight;
+constexpr GLuint IndirectRenderer::c_groupSize;
+constexpr size_t IndirectRenderer::c_numTotals;
+
+namespace
+{
+  const std::string c_cullProgram("IndirectCull");
+  const std::string c_drawProgram("IndirectShader");
+}
+
+IndirectRenderer::~IndirectRenderer()
+{
+  for(auto &f : m_frames)
+  {
+    if(f.m_fence)
+    {
+      glDeleteSync(f.m_fence);
+    }
+    if(f.m_counters)
+    {
+      glDeleteBuffers(1,&f.m_counters);
+    }
+  }
+  if(m_vao)
+  {
+    GLuint buffers[]={m_vbo,m_ibo,m_objectIds,m_objectBuffer,m_meshBuffer,m_commands};
+    glDeleteBuffers(6,buffers);
+    glDeleteVertexArrays(1,&m_vao);
+  }
+}
+
+bool IndirectRenderer::init()
+{
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  shader->createShaderProgram(c_cullProgram);
+  shader->attachShader("IndirectCullShader",ngl::ShaderType::COMPUTE);
+  shader->loadShaderSource("IndirectCullShader","shaders/IndirectCull.glsl");
+  shader->compileShader("IndirectCullShader");
+  shader->attachShaderToProgram(c_cullProgram,"IndirectCullShader");
+  shader->linkProgramObject(c_cullProgram);
+  // TextureShader with the world matrix looked up per node
+  shader->createShaderProgram(c_drawProgram);
+  shader->attachShader("IndirectVertex",ngl::ShaderType::VERTEX);
+  shader->loadShaderSource("IndirectVertex","shaders/IndirectVertex.glsl");
+  shader->compileShader("IndirectVertex");
+  shader->attachShaderToProgram(c_drawProgram,"IndirectVertex");
+  shader->attachShaderToProgram(c_drawProgram,"TextureFragment");
+  shader->linkProgramObject(c_drawProgram);
+  GLint cullLinked=GL_FALSE;
+  GLint drawLinked=GL_FALSE;
+  glGetProgramiv(shader->getProgramID(c_cullProgram),GL_LINK_STATUS,&cullLinked);
+  glGetProgramiv(shader->getProgramID(c_drawProgram),GL_LINK_STATUS,&drawLinked);
+  if(cullLinked!=GL_TRUE || drawLinked!=GL_TRUE)
+  {
+    std::cerr<<"indirect draw shaders did not build\n";
+    return false;
+  }
+
+  // one VAO over the shared buffers, created empty and filled as meshes arrive
+  glGenVertexArrays(1,&m_vao);
+  glBindVertexArray(m_vao);
+  glGenBuffers(1,&m_vbo);
+  glGenBuffers(1,&m_ibo);
+  glGenBuffers(1,&m_objectIds);
+  glGenBuffers(1,&m_objectBuffer);
+  glGenBuffers(1,&m_meshBuffer);
+  glGenBuffers(1,&m_commands);
+  glBindBuffer(GL_ARRAY_BUFFER,m_objectIds);
+  glVertexAttribIPointer(3,1,GL_UNSIGNED_INT,sizeof(GLuint),nullptr);
+  glVertexAttribDivisor(3,1);
+  for(GLuint a=0; a<4; ++a)
+  {
+    glEnableVertexAttribArray(a);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+  bindGeometry();
+  for(auto &f : m_frames)
+  {
+    glGenBuffers(1,&f.m_counters);
+  }
+  return true;
+}
+
+void IndirectRenderer::beginFrame(const SceneGraph &_scene, const GeometryCache &_geometry, std::chrono::steady_clock::duration _budget)
+{
+  // a new or reloaded mesh is appended, the others stay where they are
+  m_used.assign(m_used.size(),0);
+  for(size_t i=0; i<_scene.size(); ++i)
+  {
+    GeometryCache::MeshID mesh=_scene.asset(i).m_mesh;
+    if(!_geometry.isReady(mesh))
+    {
+      continue;
+    }
+    if(mesh>=m_slots.size())
+    {
+      m_slots.resize(mesh+1);
+      m_ranges.resize(mesh+1,MeshRanges());
+      m_used.resize(mesh+1,0);
+    }
+    m_used[mesh]=1;
+    const MeshLOD *lod=_geometry.mesh(mesh).m_lod.get();
+    if(m_slots[mesh].m_lod!=lod)
+    {
+      place(mesh,lod);
+    }
+  }
+  // a mesh the scene no longer uses may have been freed
+  for(size_t m=0; m<m_slots.size(); ++m)
+  {
+    if(m_slots[m].m_lod && !m_used[m])
+    {
+      release(static_cast<GeometryCache::MeshID>(m));
+    }
+  }
+  copyPending(_budget);
+  if(m_rangesChanged)
+  {
+    glBindBuffer(GL_COPY_WRITE_BUFFER,m_meshBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER,m_ranges.size()*sizeof(MeshRanges),m_ranges.data(),GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+    Stats::add(Stats::Counter::GL_BYTES_UPLOADED,m_ranges.size()*sizeof(MeshRanges));
+    m_rangesChanged=false;
+  }
+
+  // only the nodes whose mesh is all there
+  m_order.clear();
+  for(size_t i=0; i<_scene.size(); ++i)
+  {
+    const SceneGraph::Asset &asset=_scene.asset(i);
+    if(_geometry.isReady(asset.m_mesh) && m_ranges[asset.m_mesh].m_numLevels>0)
+    {
+      m_order.push_back(std::make_pair(_geometry.texture(asset.m_texture),i));
+    }
+  }
+
+  // nodes sharing a texture are drawn by one call so they go next to each other
+  std::sort(m_order.begin(),m_order.end());
+  m_objects.resize(m_order.size());
+  m_batches.clear();
+  for(size_t k=0; k<m_order.size(); ++k)
+  {
+    size_t i=m_order[k].second;
+    if(m_batches.empty() || m_batches.back().m_texture!=m_order[k].first)
+    {
+      m_batches.push_back({m_order[k].first,static_cast<uint32_t>(k),0});
+    }
+    ++m_batches.back().m_size;
+    Object &o=m_objects[k];
+    std::memcpy(o.m_world,&_scene.worldMatrix(i).m_m[0][0],sizeof(o.m_world));
+    const AABB &box=_scene.mesh(i).getAABB();
+    for(int a=0; a<3; ++a)
+    {
+      o.m_boxMin[a]=box.m_min[a];
+      o.m_boxMax[a]=box.m_max[a];
+    }
+    o.m_boxMin[3]=o.m_boxMax[3]=1.0f;
+    o.m_mesh=_scene.asset(i).m_mesh;
+    o.m_batch=static_cast<uint32_t>(m_batches.size()-1);
+    o.m_batchStart=m_batches.back().m_start;
+    o.m_pad=0;
+  }
+  reserve(m_objects.size(),m_batches.size());
+  if(m_objects.empty())
+  {
+    return;
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,m_objectBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER,0,m_objects.size()*sizeof(Object),&m_objects[0]);
+  Stats::add(Stats::Counter::GL_BYTES_UPLOADED,m_objects.size()*sizeof(Object));
+  // views this frame does not draw must read back as nothing drawn
+  Frame &frame=m_frames[m_current];
+  if(frame.m_fence)
+  {
+    // the GPU is a whole ring behind, drop that frame's counts rather than wait
+    glDeleteSync(frame.m_fence);
+    frame.m_fence=nullptr;
+  }
+  m_counterData.assign(m_numViews*(c_numTotals+m_batchCapacity),0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,frame.m_counters);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER,0,m_counterData.size()*sizeof(uint32_t),&m_counterData[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER,0);
+}
+
+void IndirectRenderer::place(GeometryCache::MeshID _mesh, const MeshLOD *_lod)
+{
+  if(m_slots[_mesh].m_lod)
+  {
+    release(_mesh);
+  }
+  Slot &slot=m_slots[_mesh];
+  slot.m_lod=_lod;
+  slot.m_ranges=MeshRanges();
+  slot.m_ranges.m_baseVertex=static_cast<int32_t>(m_numVertices);
+  slot.m_ranges.m_numLevels=static_cast<uint32_t>(std::min(c_maxLevels,_lod->numLevels()));
+  slot.m_numVertices=_lod->numVertices();
+  slot.m_numIndices=0;
+  for(size_t l=0; l<slot.m_ranges.m_numLevels; ++l)
+  {
+    slot.m_ranges.m_first[l]=static_cast<uint32_t>(m_numIndices+slot.m_numIndices);
+    slot.m_ranges.m_count[l]=static_cast<uint32_t>(_lod->numIndices(l));
+    slot.m_numIndices+=_lod->numIndices(l);
+  }
+  reserveGeometry(m_numVertices+slot.m_numVertices,m_numIndices+slot.m_numIndices);
+  m_numVertices+=slot.m_numVertices;
+  m_numIndices+=slot.m_numIndices;
+  m_pending.push_back({_mesh,0,0});
+}
+
+void IndirectRenderer::release(GeometryCache::MeshID _mesh)
+{
+  Slot &slot=m_slots[_mesh];
+  m_deadVertices+=slot.m_numVertices;
+  m_deadIndices+=slot.m_numIndices;
+  slot=Slot();
+  if(m_ranges[_mesh].m_numLevels>0)
+  {
+    m_ranges[_mesh]=MeshRanges();
+    m_rangesChanged=true;
+  }
+  m_pending.erase(std::remove_if(m_pending.begin(),m_pending.end(),[_mesh](const Pending &_p){return _p.m_mesh==_mesh;}),
+                  m_pending.end());
+  // meshes are only released along with the scene, so rather than fill gaps start again
+  // once nothing is left
+  if(m_deadVertices==m_numVertices && m_deadIndices==m_numIndices)
+  {
+    m_numVertices=m_numIndices=0;
+    m_deadVertices=m_deadIndices=0;
+  }
+}
+
+void IndirectRenderer::copyPending(std::chrono::steady_clock::duration _budget)
+{
+  typedef IndexedMesh::Vertex Vertex;
+  auto start=std::chrono::steady_clock::now();
+  bool first=true;
+  while(!m_pending.empty() && (first || std::chrono::steady_clock::now()-start<_budget))
+  {
+    first=false;
+    Pending &p=m_pending.front();
+    const Slot &slot=m_slots[p.m_mesh];
+    const char *source;
+    size_t bytes;
+    GLintptr at;
+    if(p.m_part==0)
+    {
+      glBindBuffer(GL_COPY_WRITE_BUFFER,m_vbo);
+      source=reinterpret_cast<const char *>(slot.m_lod->vertices());
+      bytes=slot.m_numVertices*sizeof(Vertex);
+      at=static_cast<GLintptr>(slot.m_ranges.m_baseVertex*sizeof(Vertex));
+    }
+    else
+    {
+      size_t level=p.m_part-1;
+      glBindBuffer(GL_COPY_WRITE_BUFFER,m_ibo);
+      source=reinterpret_cast<const char *>(slot.m_lod->indices(level));
+      bytes=slot.m_ranges.m_count[level]*sizeof(GLuint);
+      at=static_cast<GLintptr>(slot.m_ranges.m_first[level]*sizeof(GLuint));
+    }
+    size_t size=std::min(GeometryCache::c_uploadChunk,bytes-p.m_copied);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,at+static_cast<GLintptr>(p.m_copied),static_cast<GLsizeiptr>(size),source+p.m_copied);
+    Stats::add(Stats::Counter::GL_BYTES_UPLOADED,size);
+    p.m_copied+=size;
+    if(p.m_copied<bytes)
+    {
+      continue;
+    }
+    p.m_copied=0;
+    if(++p.m_part>slot.m_ranges.m_numLevels)
+    {
+      // all there, the cull shader can start picking it
+      m_ranges[p.m_mesh]=slot.m_ranges;
+      m_rangesChanged=true;
+      m_pending.pop_front();
+    }
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+}
+
+void IndirectRenderer::reserveGeometry(size_t _vertices, size_t _indices)
+{
+  typedef IndexedMesh::Vertex Vertex;
+  // grow by half again and copy on the GPU, so adding meshes one at a time stays linear
+  auto grow=[](GLuint &_buffer, size_t _used, size_t _size)
+  {
+    GLuint larger;
+    glGenBuffers(1,&larger);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,larger);
+    glBufferData(GL_COPY_WRITE_BUFFER,static_cast<GLsizeiptr>(_size),nullptr,GL_STATIC_DRAW);
+    if(_used>0)
+    {
+      glBindBuffer(GL_COPY_READ_BUFFER,_buffer);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,0,0,static_cast<GLsizeiptr>(_used));
+      glBindBuffer(GL_COPY_READ_BUFFER,0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+    glDeleteBuffers(1,&_buffer);
+    _buffer=larger;
+  };
+  bool grown=false;
+  if(_vertices>m_vertexCapacity)
+  {
+    size_t capacity=std::max(_vertices,m_vertexCapacity+m_vertexCapacity/2);
+    grow(m_vbo,m_numVertices*sizeof(Vertex),capacity*sizeof(Vertex));
+    m_vertexCapacity=capacity;
+    grown=true;
+  }
+  if(_indices>m_indexCapacity)
+  {
+    size_t capacity=std::max(_indices,m_indexCapacity+m_indexCapacity/2);
+    grow(m_ibo,m_numIndices*sizeof(GLuint),capacity*sizeof(GLuint));
+    m_indexCapacity=capacity;
+    grown=true;
+  }
+  if(grown)
+  {
+    bindGeometry();
+  }
+}
+
+void IndirectRenderer::bindGeometry()
+{
+  typedef IndexedMesh::Vertex Vertex;
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_ARRAY_BUFFER,m_vbo);
+  glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),reinterpret_cast<void *>(offsetof(Vertex,m_x)));
+  glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,sizeof(Vertex),reinterpret_cast<void *>(offsetof(Vertex,m_u)));
+  glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),reinterpret_cast<void *>(offsetof(Vertex,m_nx)));
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_ibo);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+}
+
+void IndirectRenderer::reserve(size_t _count, size_t _batches)
+{
+  if(_count>m_capacity)
+  {
+    // grow by half again so a slowly growing scene does not reallocate every frame
+    m_capacity=std::max(_count,m_capacity+m_capacity/2);
+    std::vector<GLuint> ids(m_capacity);
+    for(size_t i=0; i<m_capacity; ++i)
+    {
+      ids[i]=static_cast<GLuint>(i);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER,m_objectIds);
+    glBufferData(GL_COPY_WRITE_BUFFER,m_capacity*sizeof(GLuint),ids.data(),GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,m_objectBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER,m_capacity*sizeof(Object),nullptr,GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,m_commands);
+    glBufferData(GL_COPY_WRITE_BUFFER,m_numViews*m_capacity*sizeof(Command),nullptr,GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+  }
+  if(_batches>m_batchCapacity)
+  {
+    m_batchCapacity=std::max(_batches,m_batchCapacity*2);
+    for(auto &f : m_frames)
+    {
+      // the old layout can not be read back any more
+      if(f.m_fence)
+      {
+        glDeleteSync(f.m_fence);
+        f.m_fence=nullptr;
+      }
+      glBindBuffer(GL_COPY_WRITE_BUFFER,f.m_counters);
+      glBufferData(GL_COPY_WRITE_BUFFER,m_numViews*(c_numTotals+m_batchCapacity)*sizeof(uint32_t),nullptr,GL_STREAM_READ);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+  }
+}
+
+bool IndirectRenderer::cullObject(const Object &_object, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight, bool _useLOD,
+                                  Command &_command) const
+{
+  // with row vectors the clip space planes are sums of the columns of VP, a box is out when
+  // it is wholly behind one
+  const ngl::Real (*m)[4]=_VP.m_m;
+  ngl::Vec3 centre((_object.m_boxMin[0]+_object.m_boxMax[0])*0.5f,(_object.m_boxMin[1]+_object.m_boxMax[1])*0.5f,
+                   (_object.m_boxMin[2]+_object.m_boxMax[2])*0.5f);
+  ngl::Vec3 extent((_object.m_boxMax[0]-_object.m_boxMin[0])*0.5f,(_object.m_boxMax[1]-_object.m_boxMin[1])*0.5f,
+                   (_object.m_boxMax[2]-_object.m_boxMin[2])*0.5f);
+  for(int axis=0; axis<3; ++axis)
+  {
+    for(ngl::Real side=-1.0f; side<=1.0f; side+=2.0f)
+    {
+      ngl::Real plane[4];
+      for(int r=0; r<4; ++r)
+      {
+        plane[r]=m[r][3]+side*m[r][axis];
+      }
+      ngl::Real distance=plane[0]*centre.m_x+plane[1]*centre.m_y+plane[2]*centre.m_z+plane[3];
+      ngl::Real radius=std::abs(plane[0])*extent.m_x+std::abs(plane[1])*extent.m_y+std::abs(plane[2])*extent.m_z;
+      if(distance+radius<0.0f)
+      {
+        return false;
+      }
+    }
+  }
+  const MeshRanges &ranges=m_ranges[_object.m_mesh];
+  size_t level=0;
+  if(_useLOD)
+  {
+    AABB box(ngl::Vec3(_object.m_boxMin[0],_object.m_boxMin[1],_object.m_boxMin[2]),
+             ngl::Vec3(_object.m_boxMax[0],_object.m_boxMax[1],_object.m_boxMax[2]));
+    ngl::Real pixels=MeshLOD::projectedSize(box,_VP,_viewportWidth,_viewportHeight);
+    if(pixels<=0.0f)
+    {
+      level=ranges.m_numLevels-1;
+    }
+    else if(pixels<MeshLOD::c_fullDetailPixels)
+    {
+      level=std::min<size_t>(static_cast<size_t>(std::log2(MeshLOD::c_fullDetailPixels/pixels)),ranges.m_numLevels-1);
+    }
+  }
+  _command={ranges.m_count[level],1,ranges.m_first[level],ranges.m_baseVertex,0};
+  return true;
+}
+
+IndirectRenderer::Counts IndirectRenderer::draw(size_t _view, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight, bool _useLOD,
+                                                Culling _culling)
+{
+  Counts counts;
+#if !defined(__APPLE__)
+  size_t count=m_objects.size();
+  if(count==0 || _view>=m_numViews)
+  {
+    return counts;
+  }
+  size_t commandBase=_view*m_capacity;
+  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+  if(_culling==Culling::GPU)
+  {
+    // unused slots have to stay zero so they draw nothing
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,m_commands);
+    glClearBufferSubData(GL_SHADER_STORAGE_BUFFER,GL_R32UI,commandBase*sizeof(Command),count*sizeof(Command),
+                         GL_RED_INTEGER,GL_UNSIGNED_INT,nullptr);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,0,m_objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,1,m_meshBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,2,m_commands);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,3,m_frames[m_current].m_counters);
+    shader->use(c_cullProgram);
+    Stats::add(Stats::Counter::PROGRAM_SWITCHES);
+    shader->setUniform("VP",_VP);
+    shader->setUniform("numObjects",static_cast<int>(count));
+    shader->setUniform("viewportWidth",_viewportWidth);
+    shader->setUniform("viewportHeight",_viewportHeight);
+    shader->setUniform("useLOD",_useLOD ? 1 : 0);
+    shader->setUniform("fullDetailPixels",MeshLOD::c_fullDetailPixels);
+    shader->setUniform("commandBase",static_cast<int>(commandBase));
+    shader->setUniform("counterBase",static_cast<int>(_view*(c_numTotals+m_batchCapacity)));
+    glDispatchCompute(static_cast<GLuint>((count+c_groupSize-1)/c_groupSize),1,1);
+    // the commands are read by the draw, the counters later by collect()
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+  }
+  else
+  {
+    m_cpuCommands.assign(count,Command());
+    for(const auto &b : m_batches)
+    {
+      uint32_t fill=b.m_start;
+      for(uint32_t k=b.m_start; k<b.m_start+b.m_size; ++k)
+      {
+        Command command;
+        if(cullObject(m_objects[k],_VP,_viewportWidth,_viewportHeight,_useLOD,command))
+        {
+          command.m_baseInstance=k;
+          m_cpuCommands[fill++]=command;
+          ++counts.m_nodes;
+          counts.m_triangles+=command.m_count/3;
+          counts.m_fullTriangles+=m_ranges[m_objects[k].m_mesh].m_count[0]/3;
+        }
+      }
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER,m_commands);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,commandBase*sizeof(Command),count*sizeof(Command),&m_cpuCommands[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+    Stats::add(Stats::Counter::GL_BYTES_UPLOADED,count*sizeof(Command));
+    Stats::add(Stats::Counter::TRIANGLES,counts.m_triangles);
+  }
+
+  // one call per texture, each reads that texture's slots
+  shader->use(c_drawProgram);
+  Stats::add(Stats::Counter::PROGRAM_SWITCHES);
+  shader->setUniform("VP",_VP);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,0,m_objectBuffer);
+  glBindVertexArray(m_vao);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER,m_commands);
+  for(const auto &b : m_batches)
+  {
+    glBindTexture(GL_TEXTURE_2D,b.m_texture);
+    glMultiDrawElementsIndirect(GL_TRIANGLES,GL_UNSIGNED_INT,reinterpret_cast<const void *>((commandBase+b.m_start)*sizeof(Command)),
+                                static_cast<GLsizei>(b.m_size),0);
+    Stats::add(Stats::Counter::DRAW_CALLS);
+  }
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER,0);
+  glBindVertexArray(0);
+  for(GLuint binding=0; binding<4; ++binding)
+  {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,binding,0);
+  }
+#endif
+  return counts;
+}
+
+void IndirectRenderer::endFrame()
+{
+#if !defined(__APPLE__)
+  if(m_objects.empty())
+  {
+    return;
+  }
+  m_frames[m_current].m_fence=glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+  m_current=(m_current+1)%c_framesInFlight;
+#endif
+}
+
+bool IndirectRenderer::collect(std::array<Counts,Stats::c_maxViews> &_counts)
+{
+  bool found=false;
+#if !defined(__APPLE__)
+  // oldest first, so the newest finished frame is the one left in _counts
+  for(size_t n=0; n<c_framesInFlight; ++n)
+  {
+    Frame &frame=m_frames[(m_current+n)%c_framesInFlight];
+    if(!frame.m_fence)
+    {
+      continue;
+    }
+    GLenum status=glClientWaitSync(frame.m_fence,GL_SYNC_FLUSH_COMMANDS_BIT,0);
+    if(status!=GL_ALREADY_SIGNALED && status!=GL_CONDITION_SATISFIED)
+    {
+      break;
+    }
+    glDeleteSync(frame.m_fence);
+    frame.m_fence=nullptr;
+    size_t stride=c_numTotals+m_batchCapacity;
+    m_counterData.resize(m_numViews*stride);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,frame.m_counters);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER,0,m_counterData.size()*sizeof(uint32_t),&m_counterData[0]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER,0);
+    for(size_t v=0; v<m_numViews; ++v)
+    {
+      _counts[v].m_nodes=m_counterData[v*stride];
+      _counts[v].m_triangles=m_counterData[v*stride+1];
+      _counts[v].m_fullTriangles=m_counterData[v*stride+2];
+      // counted in the frame they come back in
+      Stats::add(Stats::Counter::TRIANGLES,_counts[v].m_triangles);
+    }
+    found=true;
+  }
+#endif
+  return found;
+}
@@ -0,0 +1,562 @@
+#include "LinearBVH.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+constexpr uint32_t LinearBVH::c_leaf;
+constexpr size_t LinearBVH::c_grain;
+constexpr int LinearBVH::c_radixBits;
+constexpr size_t LinearBVH::c_stackSize;
+constexpr size_t LinearBVH::c_buckets;
+
+namespace
+{
+  int leadingZeros(uint64_t _v)
+  {
+#if defined(_MSC_VER)
+    unsigned long bit;
+    _BitScanReverse64(&bit,_v);
+    return 63-static_cast<int>(bit);
+#else
+    return __builtin_clzll(_v);
+#endif
+  }
+
+  // spread the low 10 bits out to every third bit
+  uint64_t spread10(uint32_t _v)
+  {
+    _v=(_v*0x00010001u) & 0xff0000ffu;
+    _v=(_v*0x00000101u) & 0x0f00f00fu;
+    _v=(_v*0x00000011u) & 0xc30c30c3u;
+    _v=(_v*0x00000005u) & 0x49249249u;
+    return _v;
+  }
+
+  // spread the low 21 bits out to every third bit
+  uint64_t spread21(uint64_t _v)
+  {
+    _v&=0x1fffff;
+    _v=(_v | _v<<32) & 0x1f00000000ffffull;
+    _v=(_v | _v<<16) & 0x1f0000ff0000ffull;
+    _v=(_v | _v<<8) & 0x100f00f00f00f00full;
+    _v=(_v | _v<<4) & 0x10c30c30c30c30c3ull;
+    _v=(_v | _v<<2) & 0x1249249249249249ull;
+    return _v;
+  }
+
+  ngl::Real distance2(const AABB &_box, const ngl::Vec3 &_p)
+  {
+    ngl::Real d2=0.0f;
+    for(int a=0; a<3; ++a)
+    {
+      ngl::Real d=std::max(_box.m_min[a]-_p[a],std::max(0.0f,_p[a]-_box.m_max[a]));
+      d2+=d*d;
+    }
+    return d2;
+  }
+
+  // slab test, where the ray enters _box if it does before _maxT. An axis the ray is parallel
+  // to gives 0*inf on the box's face, which the max and min below ignore.
+  bool rayEnters(const AABB &_box, const ngl::Vec3 &_origin, const ngl::Vec3 &_inverse, ngl::Real _maxT, ngl::Real &_t)
+  {
+    ngl::Real near=0.0f;
+    ngl::Real far=_maxT;
+    for(int a=0; a<3; ++a)
+    {
+      ngl::Real t0=(_box.m_min[a]-_origin[a])*_inverse[a];
+      ngl::Real t1=(_box.m_max[a]-_origin[a])*_inverse[a];
+      if(t0>t1)
+      {
+        std::swap(t0,t1);
+      }
+      near=std::max(near,t0);
+      far=std::min(far,t1);
+    }
+    _t=near;
+    return near<=far;
+  }
+}
+
+LinearBVH::LinearBVH(WorkerPool *_pool) : m_pool(_pool ? _pool : &WorkerPool::shared())
+{
+}
+
+LinearBVH::~LinearBVH()=default;
+
+AABB LinearBVH::bounds() const
+{
+  if(m_order.empty())
+  {
+    return AABB();
+  }
+  return m_nodes.empty() ? m_leafBoxes[0] : m_nodes[0].m_box;
+}
+
+void LinearBVH::build(const AABB *_boxes, size_t _count, CodeBits _bits)
+{
+  WorkerPool &pool=*m_pool;
+  size_t numChunks=(_count+c_grain-1)/c_grain;
+  m_codes.resize(_count);
+  m_order.resize(_count);
+  m_codesScratch.resize(_count);
+  m_orderScratch.resize(_count);
+  m_leafBoxes.resize(_count);
+  m_nodes.resize(_count ? _count-1 : 0);
+  m_parents.resize(_count ? 2*_count-1 : 0);
+  if(_count<2)
+  {
+    if(_count)
+    {
+      m_order[0]=0;
+      m_leafBoxes[0]=_boxes[0];
+    }
+    return;
+  }
+
+  // the codes cover the box of the centres
+  m_chunkBounds.assign(numChunks,AABB());
+  pool.parallelFor(_count,c_grain,[this,_boxes](size_t _begin, size_t _end)
+  {
+    AABB bounds;
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      bounds.extend(_boxes[i].center());
+    }
+    m_chunkBounds[_begin/c_grain]=bounds;
+  });
+  AABB centres;
+  for(const auto &b : m_chunkBounds)
+  {
+    centres.extend(b);
+  }
+  bool wide=_bits==CodeBits::BITS63;
+  uint64_t cellMax= wide ? (1<<21)-1 : (1<<10)-1;
+  ngl::Real cells=static_cast<ngl::Real>(cellMax);
+  ngl::Vec3 extent=centres.size();
+  ngl::Vec3 scale;
+  for(int a=0; a<3; ++a)
+  {
+    scale[a]= extent[a]>0.0f ? cells/extent[a] : 0.0f;
+  }
+  pool.parallelFor(_count,c_grain,[this,_boxes,&centres,&scale,wide,cellMax](size_t _begin, size_t _end)
+  {
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      ngl::Vec3 c=_boxes[i].center();
+      uint64_t q[3];
+      for(int a=0; a<3; ++a)
+      {
+        q[a]=std::min(static_cast<uint64_t>((c[a]-centres.m_min[a])*scale[a]),cellMax);
+      }
+      m_codes[i]= wide ? (spread21(q[0])<<2 | spread21(q[1])<<1 | spread21(q[2])) :
+                         (spread10(static_cast<uint32_t>(q[0]))<<2 | spread10(static_cast<uint32_t>(q[1]))<<1 |
+                          spread10(static_cast<uint32_t>(q[2])));
+      m_order[i]=static_cast<uint32_t>(i);
+    }
+  });
+  sortCodes(wide ? 63 : 30);
+  pool.parallelFor(_count,c_grain,[this,_boxes](size_t _begin, size_t _end)
+  {
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      m_leafBoxes[i]=_boxes[m_order[i]];
+    }
+  });
+
+  // every internal node finds its own range and split
+  pool.parallelFor(_count-1,c_grain,[this](size_t _begin, size_t _end)
+  {
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      buildNode(static_cast<uint32_t>(i));
+    }
+  });
+
+  fitNodes();
+}
+
+void LinearBVH::refit(const AABB *_boxes)
+{
+  m_pool->parallelFor(m_order.size(),c_grain,[this,_boxes](size_t _begin, size_t _end)
+  {
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      m_leafBoxes[i]=_boxes[m_order[i]];
+    }
+  });
+  fitNodes();
+}
+
+void LinearBVH::fitNodes()
+{
+  // fit the boxes from the leaves up, the second child to finish fits the parent
+  size_t count=m_order.size();
+  if(count<2)
+  {
+    return;
+  }
+  if(m_visitCapacity<count-1)
+  {
+    m_visits.reset(new std::atomic<uint32_t>[count-1]);
+    m_visitCapacity=count-1;
+  }
+  m_pool->parallelFor(count-1,c_grain,[this](size_t _begin, size_t _end)
+  {
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      m_visits[i].store(0,std::memory_order_relaxed);
+    }
+  });
+  m_pool->parallelFor(count,c_grain,[this,count](size_t _begin, size_t _end)
+  {
+    for(size_t leaf=_begin; leaf<_end; ++leaf)
+    {
+      uint32_t index=m_parents[count-1+leaf];
+      // release so the sibling sees this side's box, acquire to see the sibling's
+      while(m_visits[index].fetch_add(1,std::memory_order_acq_rel)==1)
+      {
+        Node &node=m_nodes[index];
+        node.m_box= node.m_left & c_leaf ? m_leafBoxes[node.m_left & ~c_leaf] : m_nodes[node.m_left].m_box;
+        node.m_box.extend(node.m_right & c_leaf ? m_leafBoxes[node.m_right & ~c_leaf] : m_nodes[node.m_right].m_box);
+        if(index==0)
+        {
+          break;
+        }
+        index=m_parents[index];
+      }
+    }
+  });
+}
+
+double LinearBVH::sahCost() const
+{
+  // every node is tested when its parent is reached, so each box costs its area relative to
+  // the root's. Node and leaf tests are counted the same.
+  size_t count=m_order.size();
+  if(count<2)
+  {
+    return static_cast<double>(count);
+  }
+  // the partial sums are local so const callers on different threads do not share them
+  std::vector<double> chunkCost((count+c_grain-1)/c_grain,0.0);
+  m_pool->parallelFor(count,c_grain,[this,count,&chunkCost](size_t _begin, size_t _end)
+  {
+    double cost=0.0;
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      cost+=m_leafBoxes[i].surfaceArea();
+      if(i<count-1)
+      {
+        cost+=m_nodes[i].m_box.surfaceArea();
+      }
+    }
+    chunkCost[_begin/c_grain]=cost;
+  });
+  double cost=0.0;
+  for(double c : chunkCost)
+  {
+    cost+=c;
+  }
+  double rootArea=m_nodes[0].m_box.surfaceArea();
+  return rootArea>0.0 ? cost/rootArea : static_cast<double>(count);
+}
+
+void LinearBVH::setPool(WorkerPool *_pool)
+{
+  m_pool= _pool ? _pool : &WorkerPool::shared();
+}
+
+void LinearBVH::sortCodes(int _bits)
+{
+  size_t count=m_codes.size();
+  size_t numChunks=(count+c_grain-1)/c_grain;
+  m_histograms.resize(numChunks*c_buckets);
+  for(int shift=0; shift<_bits; shift+=c_radixBits)
+  {
+    m_pool->parallelFor(count,c_grain,[this,shift](size_t _begin, size_t _end)
+    {
+      size_t *histogram=&m_histograms[(_begin/c_grain)*c_buckets];
+      std::fill(histogram,histogram+c_buckets,0);
+      for(size_t i=_begin; i<_end; ++i)
+      {
+        ++histogram[(m_codes[i]>>shift) & (c_buckets-1)];
+      }
+    });
+    // digit major so each chunk's keys for a digit land after the earlier chunks', which keeps
+    // the sort stable. A digit every key shares would just copy everything so is skipped.
+    size_t offset=0;
+    bool allSame=false;
+    for(size_t digit=0; digit<c_buckets; ++digit)
+    {
+      size_t start=offset;
+      for(size_t c=0; c<numChunks; ++c)
+      {
+        size_t n=m_histograms[c*c_buckets+digit];
+        m_histograms[c*c_buckets+digit]=offset;
+        offset+=n;
+      }
+      allSame|= offset-start==count;
+    }
+    if(allSame)
+    {
+      continue;
+    }
+    m_pool->parallelFor(count,c_grain,[this,shift](size_t _begin, size_t _end)
+    {
+      size_t *next=&m_histograms[(_begin/c_grain)*c_buckets];
+      for(size_t i=_begin; i<_end; ++i)
+      {
+        size_t to=next[(m_codes[i]>>shift) & (c_buckets-1)]++;
+        m_codesScratch[to]=m_codes[i];
+        m_orderScratch[to]=m_order[i];
+      }
+    });
+    m_codes.swap(m_codesScratch);
+    m_order.swap(m_orderScratch);
+  }
+}
+
+int LinearBVH::delta(int64_t _i, int64_t _j) const
+{
+  if(_j<0 || _j>=static_cast<int64_t>(m_codes.size()))
+  {
+    return -1;
+  }
+  uint64_t a=m_codes[static_cast<size_t>(_i)];
+  uint64_t b=m_codes[static_cast<size_t>(_j)];
+  if(a==b)
+  {
+    return 64+leadingZeros(static_cast<uint64_t>(_i ^ _j));
+  }
+  return leadingZeros(a ^ b);
+}
+
+void LinearBVH::buildNode(uint32_t _index)
+{
+  int64_t i=_index;
+  // the node's range runs towards the neighbour sharing the longer prefix
+  int64_t d= delta(i,i+1)>delta(i,i-1) ? 1 : -1;
+  int deltaMin=delta(i,i-d);
+  int64_t lengthMax=2;
+  while(delta(i,i+lengthMax*d)>deltaMin)
+  {
+    lengthMax*=2;
+  }
+  int64_t length=0;
+  for(int64_t t=lengthMax/2; t>=1; t/=2)
+  {
+    if(delta(i,i+(length+t)*d)>deltaMin)
+    {
+      length+=t;
+    }
+  }
+  int64_t j=i+length*d;
+  // split where the prefix of the whole range ends
+  int deltaNode=delta(i,j);
+  int64_t split=0;
+  int64_t t=length;
+  do
+  {
+    t=(t+1)/2;
+    if(delta(i,i+(split+t)*d)>deltaNode)
+    {
+      split+=t;
+    }
+  }
+  while(t>1);
+  int64_t gamma=i+split*d+std::min<int64_t>(d,0);
+  uint32_t first=static_cast<uint32_t>(std::min(i,j));
+  uint32_t last=static_cast<uint32_t>(std::max(i,j));
+  uint32_t left=static_cast<uint32_t>(gamma);
+  uint32_t right=left+1;
+  // leaf k's parent is after the internal nodes'
+  size_t internal=m_nodes.size();
+  Node &node=m_nodes[_index];
+  if(left==first)
+  {
+    node.m_left=left | c_leaf;
+    m_parents[internal+left]=_index;
+  }
+  else
+  {
+    node.m_left=left;
+    m_parents[left]=_index;
+  }
+  if(right==last)
+  {
+    node.m_right=right | c_leaf;
+    m_parents[internal+right]=_index;
+  }
+  else
+  {
+    node.m_right=right;
+    m_parents[right]=_index;
+  }
+}
+
+template<typename Inside> void LinearBVH::query(const Inside &_inside, std::vector<uint32_t> &_out) const
+{
+  if(m_nodes.empty())
+  {
+    if(!m_order.empty() && _inside(m_leafBoxes[0]))
+    {
+      _out.push_back(m_order[0]);
+    }
+    return;
+  }
+  if(!_inside(m_nodes[0].m_box))
+  {
+    return;
+  }
+  uint32_t stack[c_stackSize];
+  size_t top=0;
+  stack[top++]=0;
+  while(top)
+  {
+    const Node &node=m_nodes[stack[--top]];
+    for(uint32_t child : {node.m_right,node.m_left})
+    {
+      if(child & c_leaf)
+      {
+        if(_inside(m_leafBoxes[child & ~c_leaf]))
+        {
+          _out.push_back(m_order[child & ~c_leaf]);
+        }
+      }
+      else if(_inside(m_nodes[child].m_box))
+      {
+        stack[top++]=child;
+      }
+    }
+  }
+}
+
+void LinearBVH::queryBox(const AABB &_box, std::vector<uint32_t> &_out) const
+{
+  query([&_box](const AABB &_b){return _b.overlaps(_box);},_out);
+}
+
+void LinearBVH::querySphere(const ngl::Vec3 &_centre, ngl::Real _radius, std::vector<uint32_t> &_out) const
+{
+  ngl::Real radius2=_radius*_radius;
+  query([&_centre,radius2](const AABB &_b){return distance2(_b,_centre)<=radius2;},_out);
+}
+
+bool LinearBVH::raycast(const ngl::Vec3 &_origin, const ngl::Vec3 &_direction, ngl::Real _maxT, uint32_t &_object, ngl::Real &_t) const
+{
+  if(m_order.empty())
+  {
+    return false;
+  }
+  // dividing by a zero component gives an infinity, which is what the slab test wants
+  ngl::Vec3 inverse(1.0f/_direction.m_x,1.0f/_direction.m_y,1.0f/_direction.m_z);
+  ngl::Real best=_maxT;
+  uint32_t hit=c_leaf;
+  ngl::Real t;
+  if(m_nodes.empty())
+  {
+    if(rayEnters(m_leafBoxes[0],_origin,inverse,best,t))
+    {
+      _object=m_order[0];
+      _t=t;
+      return true;
+    }
+    return false;
+  }
+  if(!rayEnters(m_nodes[0].m_box,_origin,inverse,best,t))
+  {
+    return false;
+  }
+  uint32_t stack[c_stackSize];
+  size_t top=0;
+  stack[top++]=0;
+  while(top)
+  {
+    const Node &node=m_nodes[stack[--top]];
+    // visit the nearer child first so the further one is usually pruned
+    uint32_t inner[2];
+    ngl::Real entry[2];
+    size_t numInner=0;
+    for(uint32_t child : {node.m_left,node.m_right})
+    {
+      if(child & c_leaf)
+      {
+        if(rayEnters(m_leafBoxes[child & ~c_leaf],_origin,inverse,best,t))
+        {
+          best=t;
+          hit=child & ~c_leaf;
+        }
+      }
+      else if(rayEnters(m_nodes[child].m_box,_origin,inverse,best,t))
+      {
+        inner[numInner]=child;
+        entry[numInner++]=t;
+      }
+    }
+    if(numInner==2 && entry[0]<entry[1])
+    {
+      std::swap(inner[0],inner[1]);
+    }
+    for(size_t i=0; i<numInner; ++i)
+    {
+      stack[top++]=inner[i];
+    }
+  }
+  if(hit==c_leaf)
+  {
+    return false;
+  }
+  _object=m_order[hit];
+  _t=best;
+  return true;
+}
+
+void LinearBVH::queryPairs(std::vector<Pair> &_out)
+{
+  size_t count=m_order.size();
+  if(count<2)
+  {
+    return;
+  }
+  m_chunkPairs.resize((count+c_grain-1)/c_grain);
+  m_pool->parallelFor(count,c_grain,[this](size_t _begin, size_t _end)
+  {
+    std::vector<Pair> &pairs=m_chunkPairs[_begin/c_grain];
+    pairs.clear();
+    uint32_t stack[c_stackSize];
+    for(size_t leaf=_begin; leaf<_end; ++leaf)
+    {
+      // each leaf looks for the overlapping leaves after it in the sorted order
+      const AABB &box=m_leafBoxes[leaf];
+      uint32_t a=m_order[leaf];
+      size_t top=0;
+      stack[top++]=0;
+      while(top)
+      {
+        const Node &node=m_nodes[stack[--top]];
+        for(uint32_t child : {node.m_right,node.m_left})
+        {
+          if(child & c_leaf)
+          {
+            uint32_t other=child & ~c_leaf;
+            if(other>leaf && m_leafBoxes[other].overlaps(box))
+            {
+              uint32_t b=m_order[other];
+              pairs.push_back(a<b ? Pair(a,b) : Pair(b,a));
+            }
+          }
+          else if(m_nodes[child].m_box.overlaps(box))
+          {
+            stack[top++]=child;
+          }
+        }
+      }
+    }
+  });
+  for(const auto &pairs : m_chunkPairs)
+  {
+    _out.insert(_out.end(),pairs.begin(),pairs.end());
+  }
+}
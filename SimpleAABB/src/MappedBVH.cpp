@@ -0,0 +1,217 @@
+#include "MappedBVH.h"
+#include "AtomicWrite.h"
+#include <cstring>
+#include <fstream>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  // 2 stored the full mesh's triangles in meshlet order and 3 in the vertex cache order
+  // IndexOptimizer gives each meshlet, both renumber the leaves
+  constexpr uint32_t c_bvhVersion=3;
+  // each array starts on its own cache line
+  constexpr uint64_t c_alignment=64;
+  // deep enough for any tree LinearBVH builds
+  constexpr size_t c_stackSize=130;
+
+  uint64_t alignUp(uint64_t _offset)
+  {
+    return (_offset+c_alignment-1) & ~(c_alignment-1);
+  }
+
+  // _count items of _bytes each from _offset are inside a _fileBytes file and start where write()
+  // puts an array. Written so a corrupt offset or count can not overflow.
+  bool fits(uint64_t _offset, uint64_t _count, uint64_t _bytes, uint64_t _fileBytes)
+  {
+    return _offset%c_alignment==0 && _offset<=_fileBytes && _count<=(_fileBytes-_offset)/_bytes;
+  }
+
+  void pad(std::ostream &_out, uint64_t _to)
+  {
+    static const char zeros[c_alignment]={};
+    uint64_t at=static_cast<uint64_t>(_out.tellp());
+    _out.write(zeros,static_cast<std::streamsize>(_to-at));
+  }
+}
+
+MappedBVH::~MappedBVH()
+{
+  close();
+}
+
+void MappedBVH::close()
+{
+#ifndef _WIN32
+  if(m_data && m_copy.empty())
+  {
+    munmap(const_cast<char *>(m_data),m_size);
+  }
+#endif
+  m_copy.clear();
+  m_data=nullptr;
+  m_size=0;
+  m_header=nullptr;
+  m_nodes=nullptr;
+  m_leafBoxes=nullptr;
+  m_order=nullptr;
+}
+
+bool MappedBVH::open(const std::string &_file, uint64_t _sourceKey)
+{
+  close();
+#ifndef _WIN32
+  int fd=::open(_file.c_str(),O_RDONLY);
+  if(fd<0)
+  {
+    return false;
+  }
+  struct stat info;
+  if(fstat(fd,&info)!=0 || static_cast<size_t>(info.st_size)<sizeof(Header))
+  {
+    ::close(fd);
+    return false;
+  }
+  size_t size=static_cast<size_t>(info.st_size);
+  void *data=mmap(nullptr,size,PROT_READ,MAP_SHARED,fd,0);
+  // the mapping keeps the file alive
+  ::close(fd);
+  if(data==MAP_FAILED)
+  {
+    return false;
+  }
+  m_data=static_cast<const char *>(data);
+  m_size=size;
+#else
+  std::ifstream in(_file,std::ios::binary | std::ios::ate);
+  if(!in.is_open() || static_cast<size_t>(in.tellg())<sizeof(Header))
+  {
+    return false;
+  }
+  m_copy.resize(static_cast<size_t>(in.tellg()));
+  in.seekg(0);
+  in.read(m_copy.data(),static_cast<std::streamsize>(m_copy.size()));
+  if(!in)
+  {
+    m_copy.clear();
+    return false;
+  }
+  m_data=m_copy.data();
+  m_size=m_copy.size();
+#endif
+  const Header *h=reinterpret_cast<const Header *>(m_data);
+  uint64_t leaves=h->m_numLeaves;
+  bool valid=std::memcmp(h->m_magic,"ABVH",4)==0 && h->m_version==c_bvhVersion && h->m_sourceKey==_sourceKey &&
+             h->m_nodeBytes==sizeof(LinearBVH::Node) && h->m_fileBytes==m_size && leaves>0 && leaves<LinearBVH::c_leaf &&
+             h->m_nodesOffset>=sizeof(Header) && fits(h->m_nodesOffset,leaves-1,sizeof(LinearBVH::Node),m_size) &&
+             h->m_leafBoxesOffset>=sizeof(Header) && fits(h->m_leafBoxesOffset,leaves,sizeof(AABB),m_size) &&
+             h->m_orderOffset>=sizeof(Header) && fits(h->m_orderOffset,leaves,sizeof(uint32_t),m_size);
+  if(valid)
+  {
+    m_header=h;
+    m_nodes=reinterpret_cast<const LinearBVH::Node *>(m_data+h->m_nodesOffset);
+    m_leafBoxes=reinterpret_cast<const AABB *>(m_data+h->m_leafBoxesOffset);
+    m_order=reinterpret_cast<const uint32_t *>(m_data+h->m_orderOffset);
+  }
+  if(!valid)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool MappedBVH::write(const std::string &_file, uint64_t _sourceKey, const LinearBVH &_tree, const AABB &_bounds)
+{
+  uint32_t leaves=static_cast<uint32_t>(_tree.size());
+  if(leaves==0)
+  {
+    return false;
+  }
+  Header h;
+  std::memcpy(h.m_magic,"ABVH",4);
+  h.m_version=c_bvhVersion;
+  h.m_sourceKey=_sourceKey;
+  h.m_nodeBytes=sizeof(LinearBVH::Node);
+  h.m_numLeaves=leaves;
+  h.m_nodesOffset=alignUp(sizeof(Header));
+  h.m_leafBoxesOffset=alignUp(h.m_nodesOffset+(leaves-1)*sizeof(LinearBVH::Node));
+  h.m_orderOffset=alignUp(h.m_leafBoxesOffset+leaves*sizeof(AABB));
+  h.m_fileBytes=h.m_orderOffset+leaves*sizeof(uint32_t);
+  h.m_bounds=_bounds;
+
+  return writeAtomically(_file,[&](std::ostream &_out)
+  {
+    _out.write(reinterpret_cast<const char *>(&h),sizeof(Header));
+    pad(_out,h.m_nodesOffset);
+    for(uint32_t i=0; i+1<leaves; ++i)
+    {
+      _out.write(reinterpret_cast<const char *>(&_tree.node(i)),sizeof(LinearBVH::Node));
+    }
+    pad(_out,h.m_leafBoxesOffset);
+    for(uint32_t i=0; i<leaves; ++i)
+    {
+      _out.write(reinterpret_cast<const char *>(&_tree.leafBox(i)),sizeof(AABB));
+    }
+    pad(_out,h.m_orderOffset);
+    for(uint32_t i=0; i<leaves; ++i)
+    {
+      uint32_t id=_tree.objectAt(i);
+      _out.write(reinterpret_cast<const char *>(&id),sizeof(uint32_t));
+    }
+    return static_cast<bool>(_out);
+  });
+}
+
+void MappedBVH::queryBox(const AABB &_box, std::vector<uint32_t> &_out) const
+{
+  if(!m_header)
+  {
+    return;
+  }
+  size_t leaves=m_header->m_numLeaves;
+  if(leaves==1)
+  {
+    if(m_leafBoxes[0].overlaps(_box) && m_order[0]==0)
+    {
+      _out.push_back(0);
+    }
+    return;
+  }
+  if(!m_nodes[0].m_box.overlaps(_box))
+  {
+    return;
+  }
+  // open() only checks the header, so the walk checks each index before it follows it. A valid
+  // tree visits each internal node at most once and never fills the stack, so a corrupt one
+  // stops early rather than looping or reading outside the file.
+  size_t internal=leaves-1;
+  size_t visits=0;
+  uint32_t stack[c_stackSize];
+  size_t top=0;
+  stack[top++]=0;
+  while(top && ++visits<=internal)
+  {
+    const LinearBVH::Node &node=m_nodes[stack[--top]];
+    for(uint32_t child : {node.m_right,node.m_left})
+    {
+      if(child & LinearBVH::c_leaf)
+      {
+        uint32_t leaf=child & ~LinearBVH::c_leaf;
+        if(leaf<leaves && m_leafBoxes[leaf].overlaps(_box) && m_order[leaf]<leaves)
+        {
+          _out.push_back(m_order[leaf]);
+        }
+      }
+      else if(child>0 && child<internal && top<c_stackSize && m_nodes[child].m_box.overlaps(_box))
+      {
+        stack[top++]=child;
+      }
+    }
+  }
+}
@@ -0,0 +1,773 @@
+#include "MeshLOD.h"
+#include "IndexOptimizer.h"
+#include "Stats.h"
+#include "WorkerPool.h"
+#include <ngl/Vec4.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <sys/stat.h>
+#include <unordered_map>
+#include <utility>
+
+constexpr ngl::Real MeshLOD::c_fullDetailPixels;
+constexpr size_t MeshLOD::c_positionStride;
+MeshLOD::VertexFormat MeshLOD::s_vertexFormat=MeshLOD::VertexFormat::FLOAT;
+bool MeshLOD::s_optimizeIndices=true;
+
+namespace
+{
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief symmetric 4x4 error quadric (Garland / Heckbert) stored as its 10 unique terms
+  //----------------------------------------------------------------------------------------------------------------------
+  struct Quadric
+  {
+    double m_q[10]={0,0,0,0,0,0,0,0,0,0};
+    // add the plane ax+by+cz+d=0 scaled by _w
+    void addPlane(double _a, double _b, double _c, double _d, double _w)
+    {
+      m_q[0]+=_w*_a*_a; m_q[1]+=_w*_a*_b; m_q[2]+=_w*_a*_c; m_q[3]+=_w*_a*_d;
+      m_q[4]+=_w*_b*_b; m_q[5]+=_w*_b*_c; m_q[6]+=_w*_b*_d;
+      m_q[7]+=_w*_c*_c; m_q[8]+=_w*_c*_d;
+      m_q[9]+=_w*_d*_d;
+    }
+    void operator+=(const Quadric &_o)
+    {
+      for(int i=0; i<10; ++i)
+      {
+        m_q[i]+=_o.m_q[i];
+      }
+    }
+    double error(const ngl::Vec3 &_p) const
+    {
+      double x=_p.m_x, y=_p.m_y, z=_p.m_z;
+      return m_q[0]*x*x + 2.0*m_q[1]*x*y + 2.0*m_q[2]*x*z + 2.0*m_q[3]*x
+           + m_q[4]*y*y + 2.0*m_q[5]*y*z + 2.0*m_q[6]*y
+           + m_q[7]*z*z + 2.0*m_q[8]*z
+           + m_q[9];
+    }
+  };
+
+  //----------------------------------------------------------------------------------------------------------------------
+  /// @brief half edge collapse simplifier. Works on the welded positions so uv / normal seams
+  /// do not look like holes, collapsed corners then pick the closest vertex (by uv / normal)
+  /// of the surviving position. As no new positions are made every level can index the
+  /// original vertex buffer.
+  //----------------------------------------------------------------------------------------------------------------------
+  class Simplifier
+  {
+    public :
+      explicit Simplifier(const IndexedMesh &_mesh);
+      // collapse until _target or fewer triangles remain (or nothing else can collapse)
+      void collapseTo(size_t _target);
+      size_t liveTriangles() const {return m_live;}
+      // append the live triangles as indices into the original vertex buffer
+      void emit(std::vector<GLuint> &_out) const;
+
+    private :
+      struct Candidate
+      {
+        double m_cost;
+        GLuint m_from;
+        GLuint m_to;
+        unsigned int m_fromStamp;
+        unsigned int m_toStamp;
+        bool operator>(const Candidate &_o) const {return m_cost>_o.m_cost;}
+      };
+      void pushEdge(GLuint _a, GLuint _b);
+      bool flips(GLuint _from, GLuint _to) const;
+      void collapse(GLuint _from, GLuint _to);
+      ngl::Vec3 triNormal(const GLuint *_p) const;
+
+      const IndexedMesh &m_mesh;
+      std::vector<ngl::Vec3> m_pos;
+      std::vector<Quadric> m_quadric;
+      std::vector<unsigned int> m_stamp;
+      std::vector<bool> m_dead;
+      // per position list of triangles using it (may contain dead ones)
+      std::vector<std::vector<GLuint>> m_posTris;
+      // per position list of the vertices (wedges) sitting on it
+      std::vector<std::vector<GLuint>> m_posVerts;
+      // current position ids of each triangle and whether it is still alive
+      std::vector<GLuint> m_tris;
+      std::vector<bool> m_alive;
+      size_t m_live=0;
+      std::priority_queue<Candidate,std::vector<Candidate>,std::greater<Candidate>> m_heap;
+  };
+
+  Simplifier::Simplifier(const IndexedMesh &_mesh) : m_mesh(_mesh)
+  {
+    size_t numPos=_mesh.m_numPositions;
+    m_pos.resize(numPos);
+    m_quadric.resize(numPos);
+    m_stamp.assign(numPos,0);
+    m_dead.assign(numPos,false);
+    m_posTris.resize(numPos);
+    m_posVerts.resize(numPos);
+    for(size_t v=0; v<_mesh.m_verts.size(); ++v)
+    {
+      const IndexedMesh::Vertex &vert=_mesh.m_verts[v];
+      GLuint p=_mesh.m_posIndex[v];
+      m_pos[p].set(vert.m_x,vert.m_y,vert.m_z);
+      m_posVerts[p].push_back(static_cast<GLuint>(v));
+    }
+
+    size_t numTris=_mesh.numTriangles();
+    m_tris.resize(numTris*3);
+    m_alive.assign(numTris,false);
+    // count how many triangles use each edge to find the open boundaries
+    std::unordered_map<uint64_t,int> edgeUse;
+    for(size_t t=0; t<numTris; ++t)
+    {
+      GLuint *tri=&m_tris[t*3];
+      for(int c=0; c<3; ++c)
+      {
+        tri[c]=_mesh.m_posIndex[_mesh.m_indices[t*3+c]];
+      }
+      if(tri[0]==tri[1] || tri[1]==tri[2] || tri[0]==tri[2])
+      {
+        continue;
+      }
+      m_alive[t]=true;
+      ++m_live;
+      ngl::Vec3 n=(m_pos[tri[1]]-m_pos[tri[0]]).cross(m_pos[tri[2]]-m_pos[tri[0]]);
+      double len=n.length();
+      if(len>0.0)
+      {
+        double a=n.m_x/len, b=n.m_y/len, c=n.m_z/len;
+        double d=-(a*m_pos[tri[0]].m_x+b*m_pos[tri[0]].m_y+c*m_pos[tri[0]].m_z);
+        // weight by area so big faces resist moving more than slivers
+        for(int k=0; k<3; ++k)
+        {
+          m_quadric[tri[k]].addPlane(a,b,c,d,len*0.5);
+        }
+      }
+      for(int c=0; c<3; ++c)
+      {
+        m_posTris[tri[c]].push_back(static_cast<GLuint>(t));
+        uint64_t lo=std::min(tri[c],tri[(c+1)%3]);
+        uint64_t hi=std::max(tri[c],tri[(c+1)%3]);
+        ++edgeUse[(lo<<32)|hi];
+      }
+    }
+
+    // open edges get a heavily weighted plane at right angles to the face so the outline is kept
+    for(size_t t=0; t<numTris; ++t)
+    {
+      if(!m_alive[t])
+      {
+        continue;
+      }
+      const GLuint *tri=&m_tris[t*3];
+      ngl::Vec3 n=triNormal(tri);
+      for(int c=0; c<3; ++c)
+      {
+        GLuint a=tri[c];
+        GLuint b=tri[(c+1)%3];
+        uint64_t lo=std::min(a,b);
+        uint64_t hi=std::max(a,b);
+        if(edgeUse[(lo<<32)|hi]!=1)
+        {
+          continue;
+        }
+        ngl::Vec3 e=m_pos[b]-m_pos[a];
+        ngl::Vec3 pn=e.cross(n);
+        double len=pn.length();
+        if(len<=0.0)
+        {
+          continue;
+        }
+        double pa=pn.m_x/len, pb=pn.m_y/len, pc=pn.m_z/len;
+        double d=-(pa*m_pos[a].m_x+pb*m_pos[a].m_y+pc*m_pos[a].m_z);
+        double w=1000.0*e.dot(e);
+        m_quadric[a].addPlane(pa,pb,pc,d,w);
+        m_quadric[b].addPlane(pa,pb,pc,d,w);
+      }
+    }
+
+    for(size_t t=0; t<numTris; ++t)
+    {
+      if(m_alive[t])
+      {
+        const GLuint *tri=&m_tris[t*3];
+        pushEdge(tri[0],tri[1]);
+        pushEdge(tri[1],tri[2]);
+        pushEdge(tri[2],tri[0]);
+      }
+    }
+  }
+
+  ngl::Vec3 Simplifier::triNormal(const GLuint *_p) const
+  {
+    ngl::Vec3 n=(m_pos[_p[1]]-m_pos[_p[0]]).cross(m_pos[_p[2]]-m_pos[_p[0]]);
+    ngl::Real len=n.length();
+    return len>0.0f ? n/len : n;
+  }
+
+  void Simplifier::pushEdge(GLuint _a, GLuint _b)
+  {
+    Quadric q=m_quadric[_a];
+    q+=m_quadric[_b];
+    double toB=q.error(m_pos[_b]);
+    double toA=q.error(m_pos[_a]);
+    Candidate c;
+    if(toB<=toA)
+    {
+      c.m_cost=toB; c.m_from=_a; c.m_to=_b;
+    }
+    else
+    {
+      c.m_cost=toA; c.m_from=_b; c.m_to=_a;
+    }
+    c.m_fromStamp=m_stamp[c.m_from];
+    c.m_toStamp=m_stamp[c.m_to];
+    m_heap.push(c);
+  }
+
+  bool Simplifier::flips(GLuint _from, GLuint _to) const
+  {
+    for(GLuint t : m_posTris[_from])
+    {
+      if(!m_alive[t])
+      {
+        continue;
+      }
+      const GLuint *tri=&m_tris[t*3];
+      if(tri[0]==_to || tri[1]==_to || tri[2]==_to)
+      {
+        continue;
+      }
+      GLuint moved[3]={tri[0],tri[1],tri[2]};
+      for(auto &p : moved)
+      {
+        if(p==_from)
+        {
+          p=_to;
+        }
+      }
+      ngl::Vec3 before=triNormal(tri);
+      ngl::Vec3 after=triNormal(moved);
+      // reject folds and triangles that collapse to slivers
+      if(after.dot(before)<0.2f)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void Simplifier::collapse(GLuint _from, GLuint _to)
+  {
+    for(GLuint t : m_posTris[_from])
+    {
+      if(!m_alive[t])
+      {
+        continue;
+      }
+      GLuint *tri=&m_tris[t*3];
+      if(tri[0]==_to || tri[1]==_to || tri[2]==_to)
+      {
+        m_alive[t]=false;
+        --m_live;
+        continue;
+      }
+      for(int c=0; c<3; ++c)
+      {
+        if(tri[c]==_from)
+        {
+          tri[c]=_to;
+        }
+      }
+      m_posTris[_to].push_back(t);
+    }
+    m_posTris[_from].clear();
+    m_dead[_from]=true;
+    m_quadric[_to]+=m_quadric[_from];
+    ++m_stamp[_to];
+    // drop dead entries so the lists do not keep growing
+    auto &list=m_posTris[_to];
+    list.erase(std::remove_if(list.begin(),list.end(),[this](GLuint _t){return !m_alive[_t];}),list.end());
+    for(GLuint t : list)
+    {
+      const GLuint *tri=&m_tris[t*3];
+      for(int c=0; c<3; ++c)
+      {
+        if(tri[c]!=_to)
+        {
+          pushEdge(_to,tri[c]);
+        }
+      }
+    }
+  }
+
+  void Simplifier::collapseTo(size_t _target)
+  {
+    while(m_live>_target && !m_heap.empty())
+    {
+      Candidate c=m_heap.top();
+      m_heap.pop();
+      if(m_dead[c.m_from] || m_dead[c.m_to] ||
+         m_stamp[c.m_from]!=c.m_fromStamp || m_stamp[c.m_to]!=c.m_toStamp)
+      {
+        continue;
+      }
+      if(flips(c.m_from,c.m_to))
+      {
+        continue;
+      }
+      collapse(c.m_from,c.m_to);
+    }
+  }
+
+  void Simplifier::emit(std::vector<GLuint> &_out) const
+  {
+    for(size_t t=0; t<m_alive.size(); ++t)
+    {
+      if(!m_alive[t])
+      {
+        continue;
+      }
+      for(int c=0; c<3; ++c)
+      {
+        GLuint orig=m_mesh.m_indices[t*3+c];
+        GLuint pos=m_tris[t*3+c];
+        if(m_mesh.m_posIndex[orig]==pos)
+        {
+          _out.push_back(orig);
+          continue;
+        }
+        // the corner moved, use the vertex on the new position with the closest attributes
+        const IndexedMesh::Vertex &o=m_mesh.m_verts[orig];
+        GLuint best=m_posVerts[pos].front();
+        ngl::Real bestScore=std::numeric_limits<ngl::Real>::max();
+        for(GLuint v : m_posVerts[pos])
+        {
+          const IndexedMesh::Vertex &w=m_mesh.m_verts[v];
+          ngl::Real du=w.m_u-o.m_u;
+          ngl::Real dv=w.m_v-o.m_v;
+          ngl::Real ndot=w.m_nx*o.m_nx+w.m_ny*o.m_ny+w.m_nz*o.m_nz;
+          ngl::Real score=du*du+dv*dv+0.1f*(1.0f-ndot);
+          if(score<bestScore)
+          {
+            bestScore=score;
+            best=v;
+          }
+        }
+        _out.push_back(best);
+      }
+    }
+  }
+
+  struct LODHeader
+  {
+    char m_magic[4];
+    uint32_t m_version;
+    uint64_t m_sourceKey;
+    uint32_t m_numVerts;
+    uint32_t m_numIndices;
+    uint32_t m_numLevels;
+    uint32_t m_numPositions;
+  };
+  // 7 since the vertices' obj positions are stored so a loaded mesh matches a built one
+  constexpr uint32_t c_lodVersion=7;
+}
+
+MeshLOD::MeshLOD(const std::string &_objFile, size_t _numLevels)
+{
+  // the cache is keyed on the obj's size and modification time so it can be checked
+  // without parsing the obj at all
+  struct stat info;
+  if(stat(_objFile.c_str(),&info)!=0)
+  {
+    std::cerr<<"unable to find mesh "<<_objFile<<"\n";
+    return;
+  }
+  uint64_t sourceKey=(static_cast<uint64_t>(info.st_mtime)<<32) ^ static_cast<uint64_t>(info.st_size);
+  std::string cacheFile=MeshLOD::cacheFile(_objFile,".lod");
+  if(!load(cacheFile,sourceKey))
+  {
+    // either way stays invalid (no levels) and holds nothing a half read obj left behind
+    if(!IndexedMesh::loadObj(_objFile,m_geometry))
+    {
+      std::cerr<<"unable to load mesh "<<_objFile<<"\n";
+      m_geometry=IndexedMesh();
+      return;
+    }
+    if(m_geometry.m_indices.empty())
+    {
+      std::cerr<<"mesh "<<_objFile<<" has no triangles\n";
+      m_geometry=IndexedMesh();
+      return;
+    }
+    std::cout<<"building LOD chain for "<<cacheFile<<"\n";
+    build(_numLevels);
+    m_hull.build(positions(),c_positionStride,m_geometry.m_verts.size());
+    if(!save(cacheFile,sourceKey))
+    {
+      std::cerr<<"unable to write LOD cache "<<cacheFile<<"\n";
+    }
+  }
+  m_bounds=m_geometry.bounds();
+  if(s_vertexFormat==VertexFormat::QUANTIZED)
+  {
+    m_quantized.reserve(m_geometry.m_verts.size());
+    for(const auto &v : m_geometry.m_verts)
+    {
+      m_quantized.push_back(QuantizedVertex::encode(v,m_bounds));
+    }
+  }
+  m_bvhFile=MeshLOD::cacheFile(_objFile,".bvh");
+  m_sourceKey=sourceKey;
+}
+
+const MappedBVH &MeshLOD::bvh() const
+{
+  // only a few callers use the hierarchy so loading a mesh does not pay for it
+  std::call_once(m_bvhOnce,[this]()
+  {
+    if(!isValid() || m_bvh.open(m_bvhFile,m_sourceKey))
+    {
+      return;
+    }
+    std::cout<<"building triangle BVH for "<<m_bvhFile<<"\n";
+    if(!saveBVH(m_bvhFile,m_sourceKey) || !m_bvh.open(m_bvhFile,m_sourceKey))
+    {
+      std::cerr<<"unable to write BVH cache "<<m_bvhFile<<"\n";
+    }
+  });
+  return m_bvh;
+}
+
+bool MeshLOD::saveBVH(const std::string &_fname, uint64_t _sourceKey) const
+{
+  size_t numTris=numTriangles(0);
+  if(numTris==0)
+  {
+    return false;
+  }
+  std::vector<AABB> boxes(numTris);
+  const ngl::Real *p=positions();
+  const GLuint *tri=indices(0);
+  for(size_t t=0; t<numTris; ++t, tri+=3)
+  {
+    AABB box;
+    for(int c=0; c<3; ++c)
+    {
+      const ngl::Real *v=p+tri[c]*c_positionStride;
+      box.extend(ngl::Vec3(v[0],v[1],v[2]));
+    }
+    boxes[t]=box;
+  }
+  // usually called on a loader thread, so stay off the shared pool the frame uses
+  WorkerPool serial(1);
+  LinearBVH tree(&serial);
+  tree.build(boxes.data(),numTris);
+  return MappedBVH::write(_fname,_sourceKey,tree,m_bounds);
+}
+
+MeshLOD::~MeshLOD()
+{
+  // never uploaded (eg loaded for a benchmark) means there may be no GL context at all
+  if(m_vao)
+  {
+    glDeleteBuffers(1,&m_vbo);
+    glDeleteBuffers(1,&m_ibo);
+    glDeleteVertexArrays(1,&m_vao);
+  }
+}
+
+void MeshLOD::build(size_t _numLevels)
+{
+  m_allIndices=m_geometry.m_indices;
+  m_levels.clear();
+  m_levels.push_back({0,static_cast<GLuint>(m_allIndices.size())});
+
+  Simplifier simplify(m_geometry);
+  size_t target=m_geometry.numTriangles();
+  while(m_levels.size()<_numLevels)
+  {
+    size_t previous=simplify.liveTriangles();
+    target/=2;
+    simplify.collapseTo(target);
+    // stop once the mesh will not get meaningfully smaller
+    if(simplify.liveTriangles()*10>previous*9 || simplify.liveTriangles()==0)
+    {
+      break;
+    }
+    Level l;
+    l.m_first=static_cast<GLuint>(m_allIndices.size());
+    simplify.emit(m_allIndices);
+    l.m_count=static_cast<GLuint>(m_allIndices.size())-l.m_first;
+    m_levels.push_back(l);
+  }
+  m_meshlets.build(positions(),c_positionStride,&m_allIndices[0],numTriangles(0));
+  if(s_optimizeIndices)
+  {
+    optimizeIndices();
+  }
+}
+
+void MeshLOD::optimizeIndices()
+{
+  // level 0 has to stay in meshlet runs, so its meshlets are the overdraw clusters
+  m_meshlets.optimize(positions(),c_positionStride,&m_allIndices[0]);
+  for(size_t l=1; l<m_levels.size(); ++l)
+  {
+    GLuint *indices=&m_allIndices[m_levels[l].m_first];
+    IndexOptimizer::optimizeVertexCache(indices,m_levels[l].m_count,numVertices());
+    IndexOptimizer::optimizeOverdraw(positions(),c_positionStride,indices,m_levels[l].m_count,numVertices());
+  }
+  // vertices in the order they are first drawn, full detail first
+  std::vector<GLuint> remap;
+  IndexOptimizer::optimizeVertexFetch(&m_allIndices[0],m_allIndices.size(),numVertices(),remap);
+  std::vector<IndexedMesh::Vertex> verts(numVertices());
+  std::vector<GLuint> posIndex(numVertices());
+  for(size_t v=0; v<remap.size(); ++v)
+  {
+    verts[remap[v]]=m_geometry.m_verts[v];
+    posIndex[remap[v]]=m_geometry.m_posIndex[v];
+  }
+  m_geometry.m_verts.swap(verts);
+  m_geometry.m_posIndex.swap(posIndex);
+  m_geometry.m_indices.assign(m_allIndices.begin(),m_allIndices.begin()+m_levels[0].m_count);
+}
+
+std::string MeshLOD::cacheFile(const std::string &_objFile, const std::string &_extension)
+{
+  return s_optimizeIndices ? _objFile+_extension : _objFile+".unoptimized"+_extension;
+}
+
+bool MeshLOD::load(const std::string &_fname, uint64_t _sourceKey)
+{
+  std::ifstream in(_fname,std::ios::binary | std::ios::ate);
+  if(!in.is_open())
+  {
+    return false;
+  }
+  uint64_t fileBytes=static_cast<uint64_t>(in.tellg());
+  in.seekg(0);
+  LODHeader h;
+  in.read(reinterpret_cast<char *>(&h),sizeof(LODHeader));
+  // an empty chain is never written, a file claiming one or more than it holds is corrupt
+  uint64_t arrayBytes=sizeof(Level)*uint64_t(h.m_numLevels)+(sizeof(IndexedMesh::Vertex)+sizeof(GLuint))*uint64_t(h.m_numVerts)+
+                      sizeof(GLuint)*uint64_t(h.m_numIndices);
+  if(!in || std::memcmp(h.m_magic,"ALOD",4)!=0 || h.m_version!=c_lodVersion || h.m_sourceKey!=_sourceKey ||
+     h.m_numLevels==0 || h.m_numVerts==0 || h.m_numIndices==0 || arrayBytes>fileBytes-sizeof(LODHeader))
+  {
+    return false;
+  }
+  // read into locals so a file that fails part way leaves this mesh as it was
+  std::vector<Level> levels(h.m_numLevels);
+  IndexedMesh geometry;
+  geometry.m_verts.resize(h.m_numVerts);
+  geometry.m_posIndex.resize(h.m_numVerts);
+  geometry.m_numPositions=h.m_numPositions;
+  std::vector<GLuint> allIndices(h.m_numIndices);
+  in.read(reinterpret_cast<char *>(&levels[0]),sizeof(Level)*h.m_numLevels);
+  in.read(reinterpret_cast<char *>(&geometry.m_verts[0]),sizeof(IndexedMesh::Vertex)*h.m_numVerts);
+  in.read(reinterpret_cast<char *>(&geometry.m_posIndex[0]),sizeof(GLuint)*h.m_numVerts);
+  in.read(reinterpret_cast<char *>(&allIndices[0]),sizeof(GLuint)*h.m_numIndices);
+  if(!in)
+  {
+    return false;
+  }
+  for(const Level &l : levels)
+  {
+    if(l.m_count==0 || l.m_count%3!=0 || l.m_first>h.m_numIndices || l.m_count>h.m_numIndices-l.m_first)
+    {
+      return false;
+    }
+  }
+  if(std::any_of(allIndices.begin(),allIndices.end(),[&h](GLuint _i){return _i>=h.m_numVerts;}) ||
+     std::any_of(geometry.m_posIndex.begin(),geometry.m_posIndex.end(),[&h](GLuint _p){return _p>=h.m_numPositions;}))
+  {
+    return false;
+  }
+  ConvexHull hull;
+  Meshlets meshlets;
+  if(!hull.read(in) || !meshlets.read(in,levels[0].m_count))
+  {
+    return false;
+  }
+  // the same full mesh a build leaves in m_geometry
+  geometry.m_indices.assign(allIndices.begin(),allIndices.begin()+levels[0].m_count);
+  m_levels.swap(levels);
+  m_geometry=std::move(geometry);
+  m_allIndices.swap(allIndices);
+  m_hull=std::move(hull);
+  m_meshlets=std::move(meshlets);
+  return true;
+}
+
+bool MeshLOD::save(const std::string &_fname, uint64_t _sourceKey) const
+{
+  std::ofstream out(_fname,std::ios::binary);
+  if(!out.is_open())
+  {
+    return false;
+  }
+  LODHeader h;
+  std::memcpy(h.m_magic,"ALOD",4);
+  h.m_version=c_lodVersion;
+  h.m_sourceKey=_sourceKey;
+  h.m_numVerts=static_cast<uint32_t>(m_geometry.m_verts.size());
+  h.m_numIndices=static_cast<uint32_t>(m_allIndices.size());
+  h.m_numLevels=static_cast<uint32_t>(m_levels.size());
+  h.m_numPositions=static_cast<uint32_t>(m_geometry.m_numPositions);
+  out.write(reinterpret_cast<const char *>(&h),sizeof(LODHeader));
+  out.write(reinterpret_cast<const char *>(&m_levels[0]),sizeof(Level)*h.m_numLevels);
+  out.write(reinterpret_cast<const char *>(&m_geometry.m_verts[0]),sizeof(IndexedMesh::Vertex)*h.m_numVerts);
+  out.write(reinterpret_cast<const char *>(&m_geometry.m_posIndex[0]),sizeof(GLuint)*h.m_numVerts);
+  out.write(reinterpret_cast<const char *>(&m_allIndices[0]),sizeof(GLuint)*h.m_numIndices);
+  return out && m_hull.write(out) && m_meshlets.write(out);
+}
+
+size_t MeshLOD::gpuBytes() const
+{
+  size_t vertexBytes=isQuantized() ? sizeof(QuantizedVertex) : sizeof(IndexedMesh::Vertex);
+  return m_geometry.m_verts.size()*vertexBytes+m_allIndices.size()*sizeof(GLuint);
+}
+
+ngl::Mat4 MeshLOD::dequantizeMatrix() const
+{
+  if(isQuantized())
+  {
+    return QuantizedVertex::dequantizeMatrix(m_bounds);
+  }
+  ngl::Mat4 identity;
+  identity.identity();
+  return identity;
+}
+
+bool MeshLOD::upload(size_t _maxBytes)
+{
+  typedef IndexedMesh::Vertex Vertex;
+  size_t vertexBytes=m_geometry.m_verts.size()*(isQuantized() ? sizeof(QuantizedVertex) : sizeof(Vertex));
+  size_t indexBytes=m_allIndices.size()*sizeof(GLuint);
+  if(m_vao==0)
+  {
+    // allocate everything up front, the data is then streamed in over as many calls as needed
+    glGenVertexArrays(1,&m_vao);
+    glBindVertexArray(m_vao);
+    glGenBuffers(1,&m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER,m_vbo);
+    glBufferData(GL_ARRAY_BUFFER,vertexBytes,nullptr,GL_STATIC_DRAW);
+    if(isQuantized())
+    {
+      // same locations, the shader gets 0-1 positions, float uvs and the two octahedral terms
+      typedef QuantizedVertex Packed;
+      glVertexAttribPointer(0,3,GL_UNSIGNED_SHORT,GL_TRUE,sizeof(Packed),reinterpret_cast<void *>(offsetof(Packed,m_position)));
+      glVertexAttribPointer(1,2,GL_HALF_FLOAT,GL_FALSE,sizeof(Packed),reinterpret_cast<void *>(offsetof(Packed,m_uv)));
+      glVertexAttribPointer(2,2,GL_SHORT,GL_TRUE,sizeof(Packed),reinterpret_cast<void *>(offsetof(Packed,m_normal)));
+    }
+    else
+    {
+      glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),reinterpret_cast<void *>(offsetof(Vertex,m_x)));
+      glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,sizeof(Vertex),reinterpret_cast<void *>(offsetof(Vertex,m_u)));
+      glVertexAttribPointer(2,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),reinterpret_cast<void *>(offsetof(Vertex,m_nx)));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glGenBuffers(1,&m_ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,indexBytes,nullptr,GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    m_uploaded=0;
+  }
+  // vertices then indices, the copy target avoids disturbing the VAO / array bindings
+  while(_maxBytes && m_uploaded<vertexBytes+indexBytes)
+  {
+    bool vertices=m_uploaded<vertexBytes;
+    size_t offset= vertices ? m_uploaded : m_uploaded-vertexBytes;
+    size_t remaining= vertices ? vertexBytes-offset : indexBytes-offset;
+    size_t n=std::min(_maxBytes,remaining);
+    const char *vertexData= isQuantized() ? reinterpret_cast<const char *>(&m_quantized[0])
+                                          : reinterpret_cast<const char *>(&m_geometry.m_verts[0]);
+    const char *src= vertices ? vertexData : reinterpret_cast<const char *>(&m_allIndices[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER,vertices ? m_vbo : m_ibo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,offset,n,src+offset);
+    Stats::add(Stats::Counter::GL_BYTES_UPLOADED,n);
+    m_uploaded+=n;
+    _maxBytes-=n;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER,0);
+  return isUploaded();
+}
+
+bool MeshLOD::isUploaded() const
+{
+  return m_vao!=0 && m_uploaded==gpuBytes();
+}
+
+void MeshLOD::draw(size_t _level) const
+{
+  const Level &l=m_levels[_level];
+  glBindVertexArray(m_vao);
+  glDrawElements(GL_TRIANGLES,l.m_count,GL_UNSIGNED_INT,reinterpret_cast<void *>(l.m_first*sizeof(GLuint)));
+  glBindVertexArray(0);
+  Stats::add(Stats::Counter::DRAW_CALLS);
+  Stats::add(Stats::Counter::TRIANGLES,l.m_count/3);
+}
+
+void MeshLOD::drawRanges(const GLsizei *_counts, const void *const *_offsets, size_t _numRanges) const
+{
+  if(_numRanges==0)
+  {
+    return;
+  }
+  glBindVertexArray(m_vao);
+  glMultiDrawElements(GL_TRIANGLES,_counts,GL_UNSIGNED_INT,_offsets,static_cast<GLsizei>(_numRanges));
+  glBindVertexArray(0);
+  size_t indices=0;
+  for(size_t i=0; i<_numRanges; ++i)
+  {
+    indices+=static_cast<size_t>(_counts[i]);
+  }
+  Stats::add(Stats::Counter::DRAW_CALLS);
+  Stats::add(Stats::Counter::TRIANGLES,indices/3);
+}
+
+ngl::Real MeshLOD::projectedSize(const AABB &_box, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight)
+{
+  ngl::Real minX=std::numeric_limits<ngl::Real>::max();
+  ngl::Real minY=minX;
+  ngl::Real maxX=-minX;
+  ngl::Real maxY=-minX;
+  for(int i=0; i<8; ++i)
+  {
+    ngl::Vec4 corner(i&1 ? _box.m_max.m_x : _box.m_min.m_x,
+                     i&2 ? _box.m_max.m_y : _box.m_min.m_y,
+                     i&4 ? _box.m_max.m_z : _box.m_min.m_z,1.0f);
+    ngl::Vec4 clip=corner*_VP;
+    // w is 1 for ortho, for perspective a corner behind the eye means we are inside / very close
+    if(clip.m_w<=0.0001f)
+    {
+      return static_cast<ngl::Real>(std::max(_viewportWidth,_viewportHeight));
+    }
+    ngl::Real x=clip.m_x/clip.m_w;
+    ngl::Real y=clip.m_y/clip.m_w;
+    minX=std::min(minX,x); maxX=std::max(maxX,x);
+    minY=std::min(minY,y); maxY=std::max(maxY,y);
+  }
+  // NDC is 2 units across the viewport each way
+  return std::max((maxX-minX)*0.5f*_viewportWidth,(maxY-minY)*0.5f*_viewportHeight);
+}
+
+size_t MeshLOD::selectLevel(const AABB &_box, const ngl::Mat4 &_VP, int _viewportWidth, int _viewportHeight) const
+{
+  ngl::Real pixels=projectedSize(_box,_VP,_viewportWidth,_viewportHeight);
+  if(pixels>=c_fullDetailPixels)
+  {
+    return 0;
+  }
+  if(pixels<=0.0f)
+  {
+    return m_levels.size()-1;
+  }
+  size_t level=static_cast<size_t>(std::log2(c_fullDetailPixels/pixels));
+  return std::min(level,m_levels.size()-1);
+}
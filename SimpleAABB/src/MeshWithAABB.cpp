@@ -1,73 +1,115 @@
 #include "MeshWithAABB.h"
+#include "ConvexHull.h"
 #include <ngl/BBox.h>
+#include <ngl/ShaderLib.h>
+#include "Profiler.h"
+#include "Stats.h"
 #include <iostream>
-MeshWithAABB::MeshWithAABB( ngl::Obj *_mesh)
+
+std::unique_ptr<ngl::BBox> MeshWithAABB::s_unitBox;
+MeshWithAABB::BoundsMode MeshWithAABB::s_boundsMode=MeshWithAABB::BoundsMode::CORNERS;
+
+MeshWithAABB::MeshWithAABB(const AABB &_localBounds)
+{
+  setLocalBounds(_localBounds);
+}
+
+void MeshWithAABB::setLocalBounds(const AABB &_box, const ConvexHull *_hull)
 {
-  m_mesh=_mesh;
-  ngl::BBox box=m_mesh->getBBox();
-/*  m_defaultExtents[static_cast<int>(Extents::LEFT)].set(box.minX(),0.0f,0.0f,1.0f);
-  m_defaultExtents[static_cast<int>(Extents::RIGHT)].set(box.maxX(),0.0f,0.0f,1.0f);
-  m_defaultExtents[static_cast<int>(Extents::TOP)].set(0.0f,box.maxY(),0.0f,1.0f);
-  m_defaultExtents[static_cast<int>(Extents::BOTTOM)].set(0.0f,box.minY(),0.0f,1.0f);
-  m_defaultExtents[static_cast<int>(Extents::FRONT)].set(0.0f,0.0f,box.maxZ(),1.0f);
-  m_defaultExtents[static_cast<int>(Extents::BACK)].set(0.0f,0.0f,box.minZ(),1.0f);
-  */
+  m_hull=_hull;
+  m_extremes.fill(0);
   // top
-  m_defaultExtents[0].set(box.minX(),box.maxY(),box.maxZ());
-  m_defaultExtents[1].set(box.maxX(),box.maxY(),box.maxZ());
-  m_defaultExtents[2].set(box.maxX(),box.maxY(),box.minZ());
-  m_defaultExtents[3].set(box.minX(),box.maxY(),box.minZ());
+  m_defaultExtents[0].set(_box.m_min.m_x,_box.m_max.m_y,_box.m_max.m_z);
+  m_defaultExtents[1].set(_box.m_max.m_x,_box.m_max.m_y,_box.m_max.m_z);
+  m_defaultExtents[2].set(_box.m_max.m_x,_box.m_max.m_y,_box.m_min.m_z);
+  m_defaultExtents[3].set(_box.m_min.m_x,_box.m_max.m_y,_box.m_min.m_z);
 
-  m_defaultExtents[4].set(box.minX(),box.minY(),box.maxZ());
-  m_defaultExtents[5].set(box.maxX(),box.minY(),box.maxZ());
-  m_defaultExtents[6].set(box.maxX(),box.minY(),box.minZ());
-  m_defaultExtents[7].set(box.minX(),box.minY(),box.minZ());
+  m_defaultExtents[4].set(_box.m_min.m_x,_box.m_min.m_y,_box.m_max.m_z);
+  m_defaultExtents[5].set(_box.m_max.m_x,_box.m_min.m_y,_box.m_max.m_z);
+  m_defaultExtents[6].set(_box.m_max.m_x,_box.m_min.m_y,_box.m_min.m_z);
+  m_defaultExtents[7].set(_box.m_min.m_x,_box.m_min.m_y,_box.m_min.m_z);
 
   ngl::Transformation t;
   setTransform(t);
-
 }
 
 void MeshWithAABB::setTransform( ngl::Transformation &_t)
 {
-  auto m_transformedExtents=m_defaultExtents;
-  ngl::Mat4 tx=_t.getMatrix();
+  setTransform(_t.getMatrix());
+}
 
-  for(auto &v : m_transformedExtents)
+void MeshWithAABB::setTransform( const ngl::Mat4 &_tx)
+{
+  PROFILE_ZONE("setTransform");
+  Stats::add(Stats::Counter::AABBS_UPDATED);
+  if(s_boundsMode!=BoundsMode::CORNERS && m_hull && !m_hull->isEmpty())
   {
-    v=v*tx;
+    m_aabb= s_boundsMode==BoundsMode::HULL ? m_hull->bounds(_tx) : m_hull->bounds(_tx,&m_extremes[0]);
+    return;
   }
-  ngl::Real maxX=0.0f;
-  ngl::Real minX=0.0f;
-  ngl::Real maxY=0.0f;
-  ngl::Real minY=0.0f;
-  ngl::Real maxZ=0.0f;
-  ngl::Real minZ=0.0f;
-
-  for(auto v : m_transformedExtents)
+  // start from an empty box so the result is not forced to contain the origin, corners are
+  // transformed one at a time rather than copying the extents array first
+  m_aabb.reset();
+  for(const auto &v : m_defaultExtents)
   {
-    if     (v.m_x >maxX) { maxX=v.m_x; }
-    else if(v.m_x <minX) { minX=v.m_x; }
-    if     (v.m_y >maxY) { maxY=v.m_y; }
-    else if(v.m_y <minY) { minY=v.m_y; }
-    if     (v.m_z >maxZ) { maxZ=v.m_z; }
-    else if(v.m_z <minZ) { minZ=v.m_z; }
+    ngl::Vec4 p=v*_tx;
+    m_aabb.extend(ngl::Vec3(p.m_x,p.m_y,p.m_z));
   }
-  m_bbox.reset(new ngl::BBox(minX,maxX,minY,maxY,minZ,maxZ));
 }
 
-
-void MeshWithAABB::draw() const
+void MeshWithAABB::tighten(const AABB &_box)
 {
-  m_mesh->draw();
+  AABB box=m_aabb;
+  box.intersect(_box);
+  // both bound the mesh so they always overlap, unless float error says otherwise
+  if(box.m_min.m_x<=box.m_max.m_x && box.m_min.m_y<=box.m_max.m_y && box.m_min.m_z<=box.m_max.m_z)
+  {
+    m_aabb=box;
+  }
 }
 
-void MeshWithAABB::drawAABB() const
+ngl::Mat4 MeshWithAABB::boxMatrix() const
 {
- m_bbox->draw();
-
+  ngl::Vec3 size=m_aabb.size();
+  ngl::Vec3 center=m_aabb.center();
+  ngl::Mat4 m;
+  m.m_m[0][0]=size.m_x;
+  m.m_m[1][1]=size.m_y;
+  m.m_m[2][2]=size.m_z;
+  m.m_m[3][0]=center.m_x;
+  m.m_m[3][1]=center.m_y;
+  m.m_m[3][2]=center.m_z;
+  return m;
 }
 
+void MeshWithAABB::drawAABB(const ngl::Mat4 &_VP) const
+{
+  ngl::ShaderLib::instance()->setUniform("MVP",boxMatrix()*_VP);
+  unitBox().draw();
+  Stats::add(Stats::Counter::DRAW_CALLS);
+}
 
+void MeshWithAABB::drawAABBSolid(const ngl::Mat4 &_VP) const
+{
+  ngl::BBox &box=unitBox();
+  ngl::ShaderLib::instance()->setUniform("MVP",boxMatrix()*_VP);
+  box.setDrawMode(GL_FILL);
+  box.draw();
+  box.setDrawMode(GL_LINE);
+  Stats::add(Stats::Counter::DRAW_CALLS);
+}
 
+ngl::BBox &MeshWithAABB::unitBox()
+{
+  // made on first draw as it needs a GL context
+  if(!s_unitBox)
+  {
+    s_unitBox.reset(new ngl::BBox(-0.5f,0.5f,-0.5f,0.5f,-0.5f,0.5f));
+  }
+  return *s_unitBox;
+}
 
+void MeshWithAABB::releaseUnitBox()
+{
+  s_unitBox.reset();
+}
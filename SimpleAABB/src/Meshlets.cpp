@@ -0,0 +1,457 @@
+#include "Meshlets.h"
+#include "IndexOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESHLETS_SSE
+#endif
+
+constexpr size_t Meshlets::c_maxVertices;
+constexpr size_t Meshlets::c_maxTriangles;
+
+namespace
+{
+  // never reached by a sine, so the cone test can not pass
+  constexpr ngl::Real c_noCone=2.0f;
+  // how much a triangle turned away from the meshlet counts against it, in new positions
+  constexpr ngl::Real c_coneWeight=1.0f;
+
+  ngl::Vec3 position(const ngl::Real *_positions, size_t _stride, GLuint _index)
+  {
+    const ngl::Real *p=_positions+_index*_stride;
+    return ngl::Vec3(p[0],p[1],p[2]);
+  }
+
+  // bytes from the read position to the end of _in
+  size_t bytesLeft(std::istream &_in)
+  {
+    std::streampos here=_in.tellg();
+    _in.seekg(0,std::ios::end);
+    std::streampos end=_in.tellg();
+    _in.seekg(here);
+    return here<0 || end<here ? 0 : static_cast<size_t>(end-here);
+  }
+}
+
+void Meshlets::build(const ngl::Real *_positions, size_t _stride, GLuint *_indices, size_t _numTriangles)
+{
+  m_meshlets.clear();
+  size_t numIndices=_numTriangles*3;
+  size_t numVertices=0;
+  for(size_t i=0; i<numIndices; ++i)
+  {
+    numVertices=std::max<size_t>(numVertices,_indices[i]+1);
+  }
+  // vertices split only by their normal or uv are still neighbours, so triangles are joined
+  // through welded positions
+  std::vector<uint32_t> weld(numVertices);
+  {
+    std::vector<uint32_t> byPosition(numVertices);
+    for(uint32_t v=0; v<numVertices; ++v)
+    {
+      byPosition[v]=v;
+    }
+    auto less=[&](uint32_t _a, uint32_t _b)
+    {
+      const ngl::Real *a=_positions+_a*_stride;
+      const ngl::Real *b=_positions+_b*_stride;
+      return std::lexicographical_compare(a,a+3,b,b+3);
+    };
+    std::sort(byPosition.begin(),byPosition.end(),less);
+    for(size_t i=0; i<numVertices; ++i)
+    {
+      bool same=i>0 && !less(byPosition[i-1],byPosition[i]);
+      weld[byPosition[i]]= same ? weld[byPosition[i-1]] : byPosition[i];
+    }
+  }
+  // triangles using each welded vertex
+  std::vector<uint32_t> start(numVertices+1,0);
+  for(size_t i=0; i<numIndices; ++i)
+  {
+    ++start[weld[_indices[i]]+1];
+  }
+  for(size_t v=0; v<numVertices; ++v)
+  {
+    start[v+1]+=start[v];
+  }
+  std::vector<uint32_t> fill(start.begin(),start.end()-1);
+  std::vector<uint32_t> vertexTriangles(numIndices);
+  for(size_t i=0; i<numIndices; ++i)
+  {
+    vertexTriangles[fill[weld[_indices[i]]]++]=static_cast<uint32_t>(i/3);
+  }
+
+  std::vector<GLuint> ordered;
+  ordered.reserve(numIndices);
+  std::vector<bool> used(_numTriangles,false);
+  // a vertex (or welded position) is in the current meshlet when its stamp is the meshlet number
+  std::vector<uint32_t> stamp(numVertices,~0u);
+  std::vector<uint32_t> weldStamp(numVertices,~0u);
+  std::vector<GLuint> vertices;
+  std::vector<GLuint> welded;
+  std::vector<ngl::Vec3> normals;
+  size_t seed=0;
+  auto triangleNormal=[&](size_t _t)
+  {
+    ngl::Vec3 p0=position(_positions,_stride,_indices[_t*3]);
+    ngl::Vec3 n=(position(_positions,_stride,_indices[_t*3+1])-p0).cross(position(_positions,_stride,_indices[_t*3+2])-p0);
+    ngl::Real length=n.length();
+    return length>0.0f ? n*(1.0f/length) : n;
+  };
+  auto newVertices=[&](size_t _t, size_t &_newPositions)
+  {
+    uint32_t id=static_cast<uint32_t>(m_meshlets.size());
+    size_t count=0;
+    _newPositions=0;
+    for(size_t c=0; c<3; ++c)
+    {
+      count+=stamp[_indices[_t*3+c]]!=id;
+      _newPositions+=weldStamp[weld[_indices[_t*3+c]]]!=id;
+    }
+    return count;
+  };
+  while(ordered.size()<numIndices)
+  {
+    while(used[seed])
+    {
+      ++seed;
+    }
+    uint32_t id=static_cast<uint32_t>(m_meshlets.size());
+    Meshlet m;
+    m.m_first=static_cast<GLuint>(ordered.size());
+    vertices.clear();
+    welded.clear();
+    ngl::Vec3 coneSum(0.0f,0.0f,0.0f);
+    size_t next=seed;
+    size_t numTriangles=0;
+    do
+    {
+      used[next]=true;
+      ++numTriangles;
+      for(size_t c=0; c<3; ++c)
+      {
+        GLuint v=_indices[next*3+c];
+        ordered.push_back(v);
+        if(stamp[v]!=id)
+        {
+          stamp[v]=id;
+          vertices.push_back(v);
+        }
+        if(weldStamp[weld[v]]!=id)
+        {
+          weldStamp[weld[v]]=id;
+          welded.push_back(weld[v]);
+        }
+      }
+      if(numTriangles==c_maxTriangles)
+      {
+        break;
+      }
+      coneSum+=triangleNormal(next);
+      ngl::Vec3 coneAxis=coneSum;
+      ngl::Real coneLength=coneAxis.length();
+      if(coneLength>0.0f)
+      {
+        coneAxis*=1.0f/coneLength;
+      }
+      // the unused neighbour bringing the fewest new positions keeps the meshlet compact, the
+      // fewest new vertices keeps it small and facing the same way keeps its cone narrow
+      size_t best=_numTriangles;
+      ngl::Real bestScore=std::numeric_limits<ngl::Real>::max();
+      for(size_t i=0; i<welded.size(); ++i)
+      {
+        for(uint32_t k=start[welded[i]]; k<start[welded[i]+1]; ++k)
+        {
+          uint32_t t=vertexTriangles[k];
+          if(used[t])
+          {
+            continue;
+          }
+          size_t newPositions;
+          size_t extra=newVertices(t,newPositions);
+          ngl::Real score=newPositions+0.25f*extra+c_coneWeight*(1.0f-coneAxis.dot(triangleNormal(t)));
+          if(score<bestScore && vertices.size()+extra<=c_maxVertices)
+          {
+            best=t;
+            bestScore=score;
+          }
+        }
+      }
+      if(best==_numTriangles)
+      {
+        break;
+      }
+      next=best;
+    } while(true);
+    m.m_count=static_cast<GLuint>(ordered.size())-m.m_first;
+
+    // box of the vertices, cone around the mean of the triangle normals
+    for(GLuint v : vertices)
+    {
+      m.m_box.extend(position(_positions,_stride,v));
+    }
+    normals.clear();
+    ngl::Vec3 axis(0.0f,0.0f,0.0f);
+    for(GLuint i=m.m_first; i<m.m_first+m.m_count; i+=3)
+    {
+      ngl::Vec3 p0=position(_positions,_stride,ordered[i]);
+      ngl::Vec3 n=(position(_positions,_stride,ordered[i+1])-p0).cross(position(_positions,_stride,ordered[i+2])-p0);
+      ngl::Real length=n.length();
+      // degenerate triangles draw nothing so they can face any way
+      if(length>0.0f)
+      {
+        n*=1.0f/length;
+        normals.push_back(n);
+        axis+=n;
+      }
+    }
+    m.m_coneAxis.set(0.0f,0.0f,1.0f);
+    m.m_coneCutoff=c_noCone;
+    ngl::Real axisLength=axis.length();
+    if(axisLength>0.0f)
+    {
+      axis*=1.0f/axisLength;
+      ngl::Real minDot=1.0f;
+      for(const auto &n : normals)
+      {
+        minDot=std::min(minDot,n.dot(axis));
+      }
+      // a cone wider than a hemisphere always has a triangle facing the eye
+      if(minDot>0.0f)
+      {
+        m.m_coneAxis=axis;
+        // rounded up a little so float error can not cull a triangle that is just visible
+        m.m_coneCutoff=std::min(1.0f,std::sqrt(1.0f-minDot*minDot)+1e-3f);
+      }
+    }
+    m_meshlets.push_back(m);
+  }
+  std::copy(ordered.begin(),ordered.end(),_indices);
+  setStreams();
+}
+
+void Meshlets::optimize(const ngl::Real *_positions, size_t _stride, GLuint *_indices)
+{
+  // a meshlet has at most c_maxVertices vertices so it is optimized with local numbers
+  std::vector<GLuint> local;
+  std::vector<GLuint> global;
+  for(const Meshlet &m : m_meshlets)
+  {
+    GLuint *indices=_indices+m.m_first;
+    global.clear();
+    local.resize(m.m_count);
+    for(GLuint i=0; i<m.m_count; ++i)
+    {
+      auto found=std::find(global.begin(),global.end(),indices[i]);
+      local[i]=static_cast<GLuint>(found-global.begin());
+      if(found==global.end())
+      {
+        global.push_back(indices[i]);
+      }
+    }
+    IndexOptimizer::optimizeVertexCache(local.data(),m.m_count,global.size());
+    for(GLuint i=0; i<m.m_count; ++i)
+    {
+      indices[i]=global[local[i]];
+    }
+  }
+  std::vector<size_t> starts(m_meshlets.size());
+  size_t numIndices=0;
+  for(size_t i=0; i<m_meshlets.size(); ++i)
+  {
+    starts[i]=m_meshlets[i].m_first;
+    numIndices+=m_meshlets[i].m_count;
+  }
+  std::vector<size_t> order;
+  IndexOptimizer::sortClusters(_positions,_stride,_indices,numIndices,starts,order);
+  std::vector<Meshlet> sorted;
+  sorted.reserve(m_meshlets.size());
+  GLuint first=0;
+  for(size_t i : order)
+  {
+    sorted.push_back(m_meshlets[i]);
+    sorted.back().m_first=first;
+    first+=sorted.back().m_count;
+  }
+  m_meshlets.swap(sorted);
+  setStreams();
+}
+
+void Meshlets::setStreams()
+{
+  m_padded=(m_meshlets.size()+3) & ~size_t(3);
+  m_streams.assign(c_numStreams*m_padded,0.0f);
+  for(size_t i=0; i<m_meshlets.size(); ++i)
+  {
+    const Meshlet &m=m_meshlets[i];
+    ngl::Vec3 centre=(m.m_box.m_min+m.m_box.m_max)*0.5f;
+    ngl::Vec3 extent=(m.m_box.m_max-m.m_box.m_min)*0.5f;
+    ngl::Real values[c_numStreams]={centre.m_x,centre.m_y,centre.m_z,extent.m_x,extent.m_y,extent.m_z,
+                                    m.m_coneAxis.m_x,m.m_coneAxis.m_y,m.m_coneAxis.m_z,m.m_coneCutoff,extent.length()};
+    for(int s=0; s<c_numStreams; ++s)
+    {
+      m_streams[s*m_padded+i]=values[s];
+    }
+  }
+}
+
+size_t Meshlets::cull(const ngl::Mat4 &_MVP, const ngl::Vec4 &_eye, bool _cullBackFaces,
+                      GLsizei *_counts, const void **_offsets, size_t &_numRanges) const
+{
+  // frustum planes in object space, a point is inside when dot(n,p)+d>=0 for all six. With
+  // row vectors clip = p*MVP so the planes come from the columns (w+x, w-x, w+y ...)
+  ngl::Real planes[6][4];
+  for(int p=0; p<6; ++p)
+  {
+    int axis=p/2;
+    ngl::Real sign= (p & 1) ? -1.0f : 1.0f;
+    for(int i=0; i<4; ++i)
+    {
+      planes[p][i]=_MVP.m_m[i][3]+sign*_MVP.m_m[i][axis];
+    }
+  }
+  _numRanges=0;
+  size_t triangles=0;
+  size_t numMeshlets=m_meshlets.size();
+  // meshlets are stored in order so a run of survivors is one range
+  size_t rangeEnd=0;
+  auto emit=[&](size_t _meshlet)
+  {
+    const Meshlet &m=m_meshlets[_meshlet];
+    if(_numRanges && rangeEnd==m.m_first)
+    {
+      _counts[_numRanges-1]+=static_cast<GLsizei>(m.m_count);
+    }
+    else
+    {
+      _offsets[_numRanges]=reinterpret_cast<const void *>(m.m_first*sizeof(GLuint));
+      _counts[_numRanges]=static_cast<GLsizei>(m.m_count);
+      ++_numRanges;
+    }
+    rangeEnd=m.m_first+m.m_count;
+    triangles+=m.m_count/3;
+  };
+  const ngl::Real *s=m_streams.data();
+#if defined(MESHLETS_SSE)
+  __m128 zero=_mm_setzero_ps();
+  __m128 absMask=_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 eyeX=_mm_set1_ps(_eye.m_x);
+  __m128 eyeY=_mm_set1_ps(_eye.m_y);
+  __m128 eyeZ=_mm_set1_ps(_eye.m_z);
+  __m128 eyeW=_mm_set1_ps(_eye.m_w);
+  __m128 one=_mm_set1_ps(1.0f);
+  for(size_t i=0; i<m_padded; i+=4)
+  {
+    __m128 cx=_mm_loadu_ps(s+CENTRE_X*m_padded+i);
+    __m128 cy=_mm_loadu_ps(s+CENTRE_Y*m_padded+i);
+    __m128 cz=_mm_loadu_ps(s+CENTRE_Z*m_padded+i);
+    __m128 ex=_mm_loadu_ps(s+EXTENT_X*m_padded+i);
+    __m128 ey=_mm_loadu_ps(s+EXTENT_Y*m_padded+i);
+    __m128 ez=_mm_loadu_ps(s+EXTENT_Z*m_padded+i);
+    __m128 visible=_mm_castsi128_ps(_mm_set1_epi32(-1));
+    for(int p=0; p<6; ++p)
+    {
+      __m128 nx=_mm_set1_ps(planes[p][0]);
+      __m128 ny=_mm_set1_ps(planes[p][1]);
+      __m128 nz=_mm_set1_ps(planes[p][2]);
+      // signed distance of the centre plus the box's reach towards the plane
+      __m128 d=_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx,nx),_mm_mul_ps(cy,ny)),_mm_add_ps(_mm_mul_ps(cz,nz),_mm_set1_ps(planes[p][3])));
+      __m128 r=_mm_add_ps(_mm_add_ps(_mm_mul_ps(ex,_mm_and_ps(nx,absMask)),_mm_mul_ps(ey,_mm_and_ps(ny,absMask))),_mm_mul_ps(ez,_mm_and_ps(nz,absMask)));
+      visible=_mm_and_ps(visible,_mm_cmpge_ps(_mm_add_ps(d,r),zero));
+    }
+    if(_cullBackFaces)
+    {
+      // v runs from the eye to the centre (or is the view direction for an eye at infinity),
+      // the meshlet faces away when dot(v,axis) >= cutoff*|v| + radius*w*(1+cutoff)
+      __m128 vx=_mm_sub_ps(_mm_mul_ps(cx,eyeW),eyeX);
+      __m128 vy=_mm_sub_ps(_mm_mul_ps(cy,eyeW),eyeY);
+      __m128 vz=_mm_sub_ps(_mm_mul_ps(cz,eyeW),eyeZ);
+      __m128 length=_mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx,vx),_mm_mul_ps(vy,vy)),_mm_mul_ps(vz,vz)));
+      __m128 along=_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx,_mm_loadu_ps(s+AXIS_X*m_padded+i)),_mm_mul_ps(vy,_mm_loadu_ps(s+AXIS_Y*m_padded+i))),
+                              _mm_mul_ps(vz,_mm_loadu_ps(s+AXIS_Z*m_padded+i)));
+      __m128 cutoff=_mm_loadu_ps(s+CUTOFF*m_padded+i);
+      __m128 reach=_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(s+RADIUS*m_padded+i),eyeW),_mm_add_ps(one,cutoff));
+      __m128 backFacing=_mm_cmpge_ps(along,_mm_add_ps(_mm_mul_ps(cutoff,length),reach));
+      visible=_mm_andnot_ps(backFacing,visible);
+    }
+    int mask=_mm_movemask_ps(visible);
+    for(size_t k=0; k<4 && i+k<numMeshlets; ++k)
+    {
+      if(mask & (1<<k))
+      {
+        emit(i+k);
+      }
+    }
+  }
+#else
+  for(size_t i=0; i<numMeshlets; ++i)
+  {
+    ngl::Vec3 c(s[CENTRE_X*m_padded+i],s[CENTRE_Y*m_padded+i],s[CENTRE_Z*m_padded+i]);
+    ngl::Vec3 e(s[EXTENT_X*m_padded+i],s[EXTENT_Y*m_padded+i],s[EXTENT_Z*m_padded+i]);
+    bool visible=true;
+    for(int p=0; p<6 && visible; ++p)
+    {
+      ngl::Real d=c.m_x*planes[p][0]+c.m_y*planes[p][1]+c.m_z*planes[p][2]+planes[p][3];
+      ngl::Real r=e.m_x*std::abs(planes[p][0])+e.m_y*std::abs(planes[p][1])+e.m_z*std::abs(planes[p][2]);
+      visible=d+r>=0.0f;
+    }
+    if(visible && _cullBackFaces)
+    {
+      ngl::Vec3 v=c*_eye.m_w-ngl::Vec3(_eye.m_x,_eye.m_y,_eye.m_z);
+      ngl::Vec3 axis(s[AXIS_X*m_padded+i],s[AXIS_Y*m_padded+i],s[AXIS_Z*m_padded+i]);
+      ngl::Real cutoff=s[CUTOFF*m_padded+i];
+      visible=v.dot(axis)<cutoff*v.length()+s[RADIUS*m_padded+i]*_eye.m_w*(1.0f+cutoff);
+    }
+    if(visible)
+    {
+      emit(i);
+    }
+  }
+#endif
+  return triangles;
+}
+
+bool Meshlets::write(std::ostream &_out) const
+{
+  uint32_t count=static_cast<uint32_t>(m_meshlets.size());
+  _out.write(reinterpret_cast<const char *>(&count),sizeof(count));
+  _out.write(reinterpret_cast<const char *>(m_meshlets.data()),count*sizeof(Meshlet));
+  return static_cast<bool>(_out);
+}
+
+bool Meshlets::read(std::istream &_in, size_t _numIndices)
+{
+  uint32_t count=0;
+  _in.read(reinterpret_cast<char *>(&count),sizeof(count));
+  // a meshlet holds at least one triangle, and the count has to fit in what is left of the file
+  if(!_in || count==0 || count>_numIndices/3 || count>bytesLeft(_in)/sizeof(Meshlet))
+  {
+    return false;
+  }
+  std::vector<Meshlet> meshlets(count);
+  _in.read(reinterpret_cast<char *>(meshlets.data()),count*sizeof(Meshlet));
+  if(!_in)
+  {
+    return false;
+  }
+  // the ranges go straight to glMultiDrawElements, so they must be whole triangles running
+  // back to back over level 0 as build() and optimize() leave them
+  size_t next=0;
+  for(const auto &m : meshlets)
+  {
+    if(m.m_first!=next || m.m_count==0 || m.m_count%3!=0 || m.m_count>3*c_maxTriangles || m.m_count>_numIndices-next)
+    {
+      return false;
+    }
+    next+=m.m_count;
+  }
+  if(next!=_numIndices)
+  {
+    return false;
+  }
+  m_meshlets.swap(meshlets);
+  setStreams();
+  return true;
+}
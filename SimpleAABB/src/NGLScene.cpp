@@ -1,7 +1,11 @@
 #include <QMouseEvent>
 #include <QGuiApplication>
+#include <QFont>
 
 #include "NGLScene.h"
+#include "SceneFile.h"
+#include "AllocationCounter.h"
+#include "Stats.h"
 #include <ngl/Camera.h>
 #include <ngl/Light.h>
 #include <ngl/Transformation.h>
@@ -9,6 +13,11 @@
 #include <ngl/NGLInit.h>
 #include <ngl/VAOPrimitives.h>
 #include <ngl/ShaderLib.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
 
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -19,24 +28,60 @@ const static float INCREMENT=0.01f;
 /// @brief the increment for the wheel zoom
 //----------------------------------------------------------------------------------------------------------------------
 const static float ZOOM=0.1f;
+static_assert(ViewportLayout::c_maxViewports<=Stats::c_maxViews,"every viewport needs its own counters");
 //----------------------------------------------------------------------------------------------------------------------
-/// @brief the offset for full window mode mouse data
+/// @brief shader names used every frame, kept as strings so no temporary is built per call
+/// (nglDiffuseShader is too long for the small string buffer so would hit the heap)
 //----------------------------------------------------------------------------------------------------------------------
-constexpr static int FULLOFFSET=4;
+const static std::string c_diffuseShader("nglDiffuseShader");
+const static std::string c_textureShader("TextureShader");
+const static std::string c_quantizedShader("QuantizedTextureShader");
+const static std::string c_colourShader("nglColourShader");
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief every program bind in the frame code goes through here so the switches are counted
+//----------------------------------------------------------------------------------------------------------------------
+static void useShader(ngl::ShaderLib *_shader, const std::string &_name)
+{
+  _shader->use(_name);
+  Stats::add(Stats::Counter::PROGRAM_SWITCHES);
+}
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief exact compare, used to see if a node has moved since its bounds were computed
+//----------------------------------------------------------------------------------------------------------------------
+static bool sameMatrix(const ngl::Mat4 &_a, const ngl::Mat4 &_b)
+{
+  return std::memcmp(&_a.m_m[0][0],&_b.m_m[0][0],sizeof(_a.m_m))==0;
+}
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief how many objects are rasterized into the software depth buffer and how big on
+/// screen (in pixels) they need to be to be worth it
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static size_t c_maxOccluders=4;
+constexpr static ngl::Real c_minOccluderPixels=64.0f;
+//----------------------------------------------------------------------------------------------------------------------
+/// @brief time per frame spent copying newly loaded assets to the GPU
+//----------------------------------------------------------------------------------------------------------------------
+constexpr static std::chrono::milliseconds c_uploadBudget(2);
+
+NGLScene::DrawPath NGLScene::s_drawPath=NGLScene::DrawPath::DIRECT;
+std::string NGLScene::s_layoutFile="layouts/quad.layout";
+bool NGLScene::s_verbose=false;
 
-NGLScene::NGLScene()
+NGLScene::NGLScene(const std::string &_sceneFile, const std::string &_statsSocket) : m_sceneFile(_sceneFile), m_drawPath(s_drawPath)
 {
-  for(auto &panel : m_panelMouseInfo)
+  m_startTime=std::chrono::steady_clock::now();
+  if(!_statsSocket.empty())
   {
-    panel.m_spinXFace=0;
-    panel.m_spinYFace=0;
-    panel.m_rotate=false;
+    m_statsServer.reset(new StatsServer(_statsSocket));
   }
-
-  // now we need to set the scales for the ortho windos
-  m_panelMouseInfo[static_cast<size_t>(Window::FRONT)].m_modelPos.set(0,0,1);
-  m_panelMouseInfo[static_cast<size_t>(Window::SIDE)].m_modelPos.set(0,0,1);
-  m_panelMouseInfo[static_cast<size_t>(Window::TOP)].m_modelPos.set(0,0,1);
+  m_occludedMeshes.fill(0);
+  m_lastOccludedMeshes.fill(0);
+  m_frustumCulled.fill(0);
+  m_lastFrustumCulled.fill(0);
+  m_meshletCulled.fill(0);
+  m_lastMeshletCulled.fill(0);
+  m_indirectNodes.fill(0);
+  m_lastIndirectNodes.fill(0);
 
 
   // mouse rotation values set to 0
@@ -51,6 +96,12 @@ NGLScene::NGLScene()
 NGLScene::~NGLScene()
 {
   std::cout<<"Shutting down NGL, removing VAO's and Shaders\n";
+  // the cached meshes / textures and queries free GL objects so need the context
+  makeCurrent();
+  m_occlusion.reset();
+  m_computeBounds.reset();
+  m_indirect.reset();
+  MeshWithAABB::releaseUnitBox();
 }
 
 
@@ -60,6 +111,10 @@ void NGLScene::resizeGL(int _w , int _h)
   // take into account device ratio later in the resize to be safe
   m_width=_w;
   m_height=_h;
+  if(m_text)
+  {
+    m_text->setScreenSize(_w,_h);
+  }
 }
 
 void NGLScene::initializeGL()
@@ -74,7 +129,7 @@ void NGLScene::initializeGL()
   // now to load the shader and set the values
   // grab an instance of shader manager
   ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  (*shader)["nglDiffuseShader"]->use();
+  (*shader)[c_diffuseShader]->use();
 
   shader->setUniform("Colour",1.0f,1.0f,1.0f,1.0f);
   shader->setUniform("lightPos",1.0f,1.0f,1.0f);
@@ -101,6 +156,14 @@ void NGLScene::initializeGL()
   // link the shader no attributes are bound
   shader->linkProgramObject("TextureShader");
   (*shader)["TextureShader"]->use();
+  // the same fragment shader behind the QuantizedVertex decode
+  shader->createShaderProgram(c_quantizedShader);
+  shader->attachShader("QuantizedTextureVertex",ngl::ShaderType::VERTEX);
+  shader->loadShaderSource("QuantizedTextureVertex","shaders/QuantizedTextureVertex.glsl");
+  shader->compileShader("QuantizedTextureVertex");
+  shader->attachShaderToProgram(c_quantizedShader,"QuantizedTextureVertex");
+  shader->attachShaderToProgram(c_quantizedShader,"TextureFragment");
+  shader->linkProgramObject(c_quantizedShader);
 
 
 
@@ -108,388 +171,732 @@ void NGLScene::initializeGL()
 
   shader->setUniform("Colour",1.0f,1.0f,1.0f,1.0f);
 
-  // first we create a mesh from an obj passing in the obj file and texture
-  m_mesh.reset(  new ngl::Obj("models/Helix.obj","textures/helix_base.tif"));
-  // now we need to create this as a VAO so we can draw it
-  m_mesh->createVAO();
-  m_mesh->calcBoundingSphere();
-  m_meshAABB.reset(new MeshWithAABB(m_mesh.get()));
+  // one set of queries per viewport, kept when it fills the window. Made before anything can
+  // fail so the destructor and key handlers always have it, the queries themselves are only
+  // generated when a viewport is first drawn
+  m_occlusion.reset(new OcclusionCuller(ViewportLayout::c_maxViewports));
+  // the viewports, each with its own camera and mouse state
+  if(!m_layout.load(s_layoutFile))
+  {
+    QGuiApplication::exit(EXIT_FAILURE);
+    return;
+  }
+  m_panelMouseInfo.assign(m_layout.size(),MouseInfo());
+  std::vector<std::string> names;
+  for(size_t v=0; v<m_layout.size(); ++v)
+  {
+    m_panelMouseInfo[v].m_modelPos=startModelPos(v);
+    names.push_back(m_layout.viewport(v).m_name);
+  }
+  Stats::setViewNames(names);
+  m_drawnViews.reserve(m_layout.size());
+  m_drawnVPs.reserve(m_layout.size());
+
+  // load the scene, each mesh / texture file is only loaded once into m_geometry however
+  // many objects use it. This only queues the loads, objects show as placeholder boxes
+  // until their mesh arrives
+  SceneFile sceneFile;
+  if(!sceneFile.load(m_sceneFile,m_scene,m_geometry) || m_scene.size()==0)
+  {
+    QGuiApplication::exit(EXIT_FAILURE);
+    return;
+  }
+  // the first object in the file is spun by the timer, anything parented to it follows
+  m_root=sceneFile.m_nodes[0].second;
+  m_rootLocal=sceneFile.m_locals[0];
+  // the exact bounds compute pass needs GL 4.3, without it E does nothing
+  if(ComputeBounds::isSupported())
+  {
+    m_computeBounds.reset(new ComputeBounds);
+    if(!m_computeBounds->init())
+    {
+      m_computeBounds.reset();
+    }
+    // shares the TextureFragment shader loaded above
+    m_indirect.reset(new IndirectRenderer(m_layout.size()));
+    if(!m_indirect->init())
+    {
+      m_indirect.reset();
+    }
+  }
+  if(m_drawPath!=DrawPath::DIRECT && !m_indirect)
+  {
+    std::cout<<"multi draw indirect needs GL 4.3, drawing each mesh directly\n";
+    m_drawPath=DrawPath::DIRECT;
+  }
+  m_text.reset(new ngl::Text(QFont("Arial",14)));
+  m_text->setScreenSize(width(),height());
+  m_scene.update();
+  m_sceneLoaded=true;
   startTimer(10);
 
 }
 
+ngl::Vec3 NGLScene::startModelPos(size_t _v) const
+{
+  return ngl::Vec3(0.0f,0.0f,m_layout.viewport(_v).m_perspective ? 0.0f : 1.0f);
+}
+
 void NGLScene::frameActive()
 {
-  size_t win = static_cast<size_t>(getActiveQuadrant());
-  if(m_activeWindow != Window::ALL)
+  size_t win=activeViewport();
+  if(win!=ViewportLayout::c_noViewport)
   {
-    win= FULLOFFSET;
+    m_panelMouseInfo[win].m_modelPos=startModelPos(win);
   }
-  m_panelMouseInfo[win].m_modelPos.set(0,0,1);
 }
 
-void NGLScene::loadMatricesToShader()
+ngl::Mat4 NGLScene::modelMatrix(size_t _v, bool _grid) const
 {
+  const ViewportLayout::Viewport &viewport=m_layout.viewport(_v);
+  const MouseInfo &mouse=m_panelMouseInfo[_v];
+  ngl::Transformation scaleRotate;
+  ngl::Mat4 spin;
+  ngl::Vec3 position;
+  if(viewport.m_perspective)
+  {
+    ngl::Mat4 rotX;
+    ngl::Mat4 rotY;
+    rotX.rotateX(mouse.m_spinXFace);
+    rotY.rotateY(mouse.m_spinYFace);
+    spin=rotY*rotX;
+    position=mouse.m_modelPos;
+  }
+  else
+  {
+    // pan across the view plane, z is the zoom
+    position=viewport.m_right*mouse.m_modelPos.m_x+viewport.m_cameraUp*mouse.m_modelPos.m_y;
+    scaleRotate.setScale(mouse.m_modelPos.m_z,mouse.m_modelPos.m_z,mouse.m_modelPos.m_z);
+  }
+  if(_grid)
+  {
+    scaleRotate.setRotation(viewport.m_gridRotation);
+    position+=viewport.m_gridOffset;
+  }
+  ngl::Mat4 translate;
+  translate.translate(position.m_x,position.m_y,position.m_z);
+  return scaleRotate.getMatrix()*spin*translate;
+}
+
+void NGLScene::loadMatricesToShader(const ngl::Mat4 &_model, const ViewState &_view)
+{
+  PROFILE_ZONE("loadMatricesToShader");
   ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  shader->use("nglDiffuseShader");
+  useShader(shader,c_diffuseShader);
   ngl::Mat4 MV;
   ngl::Mat4 MVP;
   ngl::Mat3 normalMatrix;
-  ngl::Mat4 M;
-  M=m_globalTransform.getMatrix();
-  MV=  m_globalTransform.getMatrix()*m_view;
-  MVP= M*m_view*m_projection;
+  MV=_model*_view.m_view;
+  MVP=MV*_view.m_projection;
   normalMatrix=MV;
   normalMatrix.inverse();
   shader->setUniform("MVP",MVP);
   shader->setUniform("normalMatrix",normalMatrix);
  }
 
-void NGLScene::loadMatricesToTextureShader()
+void NGLScene::setupViews()
 {
-  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  shader->use("TextureShader");
-  ngl::Mat4 MV;
-  ngl::Mat4 MVP;
-  ngl::Mat4 M;
-  M=m_globalTransform.getMatrix();
-  MV=  m_globalTransform.getMatrix()*m_view;
-  MVP= m_transform.getMatrix()*M*m_view*m_projection;
-  shader->setUniform("MVP",MVP);
- }
-
-void NGLScene::top(Mode _m)
-{
-  // grab an instance of the shader manager
-  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  (*shader)["nglDiffuseShader"]->use();
-
-  // Rotation based on the mouse position for our global transform
-  auto win=FULLOFFSET;
-  if(_m == Mode::PANEL)
+  m_drawnViews.clear();
+  m_drawnVPs.clear();
+  int width=static_cast<int>(m_width*devicePixelRatio());
+  int height=static_cast<int>(m_height*devicePixelRatio());
+  for(size_t v=0; v<m_layout.size(); ++v)
   {
-    win=static_cast<size_t>(Window::TOP);
+    if(m_fullscreen!=ViewportLayout::c_noViewport && v!=m_fullscreen)
+    {
+      continue;
+    }
+    ViewState view;
+    view.m_viewport=v;
+    view.m_rect= v==m_fullscreen ? std::array<int,4>{{0,0,width,height}} : m_layout.pixelRect(v,width,height);
+    ngl::Real aspect= view.m_rect[3]>0 ? static_cast<ngl::Real>(view.m_rect[2])/static_cast<ngl::Real>(view.m_rect[3]) : 1.0f;
+    view.m_model=modelMatrix(v,false);
+    view.m_view=m_layout.viewport(v).m_view;
+    view.m_projection=m_layout.projection(v,aspect);
+    view.m_VP=view.m_model*view.m_view*view.m_projection;
+    m_drawnViews.push_back(view);
+    m_drawnVPs.push_back(view.m_VP);
   }
+  m_frustums.set(m_drawnVPs.data(),m_drawnVPs.size());
+}
 
-
-  // get the VBO instance and draw the built in teapot
-  ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
-
-  // first draw a top  persp // front //side
-  ngl::Vec3 from(0,5,0);
-  ngl::Vec3 to(0,0,0);
-  ngl::Vec3 up(0,0,-1);
-  m_globalTransform.reset();
+void NGLScene::cullViews(FrameVector<uint32_t> &_nodes, FrameVector<size_t> &_starts)
+{
+  PROFILE_ZONE("cullViews");
+  size_t numViews=m_drawnViews.size();
+  size_t numNodes=m_scene.size();
+  // the only walk over the scene, every view's frustum at once
+  FrameVector<FrustumSet::Mask> masks(m_frameArena);
+  masks.resize(numNodes);
+  _starts.assign(numViews+1,0);
+  for(size_t i=0; i<numNodes; ++i)
   {
-    /// a top view (left upper)
-    m_view=ngl::lookAt(from,to,up);
-    m_projection=ngl::ortho(-5,5,-5,5, 0.1f, 500.0f);
-    // x,y w/h
-    if(_m==Mode::PANEL)
-
+    FrustumSet::Mask mask=m_frustums.visibleMask(m_scene.mesh(i).getAABB());
+    masks[i]=mask;
+    for(size_t k=0; mask; ++k, mask>>=1)
     {
-      glViewport (0,(m_height/2)*devicePixelRatio(), (m_width/2)*devicePixelRatio(), (m_height/2)*devicePixelRatio());
+      _starts[k+1]+=mask & 1;
     }
-    else
+  }
+  for(size_t k=0; k<numViews; ++k)
+  {
+    size_t v=m_drawnViews[k].m_viewport;
+    size_t culled=numNodes-_starts[k+1];
+    m_frustumCulled[v]+=culled;
+    Stats::addCulled(v,culled);
+    _starts[k+1]+=_starts[k];
+  }
+  // then each view's nodes in scene order
+  _nodes.resize(_starts[numViews]);
+  FrameVector<size_t> fill(m_frameArena);
+  fill.assign(_starts.begin(),_starts.end()-1);
+  for(size_t i=0; i<numNodes; ++i)
+  {
+    FrustumSet::Mask mask=masks[i];
+    for(size_t k=0; mask; ++k, mask>>=1)
     {
-      glViewport(0,0,m_width*devicePixelRatio(),m_height*devicePixelRatio());
+      if(mask & 1)
+      {
+        _nodes[fill[k]++]=static_cast<uint32_t>(i);
+      }
     }
-      // draw
-    // in this case set to an identity
-    ngl::Vec3 p=m_panelMouseInfo[win].m_modelPos;
-    m_globalTransform.setPosition(p.m_x,0,-p.m_y);
-    m_globalTransform.setScale(p.m_z,p.m_z,p.m_z);
-
-    loadMatricesToTextureShader();
-    m_meshAABB->draw();
-    // draw the mesh bounding box
-    (*shader)["nglColourShader"]->use();
-    //loadMatricesToShader();
-    shader->setUniform("MVP",m_view*m_projection);
-    shader->setUniform("Colour",0.0f,0.0f,1.0f,1.0f);
-    m_meshAABB->drawAABB();
-
-    m_globalTransform.addPosition(0,-1,0);
-    loadMatricesToShader();
-    prim->draw("grid");
   }
-
 }
 
-void NGLScene::side(Mode _m)
+void NGLScene::drawViewport(const ViewState &_view, const uint32_t *_nodes, size_t _numNodes)
 {
-  // grab an instance of the shader manager
-  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  (*shader)["nglDiffuseShader"]->use();
-
-  // Rotation based on the mouse position for our global transform
-  int win=FULLOFFSET;
-  if(_m == Mode::PANEL)
+  size_t win=_view.m_viewport;
+  const char *name=m_layout.viewport(win).m_name.c_str();
+  PROFILE_ZONE(name);
+  GpuProfiler::Zone gpuZone(m_gpuProfiler,name);
+  glViewport(_view.m_rect[0],_view.m_rect[1],_view.m_rect[2],_view.m_rect[3]);
+  if(m_drawPath!=DrawPath::DIRECT)
   {
-    win=static_cast<size_t>(Window::SIDE);
+    drawIndirect(_view);
   }
-
-   // get the VBO instance and draw the built in teapot
-  ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
-
-  // first draw a top  persp // front //side
-  ngl::Vec3 from(0,5,0);
-  ngl::Vec3 to(0,0,0);
-  ngl::Vec3 up(0,0,-1);
-  /// a side view (bottom right)
-  m_globalTransform.reset();
-  {
-    from.set(5,0,0);
-    up.set(0,1,0);
-    m_view=ngl::lookAt(from,to,up);
-    m_projection=ngl::ortho(-5,5,-5,5, 0.1f, 100.0f);
-    // x,y w/h
-    if(_m==Mode::PANEL)
+  else
+  {
+    ngl::ShaderLib *shader=ngl::ShaderLib::instance();
+    ngl::Mat4 view=_view.m_model*_view.m_view;
+    const ngl::Mat4 &VP=_view.m_VP;
+    int viewportWidth=_view.m_rect[2];
+    int viewportHeight=_view.m_rect[3];
+    bool orthographic=_view.m_projection.m_m[3][3]==1.0f;
+    m_occlusion->beginView(win,m_scene.size());
+    FrameVector<unsigned char> softwareVisible(m_frameArena);
+    if(m_useSoftwareOcclusion)
     {
-      glViewport ((m_width/2)*devicePixelRatio(), 0, (m_width/2)*devicePixelRatio(), (m_height/2)*devicePixelRatio());
+      softwareCull(_view,_nodes,_numNodes,softwareVisible);
     }
-    else
+    auto drawStart=std::chrono::steady_clock::now();
+    const std::string *meshShader=&c_textureShader;
+    useShader(shader,c_textureShader);
+    for(size_t n=0; n<_numNodes; ++n)
     {
-      glViewport(0,0,m_width*devicePixelRatio(),m_height*devicePixelRatio());
+      size_t i=_nodes[n];
+      if(m_useSoftwareOcclusion && !softwareVisible[n])
+      {
+        ++m_softwareCulled;
+        Stats::addCulled(win);
+        // the box is still queried below, the GPU seeing it means the CPU buffer hid
+        // something it should not have (or the GPU drew a coarser occluder)
+        if(m_useOcclusion && m_occlusion->hasResult(win,i) && m_occlusion->isVisible(win,i))
+        {
+          Stats::add(Stats::Counter::SOFTWARE_OCCLUSION_MISSES);
+        }
+        continue;
+      }
+      // last result from the query pass of an earlier frame, never waits on the GPU
+      if(m_useOcclusion && !m_occlusion->isVisible(win,i))
+      {
+        ++m_occludedMeshes[win];
+        Stats::addCulled(win);
+        continue;
+      }
+      const SceneGraph::Asset &asset=m_scene.asset(i);
+      // still loading, only the placeholder box is drawn
+      if(!m_geometry.isReady(asset.m_mesh))
+      {
+        continue;
+      }
+      const MeshLOD &lod=*m_geometry.mesh(asset.m_mesh).m_lod;
+      // every mesh loaded after the format was set matches, so this rarely switches
+      const std::string &wanted= lod.isQuantized() ? c_quantizedShader : c_textureShader;
+      if(&wanted!=meshShader)
+      {
+        useShader(shader,wanted);
+        meshShader=&wanted;
+      }
+      shader->setUniform("MVP",lod.isQuantized() ? lod.dequantizeMatrix()*m_scene.worldMatrix(i)*VP : m_scene.worldMatrix(i)*VP);
+      size_t level=0;
+      if(m_useLOD)
+      {
+        // boxes are world space so the viewport's VP gives their on screen size directly
+        level=lod.selectLevel(m_scene.mesh(i).getAABB(),VP,viewportWidth,viewportHeight);
+      }
+      glBindTexture(GL_TEXTURE_2D,m_geometry.texture(asset.m_texture));
+      size_t submitted=lod.numTriangles(level);
+      if(m_useMeshlets && level==0 && lod.meshlets().size())
+      {
+        submitted=drawMeshlets(lod,m_scene.worldMatrix(i),view,VP,orthographic);
+        m_meshletCulled[win]+=lod.numTriangles(0)-submitted;
+      }
+      else
+      {
+        lod.draw(level);
+      }
+      m_trianglesFull+=lod.numTriangles(0);
+      m_trianglesSubmitted+=submitted;
+      ++m_meshesDrawn;
     }
-
-    // draw
-    ngl::Vec3 p=m_panelMouseInfo[win].m_modelPos;
-    m_globalTransform.setPosition(0,p.m_y,-p.m_x);
-    m_globalTransform.setScale(p.m_z,p.m_z,p.m_z);
-
-
-    loadMatricesToTextureShader();
-    m_meshAABB->draw();
-    // draw the mesh bounding box
-    (*shader)["nglColourShader"]->use();
-    //loadMatricesToShader();
-    shader->setUniform("MVP",m_view*m_projection);
+    m_meshDrawTime+=std::chrono::steady_clock::now()-drawStart;
+    // draw the mesh bounding boxes, these are already in world space and the frustum culled
+    // ones would not show
+    useShader(shader,c_colourShader);
     shader->setUniform("Colour",0.0f,0.0f,1.0f,1.0f);
-    m_meshAABB->drawAABB();
-
-    m_globalTransform.setRotation(90,90,0);
-    m_globalTransform.addPosition(0,0,2);
-    loadMatricesToShader();
-    prim->draw("grid");
-  }
-
-
-
-}
-void NGLScene::persp(Mode _m)
-{
-  // grab an instance of the shader manager
-  ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  (*shader)["nglDiffuseShader"]->use();
-
-  // Rotation based on the mouse position for our global transform
-  // 4 is the panel full screen mode
-  size_t win=FULLOFFSET;
-  if(_m == Mode::PANEL)
-  {
-    win=static_cast<size_t>(Window::PERSP);
-  }
-  ngl::Mat4 rotX;
-  ngl::Mat4 rotY;
-  // create the rotation matrices
-  rotX.rotateX(m_panelMouseInfo[win].m_spinXFace);
-  rotY.rotateY(m_panelMouseInfo[win].m_spinYFace);
-  // multiply the rotations
-  ngl::Mat4 final=rotY*rotX;
-  // add the translations
-  final.m_m[3][0] = m_panelMouseInfo[win].m_modelPos.m_x;
-  final.m_m[3][1] = m_panelMouseInfo[win].m_modelPos.m_y;
-  final.m_m[3][2] = m_panelMouseInfo[win].m_modelPos.m_z;
-  // set this in the TX stack
-
-   // get the VBO instance and draw the built in teapot
-  ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
-
-  // first draw a top  persp // front //side
-  ngl::Vec3 from(0,5,0);
-  ngl::Vec3 to(0,0,0);
-  ngl::Vec3 up(0,0,-1);
-  m_globalTransform.reset();
-  {
-    /// a perspective view (right upper)
-    //first set the global mouse rotation for this one
-    m_globalTransform.setMatrix(final);
-    from.set(0,5,5);
-    up.set(0,1,0);
-    m_view=ngl::lookAt(from,to,up);
-    m_projection=ngl::perspective(45,float(m_width/m_height),0.01,100);
-    // x,y w/h
-    if(_m==Mode::PANEL)
+    for(size_t n=0; n<_numNodes; ++n)
     {
-      glViewport ((m_width/2)*devicePixelRatio(), (m_height/2)*devicePixelRatio(), (m_width/2)*devicePixelRatio(), (m_height/2)*devicePixelRatio());
+      m_scene.mesh(_nodes[n]).drawAABB(VP);
     }
-    else
+    if(m_useOcclusion)
     {
-      glViewport(0,0,m_width*devicePixelRatio(),m_height*devicePixelRatio());
+      // now test the solid boxes against the depth of what was drawn, depth only. Nodes out of
+      // the frustum keep their last result until they come back into view.
+      glColorMask(GL_FALSE,GL_FALSE,GL_FALSE,GL_FALSE);
+      glDepthMask(GL_FALSE);
+      for(size_t n=0; n<_numNodes; ++n)
+      {
+        size_t i=_nodes[n];
+        if(!m_occlusion->canQuery(win,i))
+        {
+          continue;
+        }
+        const AABB &box=m_scene.mesh(i).getAABB();
+        // clipped boxes would under report, just treat them as visible
+        if(OcclusionCuller::crossesNearPlane(box,VP))
+        {
+          m_occlusion->forceVisible(win,i);
+          continue;
+        }
+        m_occlusion->beginQuery(win,i);
+        m_scene.mesh(i).drawAABBSolid(VP);
+        m_occlusion->endQuery(win,i);
+      }
+      glDepthMask(GL_TRUE);
+      glColorMask(GL_TRUE,GL_TRUE,GL_TRUE,GL_TRUE);
     }
-
-    // draw
-    loadMatricesToTextureShader();
-    m_meshAABB->draw();
-    // draw the mesh bounding box
-    (*shader)["nglColourShader"]->use();
-    shader->setUniform("MVP",m_view*m_projection);
-    shader->setUniform("Colour",0.0f,0.0f,1.0f,1.0f);
-    loadMatricesToShader();
-    m_meshAABB->drawAABB();
-
-    // now we need to add an offset to the y position to draw the grid,
-    // easiest way is to just modify the matrix directly
-    final.m_m[3][1]-=0.8f;
-    m_globalTransform.setMatrix(final);
-
-    //m_globalTransform.setPosition(0,-0.55,0);
-    loadMatricesToShader();
-    prim->draw("grid");
   }
-
+  loadMatricesToShader(modelMatrix(win,true),_view);
+  ngl::VAOPrimitives::instance()->draw("grid");
+  Stats::add(Stats::Counter::DRAW_CALLS);
 }
-void NGLScene::front(Mode _m)
+
+void NGLScene::drawIndirect(const ViewState &_view)
 {
-  // grab an instance of the shader manager
+  size_t win=_view.m_viewport;
+  int viewportWidth=_view.m_rect[2];
+  int viewportHeight=_view.m_rect[3];
+  auto drawStart=std::chrono::steady_clock::now();
+  if(m_drawPath==DrawPath::GPU)
+  {
+    m_indirect->draw(win,_view.m_VP,viewportWidth,viewportHeight,m_useLOD,IndirectRenderer::Culling::GPU);
+  }
+  else
+  {
+    m_indirectCounts[win]=m_indirect->draw(win,_view.m_VP,viewportWidth,viewportHeight,m_useLOD,IndirectRenderer::Culling::CPU);
+    Stats::addCulled(win,m_indirect->numNodes()-m_indirectCounts[win].m_nodes);
+  }
+  m_meshDrawTime+=std::chrono::steady_clock::now()-drawStart;
   ngl::ShaderLib *shader=ngl::ShaderLib::instance();
-  (*shader)["nglDiffuseShader"]->use();
-
-  size_t win=FULLOFFSET;
-  if(_m == Mode::PANEL)
+  useShader(shader,c_colourShader);
+  shader->setUniform("Colour",0.0f,0.0f,1.0f,1.0f);
+  for(size_t i=0; i<m_scene.size(); ++i)
   {
-    win=static_cast<size_t>(Window::FRONT);
+    m_scene.mesh(i).drawAABB(_view.m_VP);
   }
+}
 
-   // get the VBO instance and draw the built in teapot
-  ngl::VAOPrimitives *prim=ngl::VAOPrimitives::instance();
-
-  // first draw a top  persp // front //side
-  ngl::Vec3 from(0,5,0);
-  ngl::Vec3 to(0,0,0);
-  ngl::Vec3 up(0,0,-1);
-  /// a front view (bottom left)
-  m_globalTransform.reset();
-  {
-    from.set(0,0,5);
-    up.set(0,1,0);
-    m_view=ngl::lookAt(from,to,up);
-    m_projection=ngl::ortho(-5,5,-5,5, 0.01f, 200.0f);
-    // x,y w/h
-    if(_m==Mode::PANEL)
+void NGLScene::softwareCull(const ViewState &_view, const uint32_t *_nodes, size_t _numNodes, FrameVector<unsigned char> &_visible)
+{
+  auto start=std::chrono::steady_clock::now();
+  const ngl::Mat4 &VP=_view.m_VP;
+  // the biggest things on screen make the best occluders. Only the full detail mesh is
+  // drawn, a simplified level can bulge past the real surface and hide things that show
+  FrameVector<std::pair<ngl::Real,size_t>> candidates(m_frameArena);
+  candidates.reserve(_numNodes);
+  for(size_t n=0; n<_numNodes; ++n)
+  {
+    size_t i=_nodes[n];
+    if(!m_geometry.isReady(m_scene.asset(i).m_mesh))
     {
-      glViewport (0,0, (m_width/2)*devicePixelRatio(), (m_height/2)*devicePixelRatio());
+      continue;
     }
-    else
+    ngl::Real pixels=MeshLOD::projectedSize(m_scene.mesh(i).getAABB(),VP,_view.m_rect[2],_view.m_rect[3]);
+    if(pixels>=c_minOccluderPixels)
     {
-      glViewport(0,0,m_width*devicePixelRatio(),m_height*devicePixelRatio());
+      candidates.push_back(std::make_pair(pixels,i));
     }
-    // draw
-    // in this case set to an identity
-    ngl::Vec3 p=m_panelMouseInfo[win].m_modelPos;
-    m_globalTransform.setPosition(p.m_x,p.m_y,0);
-    m_globalTransform.setScale(p.m_z,p.m_z,p.m_z);
-    loadMatricesToTextureShader();
-    m_meshAABB->draw();
-    // draw the mesh bounding box
-    (*shader)["nglColourShader"]->use();
-    //loadMatricesToShader();
-    shader->setUniform("MVP",m_view*m_projection);
-    shader->setUniform("Colour",0.0f,0.0f,1.0f,1.0f);
-    m_meshAABB->drawAABB();
-    m_globalTransform.setRotation(90,0,0);
-    m_globalTransform.addPosition(0,0,-1);
-    loadMatricesToShader();
-    prim->draw("grid");
   }
-
+  size_t numOccluders=std::min(c_maxOccluders,candidates.size());
+  std::partial_sort(candidates.begin(),candidates.begin()+numOccluders,
+                    candidates.end(),std::greater<std::pair<ngl::Real,size_t>>());
+  m_softwareOcclusion.begin(VP);
+  for(size_t o=0; o<numOccluders; ++o)
+  {
+    size_t i=candidates[o].second;
+    const MeshLOD &lod=*m_geometry.mesh(m_scene.asset(i).m_mesh).m_lod;
+    m_softwareOcclusion.rasterize(lod.positions(),MeshLOD::c_positionStride,
+                                  lod.indices(0),lod.numIndices(0),
+                                  m_scene.worldMatrix(i)*VP);
+  }
+  m_softwareOcclusion.end();
+  _visible.resize(_numNodes);
+  for(size_t n=0; n<_numNodes; ++n)
+  {
+    _visible[n]=m_softwareOcclusion.isVisible(m_scene.mesh(_nodes[n]).getAABB());
+  }
+  m_softwareCullTime+=std::chrono::steady_clock::now()-start;
 }
 
-
-NGLScene::Window NGLScene::getActiveQuadrant() const
+void NGLScene::uploadAssets()
 {
-  // find where the  mouse is and set quadrant
-  if( (m_mouseX <m_width/2) && (m_mouseY<m_height/2) )
+  PROFILE_ZONE("uploadAssets");
+  m_readyMeshes.clear();
+  m_geometry.update(c_uploadBudget,m_readyMeshes);
+  if(s_verbose)
   {
-    return Window::TOP;
+    for(GeometryCache::MeshID id : m_readyMeshes)
+    {
+      const GeometryCache::Mesh &mesh=m_geometry.mesh(id);
+      std::cout<<mesh.m_file<<" ready, LOD triangles";
+      for(size_t l=0; l<mesh.m_lod->numLevels(); ++l)
+      {
+        std::cout<<" "<<mesh.m_lod->numTriangles(l);
+      }
+      std::cout<<"\n";
+    }
   }
-  else if( (m_mouseX >=m_width/2) && (m_mouseY<m_height/2) )
+  if(!m_readyMeshes.empty())
   {
-    return Window::PERSP;
+    for(size_t i=0; i<m_scene.size(); ++i)
+    {
+      GeometryCache::MeshID mesh=m_scene.asset(i).m_mesh;
+      if(std::find(m_readyMeshes.begin(),m_readyMeshes.end(),mesh)!=m_readyMeshes.end())
+      {
+        m_scene.setLocalBounds(i,m_geometry.bounds(mesh),m_geometry.hull(mesh));
+      }
+    }
+    m_scene.update();
+  }
+  if(!m_loadReported && !m_geometry.isLoading())
+  {
+    if(s_verbose)
+    {
+      typedef std::chrono::duration<double,std::milli> ms;
+      std::cout<<"fully loaded after "<<std::chrono::duration_cast<ms>(std::chrono::steady_clock::now()-m_startTime).count()<<" ms\n";
+    }
+    m_loadReported=true;
   }
-  else if( (m_mouseX <=m_width/2) && (m_mouseY>m_height/2) )
+}
+
+void NGLScene::resetBounds()
+{
+  for(size_t i=0; i<m_scene.size(); ++i)
   {
-    return Window::FRONT;
+    GeometryCache::MeshID mesh=m_scene.asset(i).m_mesh;
+    m_scene.setLocalBounds(i,m_geometry.bounds(mesh),m_geometry.hull(mesh));
   }
-  else if( (m_mouseX >=m_width/2) && (m_mouseY>m_height/2) )
+  m_scene.update();
+}
+
+void NGLScene::updateExactBounds()
+{
+  PROFILE_ZONE("exactBounds");
+  GpuProfiler::Zone gpuZone(m_gpuProfiler,"exactBounds");
+  m_exact.resize(m_scene.size());
+  m_exactResults.clear();
+  m_computeBounds->collect(m_exactResults);
+  for(const auto &r : m_exactResults)
   {
-    return Window::SIDE;
+    ExactBounds &e=m_exact[r.m_id];
+    e.m_box=r.m_box;
+    e.m_world=r.m_world;
+    e.m_inverseWorld=r.m_world;
+    e.m_inverseWorld=e.m_inverseWorld.inverse();
+    e.m_valid=true;
   }
-  else // should never get here but stops warning
+  bool send=m_computeBounds->canDispatch();
+  for(size_t i=0; i<m_scene.size(); ++i)
   {
-    return Window::ALL;
+    GeometryCache::MeshID mesh=m_scene.asset(i).m_mesh;
+    if(!m_geometry.isReady(mesh))
+    {
+      continue;
+    }
+    const ngl::Mat4 &world=m_scene.worldMatrix(i);
+    ExactBounds &e=m_exact[i];
+    if(e.m_valid)
+    {
+      // a node that has moved since takes the box along by the change in transform, the
+      // box of that box is still much tighter than the box of the rotated local corners
+      m_scene.tightenBounds(i,sameMatrix(world,e.m_world) ? e.m_box : e.m_box.transformed(e.m_inverseWorld*world));
+    }
+    if(send && (!e.m_sent || !sameMatrix(world,e.m_sentWorld)))
+    {
+      const MeshLOD &lod=*m_geometry.mesh(mesh).m_lod;
+      ngl::Mat4 dequantize=lod.dequantizeMatrix();
+      m_computeBounds->add(i,lod.vertexBuffer(),lod.numVertices(),lod.vertexStride(),world,lod.isQuantized() ? &dequantize : nullptr);
+      e.m_sentWorld=world;
+      e.m_sent=true;
+    }
   }
+  m_computeBounds->dispatch();
 }
 
+size_t NGLScene::drawMeshlets(const MeshLOD &_lod, const ngl::Mat4 &_world, const ngl::Mat4 &_view, const ngl::Mat4 &_VP, bool _orthographic)
+{
+  PROFILE_ZONE("drawMeshlets");
+  ngl::Mat4 MV=_world*_view;
+  ngl::Mat4 inverseMV=MV;
+  inverseMV=inverseMV.inverse();
+  // the eye in object space, an orthographic eye is at infinity behind the view direction
+  ngl::Vec4 eye=(_orthographic ? ngl::Vec4(0.0f,0.0f,1.0f,0.0f) : ngl::Vec4(0.0f,0.0f,0.0f,1.0f))*inverseMV;
+  // a mirroring transform swaps which side of a triangle faces the eye
+  const ngl::Real (*m)[4]=MV.m_m;
+  ngl::Real det=m[0][0]*(m[1][1]*m[2][2]-m[1][2]*m[2][1])
+               -m[0][1]*(m[1][0]*m[2][2]-m[1][2]*m[2][0])
+               +m[0][2]*(m[1][0]*m[2][1]-m[1][1]*m[2][0]);
+  const Meshlets &meshlets=_lod.meshlets();
+  GLsizei *counts=m_frameArena.allocate<GLsizei>(meshlets.size());
+  const void **offsets=m_frameArena.allocate<const void *>(meshlets.size());
+  size_t numRanges=0;
+  size_t triangles=meshlets.cull(_world*_VP,eye,det>0.0f,counts,offsets,numRanges);
+  // the cone test keeps meshlets with any front facing triangle, GL drops the back facing
+  // ones in them. Only here, the other meshes are drawn without face culling.
+  glFrontFace(det>0.0f ? GL_CCW : GL_CW);
+  glEnable(GL_CULL_FACE);
+  _lod.drawRanges(counts,offsets,numRanges);
+  glDisable(GL_CULL_FACE);
+  glFrontFace(GL_CCW);
+  return triangles;
+}
 
-void NGLScene::toggleWindow()
+size_t NGLScene::activeViewport() const
 {
-  if(m_activeWindow ==Window::ALL)
+  if(m_fullscreen!=ViewportLayout::c_noViewport)
   {
-    m_activeWindow=getActiveQuadrant();
-    //store mouse info as we have gone fullscreen
-    m_panelMouseInfo[FULLOFFSET].m_modelPos = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_modelPos;
-    m_panelMouseInfo[FULLOFFSET].m_origX = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origX;
-    m_panelMouseInfo[FULLOFFSET].m_origY = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origY;
+    return m_fullscreen;
+  }
+  return m_layout.viewportAt(m_mouseX,m_mouseY,m_width,m_height);
+}
 
-    m_panelMouseInfo[FULLOFFSET].m_spinXFace = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_spinXFace;
-    m_panelMouseInfo[FULLOFFSET].m_spinYFace = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_spinYFace;
-    m_panelMouseInfo[FULLOFFSET].m_origXPos = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origXPos;
-    m_panelMouseInfo[FULLOFFSET].m_origYPos = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origYPos;
-    m_panelMouseInfo[FULLOFFSET].m_rotate = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_rotate;
-    m_panelMouseInfo[FULLOFFSET].m_translate = m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_translate;
+void NGLScene::toggleWindow()
+{
+  // the viewport keeps its own mouse info either way
+  if(m_fullscreen==ViewportLayout::c_noViewport)
+  {
+    m_fullscreen=m_layout.viewportAt(m_mouseX,m_mouseY,m_width,m_height);
   }
   else
   {
-    // store info as we are minimised
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_modelPos = m_panelMouseInfo[FULLOFFSET].m_modelPos;
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origX = m_panelMouseInfo[FULLOFFSET].m_origX;
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origY = m_panelMouseInfo[FULLOFFSET].m_origY;
-
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_spinXFace = m_panelMouseInfo[FULLOFFSET].m_spinXFace;
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_spinYFace = m_panelMouseInfo[FULLOFFSET].m_spinYFace;
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origXPos = m_panelMouseInfo[FULLOFFSET].m_origXPos;
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_origYPos = m_panelMouseInfo[FULLOFFSET].m_origYPos;
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_rotate = m_panelMouseInfo[FULLOFFSET].m_rotate;
-    m_panelMouseInfo[static_cast<size_t>(m_activeWindow)].m_translate = m_panelMouseInfo[FULLOFFSET].m_translate;
-    m_activeWindow=Window::ALL;
+    m_fullscreen=ViewportLayout::c_noViewport;
   }
+}
 
+void NGLScene::printPerView(const char *_label, const std::array<size_t,Stats::c_maxViews> &_counts) const
+{
+  std::cout<<_label;
+  for(size_t v=0; v<m_layout.size(); ++v)
+  {
+    std::cout<<" "<<m_layout.viewport(v).m_name<<" "<<_counts[v];
+  }
 }
 
 
 void NGLScene::paintGL()
 {
+  // exit() only queues the quit so a failed initializeGL still gets a paint or two
+  if(!m_sceneLoaded)
+  {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return;
+  }
+  PROFILE_ZONE("paintGL");
+  size_t allocationsAtStart=AllocationCounter::allocations();
+  // the only place the arena moves on, so anything timerEvent allocated since the last paint is
+  // still there for this one
+  m_frameArena.nextFrame();
   // clear the screen and depth buffer
    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-   switch(m_activeWindow)
+   auto uploadStart=std::chrono::steady_clock::now();
+   uploadAssets();
+   // whatever uploadAssets left of the budget goes on the indirect renderer's copies
+   std::chrono::steady_clock::duration uploadLeft=c_uploadBudget-(std::chrono::steady_clock::now()-uploadStart);
+   if(m_exactBounds)
+   {
+     updateExactBounds();
+   }
+   m_trianglesFull=0;
+   m_trianglesSubmitted=0;
+   m_occludedMeshes.fill(0);
+   m_frustumCulled.fill(0);
+   m_meshletCulled.fill(0);
+   m_softwareCulled=0;
+   m_meshesDrawn=0;
+   m_softwareCullTime=std::chrono::steady_clock::duration::zero();
+   m_meshDrawTime=std::chrono::steady_clock::duration::zero();
+   if(m_drawPath!=DrawPath::DIRECT)
    {
-     case Window::ALL :
+     m_indirect->beginFrame(m_scene,m_geometry,uploadLeft);
+     // the GPU counts are kept until newer ones come back
+     if(m_drawPath==DrawPath::CPU)
      {
-       front(Mode::PANEL);
-       side(Mode::PANEL);
-       top(Mode::PANEL);
-       persp(Mode::PANEL);
-       break;
+       m_indirectCounts.fill(IndirectRenderer::Counts());
      }
-     case Window::FRONT : {front(Mode::FULLSCREEN); break; }
-     case Window::SIDE : {side(Mode::FULLSCREEN); break; }
-     case Window::TOP : {top(Mode::FULLSCREEN); break; }
-     case Window::PERSP : {persp(Mode::FULLSCREEN); break; }
+   }
 
+   setupViews();
+   // the indirect paths cull on their own, per view
+   FrameVector<uint32_t> nodes(m_frameArena);
+   FrameVector<size_t> starts(m_frameArena);
+   if(m_drawPath==DrawPath::DIRECT)
+   {
+     cullViews(nodes,starts);
+   }
+   for(size_t k=0; k<m_drawnViews.size(); ++k)
+   {
+     if(starts.empty())
+     {
+       drawViewport(m_drawnViews[k],nullptr,0);
+     }
+     else
+     {
+       drawViewport(m_drawnViews[k],nodes.data()+starts[k],starts[k+1]-starts[k]);
+     }
+   }
+   if(m_drawPath!=DrawPath::DIRECT)
+   {
+     m_indirect->endFrame();
+     if(m_drawPath==DrawPath::GPU)
+     {
+       m_indirect->collect(m_indirectCounts);
+     }
+     for(size_t v=0; v<m_layout.size(); ++v)
+     {
+       m_trianglesFull+=m_indirectCounts[v].m_fullTriangles;
+       m_trianglesSubmitted+=m_indirectCounts[v].m_triangles;
+       m_indirectNodes[v]=m_indirectCounts[v].m_nodes;
+     }
    }
+   m_gpuProfiler.endFrame();
+   if(m_showProfile)
+   {
+     drawProfileOverlay();
+   }
+   m_frameAllocations+=AllocationCounter::allocations()-allocationsAtStart;
+   Stats::add(Stats::Counter::HEAP_ALLOCATIONS,m_frameAllocations);
+   Stats::endFrame();
+   if(s_verbose && !m_firstFrameReported)
+   {
+     typedef std::chrono::duration<double,std::milli> ms;
+     std::cout<<"first frame after "<<std::chrono::duration_cast<ms>(std::chrono::steady_clock::now()-m_startTime).count()<<" ms\n";
+     m_firstFrameReported=true;
+   }
+   if(s_verbose)
+   {
+     reportFrame();
+   }
+   m_frameAllocations=0;
+}
+
+void NGLScene::reportFrame()
+{
+  if(m_frameAllocations!=m_lastFrameAllocations)
+  {
+    std::cout<<"heap allocations in frame code "<<m_frameAllocations<<", frame arena "<<m_frameArena.used()
+             <<" of "<<m_frameArena.capacity()<<" bytes (high water "<<m_frameArena.highWater()<<")\n";
+    m_lastFrameAllocations=m_frameAllocations;
+  }
+  // only report when the numbers change so the console is not flooded
+  if(m_trianglesSubmitted!=m_lastTrianglesSubmitted)
+  {
+    std::cout<<"triangles per frame full "<<m_trianglesFull<<" submitted "<<m_trianglesSubmitted
+             <<" ("<<(m_useLOD ? "LOD on" : "LOD off")<<")\n";
+    m_lastTrianglesSubmitted=m_trianglesSubmitted;
+  }
+  if(m_frustumCulled!=m_lastFrustumCulled)
+  {
+    printPerView("frustum culled nodes",m_frustumCulled);
+    std::cout<<" of "<<m_scene.size()<<"\n";
+    m_lastFrustumCulled=m_frustumCulled;
+  }
+  if(m_occludedMeshes!=m_lastOccludedMeshes)
+  {
+    printPerView("occluded meshes skipped",m_occludedMeshes);
+    std::cout<<"\n";
+    m_lastOccludedMeshes=m_occludedMeshes;
+  }
+  if(m_meshletCulled!=m_lastMeshletCulled)
+  {
+    printPerView("meshlet culling saved triangles",m_meshletCulled);
+    std::cout<<"\n";
+    m_lastMeshletCulled=m_meshletCulled;
+  }
+  if(m_drawPath!=DrawPath::DIRECT && m_indirectNodes!=m_lastIndirectNodes)
+  {
+    printPerView(m_drawPath==DrawPath::GPU ? "GPU culled nodes drawn" : "CPU culled nodes drawn",m_indirectNodes);
+    std::cout<<" of "<<m_indirect->numNodes()<<"\n";
+    m_lastIndirectNodes=m_indirectNodes;
+  }
+  // the software cull times change every frame so only report once a second
+  auto now=std::chrono::steady_clock::now();
+  if(m_useSoftwareOcclusion && now-m_lastCullReport>std::chrono::seconds(1))
+  {
+    typedef std::chrono::duration<double,std::milli> ms;
+    double cull=std::chrono::duration_cast<ms>(m_softwareCullTime).count();
+    double perMesh=m_meshesDrawn ? std::chrono::duration_cast<ms>(m_meshDrawTime).count()/m_meshesDrawn : 0.0;
+    std::cout<<"software occlusion "<<cull<<" ms hid "<<m_softwareCulled<<" meshes, a mesh draw costs "
+             <<perMesh<<" ms so about "<<perMesh*m_softwareCulled<<" ms of draws saved\n";
+    m_lastCullReport=now;
+  }
+}
+
+void NGLScene::drawProfileOverlay()
+{
+  Profiler::collectFrame(m_cpuZones);
+  // GPU results turn up a few frames late and not every frame, keep showing the last set
+  Profiler::collectFrame(m_gpuZones,true);
+  if(!m_gpuZones.empty())
+  {
+    m_lastGpuZones.swap(m_gpuZones);
+  }
+  glViewport(0,0,m_width*devicePixelRatio(),m_height*devicePixelRatio());
+  m_text->setColour(1.0f,1.0f,0.0f);
+  float y=20.0f;
+  char line[128];
+  for(const auto &z : m_cpuZones)
+  {
+    std::snprintf(line,sizeof(line),"cpu %-22s %7.3f ms",z.first,z.second);
+    m_text->renderText(10.0f,y,line);
+    y+=18.0f;
+  }
+  m_text->setColour(0.0f,1.0f,1.0f);
+  for(const auto &z : m_lastGpuZones)
+  {
+    std::snprintf(line,sizeof(line),"gpu %-22s %7.3f ms",z.first,z.second);
+    m_text->renderText(10.0f,y,line);
+    y+=18.0f;
+  }
+  // counters from the frame before this one, this frame's are still being added to
+  m_text->setColour(1.0f,1.0f,1.0f);
+  for(size_t c=0; c<Stats::c_numCounters; ++c)
+  {
+    Stats::Counter counter=static_cast<Stats::Counter>(c);
+    std::snprintf(line,sizeof(line),"%-26s %llu",Stats::name(counter),
+                  static_cast<unsigned long long>(Stats::lastFrame(counter)));
+    m_text->renderText(10.0f,y,line);
+    y+=18.0f;
+  }
 }
 
 //----------------------------------------------------------------------------------------------------------------------
@@ -497,11 +904,11 @@ void NGLScene::mouseMoveEvent (QMouseEvent * _event)
 {
   m_mouseX=_event->x();
   m_mouseY=_event->y();
-  size_t win;
-  if(m_activeWindow ==Window::ALL)
-    win=static_cast<size_t>(getActiveQuadrant());
-  else
-    win=FULLOFFSET;
+  size_t win=activeViewport();
+  if(win==ViewportLayout::c_noViewport)
+  {
+    return;
+  }
   // note the method buttons() is the button state when event was called
   // this is different from button() which is used to check which button was
   // pressed when the mousePress/Release event is generated
@@ -534,11 +941,14 @@ void NGLScene::mouseMoveEvent (QMouseEvent * _event)
 //----------------------------------------------------------------------------------------------------------------------
 void NGLScene::mousePressEvent ( QMouseEvent * _event)
 {
-  size_t win;
-	if(m_activeWindow ==Window::ALL)
-    win=static_cast<size_t>(getActiveQuadrant());
-	else
-		win=FULLOFFSET;
+  // without mouse tracking there are no move events before the press
+  m_mouseX=_event->x();
+  m_mouseY=_event->y();
+  size_t win=activeViewport();
+  if(win==ViewportLayout::c_noViewport)
+  {
+    return;
+  }
 
   // this method is called when the mouse button is pressed in this case we
   // store the value where the maouse was clicked (x,y) and set the Rotate flag to true
@@ -562,20 +972,19 @@ void NGLScene::mousePressEvent ( QMouseEvent * _event)
 void NGLScene::mouseReleaseEvent ( QMouseEvent * _event )
 {
   // this event is called when the mouse button is released
-  // we then set Rotate to false
-  size_t win;
-  if(m_activeWindow ==Window::ALL)
-    win=static_cast<size_t>(getActiveQuadrant());
-  else
-    win=FULLOFFSET;
-  if (_event->button() == Qt::LeftButton)
-  {
-    m_panelMouseInfo[win].m_rotate=false;
-  }
-  // right mouse translate mode
-  if (_event->button() == Qt::RightButton)
+  // we then set Rotate to false, in every viewport as the mouse may have left the one it
+  // was pressed in
+  for(auto &mouse : m_panelMouseInfo)
   {
-    m_panelMouseInfo[win].m_translate=false;
+    if (_event->button() == Qt::LeftButton)
+    {
+      mouse.m_rotate=false;
+    }
+    // right mouse translate mode
+    if (_event->button() == Qt::RightButton)
+    {
+      mouse.m_translate=false;
+    }
   }
  }
 
@@ -583,11 +992,13 @@ void NGLScene::mouseReleaseEvent ( QMouseEvent * _event )
 void NGLScene::wheelEvent(QWheelEvent *_event)
 {
 
-  size_t win;
-	if(m_activeWindow ==Window::ALL)
-    win=static_cast<size_t>(getActiveQuadrant());
-	else
-		win=FULLOFFSET;
+  m_mouseX=_event->x();
+  m_mouseY=_event->y();
+  size_t win=activeViewport();
+  if(win==ViewportLayout::c_noViewport)
+  {
+    return;
+  }
 	// check the diff of the wheel position (0 means no change)
 	if(_event->delta() > 0)
 	{
@@ -599,6 +1010,32 @@ void NGLScene::wheelEvent(QWheelEvent *_event)
 	}
 	update();
 }
+void NGLScene::updateBroadPhase()
+{
+  PROFILE_ZONE("broadPhase");
+  m_gridBoxes.resize(m_scene.size());
+  for(size_t i=0; i<m_scene.size(); ++i)
+  {
+    m_gridBoxes[i]=m_scene.mesh(i).getAABB();
+  }
+  m_pairs.clear();
+  if(m_broadPhase==BroadPhase::GRID)
+  {
+    m_grid.build(m_gridBoxes.data(),m_gridBoxes.size());
+    m_grid.queryPairs(m_pairs);
+  }
+  else
+  {
+    m_lbvh.build(m_gridBoxes.data(),m_gridBoxes.size());
+    m_lbvh.queryPairs(m_pairs);
+  }
+  if(s_verbose && m_pairs.size()!=m_lastPairs)
+  {
+    std::cout<<"broad phase "<<m_pairs.size()<<" overlapping pairs of "<<m_gridBoxes.size()<<" boxes\n";
+    m_lastPairs=m_pairs.size();
+  }
+}
+
 //----------------------------------------------------------------------------------------------------------------------
 
 void NGLScene::keyPressEvent(QKeyEvent *_event)
@@ -622,6 +1059,91 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
   case Qt::Key_2 : m_rotMode=RotMode::YROT; break;
   case Qt::Key_3 : m_rotMode=RotMode::ZROT; break;
   case Qt::Key_4 : m_rotMode=RotMode::ALL; break;
+  // toggle LOD selection
+  case Qt::Key_L : m_useLOD^=true; break;
+  // toggle occlusion query culling
+  case Qt::Key_O : m_useOcclusion^=true; break;
+  // toggle the CPU depth buffer culling
+  case Qt::Key_C : m_useSoftwareOcclusion^=true; break;
+  // toggle meshlet culling of full detail meshes
+  case Qt::Key_M :
+    m_useMeshlets^=true;
+    std::cout<<"meshlet culling "<<(m_useMeshlets ? "on" : "off")<<"\n";
+  break;
+  // cycle drawing each mesh, multi draw indirect culled on the GPU and culled on the CPU
+  case Qt::Key_I :
+  {
+    if(!m_indirect)
+    {
+      std::cout<<"multi draw indirect needs GL 4.3 compute shaders\n";
+      break;
+    }
+    static const char *names[]={"a draw per mesh","multi draw indirect, GPU culled","multi draw indirect, CPU culled"};
+    int path=(static_cast<int>(m_drawPath)+1)%3;
+    m_drawPath=static_cast<DrawPath>(path);
+    m_indirectCounts.fill(IndirectRenderer::Counts());
+    m_lastIndirectNodes.fill(static_cast<size_t>(-1));
+    std::cout<<"drawing with "<<names[path]<<"\n";
+  }
+  break;
+  // toggle exact GPU computed bounds, going back rebuilds the corner boxes
+  case Qt::Key_E :
+    if(!m_computeBounds)
+    {
+      std::cout<<"exact bounds need GL 4.3 compute shaders\n";
+      break;
+    }
+    m_exactBounds^=true;
+    if(!m_exactBounds)
+    {
+      resetBounds();
+      m_exact.assign(m_scene.size(),ExactBounds());
+    }
+  break;
+  // cycle the CPU world boxes through the 8 local corners, every convex hull point and a
+  // walk over the hull from the last extreme points
+  case Qt::Key_H :
+  {
+    static const char *names[]={"box corners","convex hull","hull support walk"};
+    int mode=(static_cast<int>(MeshWithAABB::boundsMode())+1)%3;
+    MeshWithAABB::setBoundsMode(static_cast<MeshWithAABB::BoundsMode>(mode));
+    std::cout<<"world bounds from "<<names[mode]<<"\n";
+    resetBounds();
+  }
+  break;
+  // cycle the broad phase over the world boxes through off, hash grid and LBVH
+  case Qt::Key_G :
+  {
+    static const char *names[]={"off","spatial hash grid","LBVH"};
+    int mode=(static_cast<int>(m_broadPhase)+1)%3;
+    m_broadPhase=static_cast<BroadPhase>(mode);
+    m_lastPairs=static_cast<size_t>(-1);
+    std::cout<<"broad phase "<<names[mode]<<"\n";
+    if(m_broadPhase!=BroadPhase::OFF)
+    {
+      updateBroadPhase();
+    }
+  }
+  break;
+  // toggle profiling and its overlay
+  case Qt::Key_P :
+    m_showProfile^=true;
+    Profiler::setEnabled(m_showProfile);
+  break;
+  // dump the recorded zones for chrome://tracing
+  case Qt::Key_T :
+    if(Profiler::writeChromeTrace("SimpleAABB.trace.json"))
+    {
+      std::cout<<"wrote SimpleAABB.trace.json\n";
+    }
+  break;
+  // dump the frame counters
+  case Qt::Key_J :
+    if(Stats::writeJSON("SimpleAABB.stats.json"))
+    {
+      std::cout<<"wrote SimpleAABB.stats.json\n";
+    }
+  break;
 
   default : break;
   }
@@ -631,26 +1153,40 @@ void NGLScene::keyPressEvent(QKeyEvent *_event)
 void NGLScene::timerEvent(QTimerEvent *)
 {
   // draw the mesh
-  static float rotXX=0.0f;
-  if(!m_active)
+  // keep drawing while assets are arriving so their uploads are not held up
+  if(m_geometry.isLoading())
+  {
+    update();
+  }
+  if(!m_active || !m_sceneLoaded)
     return;
-  ++rotXX;
+  PROFILE_ZONE("timerEvent");
+  size_t allocationsAtStart=AllocationCounter::allocations();
+  ++m_rotation;
   switch(m_rotMode )
   {
   case RotMode::XROT :
-    m_transform.setRotation(rotXX,0,0);
+    m_transform.setRotation(m_rotation,0,0);
   break;
   case RotMode::YROT :
-    m_transform.setRotation(0,rotXX,0);
+    m_transform.setRotation(0,m_rotation,0);
   break;
   case RotMode::ZROT :
-    m_transform.setRotation(0,0,rotXX);
+    m_transform.setRotation(0,0,m_rotation);
   break;
   case RotMode::ALL :
-    m_transform.setRotation(rotXX,rotXX,rotXX);
+    m_transform.setRotation(m_rotation,m_rotation,m_rotation);
   break;
   }
-  m_meshAABB->setTransform(m_transform);
+  // spin about the object's own origin before its placement from the scene file
+  m_scene.setLocalTransform(m_root,m_transform.getMatrix()*m_rootLocal);
+  m_scene.update();
+  if(m_broadPhase!=BroadPhase::OFF)
+  {
+    updateBroadPhase();
+  }
+  // counted before update() as Qt allocates to post the repaint
+  m_frameAllocations+=AllocationCounter::allocations()-allocationsAtStart;
   update();
 }
 
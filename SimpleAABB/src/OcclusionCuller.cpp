@@ -0,0 +1,79 @@
+#include "OcclusionCuller.h"
+#include <ngl/Vec4.h>
+
+OcclusionCuller::OcclusionCuller(size_t _numViews)
+{
+  m_views.resize(_numViews);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+  for(auto &view : m_views)
+  {
+    for(auto &q : view)
+    {
+      glDeleteQueries(1,&q.m_id);
+    }
+  }
+}
+
+void OcclusionCuller::beginView(size_t _view, size_t _numObjects)
+{
+  auto &view=m_views[_view];
+  while(view.size()<_numObjects)
+  {
+    Query q;
+    glGenQueries(1,&q.m_id);
+    view.push_back(q);
+  }
+  for(auto &q : view)
+  {
+    if(!q.m_pending)
+    {
+      continue;
+    }
+    // only read the result when it is ready, otherwise keep the old answer for another frame
+    GLuint available=0;
+    glGetQueryObjectuiv(q.m_id,GL_QUERY_RESULT_AVAILABLE,&available);
+    if(available)
+    {
+      GLuint samples=0;
+      glGetQueryObjectuiv(q.m_id,GL_QUERY_RESULT,&samples);
+      q.m_visible= samples!=0;
+      q.m_pending=false;
+      q.m_answered=true;
+    }
+  }
+}
+
+void OcclusionCuller::beginQuery(size_t _view, size_t _object)
+{
+  glBeginQuery(GL_ANY_SAMPLES_PASSED,m_views[_view][_object].m_id);
+}
+
+void OcclusionCuller::endQuery(size_t _view, size_t _object)
+{
+  glEndQuery(GL_ANY_SAMPLES_PASSED);
+  m_views[_view][_object].m_pending=true;
+}
+
+void OcclusionCuller::forceVisible(size_t _view, size_t _object)
+{
+  m_views[_view][_object].m_visible=true;
+}
+
+bool OcclusionCuller::crossesNearPlane(const AABB &_box, const ngl::Mat4 &_VP)
+{
+  for(int i=0; i<8; ++i)
+  {
+    ngl::Vec4 corner(i&1 ? _box.m_max.m_x : _box.m_min.m_x,
+                     i&2 ? _box.m_max.m_y : _box.m_min.m_y,
+                     i&4 ? _box.m_max.m_z : _box.m_min.m_z,1.0f);
+    ngl::Vec4 clip=corner*_VP;
+    if(clip.m_z < -clip.m_w)
+    {
+      return true;
+    }
+  }
+  return false;
+}
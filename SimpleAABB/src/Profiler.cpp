@@ -0,0 +1,215 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+constexpr size_t Profiler::c_eventsPerThread;
+constexpr size_t GpuProfiler::c_framesInFlight;
+std::atomic<bool> Profiler::s_enabled(false);
+
+namespace
+{
+  const std::chrono::steady_clock::time_point s_epoch=std::chrono::steady_clock::now();
+}
+
+struct Profiler::ThreadBuffer
+{
+  ThreadBuffer(uint32_t _tid, bool _gpu) : m_events(new Event[c_eventsPerThread]), m_written(0), m_tid(_tid), m_gpu(_gpu) {}
+  std::unique_ptr<Event[]> m_events;
+  // total events ever written, the slot is m_written % c_eventsPerThread. Only the owning
+  // thread writes, the release store publishes the event to the exporter.
+  std::atomic<size_t> m_written;
+  // how far collectFrame has read, owning thread only
+  size_t m_collected=0;
+  uint32_t m_tid;
+  bool m_gpu;
+
+  void push(const char *_name, uint64_t _start, uint64_t _end)
+  {
+    size_t w=m_written.load(std::memory_order_relaxed);
+    Event &e=m_events[w & (c_eventsPerThread-1)];
+    e.m_name=_name;
+    e.m_start=_start;
+    e.m_end=_end;
+    m_written.store(w+1,std::memory_order_release);
+  }
+  // oldest event still in the ring
+  size_t first(size_t _written) const
+  {
+    return _written>c_eventsPerThread ? _written-c_eventsPerThread : 0;
+  }
+};
+
+std::mutex &Profiler::registryMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<std::unique_ptr<Profiler::ThreadBuffer>> &Profiler::registry()
+{
+  static std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+  return buffers;
+}
+
+uint64_t Profiler::now()
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-s_epoch).count());
+}
+
+Profiler::ThreadBuffer &Profiler::threadBuffer()
+{
+  // only the first zone on each thread takes the lock
+  static thread_local ThreadBuffer *buffer=nullptr;
+  if(!buffer)
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().emplace_back(new ThreadBuffer(static_cast<uint32_t>(registry().size()+1),false));
+    buffer=registry().back().get();
+  }
+  return *buffer;
+}
+
+Profiler::ThreadBuffer &Profiler::gpuBuffer()
+{
+  static ThreadBuffer *buffer=nullptr;
+  if(!buffer)
+  {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().emplace_back(new ThreadBuffer(0,true));
+    buffer=registry().back().get();
+  }
+  return *buffer;
+}
+
+void Profiler::record(const char *_name, uint64_t _start, uint64_t _end)
+{
+  threadBuffer().push(_name,_start,_end);
+}
+
+void Profiler::recordGPU(const char *_name, uint64_t _start, uint64_t _end)
+{
+  gpuBuffer().push(_name,_start,_end);
+}
+
+void Profiler::collectFrame(std::vector<std::pair<const char *,double>> &_msPerZone, bool _gpu)
+{
+  _msPerZone.clear();
+  ThreadBuffer &b= _gpu ? gpuBuffer() : threadBuffer();
+  size_t written=b.m_written.load(std::memory_order_acquire);
+  for(size_t i=std::max(b.m_collected,b.first(written)); i<written; ++i)
+  {
+    const Event &e=b.m_events[i & (c_eventsPerThread-1)];
+    double ms=(e.m_end-e.m_start)*1e-6;
+    bool found=false;
+    for(auto &z : _msPerZone)
+    {
+      if(z.first==e.m_name || std::strcmp(z.first,e.m_name)==0)
+      {
+        z.second+=ms;
+        found=true;
+        break;
+      }
+    }
+    if(!found)
+    {
+      _msPerZone.push_back(std::make_pair(e.m_name,ms));
+    }
+  }
+  b.m_collected=written;
+}
+
+bool Profiler::writeChromeTrace(const std::string &_file)
+{
+  FILE *out=std::fopen(_file.c_str(),"w");
+  if(!out)
+  {
+    return false;
+  }
+  std::fprintf(out,"{\"traceEvents\":[\n");
+  bool first=true;
+  std::lock_guard<std::mutex> lock(registryMutex());
+  for(const auto &b : registry())
+  {
+    std::fprintf(out,"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s%u\"}}",
+                 first ? "" : ",\n",b->m_tid,b->m_gpu ? "GPU" : "thread ",b->m_gpu ? 0u : b->m_tid);
+    first=false;
+    // a thread still recording can overwrite the oldest entries while we read, that only
+    // loses those events which is fine for a profile
+    size_t written=b->m_written.load(std::memory_order_acquire);
+    for(size_t i=b->first(written); i<written; ++i)
+    {
+      const Event &e=b->m_events[i & (c_eventsPerThread-1)];
+      std::fprintf(out,",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                   e.m_name,e.m_start*1e-3,(e.m_end-e.m_start)*1e-3,b->m_tid);
+    }
+  }
+  std::fprintf(out,"\n]}\n");
+  return std::fclose(out)==0;
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  for(auto &f : m_frames)
+  {
+    for(auto &q : f.m_queries)
+    {
+      glDeleteQueries(1,&q.m_begin);
+      glDeleteQueries(1,&q.m_end);
+    }
+  }
+}
+
+void GpuProfiler::begin(const char *_name)
+{
+  Frame &f=m_frames[m_current];
+  if(f.m_used==f.m_queries.size())
+  {
+    Query q;
+    glGenQueries(1,&q.m_begin);
+    glGenQueries(1,&q.m_end);
+    f.m_queries.push_back(q);
+  }
+  Query &q=f.m_queries[f.m_used];
+  q.m_name=_name;
+  glQueryCounter(q.m_begin,GL_TIMESTAMP);
+}
+
+void GpuProfiler::end()
+{
+  Frame &f=m_frames[m_current];
+  glQueryCounter(f.m_queries[f.m_used].m_end,GL_TIMESTAMP);
+  ++f.m_used;
+}
+
+void GpuProfiler::endFrame()
+{
+  m_current=(m_current+1)%c_framesInFlight;
+  Frame &f=m_frames[m_current];
+  if(f.m_used==0)
+  {
+    return;
+  }
+  // the last query finishing means the whole frame has, if it has not the frame is dropped
+  // rather than waiting
+  GLuint available=0;
+  glGetQueryObjectuiv(f.m_queries[f.m_used-1].m_end,GL_QUERY_RESULT_AVAILABLE,&available);
+  if(available)
+  {
+    // line the GPU clock up with ours using the current time on both
+    GLint64 gpuNow=0;
+    glGetInteger64v(GL_TIMESTAMP,&gpuNow);
+    int64_t offset=static_cast<int64_t>(Profiler::now())-gpuNow;
+    for(size_t i=0; i<f.m_used; ++i)
+    {
+      GLuint64 start=0;
+      GLuint64 end=0;
+      glGetQueryObjectui64v(f.m_queries[i].m_begin,GL_QUERY_RESULT,&start);
+      glGetQueryObjectui64v(f.m_queries[i].m_end,GL_QUERY_RESULT,&end);
+      Profiler::recordGPU(f.m_queries[i].m_name,static_cast<uint64_t>(static_cast<int64_t>(start)+offset),
+                          static_cast<uint64_t>(static_cast<int64_t>(end)+offset));
+    }
+  }
+  f.m_used=0;
+}
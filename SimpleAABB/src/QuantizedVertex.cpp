@@ -0,0 +1,138 @@
+#include "QuantizedVertex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+  uint16_t toUnorm16(ngl::Real _v)
+  {
+    return static_cast<uint16_t>(std::lround(std::min(1.0f,std::max(0.0f,_v))*65535.0f));
+  }
+
+  int16_t toSnorm16(ngl::Real _v)
+  {
+    return static_cast<int16_t>(std::lround(std::min(1.0f,std::max(-1.0f,_v))*32767.0f));
+  }
+
+  ngl::Real signNotZero(ngl::Real _v)
+  {
+    return _v>=0.0f ? 1.0f : -1.0f;
+  }
+}
+
+QuantizedVertex QuantizedVertex::encode(const IndexedMesh::Vertex &_v, const AABB &_range)
+{
+  QuantizedVertex q;
+  ngl::Real p[3]={_v.m_x,_v.m_y,_v.m_z};
+  for(int i=0; i<3; ++i)
+  {
+    ngl::Real extent=_range.m_max[i]-_range.m_min[i];
+    // a flat axis dequantizes to a scale of 0 so any value works
+    q.m_position[i]= extent>0.0f ? toUnorm16((p[i]-_range.m_min[i])/extent) : 0;
+  }
+  q.m_position[3]=0;
+  q.m_uv[0]=toHalf(_v.m_u);
+  q.m_uv[1]=toHalf(_v.m_v);
+  ngl::Real x,y;
+  octEncode(ngl::Vec3(_v.m_nx,_v.m_ny,_v.m_nz),x,y);
+  q.m_normal[0]=toSnorm16(x);
+  q.m_normal[1]=toSnorm16(y);
+  return q;
+}
+
+ngl::Mat4 QuantizedVertex::dequantizeMatrix(const AABB &_range)
+{
+  ngl::Mat4 m;
+  m.identity();
+  for(int i=0; i<3; ++i)
+  {
+    m.m_m[i][i]=_range.m_max[i]-_range.m_min[i];
+    m.m_m[3][i]=_range.m_min[i];
+  }
+  return m;
+}
+
+uint16_t QuantizedVertex::toHalf(float _f)
+{
+  uint32_t bits;
+  std::memcpy(&bits,&_f,sizeof(bits));
+  uint16_t sign=static_cast<uint16_t>((bits>>16) & 0x8000u);
+  uint32_t biased=(bits>>23) & 0xffu;
+  uint32_t mantissa=bits & 0x7fffffu;
+  if(biased==0xffu)
+  {
+    // infinity stays infinity, NaN stays a (quiet) NaN
+    return sign | 0x7c00u | (mantissa ? 0x200u : 0u);
+  }
+  int exponent=static_cast<int>(biased)-127+15;
+  if(exponent>=31)
+  {
+    return sign | 0x7c00u;
+  }
+  if(exponent<=0)
+  {
+    // too small even for a half denormal
+    if(exponent<-10)
+    {
+      return sign;
+    }
+    mantissa|=0x800000u;
+    int shift=14-exponent;
+    uint32_t half=mantissa>>shift;
+    half+=(mantissa>>(shift-1)) & 1u;
+    return static_cast<uint16_t>(sign | half);
+  }
+  uint32_t half=(static_cast<uint32_t>(exponent)<<10) | (mantissa>>13);
+  // a carry out of the mantissa correctly bumps the exponent
+  half+=(mantissa>>12) & 1u;
+  return static_cast<uint16_t>(sign | half);
+}
+
+float QuantizedVertex::fromHalf(uint16_t _h)
+{
+  uint32_t sign=static_cast<uint32_t>(_h & 0x8000u)<<16;
+  uint32_t exponent=(_h>>10) & 0x1fu;
+  uint32_t mantissa=_h & 0x3ffu;
+  float f;
+  if(exponent==0)
+  {
+    // zero or denormal, mantissa * 2^-24
+    f=std::ldexp(static_cast<float>(mantissa),-24);
+    return sign ? -f : f;
+  }
+  uint32_t bits= exponent==31 ? sign | 0x7f800000u | (mantissa<<13)
+                              : sign | ((exponent-15+127)<<23) | (mantissa<<13);
+  std::memcpy(&f,&bits,sizeof(f));
+  return f;
+}
+
+void QuantizedVertex::octEncode(const ngl::Vec3 &_n, ngl::Real &_x, ngl::Real &_y)
+{
+  ngl::Real l1=std::abs(_n.m_x)+std::abs(_n.m_y)+std::abs(_n.m_z);
+  if(l1==0.0f)
+  {
+    // no normal, decodes to +z
+    _x=_y=0.0f;
+    return;
+  }
+  // project onto the octahedron then fold the lower half over the upper
+  _x=_n.m_x/l1;
+  _y=_n.m_y/l1;
+  if(_n.m_z<0.0f)
+  {
+    ngl::Real x=_x;
+    _x=(1.0f-std::abs(_y))*signNotZero(x);
+    _y=(1.0f-std::abs(x))*signNotZero(_y);
+  }
+}
+
+ngl::Vec3 QuantizedVertex::octDecode(ngl::Real _x, ngl::Real _y)
+{
+  ngl::Vec3 n(_x,_y,1.0f-std::abs(_x)-std::abs(_y));
+  ngl::Real t=std::max(-n.m_z,0.0f);
+  n.m_x+= n.m_x>=0.0f ? -t : t;
+  n.m_y+= n.m_y>=0.0f ? -t : t;
+  n.normalize();
+  return n;
+}
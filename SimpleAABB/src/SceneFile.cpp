@@ -0,0 +1,113 @@
+#include "SceneFile.h"
+#include <ngl/Transformation.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+
+bool SceneFile::load(const std::string &_file, SceneGraph &_scene, GeometryCache &_cache)
+{
+  std::ifstream in(_file);
+  if(!in.is_open())
+  {
+    std::cerr<<"unable to open scene "<<_file<<"\n";
+    return false;
+  }
+  std::unordered_map<std::string,SceneGraph::NodeID> names;
+  std::string line;
+  size_t lineNumber=0;
+  while(std::getline(in,line))
+  {
+    ++lineNumber;
+    std::istringstream tokens(line);
+    std::string type;
+    if(!(tokens>>type) || type[0]=='#')
+    {
+      continue;
+    }
+    std::string name,parentName,meshFile,textureFile;
+    tokens>>name>>parentName>>meshFile>>textureFile;
+    SceneGraph::NodeID parent=SceneGraph::c_noParent;
+    if(parentName!="-")
+    {
+      auto found=names.find(parentName);
+      if(found==names.end())
+      {
+        std::cerr<<_file<<":"<<lineNumber<<" unknown parent "<<parentName<<"\n";
+        continue;
+      }
+      parent=found->second;
+    }
+
+    // build the list of local transforms this line asks for
+    std::vector<ngl::Mat4> locals;
+    ngl::Transformation tx;
+    if(type=="object")
+    {
+      ngl::Vec3 t,r,s;
+      tokens>>t.m_x>>t.m_y>>t.m_z>>r.m_x>>r.m_y>>r.m_z>>s.m_x>>s.m_y>>s.m_z;
+      if(!tokens)
+      {
+        std::cerr<<_file<<":"<<lineNumber<<" expected translate rotate scale\n";
+        continue;
+      }
+      tx.setPosition(t.m_x,t.m_y,t.m_z);
+      tx.setRotation(r.m_x,r.m_y,r.m_z);
+      tx.setScale(s.m_x,s.m_y,s.m_z);
+      locals.push_back(tx.getMatrix());
+    }
+    else if(type=="grid")
+    {
+      int nx,ny,nz;
+      ngl::Real spacing,scale;
+      tokens>>nx>>ny>>nz>>spacing>>scale;
+      if(!tokens || nx<1 || ny<1 || nz<1)
+      {
+        std::cerr<<_file<<":"<<lineNumber<<" expected nx ny nz spacing scale\n";
+        continue;
+      }
+      locals.reserve(static_cast<size_t>(nx)*ny*nz);
+      tx.setScale(scale,scale,scale);
+      for(int z=0; z<nz; ++z)
+      {
+        for(int y=0; y<ny; ++y)
+        {
+          for(int x=0; x<nx; ++x)
+          {
+            tx.setPosition((x-(nx-1)*0.5f)*spacing,(y-(ny-1)*0.5f)*spacing,(z-(nz-1)*0.5f)*spacing);
+            locals.push_back(tx.getMatrix());
+          }
+        }
+      }
+    }
+    else
+    {
+      std::cerr<<_file<<":"<<lineNumber<<" unknown entry "<<type<<"\n";
+      continue;
+    }
+
+    // every copy shares the one cached mesh / texture, only the per node state is new
+    SceneGraph::Asset asset;
+    asset.m_mesh=_cache.acquireMesh(meshFile);
+    asset.m_texture=_cache.acquireTexture(textureFile);
+    // the mesh is usually still loading so this is the placeholder box, NGLScene swaps in
+    // the real bounds once the cache reports the mesh ready
+    AABB bounds=_cache.bounds(asset.m_mesh);
+    for(size_t i=0; i<locals.size(); ++i)
+    {
+      if(i>0)
+      {
+        _cache.acquireMesh(meshFile);
+        _cache.acquireTexture(textureFile);
+      }
+      SceneGraph::NodeID id=_scene.addNode(bounds,locals[i],parent,asset);
+      std::string nodeName= locals.size()==1 ? name : name+"_"+std::to_string(i);
+      names[nodeName]=id;
+      m_nodes.push_back(std::make_pair(nodeName,id));
+      m_locals.push_back(locals[i]);
+    }
+  }
+  std::cout<<"read "<<m_nodes.size()<<" objects from "<<_file<<" using "<<_cache.numMeshes()
+           <<" meshes and "<<_cache.numTextures()<<" textures\n";
+  return true;
+}
@@ -0,0 +1,125 @@
+#include "SceneGraph.h"
+
+constexpr SceneGraph::NodeID SceneGraph::c_noParent;
+
+SceneGraph::NodeID SceneGraph::addNode(const AABB &_localBounds, const ngl::Mat4 &_local, NodeID _parent, Asset _asset)
+{
+  // new roots go at the end, children go at the end of the parent's subtree so the
+  // array stays in depth first order
+  size_t parent=c_noParent;
+  size_t pos=m_nodes.size();
+  if(_parent != c_noParent)
+  {
+    parent=m_index[_parent];
+    pos=parent+m_nodes[parent].m_subtreeSize;
+  }
+
+  Node n;
+  n.m_local=_local;
+  n.m_parent=parent;
+  n.m_subtreeSize=1;
+  n.m_id=m_index.size();
+  n.m_localDirty=true;
+  n.m_subtreeDirty=false;
+  n.m_moved=false;
+
+  m_nodes.insert(m_nodes.begin()+pos,n);
+  m_meshes.insert(m_meshes.begin()+pos,MeshWithAABB(_localBounds));
+  m_assets.insert(m_assets.begin()+pos,_asset);
+  m_index.push_back(pos);
+
+  // everything after the insert point has shifted by one
+  for(size_t i=pos+1; i<m_nodes.size(); ++i)
+  {
+    Node &node=m_nodes[i];
+    m_index[node.m_id]=i;
+    if(node.m_parent!=c_noParent && node.m_parent>=pos)
+    {
+      ++node.m_parent;
+    }
+  }
+  // and the ancestors have grown
+  for(size_t p=parent; p!=c_noParent; p=m_nodes[p].m_parent)
+  {
+    ++m_nodes[p].m_subtreeSize;
+  }
+  markDirty(pos);
+  return n.m_id;
+}
+
+void SceneGraph::setLocalTransform(NodeID _id, const ngl::Mat4 &_local)
+{
+  size_t i=m_index[_id];
+  m_nodes[i].m_local=_local;
+  m_nodes[i].m_localDirty=true;
+  markDirty(i);
+}
+
+void SceneGraph::setLocalBounds(size_t _index, const AABB &_localBounds, const ConvexHull *_hull)
+{
+  m_meshes[_index].setLocalBounds(_localBounds,_hull);
+  // the world box is rebuilt from the world matrix in the next update
+  m_nodes[_index].m_localDirty=true;
+  markDirty(_index);
+}
+
+void SceneGraph::markDirty(size_t _index)
+{
+  // stop as soon as we reach a node that is already flagged, its ancestors will be too
+  for(size_t i=_index; i!=c_noParent && !m_nodes[i].m_subtreeDirty; i=m_nodes[i].m_parent)
+  {
+    m_nodes[i].m_subtreeDirty=true;
+  }
+}
+
+size_t SceneGraph::update()
+{
+  m_refit.clear();
+  size_t updated=0;
+  // top down, parents are always before children so the parent world matrix is
+  // current by the time we reach a child. Clean subtrees are skipped in one step.
+  size_t i=0;
+  while(i<m_nodes.size())
+  {
+    Node &node=m_nodes[i];
+    bool parentMoved = node.m_parent!=c_noParent && m_nodes[node.m_parent].m_moved;
+    if(!parentMoved && !node.m_subtreeDirty)
+    {
+      i+=node.m_subtreeSize;
+      continue;
+    }
+    node.m_moved = parentMoved || node.m_localDirty;
+    if(node.m_moved)
+    {
+      if(node.m_parent==c_noParent)
+      {
+        node.m_world=node.m_local;
+      }
+      else
+      {
+        node.m_world=node.m_local*m_nodes[node.m_parent].m_world;
+      }
+      m_meshes[i].setTransform(node.m_world);
+      ++updated;
+    }
+    node.m_localDirty=false;
+    node.m_subtreeDirty=false;
+    m_refit.push_back(i);
+    ++i;
+  }
+
+  // bottom up, m_refit is in depth first order so walking it backwards visits
+  // children before parents. Children that were not visited still have valid bounds.
+  for(auto r=m_refit.rbegin(); r!=m_refit.rend(); ++r)
+  {
+    size_t n=*r;
+    Node &node=m_nodes[n];
+    node.m_bounds=m_meshes[n].getAABB();
+    size_t end=n+node.m_subtreeSize;
+    for(size_t c=n+1; c<end; c+=m_nodes[c].m_subtreeSize)
+    {
+      node.m_bounds.extend(m_nodes[c].m_bounds);
+    }
+  }
+  return updated;
+}
@@ -0,0 +1,226 @@
+#include "SoftwareOcclusion.h"
+#include <ngl/Vec4.h>
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+constexpr int SoftwareOcclusion::c_width;
+constexpr int SoftwareOcclusion::c_height;
+constexpr int SoftwareOcclusion::c_tileSize;
+constexpr int SoftwareOcclusion::c_tilesX;
+constexpr int SoftwareOcclusion::c_tilesY;
+
+namespace
+{
+  // anything closer than this in w is treated as crossing the eye / near plane
+  constexpr ngl::Real c_minW=0.0001f;
+}
+
+SoftwareOcclusion::SoftwareOcclusion()
+{
+  m_depth.assign(c_width*c_height,1.0f);
+  m_tileMax.assign(c_tilesX*c_tilesY,1.0f);
+}
+
+void SoftwareOcclusion::begin(const ngl::Mat4 &_VP)
+{
+  m_VP=_VP;
+  std::fill(m_depth.begin(),m_depth.end(),1.0f);
+}
+
+void SoftwareOcclusion::rasterize(const ngl::Real *_positions, size_t _stride, const GLuint *_indices, size_t _numIndices, const ngl::Mat4 &_MVP)
+{
+  for(size_t i=0; i+2<_numIndices; i+=3)
+  {
+    ngl::Real screen[3][3];
+    bool clipped=false;
+    for(int c=0; c<3; ++c)
+    {
+      const ngl::Real *p=_positions+_indices[i+c]*_stride;
+      ngl::Vec4 clip=ngl::Vec4(p[0],p[1],p[2],1.0f)*_MVP;
+      // occluders only ever hide things, so dropping a triangle is always safe
+      if(clip.m_w<=c_minW || clip.m_z< -clip.m_w)
+      {
+        clipped=true;
+        break;
+      }
+      ngl::Real invW=1.0f/clip.m_w;
+      screen[c][0]=(clip.m_x*invW*0.5f+0.5f)*c_width;
+      screen[c][1]=(clip.m_y*invW*0.5f+0.5f)*c_height;
+      screen[c][2]=clip.m_z*invW*0.5f+0.5f;
+    }
+    if(!clipped)
+    {
+      rasterizeTriangle(screen[0],screen[1],screen[2]);
+    }
+  }
+}
+
+void SoftwareOcclusion::rasterizeTriangle(const ngl::Real *_a, const ngl::Real *_b, const ngl::Real *_c)
+{
+  const ngl::Real *a=_a;
+  const ngl::Real *b=_b;
+  const ngl::Real *c=_c;
+  ngl::Real area=(c[0]-a[0])*(b[1]-a[1])-(c[1]-a[1])*(b[0]-a[0]);
+  if(area<0.0f)
+  {
+    std::swap(b,c);
+    area=-area;
+  }
+  if(area<=0.0f)
+  {
+    return;
+  }
+  int minX=std::max(0,static_cast<int>(std::floor(std::min({a[0],b[0],c[0]}))));
+  int maxX=std::min(c_width-1,static_cast<int>(std::floor(std::max({a[0],b[0],c[0]}))));
+  int minY=std::max(0,static_cast<int>(std::floor(std::min({a[1],b[1],c[1]}))));
+  int maxY=std::min(c_height-1,static_cast<int>(std::floor(std::max({a[1],b[1],c[1]}))));
+  if(minX>maxX || minY>maxY)
+  {
+    return;
+  }
+  // work in blocks of 4 pixels, c_width is a multiple of 4 so this never runs off the row
+  minX&=~3;
+
+  // edge function E(p)=A*p.x+B*p.y+C for the edge opposite each vertex, positive inside
+  auto edge=[](const ngl::Real *_p0, const ngl::Real *_p1, ngl::Real &o_a, ngl::Real &o_b, ngl::Real &o_c)
+  {
+    o_a=_p1[1]-_p0[1];
+    o_b=-(_p1[0]-_p0[0]);
+    o_c=_p0[1]*(_p1[0]-_p0[0])-_p0[0]*(_p1[1]-_p0[1]);
+  };
+  ngl::Real a0,b0,c0,a1,b1,c1,a2,b2,c2;
+  edge(b,c,a0,b0,c0);
+  edge(c,a,a1,b1,c1);
+  edge(a,b,a2,b2,c2);
+  ngl::Real invArea=1.0f/area;
+  // depth as a plane z=zx*x+zy*y+z0 in pixel space
+  ngl::Real zx=(a0*a[2]+a1*b[2]+a2*c[2])*invArea;
+  ngl::Real zy=(b0*a[2]+b1*b[2]+b2*c[2])*invArea;
+  ngl::Real zc=(c0*a[2]+c1*b[2]+c2*c[2])*invArea;
+
+#if defined(__SSE2__)
+  const __m128 offsets=_mm_setr_ps(0.5f,1.5f,2.5f,3.5f);
+  const __m128 zero=_mm_setzero_ps();
+  for(int y=minY; y<=maxY; ++y)
+  {
+    ngl::Real py=y+0.5f;
+    const __m128 row0=_mm_set1_ps(b0*py+c0);
+    const __m128 row1=_mm_set1_ps(b1*py+c1);
+    const __m128 row2=_mm_set1_ps(b2*py+c2);
+    const __m128 rowZ=_mm_set1_ps(zy*py+zc);
+    float *depthRow=&m_depth[y*c_width];
+    for(int x=minX; x<=maxX; x+=4)
+    {
+      __m128 px=_mm_add_ps(_mm_set1_ps(static_cast<float>(x)),offsets);
+      __m128 w0=_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0),px),row0);
+      __m128 w1=_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1),px),row1);
+      __m128 w2=_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2),px),row2);
+      __m128 inside=_mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0,zero),_mm_cmpge_ps(w1,zero)),_mm_cmpge_ps(w2,zero));
+      if(_mm_movemask_ps(inside)==0)
+      {
+        continue;
+      }
+      __m128 z=_mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx),px),rowZ);
+      __m128 old=_mm_loadu_ps(depthRow+x);
+      __m128 nearest=_mm_min_ps(old,z);
+      _mm_storeu_ps(depthRow+x,_mm_or_ps(_mm_and_ps(inside,nearest),_mm_andnot_ps(inside,old)));
+    }
+  }
+#else
+  for(int y=minY; y<=maxY; ++y)
+  {
+    ngl::Real py=y+0.5f;
+    float *depthRow=&m_depth[y*c_width];
+    for(int x=minX; x<=maxX; ++x)
+    {
+      ngl::Real px=x+0.5f;
+      if(a0*px+b0*py+c0>=0.0f && a1*px+b1*py+c1>=0.0f && a2*px+b2*py+c2>=0.0f)
+      {
+        depthRow[x]=std::min(depthRow[x],zx*px+zy*py+zc);
+      }
+    }
+  }
+#endif
+}
+
+void SoftwareOcclusion::end()
+{
+  for(int ty=0; ty<c_tilesY; ++ty)
+  {
+    for(int tx=0; tx<c_tilesX; ++tx)
+    {
+      float farthest=0.0f;
+      for(int y=ty*c_tileSize; y<(ty+1)*c_tileSize; ++y)
+      {
+        const float *row=&m_depth[y*c_width+tx*c_tileSize];
+        farthest=std::max(farthest,*std::max_element(row,row+c_tileSize));
+      }
+      m_tileMax[ty*c_tilesX+tx]=farthest;
+    }
+  }
+}
+
+bool SoftwareOcclusion::isVisible(const AABB &_box) const
+{
+  ngl::Real minX=std::numeric_limits<ngl::Real>::max();
+  ngl::Real minY=minX;
+  ngl::Real maxX=-minX;
+  ngl::Real maxY=-minX;
+  ngl::Real nearest=minX;
+  for(int i=0; i<8; ++i)
+  {
+    ngl::Vec4 corner(i&1 ? _box.m_max.m_x : _box.m_min.m_x,
+                     i&2 ? _box.m_max.m_y : _box.m_min.m_y,
+                     i&4 ? _box.m_max.m_z : _box.m_min.m_z,1.0f);
+    ngl::Vec4 clip=corner*m_VP;
+    if(clip.m_w<=c_minW || clip.m_z< -clip.m_w)
+    {
+      return true;
+    }
+    ngl::Real invW=1.0f/clip.m_w;
+    ngl::Real x=(clip.m_x*invW*0.5f+0.5f)*c_width;
+    ngl::Real y=(clip.m_y*invW*0.5f+0.5f)*c_height;
+    minX=std::min(minX,x); maxX=std::max(maxX,x);
+    minY=std::min(minY,y); maxY=std::max(maxY,y);
+    nearest=std::min(nearest,clip.m_z*invW*0.5f+0.5f);
+  }
+  // every pixel the rectangle touches, not just the centres, so small boxes are still tested
+  int x0=std::max(0,static_cast<int>(std::floor(minX)));
+  int x1=std::min(c_width-1,static_cast<int>(std::floor(maxX)));
+  int y0=std::max(0,static_cast<int>(std::floor(minY)));
+  int y1=std::min(c_height-1,static_cast<int>(std::floor(maxY)));
+  if(x0>x1 || y0>y1 || maxX<0.0f || maxY<0.0f)
+  {
+    return false;
+  }
+  for(int ty=y0/c_tileSize; ty<=y1/c_tileSize; ++ty)
+  {
+    for(int tx=x0/c_tileSize; tx<=x1/c_tileSize; ++tx)
+    {
+      // the whole tile is in front of the box
+      if(nearest>m_tileMax[ty*c_tilesX+tx])
+      {
+        continue;
+      }
+      int px0=std::max(x0,tx*c_tileSize);
+      int px1=std::min(x1,(tx+1)*c_tileSize-1);
+      int py0=std::max(y0,ty*c_tileSize);
+      int py1=std::min(y1,(ty+1)*c_tileSize-1);
+      for(int y=py0; y<=py1; ++y)
+      {
+        const float *row=&m_depth[y*c_width];
+        for(int x=px0; x<=px1; ++x)
+        {
+          if(nearest<=row[x])
+          {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
@@ -0,0 +1,490 @@
+#include "SpatialHashGrid.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <cmath>
+
+constexpr size_t SpatialHashGrid::c_maxCellsPerObject;
+constexpr uint64_t SpatialHashGrid::c_emptyKey;
+constexpr size_t SpatialHashGrid::c_grain;
+
+namespace
+{
+  // cell coordinates are stored in 21 bits each
+  constexpr int32_t c_cellLimit=(1<<20)-1;
+  constexpr uint64_t c_coordMask=(uint64_t(1)<<21)-1;
+
+  int32_t toCell(ngl::Real _v)
+  {
+    ngl::Real c=std::floor(_v);
+    // also catches NaN, which fails both compares
+    if(!(c>-c_cellLimit))
+    {
+      return -c_cellLimit;
+    }
+    return c<c_cellLimit ? static_cast<int32_t>(c) : c_cellLimit;
+  }
+
+  int64_t cellCount(const int32_t *_min, const int32_t *_max)
+  {
+    int64_t n=1;
+    for(int a=0; a<3; ++a)
+    {
+      n*=std::max<int64_t>(0,int64_t(_max[a])-_min[a]+1);
+    }
+    return n;
+  }
+
+  void decodeKey(uint64_t _key, int32_t &_x, int32_t &_y, int32_t &_z)
+  {
+    _x=static_cast<int32_t>(_key & c_coordMask)-(c_cellLimit+1);
+    _y=static_cast<int32_t>((_key>>21) & c_coordMask)-(c_cellLimit+1);
+    _z=static_cast<int32_t>((_key>>42) & c_coordMask)-(c_cellLimit+1);
+  }
+}
+
+SpatialHashGrid::SpatialHashGrid(WorkerPool *_pool) : m_pool(_pool ? _pool : &WorkerPool::shared())
+{
+}
+
+SpatialHashGrid::~SpatialHashGrid()=default;
+
+SpatialHashGrid::CellRange SpatialHashGrid::cellRange(const AABB &_box) const
+{
+  CellRange r;
+  for(int a=0; a<3; ++a)
+  {
+    r.m_min[a]=toCell(_box.m_min[a]*m_inverseCellSize);
+    r.m_max[a]=toCell(_box.m_max[a]*m_inverseCellSize);
+  }
+  return r;
+}
+
+uint64_t SpatialHashGrid::cellKey(int32_t _x, int32_t _y, int32_t _z)
+{
+  return  static_cast<uint64_t>(_x+c_cellLimit+1) |
+         (static_cast<uint64_t>(_y+c_cellLimit+1)<<21) |
+         (static_cast<uint64_t>(_z+c_cellLimit+1)<<42);
+}
+
+size_t SpatialHashGrid::hashSlot(uint64_t _key) const
+{
+  // runs of 4 cells along x hash to the same place and sit next to each other, a box touching
+  // neighbouring cells or a query walking along x then reads one cache line instead of four.
+  // The rest of the key is mixed so the runs spread over the whole table.
+  uint64_t run=_key & ~uint64_t(3);
+  run^=run>>29;
+  run*=0xbf58476d1ce4e5b9ull;
+  run^=run>>32;
+  return (static_cast<size_t>(run & ~uint64_t(3))+static_cast<size_t>(_key & 3)) & (m_capacity-1);
+}
+
+uint32_t SpatialHashGrid::claim(uint64_t _key)
+{
+  for(size_t i=hashSlot(_key); ; i=(i+1) & (m_capacity-1))
+  {
+    Slot &slot=m_slots[i];
+    uint64_t current=slot.m_key.load(std::memory_order_relaxed);
+    if(current==c_emptyKey)
+    {
+      // another thread may take it first, with this cell or a different one
+      if(slot.m_key.compare_exchange_strong(current,_key,std::memory_order_relaxed))
+      {
+        return static_cast<uint32_t>(i);
+      }
+    }
+    if(current==_key)
+    {
+      return static_cast<uint32_t>(i);
+    }
+  }
+}
+
+const SpatialHashGrid::Slot *SpatialHashGrid::find(uint64_t _key) const
+{
+  for(size_t i=hashSlot(_key); ; i=(i+1) & (m_capacity-1))
+  {
+    uint64_t current=m_slots[i].m_key.load(std::memory_order_relaxed);
+    if(current==_key)
+    {
+      return &m_slots[i];
+    }
+    if(current==c_emptyKey)
+    {
+      return nullptr;
+    }
+  }
+}
+
+void SpatialHashGrid::build(const AABB *_boxes, size_t _count, ngl::Real _cellSize)
+{
+  WorkerPool &pool=*m_pool;
+  size_t numChunks=(_count+c_grain-1)/c_grain;
+  m_boxes.resize(_count);
+  m_ranges.resize(_count);
+  m_chunkExtent.assign(numChunks,0.0);
+  m_chunkBounds.assign(numChunks,AABB());
+  m_chunkEntries.assign(numChunks,0);
+  m_chunkOversized.assign(numChunks,0);
+
+  // copy the boxes, summing their sizes in case the cell size is automatic
+  pool.parallelFor(_count,c_grain,[this,_boxes](size_t _begin, size_t _end)
+  {
+    double extent=0.0;
+    AABB bounds;
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      m_boxes[i]=_boxes[i];
+      if(!_boxes[i].isEmpty())
+      {
+        ngl::Vec3 d=_boxes[i].size();
+        extent+=std::max(d.m_x,std::max(d.m_y,d.m_z));
+        bounds.extend(_boxes[i]);
+      }
+    }
+    m_chunkExtent[_begin/c_grain]=extent;
+    m_chunkBounds[_begin/c_grain]=bounds;
+  });
+  if(_cellSize<=0.0f)
+  {
+    double extent=0.0;
+    for(double e : m_chunkExtent)
+    {
+      extent+=e;
+    }
+    _cellSize= extent>0.0 ? static_cast<ngl::Real>(2.0*extent/_count) : 1.0f;
+  }
+  m_cellSize=_cellSize;
+  m_inverseCellSize=1.0f/_cellSize;
+
+  // which cells each box touches
+  pool.parallelFor(_count,c_grain,[this](size_t _begin, size_t _end)
+  {
+    size_t entries=0;
+    size_t oversized=0;
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      CellRange &r=m_ranges[i];
+      r=cellRange(m_boxes[i]);
+      int64_t cells=cellCount(r.m_min,r.m_max);
+      if(cells>static_cast<int64_t>(c_maxCellsPerObject))
+      {
+        ++oversized;
+      }
+      else
+      {
+        entries+=static_cast<size_t>(cells);
+      }
+    }
+    m_chunkEntries[_begin/c_grain]=entries;
+    m_chunkOversized[_begin/c_grain]=oversized;
+  });
+  // both become where each chunk writes
+  size_t entries=0;
+  size_t oversized=0;
+  for(size_t c=0; c<numChunks; ++c)
+  {
+    size_t n=m_chunkEntries[c];
+    m_chunkEntries[c]=entries;
+    entries+=n;
+    n=m_chunkOversized[c];
+    m_chunkOversized[c]=oversized;
+    oversized+=n;
+  }
+  m_oversized.resize(oversized);
+  m_entries.resize(entries);
+
+  // there can be no more cells than entries or than the cells covering every box. The table
+  // must never fill up or a probe for a missing cell would not stop, and a table much bigger
+  // than needed misses the cache on every probe.
+  AABB bounds;
+  for(const auto &b : m_chunkBounds)
+  {
+    bounds.extend(b);
+  }
+  size_t maxCells=entries;
+  if(!bounds.isEmpty())
+  {
+    CellRange r=cellRange(bounds);
+    maxCells=static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(entries),cellCount(r.m_min,r.m_max)));
+  }
+  size_t capacity=16;
+  while(capacity<=maxCells+maxCells/4)
+  {
+    capacity*=2;
+  }
+  if(capacity!=m_capacity)
+  {
+    m_slots.reset(new Slot[capacity]);
+    m_capacity=capacity;
+  }
+  pool.parallelFor(m_capacity,c_grain,[this](size_t _begin, size_t _end)
+  {
+    for(size_t s=_begin; s<_end; ++s)
+    {
+      m_slots[s].m_key.store(c_emptyKey,std::memory_order_relaxed);
+      m_slots[s].m_count.store(0,std::memory_order_relaxed);
+    }
+  });
+
+  // claim and count the cells, the count before each increment is where the object goes in
+  // the cell so filling the cells later needs no atomics
+  pool.parallelFor(_count,c_grain,[this](size_t _begin, size_t _end)
+  {
+    size_t next=m_chunkOversized[_begin/c_grain];
+    Entry *entry=&m_entries[m_chunkEntries[_begin/c_grain]];
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      const CellRange &r=m_ranges[i];
+      if(cellCount(r.m_min,r.m_max)>static_cast<int64_t>(c_maxCellsPerObject))
+      {
+        m_oversized[next++]=static_cast<uint32_t>(i);
+        continue;
+      }
+      for(int32_t z=r.m_min[2]; z<=r.m_max[2]; ++z)
+      {
+        for(int32_t y=r.m_min[1]; y<=r.m_max[1]; ++y)
+        {
+          for(int32_t x=r.m_min[0]; x<=r.m_max[0]; ++x)
+          {
+            entry->m_slot=claim(cellKey(x,y,z));
+            entry->m_rank=m_slots[entry->m_slot].m_count.fetch_add(1,std::memory_order_relaxed);
+            ++entry;
+          }
+        }
+      }
+    }
+  });
+
+  // prefix sum of the counts gives each cell its range of m_ids
+  size_t slotChunks=(m_capacity+c_grain-1)/c_grain;
+  m_chunkSlots.assign(slotChunks,0);
+  std::atomic<size_t> occupied(0);
+  pool.parallelFor(m_capacity,c_grain,[this,&occupied](size_t _begin, size_t _end)
+  {
+    size_t sum=0;
+    size_t cells=0;
+    for(size_t s=_begin; s<_end; ++s)
+    {
+      uint32_t n=m_slots[s].m_count.load(std::memory_order_relaxed);
+      sum+=n;
+      cells+= n ? 1 : 0;
+    }
+    m_chunkSlots[_begin/c_grain]=sum;
+    occupied+=cells;
+  });
+  m_numCells=occupied;
+  size_t offset=0;
+  for(auto &c : m_chunkSlots)
+  {
+    size_t n=c;
+    c=offset;
+    offset+=n;
+  }
+  pool.parallelFor(m_capacity,c_grain,[this](size_t _begin, size_t _end)
+  {
+    size_t start=m_chunkSlots[_begin/c_grain];
+    for(size_t s=_begin; s<_end; ++s)
+    {
+      m_slots[s].m_start=static_cast<uint32_t>(start);
+      start+=m_slots[s].m_count.load(std::memory_order_relaxed);
+    }
+  });
+
+  // the entries are in object order so each chunk knows which objects its entries belong to
+  m_ids.resize(entries);
+  pool.parallelFor(_count,c_grain,[this](size_t _begin, size_t _end)
+  {
+    const Entry *entry=&m_entries[m_chunkEntries[_begin/c_grain]];
+    for(size_t i=_begin; i<_end; ++i)
+    {
+      const CellRange &r=m_ranges[i];
+      int64_t cells=cellCount(r.m_min,r.m_max);
+      if(cells>static_cast<int64_t>(c_maxCellsPerObject))
+      {
+        continue;
+      }
+      for(int64_t c=0; c<cells; ++c, ++entry)
+      {
+        m_ids[m_slots[entry->m_slot].m_start+entry->m_rank]=static_cast<uint32_t>(i);
+      }
+    }
+  });
+}
+
+template<typename F> void SpatialHashGrid::forEachCell(const CellRange &_range, const F &_fn) const
+{
+  if(m_numCells==0)
+  {
+    return;
+  }
+  if(cellCount(_range.m_min,_range.m_max)>static_cast<int64_t>(m_numCells))
+  {
+    for(size_t s=0; s<m_capacity; ++s)
+    {
+      uint64_t key=m_slots[s].m_key.load(std::memory_order_relaxed);
+      if(key==c_emptyKey)
+      {
+        continue;
+      }
+      int32_t x,y,z;
+      decodeKey(key,x,y,z);
+      if(x>=_range.m_min[0] && x<=_range.m_max[0] && y>=_range.m_min[1] && y<=_range.m_max[1] &&
+         z>=_range.m_min[2] && z<=_range.m_max[2])
+      {
+        _fn(&m_ids[m_slots[s].m_start],m_slots[s].m_count.load(std::memory_order_relaxed),x,y,z);
+      }
+    }
+    return;
+  }
+  for(int32_t z=_range.m_min[2]; z<=_range.m_max[2]; ++z)
+  {
+    for(int32_t y=_range.m_min[1]; y<=_range.m_max[1]; ++y)
+    {
+      for(int32_t x=_range.m_min[0]; x<=_range.m_max[0]; ++x)
+      {
+        if(const Slot *slot=find(cellKey(x,y,z)))
+        {
+          _fn(&m_ids[slot->m_start],slot->m_count.load(std::memory_order_relaxed),x,y,z);
+        }
+      }
+    }
+  }
+}
+
+void SpatialHashGrid::queryBox(const AABB &_box, std::vector<uint32_t> &_out) const
+{
+  CellRange q=cellRange(_box);
+  forEachCell(q,[this,&q,&_box,&_out](const uint32_t *_ids, uint32_t _count, int32_t _x, int32_t _y, int32_t _z)
+  {
+    for(uint32_t k=0; k<_count; ++k)
+    {
+      uint32_t id=_ids[k];
+      const CellRange &r=m_ranges[id];
+      // only from the first cell the object and the query share
+      if(std::max(r.m_min[0],q.m_min[0])==_x && std::max(r.m_min[1],q.m_min[1])==_y &&
+         std::max(r.m_min[2],q.m_min[2])==_z && m_boxes[id].overlaps(_box))
+      {
+        _out.push_back(id);
+      }
+    }
+  });
+  for(uint32_t id : m_oversized)
+  {
+    if(m_boxes[id].overlaps(_box))
+    {
+      _out.push_back(id);
+    }
+  }
+}
+
+void SpatialHashGrid::querySphere(const ngl::Vec3 &_centre, ngl::Real _radius, std::vector<uint32_t> &_out) const
+{
+  ngl::Vec3 r(_radius,_radius,_radius);
+  CellRange q=cellRange(AABB(_centre-r,_centre+r));
+  ngl::Real radius2=_radius*_radius;
+  auto inside=[this,&_centre,radius2](uint32_t _id)
+  {
+    // squared distance from the centre to the nearest point of the box
+    const AABB &b=m_boxes[_id];
+    ngl::Real d2=0.0f;
+    for(int a=0; a<3; ++a)
+    {
+      ngl::Real d=std::max(b.m_min[a]-_centre[a],std::max(0.0f,_centre[a]-b.m_max[a]));
+      d2+=d*d;
+    }
+    return d2<=radius2;
+  };
+  forEachCell(q,[this,&q,&inside,&_out](const uint32_t *_ids, uint32_t _count, int32_t _x, int32_t _y, int32_t _z)
+  {
+    for(uint32_t k=0; k<_count; ++k)
+    {
+      uint32_t id=_ids[k];
+      const CellRange &r=m_ranges[id];
+      if(std::max(r.m_min[0],q.m_min[0])==_x && std::max(r.m_min[1],q.m_min[1])==_y &&
+         std::max(r.m_min[2],q.m_min[2])==_z && inside(id))
+      {
+        _out.push_back(id);
+      }
+    }
+  });
+  for(uint32_t id : m_oversized)
+  {
+    if(inside(id))
+    {
+      _out.push_back(id);
+    }
+  }
+}
+
+void SpatialHashGrid::queryPairs(std::vector<Pair> &_out)
+{
+  size_t slotChunks=(m_capacity+c_grain-1)/c_grain;
+  m_chunkPairs.resize(slotChunks);
+  m_pool->parallelFor(m_capacity,c_grain,[this](size_t _begin, size_t _end)
+  {
+    std::vector<Pair> &pairs=m_chunkPairs[_begin/c_grain];
+    pairs.clear();
+    for(size_t s=_begin; s<_end; ++s)
+    {
+      const Slot &slot=m_slots[s];
+      uint64_t key=slot.m_key.load(std::memory_order_relaxed);
+      if(key==c_emptyKey)
+      {
+        continue;
+      }
+      int32_t cell[3];
+      decodeKey(key,cell[0],cell[1],cell[2]);
+      const uint32_t *ids=&m_ids[slot.m_start];
+      uint32_t count=slot.m_count.load(std::memory_order_relaxed);
+      for(uint32_t i=0; i<count; ++i)
+      {
+        uint32_t a=ids[i];
+        const CellRange &ra=m_ranges[a];
+        const AABB &boxA=m_boxes[a];
+        for(uint32_t j=i+1; j<count; ++j)
+        {
+          uint32_t b=ids[j];
+          const CellRange &rb=m_ranges[b];
+          // a pair sharing several cells is only reported from the first of them
+          if(std::max(ra.m_min[0],rb.m_min[0])==cell[0] && std::max(ra.m_min[1],rb.m_min[1])==cell[1] &&
+             std::max(ra.m_min[2],rb.m_min[2])==cell[2] && boxA.overlaps(m_boxes[b]))
+          {
+            pairs.push_back(a<b ? Pair(a,b) : Pair(b,a));
+          }
+        }
+      }
+    }
+  });
+  for(const auto &pairs : m_chunkPairs)
+  {
+    _out.insert(_out.end(),pairs.begin(),pairs.end());
+  }
+  // the big objects against everything in their cells and then each other
+  for(size_t k=0; k<m_oversized.size(); ++k)
+  {
+    uint32_t o=m_oversized[k];
+    const CellRange &q=m_ranges[o];
+    const AABB &box=m_boxes[o];
+    forEachCell(q,[this,o,&q,&box,&_out](const uint32_t *_ids, uint32_t _count, int32_t _x, int32_t _y, int32_t _z)
+    {
+      for(uint32_t i=0; i<_count; ++i)
+      {
+        uint32_t id=_ids[i];
+        const CellRange &r=m_ranges[id];
+        if(std::max(r.m_min[0],q.m_min[0])==_x && std::max(r.m_min[1],q.m_min[1])==_y &&
+           std::max(r.m_min[2],q.m_min[2])==_z && m_boxes[id].overlaps(box))
+        {
+          _out.push_back(id<o ? Pair(id,o) : Pair(o,id));
+        }
+      }
+    });
+    for(size_t l=k+1; l<m_oversized.size(); ++l)
+    {
+      uint32_t other=m_oversized[l];
+      if(m_boxes[other].overlaps(box))
+      {
+        _out.push_back(o<other ? Pair(o,other) : Pair(other,o));
+      }
+    }
+  }
+}
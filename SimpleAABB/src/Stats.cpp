@@ -0,0 +1,236 @@
+#include "Stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+constexpr size_t Stats::c_numCounters;
+constexpr size_t Stats::c_maxViews;
+constexpr size_t Stats::c_maxViewName;
+constexpr size_t Stats::c_maxJSON;
+Stats::Values Stats::s_current;
+Stats::Values Stats::s_lastFrame;
+Stats::Values Stats::s_total;
+std::atomic<uint64_t> Stats::s_frames(0);
+std::array<std::array<char,Stats::c_maxViewName>,Stats::c_maxViews> Stats::s_viewNames;
+size_t Stats::s_numViewNames=0;
+std::mutex Stats::s_viewNamesMutex;
+
+namespace
+{
+  const char *s_counterNames[]={"draw_calls","program_switches","triangles","aabbs_updated","gl_bytes_uploaded","heap_allocations","software_occlusion_misses"};
+  // how often the listener checks whether it should stop
+  constexpr int c_pollMs=200;
+#if defined(MSG_NOSIGNAL)
+  // a scraper hanging up early must not raise SIGPIPE and kill the app
+  constexpr int c_sendFlags=MSG_NOSIGNAL;
+#else
+  constexpr int c_sendFlags=0;
+#endif
+
+  // append printf style to _buffer at _used, false once it would overflow
+  template <typename... Args>
+  bool append(char *_buffer, size_t _size, size_t &_used, const char *_format, Args... _args)
+  {
+    int n=std::snprintf(_buffer+_used,_size-_used,_format,_args...);
+    if(n<0 || static_cast<size_t>(n)>=_size-_used)
+    {
+      return false;
+    }
+    _used+=static_cast<size_t>(n);
+    return true;
+  }
+
+  bool appendValues(char *_buffer, size_t _size, size_t &_used, const std::array<std::atomic<uint64_t>,Stats::c_numCounters+Stats::c_maxViews> &_values,
+                    const std::array<std::array<char,Stats::c_maxViewName>,Stats::c_maxViews> &_viewNames, size_t _numViews)
+  {
+    bool ok=append(_buffer,_size,_used,"{");
+    for(size_t i=0; i<Stats::c_numCounters; ++i)
+    {
+      ok=ok && append(_buffer,_size,_used,"\"%s\":%llu,",s_counterNames[i],
+                      static_cast<unsigned long long>(_values[i].load(std::memory_order_relaxed)));
+    }
+    ok=ok && append(_buffer,_size,_used,"\"culled\":{");
+    for(size_t v=0; v<_numViews; ++v)
+    {
+      ok=ok && append(_buffer,_size,_used,"%s\"%s\":%llu",v ? "," : "",_viewNames[v].data(),
+                      static_cast<unsigned long long>(_values[Stats::c_numCounters+v].load(std::memory_order_relaxed)));
+    }
+    return ok && append(_buffer,_size,_used,"}}");
+  }
+}
+
+void Stats::endFrame()
+{
+  for(size_t i=0; i<s_current.size(); ++i)
+  {
+    uint64_t n=s_current[i].exchange(0,std::memory_order_relaxed);
+    s_lastFrame[i].store(n,std::memory_order_relaxed);
+    s_total[i].fetch_add(n,std::memory_order_relaxed);
+  }
+  s_frames.fetch_add(1,std::memory_order_relaxed);
+}
+
+uint64_t Stats::lastFrame(Counter _counter)
+{
+  return s_lastFrame[static_cast<size_t>(_counter)].load(std::memory_order_relaxed);
+}
+
+uint64_t Stats::total(Counter _counter)
+{
+  return s_total[static_cast<size_t>(_counter)].load(std::memory_order_relaxed);
+}
+
+uint64_t Stats::lastFrameCulled(size_t _view)
+{
+  return s_lastFrame[c_numCounters+_view].load(std::memory_order_relaxed);
+}
+
+uint64_t Stats::totalCulled(size_t _view)
+{
+  return s_total[c_numCounters+_view].load(std::memory_order_relaxed);
+}
+
+const char *Stats::name(Counter _counter)
+{
+  return s_counterNames[static_cast<size_t>(_counter)];
+}
+
+void Stats::setViewNames(const std::vector<std::string> &_names)
+{
+  std::lock_guard<std::mutex> lock(s_viewNamesMutex);
+  s_numViewNames=std::min(_names.size(),c_maxViews);
+  for(size_t v=0; v<s_numViewNames; ++v)
+  {
+    std::snprintf(s_viewNames[v].data(),c_maxViewName,"%s",_names[v].c_str());
+  }
+}
+
+size_t Stats::numViews()
+{
+  std::lock_guard<std::mutex> lock(s_viewNamesMutex);
+  return s_numViewNames;
+}
+
+size_t Stats::toJSON(char *_buffer, size_t _size)
+{
+  std::lock_guard<std::mutex> lock(s_viewNamesMutex);
+  size_t used=0;
+  bool ok=append(_buffer,_size,used,"{\"frames\":%llu,\"last_frame\":",static_cast<unsigned long long>(frames()));
+  ok=ok && appendValues(_buffer,_size,used,s_lastFrame,s_viewNames,s_numViewNames);
+  ok=ok && append(_buffer,_size,used,",\"totals\":");
+  ok=ok && appendValues(_buffer,_size,used,s_total,s_viewNames,s_numViewNames);
+  ok=ok && append(_buffer,_size,used,"}\n");
+  return ok ? used : 0;
+}
+
+bool Stats::writeJSON(const std::string &_file)
+{
+  char json[c_maxJSON];
+  size_t size=toJSON(json,sizeof(json));
+  FILE *out=std::fopen(_file.c_str(),"w");
+  if(!out || size==0)
+  {
+    if(out)
+    {
+      std::fclose(out);
+    }
+    return false;
+  }
+  bool ok=std::fwrite(json,1,size,out)==size;
+  return std::fclose(out)==0 && ok;
+}
+
+#ifndef _WIN32
+StatsServer::StatsServer(const std::string &_path) : m_path(_path), m_running(false)
+{
+  sockaddr_un address={};
+  address.sun_family=AF_UNIX;
+  if(_path.size()>=sizeof(address.sun_path))
+  {
+    std::cerr<<"stats socket path too long "<<_path<<"\n";
+    return;
+  }
+  _path.copy(address.sun_path,_path.size());
+  m_socket=socket(AF_UNIX,SOCK_STREAM,0);
+  unlink(_path.c_str());
+  if(m_socket<0 || bind(m_socket,reinterpret_cast<sockaddr *>(&address),sizeof(address))!=0 || listen(m_socket,4)!=0)
+  {
+    std::cerr<<"could not listen on stats socket "<<_path<<"\n";
+    if(m_socket>=0)
+    {
+      close(m_socket);
+      m_socket=-1;
+    }
+    return;
+  }
+  m_running=true;
+  m_thread=std::thread(&StatsServer::run,this);
+}
+
+StatsServer::~StatsServer()
+{
+  m_running=false;
+  if(m_thread.joinable())
+  {
+    m_thread.join();
+  }
+  if(m_socket>=0)
+  {
+    close(m_socket);
+    unlink(m_path.c_str());
+  }
+}
+
+void StatsServer::run()
+{
+  char json[Stats::c_maxJSON];
+  while(m_running)
+  {
+    // wake up now and again to see if we are shutting down
+    pollfd p={m_socket,POLLIN,0};
+    if(poll(&p,1,c_pollMs)<=0)
+    {
+      continue;
+    }
+    int client=accept(m_socket,nullptr,nullptr);
+    if(client<0)
+    {
+      continue;
+    }
+#if defined(SO_NOSIGPIPE)
+    int on=1;
+    setsockopt(client,SOL_SOCKET,SO_NOSIGPIPE,&on,sizeof(on));
+#endif
+    size_t size=Stats::toJSON(json,sizeof(json));
+    for(size_t sent=0; sent<size; )
+    {
+      ssize_t n=send(client,json+sent,size-sent,c_sendFlags);
+      if(n<=0)
+      {
+        break;
+      }
+      sent+=static_cast<size_t>(n);
+    }
+    close(client);
+  }
+}
+#else
+StatsServer::StatsServer(const std::string &_path) : m_path(_path), m_running(false)
+{
+  std::cerr<<"stats socket not supported on this platform\n";
+}
+
+StatsServer::~StatsServer()
+{
+}
+
+void StatsServer::run()
+{
+}
+#endif
@@ -0,0 +1,109 @@
+#include "ViewportLayout.h"
+#include <ngl/Util.h>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+constexpr size_t ViewportLayout::c_maxViewports;
+constexpr size_t ViewportLayout::c_noViewport;
+
+bool ViewportLayout::load(const std::string &_file)
+{
+  std::ifstream in(_file);
+  if(!in.is_open())
+  {
+    std::cerr<<"unable to open layout "<<_file<<"\n";
+    return false;
+  }
+  m_viewports.clear();
+  std::string line;
+  size_t lineNumber=0;
+  while(std::getline(in,line))
+  {
+    ++lineNumber;
+    std::istringstream tokens(line);
+    std::string type;
+    if(!(tokens>>type) || type[0]=='#')
+    {
+      continue;
+    }
+    if(type!="ortho" && type!="persp")
+    {
+      std::cerr<<_file<<":"<<lineNumber<<" unknown viewport "<<type<<"\n";
+      continue;
+    }
+    if(m_viewports.size()==c_maxViewports)
+    {
+      std::cerr<<_file<<":"<<lineNumber<<" more than "<<c_maxViewports<<" viewports\n";
+      break;
+    }
+    Viewport v;
+    v.m_perspective= type=="persp";
+    tokens>>v.m_name>>v.m_x>>v.m_y>>v.m_width>>v.m_height;
+    tokens>>v.m_eye.m_x>>v.m_eye.m_y>>v.m_eye.m_z>>v.m_target.m_x>>v.m_target.m_y>>v.m_target.m_z>>v.m_up.m_x>>v.m_up.m_y>>v.m_up.m_z;
+    tokens>>v.m_size>>v.m_near>>v.m_far;
+    tokens>>v.m_gridRotation.m_x>>v.m_gridRotation.m_y>>v.m_gridRotation.m_z>>v.m_gridOffset.m_x>>v.m_gridOffset.m_y>>v.m_gridOffset.m_z;
+    if(!tokens)
+    {
+      std::cerr<<_file<<":"<<lineNumber<<" expected name x y w h eye target up size near far grid rotation offset\n";
+      continue;
+    }
+    ngl::Vec3 forward=v.m_target-v.m_eye;
+    v.m_right=forward.cross(v.m_up);
+    if(v.m_width<=0.0f || v.m_height<=0.0f || v.m_near>=v.m_far || forward.lengthSquared()==0.0f || v.m_right.lengthSquared()==0.0f)
+    {
+      std::cerr<<_file<<":"<<lineNumber<<" viewport "<<v.m_name<<" has no area, depth range or camera\n";
+      continue;
+    }
+    v.m_right.normalize();
+    v.m_cameraUp=v.m_right.cross(forward);
+    v.m_cameraUp.normalize();
+    v.m_view=ngl::lookAt(v.m_eye,v.m_target,v.m_up);
+    m_viewports.push_back(v);
+  }
+  if(m_viewports.empty())
+  {
+    std::cerr<<"no viewports in layout "<<_file<<"\n";
+    return false;
+  }
+  std::cout<<"read "<<m_viewports.size()<<" viewports from "<<_file<<"\n";
+  return true;
+}
+
+size_t ViewportLayout::viewportAt(int _x, int _y, int _width, int _height) const
+{
+  ngl::Real x=static_cast<ngl::Real>(_x)/static_cast<ngl::Real>(_width);
+  ngl::Real y=1.0f-static_cast<ngl::Real>(_y)/static_cast<ngl::Real>(_height);
+  // later viewports are drawn over earlier ones so look from the end
+  for(size_t i=m_viewports.size(); i-->0;)
+  {
+    const Viewport &v=m_viewports[i];
+    if(x>=v.m_x && x<v.m_x+v.m_width && y>v.m_y && y<=v.m_y+v.m_height)
+    {
+      return i;
+    }
+  }
+  return c_noViewport;
+}
+
+std::array<int,4> ViewportLayout::pixelRect(size_t _index, int _width, int _height) const
+{
+  const Viewport &v=m_viewports[_index];
+  // round both edges rather than the size so the tiles meet exactly
+  int x0=static_cast<int>(std::lround(v.m_x*_width));
+  int y0=static_cast<int>(std::lround(v.m_y*_height));
+  int x1=static_cast<int>(std::lround((v.m_x+v.m_width)*_width));
+  int y1=static_cast<int>(std::lround((v.m_y+v.m_height)*_height));
+  return {{x0,y0,x1-x0,y1-y0}};
+}
+
+ngl::Mat4 ViewportLayout::projection(size_t _index, ngl::Real _aspect) const
+{
+  const Viewport &v=m_viewports[_index];
+  if(v.m_perspective)
+  {
+    return ngl::perspective(v.m_size,_aspect,v.m_near,v.m_far);
+  }
+  return ngl::ortho(-v.m_size,v.m_size,-v.m_size,v.m_size,v.m_near,v.m_far);
+}
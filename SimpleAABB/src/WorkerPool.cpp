@@ -0,0 +1,141 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace
+{
+  // the pool whose chunks this thread is running, a nested parallelFor on it would wait for
+  // the loop it is part of
+  thread_local const WorkerPool *t_running=nullptr;
+
+  struct Running
+  {
+    explicit Running(const WorkerPool *_pool) : m_previous(t_running) {t_running=_pool;}
+    ~Running() {t_running=m_previous;}
+    const WorkerPool *m_previous;
+  };
+}
+
+WorkerPool::WorkerPool(size_t _numThreads) : m_next(0)
+{
+  if(_numThreads==0)
+  {
+    // hardware_concurrency may report 0
+    _numThreads=std::max(1u,std::thread::hardware_concurrency());
+  }
+  for(size_t i=1; i<_numThreads; ++i)
+  {
+    m_threads.push_back(std::thread(&WorkerPool::worker,this));
+  }
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_quit=true;
+  }
+  m_wake.notify_all();
+  for(auto &t : m_threads)
+  {
+    t.join();
+  }
+}
+
+WorkerPool &WorkerPool::shared()
+{
+  static WorkerPool pool;
+  return pool;
+}
+
+void WorkerPool::run(size_t _count, size_t _grain, Task _task, const void *_context)
+{
+  _grain=std::max<size_t>(_grain,1);
+  // nested in one of our own chunks, so run serially rather than wait on m_runMutex. Not worth
+  // waking anyone for a single chunk either. The chunks stay the same size as callers index
+  // per chunk results by them.
+  if(t_running==this || m_threads.empty() || _count<=_grain)
+  {
+    Running running(this);
+    for(size_t begin=0; begin<_count; begin+=_grain)
+    {
+      _task(_context,begin,std::min(begin+_grain,_count));
+    }
+    return;
+  }
+  std::lock_guard<std::mutex> running(m_runMutex);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task=_task;
+    m_context=_context;
+    m_count=_count;
+    m_grain=_grain;
+    m_next=0;
+    m_busy=m_threads.size();
+    m_error=nullptr;
+    ++m_generation;
+  }
+  m_wake.notify_all();
+  work();
+  std::exception_ptr error;
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock,[this](){return m_busy==0;});
+    std::swap(error,m_error);
+  }
+  // only now that no worker can touch _context
+  if(error)
+  {
+    std::rethrow_exception(error);
+  }
+}
+
+void WorkerPool::work()
+{
+  Running running(this);
+  for(;;)
+  {
+    size_t begin=m_next.fetch_add(m_grain);
+    if(begin>=m_count)
+    {
+      return;
+    }
+    try
+    {
+      m_task(m_context,begin,std::min(begin+m_grain,m_count));
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if(!m_error)
+      {
+        m_error=std::current_exception();
+      }
+      // hand out no more chunks
+      m_next=m_count;
+      return;
+    }
+  }
+}
+
+void WorkerPool::worker()
+{
+  uint64_t seen=0;
+  for(;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock,[this,seen](){return m_quit || m_generation!=seen;});
+      if(m_quit)
+      {
+        return;
+      }
+      seen=m_generation;
+    }
+    work();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(--m_busy==0)
+    {
+      m_done.notify_one();
+    }
+  }
+}
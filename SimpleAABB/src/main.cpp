@@ -3,9 +3,31 @@ basic OpenGL demo modified from http://qt-project.org/doc/qt-5.0/qtgui/openglwin
 ****************************************************************************/
 #include <QtGui/QGuiApplication>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 #include "NGLScene.h"
+#include "EventRecording.h"
+#include "Benchmark.h"
+#include "MeshLOD.h"
 
-
+namespace
+{
+  void usage(std::ostream &_out)
+  {
+    _out<<"usage: SimpleAABB [options] [scene file]   default scenes/default.scene\n"
+          "  --layout <file>              the viewports, default layouts/quad.layout (wall.layout is 16 views)\n"
+          "  --draw-path direct|gpu|cpu   a draw per mesh, or a multi draw indirect per panel culled on the GPU or CPU\n"
+          "  --quantize                   draw every mesh with quantized vertices\n"
+          "  --no-index-optimize          keep the triangles in the order the LOD build made them\n"
+          "  --verbose                    print the load times and the per frame figures when they change\n"
+          "  --stats <socket>             serve the frame counters as JSON on a UNIX socket\n"
+          "  --record <file>              capture the input\n"
+          "  --replay <file>              play a recording back offscreen and write its frame times\n"
+          "  --out <file>                 where --replay writes them, default the recording name plus .csv\n"
+          "  --bench-* [arguments]        run a benchmark and exit, an unknown one lists them all\n";
+  }
+}
 
 int main(int argc, char **argv)
 {
@@ -29,14 +51,103 @@ int main(int argc, char **argv)
   format.setProfile(QSurfaceFormat::CoreProfile);
   // now set the depth buffer to 24 bits
   format.setDepthBufferSize(24);
-  // now we are going to create our scene window
-  NGLScene window;
+  // now we are going to create our scene window, see usage() for the options
+  std::string sceneFile="scenes/default.scene";
+  std::string statsSocket;
+  std::string recordFile;
+  std::string replayFile;
+  std::string outFile;
+  for(int i=1; i<argc; ++i)
+  {
+    std::string arg(argv[i]);
+    if(arg.compare(0,8,"--bench-")==0)
+    {
+      // everything after the option belongs to the benchmark
+      int exitCode=EXIT_FAILURE;
+      if(!runBenchmark(arg,std::vector<std::string>(argv+i+1,argv+argc),exitCode))
+      {
+        std::cerr<<"unknown benchmark "<<arg<<", the benchmarks are\n";
+        printBenchmarks(std::cerr);
+      }
+      return exitCode;
+    }
+    else if(arg=="--no-index-optimize")
+    {
+      MeshLOD::setOptimizeIndices(false);
+    }
+    else if(arg=="--quantize")
+    {
+      MeshLOD::setVertexFormat(MeshLOD::VertexFormat::QUANTIZED);
+    }
+    else if(arg=="--draw-path" && i+1<argc)
+    {
+      std::string path(argv[++i]);
+      if(path!="direct" && path!="gpu" && path!="cpu")
+      {
+        std::cerr<<"unknown draw path "<<path<<"\n";
+        usage(std::cerr);
+        return EXIT_FAILURE;
+      }
+      NGLScene::setDrawPath(path=="gpu" ? NGLScene::DrawPath::GPU :
+                            path=="cpu" ? NGLScene::DrawPath::CPU : NGLScene::DrawPath::DIRECT);
+    }
+    else if(arg=="--verbose")
+    {
+      NGLScene::setVerbose(true);
+    }
+    else if(arg=="--layout" && i+1<argc)
+    {
+      NGLScene::setLayoutFile(argv[++i]);
+    }
+    else if(arg=="--stats" && i+1<argc)
+    {
+      statsSocket=argv[++i];
+    }
+    else if(arg=="--record" && i+1<argc)
+    {
+      recordFile=argv[++i];
+    }
+    else if(arg=="--replay" && i+1<argc)
+    {
+      replayFile=argv[++i];
+    }
+    else if(arg=="--out" && i+1<argc)
+    {
+      outFile=argv[++i];
+    }
+    else if(arg.compare(0,2,"--")==0)
+    {
+      // also an option missing its argument, rather than opening it as a scene
+      std::cerr<<"unknown option "<<arg<<" (or it needs an argument)\n";
+      usage(std::cerr);
+      return EXIT_FAILURE;
+    }
+    else
+    {
+      sceneFile=arg;
+    }
+  }
+  if(!replayFile.empty())
+  {
+    EventPlayer player;
+    if(!player.load(replayFile))
+    {
+      return EXIT_FAILURE;
+    }
+    return player.run(sceneFile,statsSocket,format,outFile.empty() ? replayFile+".csv" : outFile);
+  }
+  NGLScene window(sceneFile,statsSocket);
   // and set the OpenGL format
   window.setFormat(format);
   // we can now query the version to see if it worked
   std::cout<<"Profile is "<<format.majorVersion()<<" "<<format.minorVersion()<<"\n";
   // set the window size
   window.resize(1024, 720);
+  std::unique_ptr<EventRecorder> recorder;
+  if(!recordFile.empty())
+  {
+    recorder.reset(new EventRecorder(recordFile,&window));
+  }
   // and finally show
   window.show();
 
@@ -0,0 +1,38 @@
+#ifndef UNITTEST_H_
+#define UNITTEST_H_
+#include <cstdlib>
+#include <iostream>
+
+// The unit tests here are plain programs run by ctest. CHECK reports a failed condition with
+// its line and carries on, so one run shows every failure, and finish() gives the exit code.
+namespace unittest
+{
+  inline int &failures()
+  {
+    static int s_failures=0;
+    return s_failures;
+  }
+
+  inline int finish(const char *_name)
+  {
+    if(failures())
+    {
+      std::cerr<<_name<<": "<<failures()<<" checks failed\n";
+      return EXIT_FAILURE;
+    }
+    std::cout<<_name<<" ok\n";
+    return EXIT_SUCCESS;
+  }
+}
+
+#define CHECK(_condition) \
+  do \
+  { \
+    if(!(_condition)) \
+    { \
+      std::cerr<<__FILE__<<":"<<__LINE__<<" failed: "<<#_condition<<"\n"; \
+      ++unittest::failures(); \
+    } \
+  } while(0)
+
+#endif
@@ -0,0 +1,83 @@
+// AABB: extend, intersect, overlap and area, and Arvo's transformed() against transforming
+// all 8 corners of the box.
+#include "AABB.h"
+#include "UnitTest.h"
+#include <cmath>
+#include <random>
+
+namespace
+{
+  // the 8 corners of _box through _tx as row vectors, translation in the last row
+  AABB cornerBox(const AABB &_box, const ngl::Mat4 &_tx)
+  {
+    AABB r;
+    for(int c=0; c<8; ++c)
+    {
+      ngl::Vec3 p((c & 1) ? _box.m_max.m_x : _box.m_min.m_x,
+                  (c & 2) ? _box.m_max.m_y : _box.m_min.m_y,
+                  (c & 4) ? _box.m_max.m_z : _box.m_min.m_z);
+      ngl::Vec3 q;
+      for(int j=0; j<3; ++j)
+      {
+        q[j]=p.m_x*_tx.m_m[0][j]+p.m_y*_tx.m_m[1][j]+p.m_z*_tx.m_m[2][j]+_tx.m_m[3][j];
+      }
+      r.extend(q);
+    }
+    return r;
+  }
+
+  bool near(const ngl::Vec3 &_a, const ngl::Vec3 &_b, ngl::Real _tolerance)
+  {
+    return std::abs(_a.m_x-_b.m_x)<=_tolerance && std::abs(_a.m_y-_b.m_y)<=_tolerance && std::abs(_a.m_z-_b.m_z)<=_tolerance;
+  }
+}
+
+int main()
+{
+  AABB box;
+  CHECK(box.isEmpty());
+  box.extend(ngl::Vec3(1,2,3));
+  CHECK(!box.isEmpty());
+  CHECK(near(box.m_min,ngl::Vec3(1,2,3),0.0f) && near(box.m_max,ngl::Vec3(1,2,3),0.0f));
+  box.extend(AABB(ngl::Vec3(-1,0,0),ngl::Vec3(0,4,6)));
+  CHECK(near(box.m_min,ngl::Vec3(-1,0,0),0.0f) && near(box.m_max,ngl::Vec3(1,4,6),0.0f));
+  CHECK(near(box.center(),ngl::Vec3(0,2,3),0.0f));
+  CHECK(near(box.size(),ngl::Vec3(2,4,6),0.0f));
+  CHECK(box.surfaceArea()==2.0f*(8+24+12));
+
+  // touching counts as overlapping, and the overlap of disjoint boxes is empty
+  AABB a(ngl::Vec3(0,0,0),ngl::Vec3(1,1,1));
+  AABB b(ngl::Vec3(1,0,0),ngl::Vec3(2,1,1));
+  AABB c(ngl::Vec3(1.5f,0,0),ngl::Vec3(2,1,1));
+  CHECK(a.overlaps(b) && b.overlaps(a));
+  CHECK(!a.overlaps(c) && !c.overlaps(a));
+  AABB overlap=a;
+  overlap.intersect(c);
+  CHECK(overlap.isEmpty());
+  overlap=a;
+  overlap.intersect(AABB(ngl::Vec3(0.5f,-1,0.25f),ngl::Vec3(3,0.5f,0.75f)));
+  CHECK(near(overlap.m_min,ngl::Vec3(0.5f,0,0.25f),0.0f) && near(overlap.m_max,ngl::Vec3(1,0.5f,0.75f),0.0f));
+
+  // any affine transform, including mirrors and shears
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<ngl::Real> unit(-1.0f,1.0f);
+  for(int t=0; t<1000; ++t)
+  {
+    ngl::Mat4 tx;
+    tx.identity();
+    for(int i=0; i<4; ++i)
+    {
+      for(int j=0; j<3; ++j)
+      {
+        tx.m_m[i][j]= i<3 ? 2.0f*unit(rng) : 10.0f*unit(rng);
+      }
+    }
+    ngl::Vec3 p(unit(rng),unit(rng),unit(rng));
+    ngl::Vec3 half(std::abs(unit(rng)),std::abs(unit(rng)),std::abs(unit(rng)));
+    AABB local(p-half,p+half);
+    AABB expected=cornerBox(local,tx);
+    AABB arvo=local.transformed(tx);
+    CHECK(near(arvo.m_min,expected.m_min,1e-4f) && near(arvo.m_max,expected.m_max,1e-4f));
+  }
+  return unittest::finish("aabb_test");
+}
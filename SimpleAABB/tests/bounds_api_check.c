@@ -0,0 +1,236 @@
+/* Checks the SimpleAABBBounds C interface from plain C, against brute force answers worked out
+   here. Built and run by ctest (the bounds_api_check target). Exits non zero on any mismatch. */
+#include "BoundsAPI.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {c_numBoxes=2000, c_numRays=2000};
+
+/* a caller's own struct, so the strided access is exercised with an offset and padding */
+typedef struct Object
+{
+  int tag;
+  float matrix[16];
+  float local[6];
+  float world[6];
+} Object;
+
+static int s_failures=0;
+
+static void check(int _ok, const char *_what)
+{
+  if(!_ok)
+  {
+    fprintf(stderr,"FAILED: %s\n",_what);
+    ++s_failures;
+  }
+}
+
+/* deterministic so a failure can be reproduced */
+static unsigned s_seed=1234u;
+static float randomIn(float _lo, float _hi)
+{
+  s_seed=s_seed*1664525u+1013904223u;
+  return _lo+(_hi-_lo)*(float)(s_seed>>8)/(float)(1u<<24);
+}
+
+static int near(float _a, float _b)
+{
+  return fabsf(_a-_b)<=1e-4f*(1.0f+fabsf(_a)+fabsf(_b));
+}
+
+/* the box of the 8 transformed corners, row vectors p*M */
+static void transformBox(const float *_m, const float *_box, float *_out)
+{
+  int a;
+  int i;
+  for(a=0; a<3; ++a)
+  {
+    _out[a]=1e30f;
+    _out[3+a]=-1e30f;
+  }
+  for(i=0; i<8; ++i)
+  {
+    float p[3]={_box[(i&1) ? 3 : 0],_box[(i&2) ? 4 : 1],_box[(i&4) ? 5 : 2]};
+    for(a=0; a<3; ++a)
+    {
+      float w=p[0]*_m[a]+p[1]*_m[4+a]+p[2]*_m[8+a]+_m[12+a];
+      _out[a]=w<_out[a] ? w : _out[a];
+      _out[3+a]=w>_out[3+a] ? w : _out[3+a];
+    }
+  }
+}
+
+static int overlaps(const float *_a, const float *_b)
+{
+  int a;
+  for(a=0; a<3; ++a)
+  {
+    if(_a[3+a]<_b[a] || _b[3+a]<_a[a])
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* entry distance of the ray into _box within [0,_maxT], negative for a miss */
+static float rayEntry(const float *_o, const float *_d, const float *_box, float _maxT)
+{
+  float tNear=0.0f;
+  float tFar=_maxT;
+  int a;
+  for(a=0; a<3; ++a)
+  {
+    float inv=1.0f/_d[a];
+    float t0=(_box[a]-_o[a])*inv;
+    float t1=(_box[3+a]-_o[a])*inv;
+    if(t0>t1)
+    {
+      float t=t0;
+      t0=t1;
+      t1=t;
+    }
+    tNear=t0>tNear ? t0 : tNear;
+    tFar=t1<tFar ? t1 : tFar;
+  }
+  return tNear<=tFar ? tNear : -1.0f;
+}
+
+int main(void)
+{
+  static Object objects[c_numBoxes];
+  static float packed[6*c_numBoxes];
+  static float origins[3*c_numRays];
+  static float directions[3*c_numRays];
+  static saabb_ray_hit hits[c_numRays];
+  saabb_context *context=NULL;
+  uint32_t *pairs;
+  size_t numPairs=0;
+  size_t expected=0;
+  size_t i;
+  size_t j;
+  int a;
+  int ok;
+
+  /* the layout other languages bind to */
+  check(saabb_version()==SAABB_API_VERSION,"library version matches the header");
+  check(sizeof(saabb_ray_hit)==8 && offsetof(saabb_ray_hit,object)==0 && offsetof(saabb_ray_hit,t)==4,"saabb_ray_hit layout");
+  check(SAABB_OK==0 && SAABB_INVALID_ARGUMENT==1 && SAABB_NOT_BUILT==2 && SAABB_OUT_OF_MEMORY==3 &&
+        SAABB_BUFFER_TOO_SMALL==4,"saabb_status values");
+
+  for(i=0; i<c_numBoxes; ++i)
+  {
+    Object *o=&objects[i];
+    float angle=randomIn(0.0f,6.2831853f);
+    float c=cosf(angle);
+    float s=sinf(angle);
+    float size=randomIn(0.1f,2.0f);
+    memset(o->matrix,0,sizeof(o->matrix));
+    /* a rotation about y then a translation */
+    o->matrix[0]=c; o->matrix[2]=-s;
+    o->matrix[5]=1.0f;
+    o->matrix[8]=s; o->matrix[10]=c;
+    o->matrix[12]=randomIn(-50.0f,50.0f); o->matrix[13]=randomIn(-50.0f,50.0f); o->matrix[14]=randomIn(-50.0f,50.0f);
+    o->matrix[15]=1.0f;
+    o->local[0]=-size; o->local[1]=-randomIn(0.1f,2.0f); o->local[2]=-size;
+    o->local[3]=size; o->local[4]=randomIn(0.1f,2.0f); o->local[5]=size;
+  }
+
+  check(saabb_transform_boxes(objects[0].matrix,sizeof(Object),objects[0].local,sizeof(Object),c_numBoxes,
+                              objects[0].world,sizeof(Object))==SAABB_OK,"saabb_transform_boxes");
+  ok=1;
+  for(i=0; i<c_numBoxes; ++i)
+  {
+    float expect[6];
+    transformBox(objects[i].matrix,objects[i].local,expect);
+    for(a=0; a<6; ++a)
+    {
+      ok=ok && near(expect[a],objects[i].world[a]);
+    }
+    memcpy(&packed[6*i],objects[i].world,sizeof(objects[i].world));
+  }
+  check(ok,"transformed boxes match the corner transform");
+
+  check(saabb_create(2,&context)==SAABB_OK && context,"saabb_create");
+  check(saabb_overlap_pairs(context,NULL,0,&numPairs)==SAABB_NOT_BUILT,"queries before a build fail");
+  check(saabb_build(context,objects[0].world,sizeof(Object),c_numBoxes)==SAABB_OK,"saabb_build strided");
+
+  for(i=0; i<c_numBoxes; ++i)
+  {
+    for(j=i+1; j<c_numBoxes; ++j)
+    {
+      expected+=(size_t)overlaps(&packed[6*i],&packed[6*j]);
+    }
+  }
+  check(saabb_overlap_pairs(context,NULL,0,&numPairs)==(expected ? SAABB_BUFFER_TOO_SMALL : SAABB_OK) && numPairs==expected,
+        "pair count with no buffer");
+  pairs=(uint32_t *)malloc(2*(numPairs+1)*sizeof(uint32_t));
+  check(saabb_overlap_pairs(context,pairs,numPairs,&numPairs)==SAABB_OK && numPairs==expected,"saabb_overlap_pairs");
+  ok=1;
+  for(i=0; i<numPairs; ++i)
+  {
+    ok=ok && pairs[2*i]<pairs[2*i+1] && pairs[2*i+1]<c_numBoxes && overlaps(&packed[6*pairs[2*i]],&packed[6*pairs[2*i+1]]);
+  }
+  check(ok,"every pair is ordered and overlaps");
+
+  /* packed input, and a refit must be given the built count */
+  check(saabb_build(context,packed,0,c_numBoxes)==SAABB_OK,"saabb_build packed");
+  check(saabb_refit(context,packed,0,c_numBoxes-1)==SAABB_NOT_BUILT,"refit with a different count");
+  check(saabb_refit(context,packed,0,c_numBoxes)==SAABB_OK,"saabb_refit");
+
+  for(i=0; i<c_numRays; ++i)
+  {
+    for(a=0; a<3; ++a)
+    {
+      origins[3*i+a]=randomIn(-50.0f,50.0f);
+      directions[3*i+a]=randomIn(-50.0f,50.0f);
+    }
+    /* axis parallel rays take the infinite slab path */
+    if(i%7==0)
+    {
+      directions[3*i]=0.0f;
+    }
+    if(i%11==0)
+    {
+      directions[3*i+1]=0.0f;
+      directions[3*i+2]=0.0f;
+    }
+  }
+  check(saabb_raycast(context,origins,0,directions,0,c_numRays,1.0f,hits,0)==SAABB_OK,"saabb_raycast");
+  ok=1;
+  for(i=0; i<c_numRays; ++i)
+  {
+    float best=-1.0f;
+    for(j=0; j<c_numBoxes; ++j)
+    {
+      float t=rayEntry(&origins[3*i],&directions[3*i],&packed[6*j],1.0f);
+      if(t>=0.0f && (best<0.0f || t<best))
+      {
+        best=t;
+      }
+    }
+    if(best<0.0f)
+    {
+      ok=ok && hits[i].object==SAABB_NO_HIT;
+    }
+    else
+    {
+      ok=ok && hits[i].object<c_numBoxes && near(best,hits[i].t) &&
+         near(rayEntry(&origins[3*i],&directions[3*i],&packed[6*hits[i].object],1.0f),best);
+    }
+  }
+  check(ok,"nearest hits match brute force");
+
+  check(saabb_build(NULL,packed,0,c_numBoxes)==SAABB_INVALID_ARGUMENT,"null context");
+  free(pairs);
+  saabb_destroy(context);
+  if(s_failures==0)
+  {
+    printf("bounds api ok, %zu pairs\n",expected);
+  }
+  return s_failures==0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,120 @@
+// CompressedBVH: node layout, every leaf's decoded box containing its exact box, and box
+// queries returning every exact hit plus only a few near misses.
+#include "CompressedBVH.h"
+#include "LinearBVH.h"
+#include "WorkerPool.h"
+#include "UnitTest.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace
+{
+  bool contains(const AABB &_outer, const AABB &_inner)
+  {
+    return _outer.m_min.m_x<=_inner.m_min.m_x && _outer.m_min.m_y<=_inner.m_min.m_y && _outer.m_min.m_z<=_inner.m_min.m_z &&
+           _outer.m_max.m_x>=_inner.m_max.m_x && _outer.m_max.m_y>=_inner.m_max.m_y && _outer.m_max.m_z>=_inner.m_max.m_z;
+  }
+
+  // walk the tree checking each child box holds the exact boxes of every object below it,
+  // returns the exact box of the subtree and counts its objects into _objects
+  AABB checkNode(const CompressedBVH &_tree, size_t _index, const std::vector<AABB> &_boxes, size_t &_objects, size_t &_bad)
+  {
+    const CompressedBVH::Node &node=_tree.node(_index);
+    AABB subtree;
+    for(int c=0; c<node.m_count; ++c)
+    {
+      uint32_t child=node.m_child[c];
+      AABB below;
+      if(child & CompressedBVH::c_leaf)
+      {
+        below=_boxes[child & ~CompressedBVH::c_leaf];
+        ++_objects;
+      }
+      else
+      {
+        below=checkNode(_tree,child,_boxes,_objects,_bad);
+      }
+      _bad+=!contains(CompressedBVH::childBox(node,c),below);
+      subtree.extend(below);
+    }
+    return subtree;
+  }
+
+  void checkTree(const std::vector<AABB> &_boxes, std::mt19937 &_rng)
+  {
+    WorkerPool pool(2);
+    LinearBVH exact(&pool);
+    exact.build(_boxes.data(),_boxes.size());
+    CompressedBVH tree;
+    tree.build(exact);
+    CHECK(tree.memoryBytes()==tree.numNodes()*sizeof(CompressedBVH::Node));
+    if(_boxes.empty())
+    {
+      CHECK(tree.numNodes()==0);
+      return;
+    }
+    CHECK(reinterpret_cast<uintptr_t>(&tree.node(0))%64==0);
+    size_t objects=0;
+    size_t bad=0;
+    checkNode(tree,0,_boxes,objects,bad);
+    CHECK(objects==_boxes.size());
+    CHECK(bad==0);
+
+    // queries spread over and a little beyond the boxes, up to a tenth of their extent
+    AABB bounds=exact.bounds();
+    ngl::Vec3 extent=bounds.size();
+    std::uniform_real_distribution<ngl::Real> where(-0.05f,1.05f);
+    std::uniform_real_distribution<ngl::Real> size(0.0f,0.1f);
+    size_t missed=0;
+    size_t hits=0;
+    size_t candidates=0;
+    std::vector<uint32_t> expected;
+    std::vector<uint32_t> found;
+    for(int q=0; q<500; ++q)
+    {
+      ngl::Vec3 p(bounds.m_min.m_x+where(_rng)*extent.m_x,bounds.m_min.m_y+where(_rng)*extent.m_y,bounds.m_min.m_z+where(_rng)*extent.m_z);
+      AABB query(p,p+ngl::Vec3(size(_rng)*extent.m_x,size(_rng)*extent.m_y,size(_rng)*extent.m_z));
+      expected.clear();
+      found.clear();
+      exact.queryBox(query,expected);
+      tree.queryBox(query,found);
+      std::sort(expected.begin(),expected.end());
+      std::sort(found.begin(),found.end());
+      missed+=!std::includes(found.begin(),found.end(),expected.begin(),expected.end());
+      CHECK(std::adjacent_find(found.begin(),found.end())==found.end());
+      hits+=expected.size();
+      candidates+=found.size();
+    }
+    CHECK(missed==0);
+    CHECK(hits>0 && candidates<=hits+hits/10+10);
+  }
+}
+
+int main()
+{
+  CHECK(sizeof(CompressedBVH::Node)==64);
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<ngl::Real> position(-50.0f,50.0f);
+  std::uniform_real_distribution<ngl::Real> size(0.0f,2.0f);
+  for(size_t count : {0,1,2,5,4000})
+  {
+    std::vector<AABB> boxes(count);
+    for(auto &box : boxes)
+    {
+      ngl::Vec3 p(position(rng),position(rng),position(rng));
+      box=AABB(p,p+ngl::Vec3(size(rng),size(rng),size(rng)));
+    }
+    checkTree(boxes,rng);
+  }
+  // flat and tiny boxes far from the origin are the hardest to round outwards
+  std::vector<AABB> flat(1000);
+  for(auto &box : flat)
+  {
+    ngl::Vec3 p(1e4f+position(rng)*1e-2f,-3e3f,1e4f+position(rng)*1e-2f);
+    box=AABB(p,p+ngl::Vec3(size(rng)*1e-3f,0.0f,size(rng)*1e-3f));
+  }
+  checkTree(flat,rng);
+  return unittest::finish("compressed_bvh_test");
+}
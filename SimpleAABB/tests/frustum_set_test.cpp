@@ -0,0 +1,162 @@
+// FrustumSet: the mask of every view against clipping the 8 box corners of each view on its
+// own, for view counts that fill a group of four, leave one part full and use all 64.
+#include "FrustumSet.h"
+#include "UnitTest.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+  ngl::Mat4 multiply(const ngl::Mat4 &_a, const ngl::Mat4 &_b)
+  {
+    ngl::Mat4 r;
+    for(int i=0; i<4; ++i)
+    {
+      for(int j=0; j<4; ++j)
+      {
+        r.m_m[i][j]=0.0f;
+        for(int k=0; k<4; ++k)
+        {
+          r.m_m[i][j]+=_a.m_m[i][k]*_b.m_m[k][j];
+        }
+      }
+    }
+    return r;
+  }
+
+  // a random camera looking at the origin region, half of them orthographic, as row vector
+  // view * projection matrices
+  ngl::Mat4 randomView(std::mt19937 &_rng)
+  {
+    std::normal_distribution<ngl::Real> gauss(0.0f,1.0f);
+    std::uniform_real_distribution<ngl::Real> unit(0.0f,1.0f);
+    ngl::Real q[4]={gauss(_rng),gauss(_rng),gauss(_rng),gauss(_rng)};
+    ngl::Real len=std::sqrt(q[0]*q[0]+q[1]*q[1]+q[2]*q[2]+q[3]*q[3]);
+    ngl::Real w=q[0]/len, x=q[1]/len, y=q[2]/len, z=q[3]/len;
+    ngl::Real r[3][3]={{1-2*(y*y+z*z),2*(x*y+w*z),2*(x*z-w*y)},
+                       {2*(x*y-w*z),1-2*(x*x+z*z),2*(y*z+w*x)},
+                       {2*(x*z+w*y),2*(y*z-w*x),1-2*(x*x+y*y)}};
+    // world to eye is the transposed rotation after moving the eye to the origin, the eye
+    // sits 20 units back along its own +z
+    ngl::Mat4 view;
+    view.identity();
+    for(int i=0; i<3; ++i)
+    {
+      for(int j=0; j<3; ++j)
+      {
+        view.m_m[i][j]=r[j][i];
+      }
+    }
+    view.m_m[3][2]=-20.0f;
+    ngl::Real near=0.5f+unit(_rng);
+    ngl::Real far=30.0f+20.0f*unit(_rng);
+    ngl::Mat4 projection;
+    projection.identity();
+    if(unit(_rng)<0.5f)
+    {
+      ngl::Real f=1.0f/std::tan(0.2f+unit(_rng));
+      ngl::Real aspect=0.5f+unit(_rng);
+      projection.m_m[0][0]=f/aspect;
+      projection.m_m[1][1]=f;
+      projection.m_m[2][2]=(far+near)/(near-far);
+      projection.m_m[2][3]=-1.0f;
+      projection.m_m[3][2]=2.0f*far*near/(near-far);
+      projection.m_m[3][3]=0.0f;
+    }
+    else
+    {
+      ngl::Real half=2.0f+8.0f*unit(_rng);
+      projection.m_m[0][0]=1.0f/half;
+      projection.m_m[1][1]=1.0f/(half*(0.5f+unit(_rng)));
+      projection.m_m[2][2]=-2.0f/(far-near);
+      projection.m_m[3][2]=-(far+near)/(far-near);
+    }
+    return multiply(view,projection);
+  }
+
+  // -1 when _box is outside the view, 1 when it is not, 0 when a corner is so close to a
+  // plane that float rounding may decide either way
+  int reference(const AABB &_box, const ngl::Mat4 &_VP)
+  {
+    double margins[6];
+    std::fill(margins,margins+6,-1e30);
+    for(int c=0; c<8; ++c)
+    {
+      double p[3]={(c & 1) ? _box.m_max.m_x : _box.m_min.m_x,(c & 2) ? _box.m_max.m_y : _box.m_min.m_y,(c & 4) ? _box.m_max.m_z : _box.m_min.m_z};
+      double clip[4];
+      for(int j=0; j<4; ++j)
+      {
+        clip[j]=p[0]*_VP.m_m[0][j]+p[1]*_VP.m_m[1][j]+p[2]*_VP.m_m[2][j]+_VP.m_m[3][j];
+      }
+      for(int axis=0; axis<3; ++axis)
+      {
+        margins[2*axis]=std::max(margins[2*axis],clip[3]+clip[axis]);
+        margins[2*axis+1]=std::max(margins[2*axis+1],clip[3]-clip[axis]);
+      }
+    }
+    int result=1;
+    for(double margin : margins)
+    {
+      if(std::abs(margin)<1e-3)
+      {
+        result=std::min(result,0);
+      }
+      else if(margin<0.0)
+      {
+        return -1;
+      }
+    }
+    return result;
+  }
+}
+
+int main()
+{
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<ngl::Real> position(-30.0f,30.0f);
+  std::uniform_real_distribution<ngl::Real> size(0.0f,6.0f);
+  std::vector<AABB> boxes(2000);
+  for(auto &box : boxes)
+  {
+    ngl::Vec3 p(position(rng),position(rng),position(rng));
+    box=AABB(p,p+ngl::Vec3(size(rng),size(rng),size(rng)));
+  }
+  FrustumSet set;
+  for(size_t numViews : {1,3,4,5,17,64,80})
+  {
+    std::vector<ngl::Mat4> VPs;
+    for(size_t v=0; v<numViews; ++v)
+    {
+      VPs.push_back(randomView(rng));
+    }
+    set.set(VPs.data(),VPs.size());
+    size_t used=std::min(numViews,FrustumSet::c_maxViews);
+    CHECK(set.size()==used);
+    FrustumSet::Mask all= used==64 ? ~FrustumSet::Mask(0) : (FrustumSet::Mask(1)<<used)-1;
+    size_t wrong=0;
+    size_t visible=0;
+    size_t culled=0;
+    for(const auto &box : boxes)
+    {
+      FrustumSet::Mask mask=set.visibleMask(box);
+      wrong+=(mask & ~all)!=0;
+      for(size_t v=0; v<used; ++v)
+      {
+        bool in=(mask>>v) & 1;
+        int expected=reference(box,VPs[v]);
+        wrong+=expected!=0 && in!=(expected>0);
+        visible+=in;
+        culled+=!in;
+      }
+    }
+    CHECK(wrong==0);
+    CHECK(visible>0 && culled>0);
+    CHECK(set.visibleMask(AABB())==0);
+  }
+  // no views sees nothing
+  set.set(nullptr,0);
+  CHECK(set.size()==0 && set.visibleMask(boxes[0])==0);
+  return unittest::finish("frustum_set_test");
+}
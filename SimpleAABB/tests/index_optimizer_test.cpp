@@ -0,0 +1,141 @@
+// IndexOptimizer: cache figures of known orders, and each pass over a shuffled grid keeping
+// every triangle with its winding while lowering the vertex cache misses.
+#include "IndexOptimizer.h"
+#include "UnitTest.h"
+#include <algorithm>
+#include <array>
+#include <random>
+#include <vector>
+
+namespace
+{
+  constexpr size_t c_gridSize=64;
+  constexpr size_t c_stride=3;
+
+  typedef std::array<ngl::Real,9> Triangle;
+
+  // the corner positions of each triangle starting from its lowest corner, so a rotated
+  // triangle compares equal and a flipped one does not, sorted
+  std::vector<Triangle> triangles(const std::vector<ngl::Real> &_positions, const std::vector<GLuint> &_indices)
+  {
+    std::vector<Triangle> result;
+    for(size_t t=0; t<_indices.size(); t+=3)
+    {
+      size_t first=0;
+      for(size_t c=1; c<3; ++c)
+      {
+        if(std::lexicographical_compare(&_positions[_indices[t+c]*c_stride],&_positions[_indices[t+c]*c_stride]+3,
+                                        &_positions[_indices[t+first]*c_stride],&_positions[_indices[t+first]*c_stride]+3))
+        {
+          first=c;
+        }
+      }
+      Triangle triangle;
+      for(size_t c=0; c<3; ++c)
+      {
+        std::copy_n(&_positions[_indices[t+(first+c)%3]*c_stride],3,triangle.begin()+3*c);
+      }
+      result.push_back(triangle);
+    }
+    std::sort(result.begin(),result.end());
+    return result;
+  }
+}
+
+int main()
+{
+  // one triangle misses on every vertex, drawing it again hits on every vertex
+  GLuint twice[]={0,1,2,0,1,2};
+  IndexOptimizer::CacheStats stats=IndexOptimizer::analyzeCache(twice,3,3);
+  CHECK(stats.m_acmr==3.0f && stats.m_atvr==1.0f);
+  stats=IndexOptimizer::analyzeCache(twice,6,3);
+  CHECK(stats.m_acmr==1.5f && stats.m_atvr==1.0f);
+  // in a FIFO of 3 the second triangle hits on 2 and 1 but pushes 0 out, and each miss of
+  // the third pushes out the next vertex it wants
+  GLuint strip[]={0,1,2,2,1,3,0,1,2};
+  stats=IndexOptimizer::analyzeCache(strip,9,4,3);
+  CHECK(stats.m_acmr==7.0f/3.0f && stats.m_atvr==7.0f/4.0f);
+
+  // a grid of quads with its triangles shuffled and numbered in a random order
+  size_t numVertices=(c_gridSize+1)*(c_gridSize+1);
+  std::vector<ngl::Real> positions(numVertices*c_stride);
+  for(size_t v=0; v<numVertices; ++v)
+  {
+    positions[v*c_stride]=static_cast<ngl::Real>(v%(c_gridSize+1));
+    positions[v*c_stride+1]=static_cast<ngl::Real>(v/(c_gridSize+1));
+    // a bump in the middle so overdraw sorting has front and back facing parts to order
+    ngl::Real dx=positions[v*c_stride]-c_gridSize/2.0f;
+    ngl::Real dy=positions[v*c_stride+1]-c_gridSize/2.0f;
+    positions[v*c_stride+2]=std::max(0.0f,100.0f-dx*dx-dy*dy)*0.1f;
+  }
+  std::vector<GLuint> indices;
+  for(size_t y=0; y<c_gridSize; ++y)
+  {
+    for(size_t x=0; x<c_gridSize; ++x)
+    {
+      GLuint v=static_cast<GLuint>(y*(c_gridSize+1)+x);
+      GLuint quad[6]={v,v+1,v+GLuint(c_gridSize)+2,v,v+GLuint(c_gridSize)+2,v+GLuint(c_gridSize)+1};
+      indices.insert(indices.end(),quad,quad+6);
+    }
+  }
+  std::mt19937 rng(1234);
+  std::vector<size_t> order(indices.size()/3);
+  for(size_t t=0; t<order.size(); ++t)
+  {
+    order[t]=t;
+  }
+  std::shuffle(order.begin(),order.end(),rng);
+  std::vector<GLuint> shuffled;
+  for(size_t t : order)
+  {
+    shuffled.insert(shuffled.end(),&indices[3*t],&indices[3*t]+3);
+  }
+  std::vector<Triangle> expected=triangles(positions,shuffled);
+  IndexOptimizer::CacheStats before=IndexOptimizer::analyzeCache(shuffled.data(),shuffled.size(),numVertices);
+  CHECK(before.m_acmr>2.5f);
+
+  std::vector<GLuint> optimized(shuffled);
+  IndexOptimizer::optimizeVertexCache(optimized.data(),optimized.size(),numVertices);
+  CHECK(triangles(positions,optimized)==expected);
+  IndexOptimizer::CacheStats cache=IndexOptimizer::analyzeCache(optimized.data(),optimized.size(),numVertices);
+  CHECK(cache.m_acmr<0.8f);
+  CHECK(cache.m_atvr<1.5f);
+
+  // the overdraw pass only moves whole clusters so the misses barely change
+  IndexOptimizer::optimizeOverdraw(positions.data(),c_stride,optimized.data(),optimized.size(),numVertices);
+  CHECK(triangles(positions,optimized)==expected);
+  IndexOptimizer::CacheStats overdraw=IndexOptimizer::analyzeCache(optimized.data(),optimized.size(),numVertices);
+  CHECK(overdraw.m_acmr<=cache.m_acmr*1.1f);
+
+  // renumbering the vertices in the order they are used, applied to the positions, leaves
+  // the triangles where they were and is a permutation
+  std::vector<GLuint> remap;
+  std::vector<GLuint> renumbered(optimized);
+  IndexOptimizer::optimizeVertexFetch(renumbered.data(),renumbered.size(),numVertices,remap);
+  CHECK(remap.size()==numVertices);
+  std::vector<GLuint> sortedRemap(remap);
+  std::sort(sortedRemap.begin(),sortedRemap.end());
+  bool permutation=true;
+  for(size_t v=0; v<numVertices; ++v)
+  {
+    permutation&=sortedRemap[v]==v;
+  }
+  CHECK(permutation);
+  std::vector<ngl::Real> moved(positions.size());
+  for(size_t v=0; v<numVertices && permutation; ++v)
+  {
+    std::copy_n(&positions[v*c_stride],c_stride,&moved[remap[v]*c_stride]);
+  }
+  CHECK(triangles(moved,renumbered)==expected);
+  GLuint next=0;
+  bool firstUseOrder=true;
+  for(GLuint i : renumbered)
+  {
+    firstUseOrder&=i<=next;
+    next=std::max(next,i+1);
+  }
+  CHECK(firstUseOrder);
+  stats=IndexOptimizer::analyzeCache(renumbered.data(),renumbered.size(),numVertices);
+  CHECK(stats.m_acmr==overdraw.m_acmr);
+  return unittest::finish("index_optimizer_test");
+}
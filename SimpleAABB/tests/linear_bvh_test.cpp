@@ -0,0 +1,214 @@
+// LinearBVH: box, sphere and pair queries and raycasts against brute force, for both code
+// widths, serial and on a pool, before and after refitting to moved boxes, and the SAH cost
+// of a refitted tree against a fresh build.
+#include "LinearBVH.h"
+#include "WorkerPool.h"
+#include "UnitTest.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+  constexpr size_t c_numBoxes=3000;
+  constexpr size_t c_numQueries=200;
+
+  std::vector<AABB> randomBoxes(size_t _count, std::mt19937 &_rng)
+  {
+    std::uniform_real_distribution<ngl::Real> position(-50.0f,50.0f);
+    std::uniform_real_distribution<ngl::Real> size(0.1f,3.0f);
+    std::vector<AABB> boxes(_count);
+    for(auto &box : boxes)
+    {
+      ngl::Vec3 p(position(_rng),position(_rng),position(_rng));
+      box=AABB(p,p+ngl::Vec3(size(_rng),size(_rng),size(_rng)));
+    }
+    return boxes;
+  }
+
+  std::vector<uint32_t> sorted(std::vector<uint32_t> _ids)
+  {
+    std::sort(_ids.begin(),_ids.end());
+    return _ids;
+  }
+
+  // slab test as a reference for raycast, false if _ray misses or only hits beyond _maxT
+  bool hit(const AABB &_box, const ngl::Vec3 &_origin, const ngl::Vec3 &_direction, ngl::Real _maxT, ngl::Real &_t)
+  {
+    ngl::Real near=0.0f;
+    ngl::Real far=_maxT;
+    for(int i=0; i<3; ++i)
+    {
+      if(_direction[i]==0.0f)
+      {
+        if(_origin[i]<_box.m_min[i] || _origin[i]>_box.m_max[i])
+        {
+          return false;
+        }
+        continue;
+      }
+      ngl::Real t0=(_box.m_min[i]-_origin[i])/_direction[i];
+      ngl::Real t1=(_box.m_max[i]-_origin[i])/_direction[i];
+      near=std::max(near,std::min(t0,t1));
+      far=std::min(far,std::max(t0,t1));
+    }
+    _t=near;
+    return near<=far;
+  }
+
+  void checkQueries(LinearBVH &_tree, const std::vector<AABB> &_boxes, std::mt19937 &_rng)
+  {
+    CHECK(_tree.size()==_boxes.size());
+    AABB all;
+    for(const auto &box : _boxes)
+    {
+      all.extend(box);
+    }
+    AABB bounds=_tree.bounds();
+    CHECK(bounds.m_min.m_x==all.m_min.m_x && bounds.m_min.m_y==all.m_min.m_y && bounds.m_min.m_z==all.m_min.m_z);
+    CHECK(bounds.m_max.m_x==all.m_max.m_x && bounds.m_max.m_y==all.m_max.m_y && bounds.m_max.m_z==all.m_max.m_z);
+
+    std::uniform_real_distribution<ngl::Real> position(-55.0f,55.0f);
+    std::uniform_real_distribution<ngl::Real> size(0.0f,10.0f);
+    std::uniform_real_distribution<ngl::Real> unit(-1.0f,1.0f);
+    std::vector<uint32_t> found;
+    size_t mismatches=0;
+    for(size_t q=0; q<c_numQueries; ++q)
+    {
+      ngl::Vec3 p(position(_rng),position(_rng),position(_rng));
+      AABB query(p,p+ngl::Vec3(size(_rng),size(_rng),size(_rng)));
+      ngl::Real radius=size(_rng);
+      std::vector<uint32_t> inBox;
+      std::vector<uint32_t> inSphere;
+      for(uint32_t i=0; i<_boxes.size(); ++i)
+      {
+        if(query.overlaps(_boxes[i]))
+        {
+          inBox.push_back(i);
+        }
+        // squared distance from the centre to the nearest point of the box
+        ngl::Real d2=0.0f;
+        for(int a=0; a<3; ++a)
+        {
+          ngl::Real d=std::max(std::max(_boxes[i].m_min[a]-p[a],p[a]-_boxes[i].m_max[a]),0.0f);
+          d2+=d*d;
+        }
+        if(d2<=radius*radius)
+        {
+          inSphere.push_back(i);
+        }
+      }
+      found.clear();
+      _tree.queryBox(query,found);
+      mismatches+=sorted(found)!=inBox;
+      found.clear();
+      _tree.querySphere(p,radius,found);
+      mismatches+=sorted(found)!=inSphere;
+
+      // the nearest hit along a ray, one in four along an axis
+      ngl::Vec3 direction(unit(_rng),unit(_rng),unit(_rng));
+      if(q%4==0)
+      {
+        direction.set(0.0f,0.0f,0.0f);
+        direction[q/4%3]=1.0f;
+      }
+      ngl::Real nearest=100.0f;
+      bool expected=false;
+      for(const auto &box : _boxes)
+      {
+        ngl::Real t;
+        if(hit(box,p,direction,nearest,t))
+        {
+          nearest=t;
+          expected=true;
+        }
+      }
+      uint32_t object=0;
+      ngl::Real t=0.0f;
+      bool hitSomething=_tree.raycast(p,direction,100.0f,object,t);
+      mismatches+=hitSomething!=expected;
+      if(hitSomething && expected)
+      {
+        ngl::Real objectT;
+        mismatches+=std::abs(t-nearest)>1e-3f || !hit(_boxes[object],p,direction,100.0f,objectT);
+      }
+    }
+    CHECK(mismatches==0);
+
+    std::vector<LinearBVH::Pair> pairs;
+    _tree.queryPairs(pairs);
+    for(auto &pair : pairs)
+    {
+      if(pair.first>pair.second)
+      {
+        std::swap(pair.first,pair.second);
+      }
+    }
+    std::sort(pairs.begin(),pairs.end());
+    std::vector<LinearBVH::Pair> expected;
+    for(uint32_t i=0; i<_boxes.size(); ++i)
+    {
+      for(uint32_t j=i+1; j<_boxes.size(); ++j)
+      {
+        if(_boxes[i].overlaps(_boxes[j]))
+        {
+          expected.push_back({i,j});
+        }
+      }
+    }
+    CHECK(pairs==expected);
+  }
+}
+
+int main()
+{
+  std::mt19937 rng(1234);
+  std::vector<AABB> boxes=randomBoxes(c_numBoxes,rng);
+  WorkerPool serial(1);
+  WorkerPool pool(4);
+  for(auto bits : {LinearBVH::CodeBits::BITS30,LinearBVH::CodeBits::BITS63})
+  {
+    for(WorkerPool *p : {&serial,&pool})
+    {
+      LinearBVH tree(p);
+      tree.build(boxes.data(),boxes.size(),bits);
+      checkQueries(tree,boxes,rng);
+    }
+  }
+
+  // no boxes and one box
+  LinearBVH tree(&pool);
+  tree.build(boxes.data(),0);
+  std::vector<uint32_t> found;
+  tree.queryBox(AABB(ngl::Vec3(-100,-100,-100),ngl::Vec3(100,100,100)),found);
+  CHECK(tree.size()==0 && found.empty() && tree.bounds().isEmpty() && tree.sahCost()==0.0);
+  tree.build(boxes.data(),1);
+  tree.queryBox(boxes[0],found);
+  CHECK(found.size()==1 && found[0]==0 && tree.sahCost()==1.0);
+
+  // refitting to the boxes it was built from leaves the tree as it was
+  tree.build(boxes.data(),boxes.size());
+  double builtCost=tree.sahCost();
+  CHECK(builtCost>1.0);
+  tree.refit(boxes.data());
+  CHECK(std::abs(tree.sahCost()-builtCost)<=1e-9*builtCost);
+
+  // a small drift keeps the queries right, scattering the boxes keeps them right but the
+  // refitted tree then costs more than a fresh build
+  std::normal_distribution<ngl::Real> drift(0.0f,0.5f);
+  for(auto &box : boxes)
+  {
+    ngl::Vec3 d(drift(rng),drift(rng),drift(rng));
+    box=AABB(box.m_min+d,box.m_max+d);
+  }
+  tree.refit(boxes.data());
+  checkQueries(tree,boxes,rng);
+  std::vector<AABB> scattered=randomBoxes(c_numBoxes,rng);
+  tree.refit(scattered.data());
+  checkQueries(tree,scattered,rng);
+  LinearBVH rebuilt(&pool);
+  rebuilt.build(scattered.data(),scattered.size());
+  CHECK(tree.sahCost()>2.0*rebuilt.sahCost());
+  return unittest::finish("linear_bvh_test");
+}
@@ -0,0 +1,146 @@
+// QuantizedVertex: half floats against every half value and random floats, positions
+// through dequantizeMatrix within half a step of where they started, and octahedral normals.
+#include "QuantizedVertex.h"
+#include "UnitTest.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace
+{
+  // the decode the vertex shader does, 0-1 in the box through the matrix as a row vector
+  ngl::Vec3 dequantize(const QuantizedVertex &_q, const ngl::Mat4 &_m)
+  {
+    ngl::Vec3 p;
+    for(int j=0; j<3; ++j)
+    {
+      p[j]=_m.m_m[3][j];
+      for(int i=0; i<3; ++i)
+      {
+        p[j]+=_q.m_position[i]/65535.0f*_m.m_m[i][j];
+      }
+    }
+    return p;
+  }
+
+  ngl::Vec3 randomUnit(std::mt19937 &_rng)
+  {
+    std::normal_distribution<ngl::Real> gauss(0.0f,1.0f);
+    ngl::Vec3 n;
+    do
+    {
+      n.set(gauss(_rng),gauss(_rng),gauss(_rng));
+    } while(n.length()<1e-3f);
+    n.normalize();
+    return n;
+  }
+
+  // atan2 as acos of the dot product cannot resolve the small angles measured here
+  ngl::Real degreesBetween(const ngl::Vec3 &_a, const ngl::Vec3 &_b)
+  {
+    return std::atan2(_a.cross(_b).length(),_a.dot(_b))*57.29578f;
+  }
+}
+
+int main()
+{
+  // every half that is not a NaN survives a round trip, NaNs stay NaN
+  size_t roundTrip=0;
+  for(uint32_t h=0; h<=0xffffu; ++h)
+  {
+    float f=QuantizedVertex::fromHalf(static_cast<uint16_t>(h));
+    if(std::isnan(f))
+    {
+      CHECK(std::isnan(QuantizedVertex::fromHalf(QuantizedVertex::toHalf(f))));
+    }
+    else
+    {
+      roundTrip+=QuantizedVertex::toHalf(f)!=h;
+    }
+  }
+  CHECK(roundTrip==0);
+  CHECK(QuantizedVertex::fromHalf(QuantizedVertex::toHalf(1.0f))==1.0f);
+  CHECK(QuantizedVertex::fromHalf(QuantizedVertex::toHalf(-0.375f))==-0.375f);
+  CHECK(QuantizedVertex::toHalf(65504.0f)==0x7bffu);
+  CHECK(QuantizedVertex::toHalf(1e6f)==0x7c00u);
+  CHECK(QuantizedVertex::toHalf(-1e6f)==0xfc00u);
+  CHECK(QuantizedVertex::toHalf(std::numeric_limits<float>::infinity())==0x7c00u);
+  CHECK(QuantizedVertex::toHalf(1e-9f)==0);
+
+  // anything in range rounds to within half a step of the nearest half, normal or denormal
+  std::mt19937 rng(1234);
+  std::uniform_real_distribution<float> exponent(-26.0f,15.0f);
+  size_t badRounding=0;
+  for(int i=0; i<100000; ++i)
+  {
+    float f=std::exp2(exponent(rng))*(i & 1 ? -1.0f : 1.0f);
+    int e;
+    std::frexp(f,&e);
+    float step=std::ldexp(1.0f,std::max(e,-13)-11);
+    badRounding+=std::abs(QuantizedVertex::fromHalf(QuantizedVertex::toHalf(f))-f)>0.5f*step;
+  }
+  CHECK(badRounding==0);
+
+  // positions come back within half a 16 bit step of each axis of the box, the box corners
+  // exactly, and a flat axis comes back as the plane it lies in
+  std::uniform_real_distribution<ngl::Real> unit(0.0f,1.0f);
+  AABB range(ngl::Vec3(-3.0f,10.0f,2.0f),ngl::Vec3(5.0f,10.5f,2.0f));
+  ngl::Mat4 m=QuantizedVertex::dequantizeMatrix(range);
+  ngl::Vec3 extent=range.size();
+  size_t badPositions=0;
+  for(int i=0; i<10000; ++i)
+  {
+    IndexedMesh::Vertex v={};
+    v.m_x=range.m_min.m_x+unit(rng)*extent.m_x;
+    v.m_y=range.m_min.m_y+unit(rng)*extent.m_y;
+    v.m_z=range.m_min.m_z;
+    v.m_nz=1.0f;
+    if(i<2)
+    {
+      v.m_x= i ? range.m_max.m_x : range.m_min.m_x;
+      v.m_y= i ? range.m_max.m_y : range.m_min.m_y;
+    }
+    ngl::Vec3 p=dequantize(QuantizedVertex::encode(v,range),m);
+    badPositions+=std::abs(p.m_x-v.m_x)>0.5f*extent.m_x/65535.0f+1e-6f ||
+                  std::abs(p.m_y-v.m_y)>0.5f*extent.m_y/65535.0f+1e-6f ||
+                  p.m_z!=v.m_z;
+    if(i<2)
+    {
+      CHECK(p.m_x==v.m_x && p.m_y==v.m_y);
+    }
+  }
+  CHECK(badPositions==0);
+
+  // normals: the float octahedral round trip is near exact, the 16 bit one within a few
+  // hundredths of a degree, and the axes and a zero normal land where they should
+  ngl::Real worstFloat=0.0f;
+  ngl::Real worstPacked=0.0f;
+  for(int i=0; i<10000; ++i)
+  {
+    ngl::Vec3 n=randomUnit(rng);
+    ngl::Real x,y;
+    QuantizedVertex::octEncode(n,x,y);
+    CHECK(std::abs(x)<=1.0f && std::abs(y)<=1.0f);
+    worstFloat=std::max(worstFloat,degreesBetween(n,QuantizedVertex::octDecode(x,y)));
+    IndexedMesh::Vertex v={};
+    v.m_nx=n.m_x;
+    v.m_ny=n.m_y;
+    v.m_nz=n.m_z;
+    QuantizedVertex q=QuantizedVertex::encode(v,range);
+    ngl::Vec3 decoded=QuantizedVertex::octDecode(std::max(-1.0f,q.m_normal[0]/32767.0f),std::max(-1.0f,q.m_normal[1]/32767.0f));
+    worstPacked=std::max(worstPacked,degreesBetween(n,decoded));
+  }
+  CHECK(worstFloat<0.01f);
+  CHECK(worstPacked<0.05f);
+  for(const ngl::Vec3 &axis : {ngl::Vec3(1,0,0),ngl::Vec3(0,-1,0),ngl::Vec3(0,0,1),ngl::Vec3(0,0,-1)})
+  {
+    ngl::Real x,y;
+    QuantizedVertex::octEncode(axis,x,y);
+    CHECK(degreesBetween(axis,QuantizedVertex::octDecode(x,y))<1e-3f);
+  }
+  ngl::Real x,y;
+  QuantizedVertex::octEncode(ngl::Vec3(0,0,0),x,y);
+  CHECK(x==0.0f && y==0.0f);
+  return unittest::finish("quantized_vertex_test");
+}